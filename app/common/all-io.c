@@ -69,6 +69,64 @@ ssize_t read_all(int fd, char *buf, size_t count)
     return c;
 }
 
+/*
+ * pread() until @count bytes are read or the end of the file is reached.
+ * Returns the bytes read, or -1 with errno set if nothing could be read.
+ */
+ssize_t pread_all(int fd, void *buf, size_t count, off_t off)
+{
+    ssize_t ret;
+    ssize_t c = 0;
+    int tries = 0;
+
+    while (count > 0) {
+        ret = pread(fd, (char *) buf + c, count, off + c);
+        if (ret < 0) {
+            if ((errno == EAGAIN || errno == EINTR) && (tries++ < 5)) {
+                if (errno == EAGAIN)
+                    xusleep(250000);
+                continue;
+            }
+            return c ? c : -1;
+        }
+        if (ret == 0)
+            return c;
+        tries = 0;
+        count -= ret;
+        c += ret;
+    }
+    return c;
+}
+
+/*
+ * pwrite() all @count bytes at @off. Returns 0, or -1 with errno set; a
+ * write which makes no progress fails with EIO.
+ */
+int pwrite_all(int fd, const void *buf, size_t count, off_t off)
+{
+    while (count) {
+        ssize_t tmp;
+
+        errno = 0;
+        tmp = pwrite(fd, buf, count, off);
+        if (tmp > 0) {
+            count -= tmp;
+            off += tmp;
+            buf = (const void *) ((const char *) buf + tmp);
+            continue;
+        }
+        if (tmp == 0) {
+            errno = EIO;
+            return -1;
+        }
+        if (errno != EINTR && errno != EAGAIN)
+            return -1;
+        if (errno == EAGAIN)	/* Try later, *sigh* */
+            xusleep(250000);
+    }
+    return 0;
+}
+
 ssize_t sendfile_all(int out, int in, off_t *off, size_t count)
 {
 #if defined(HAVE_SENDFILE) && defined(__linux__)
@@ -14,7 +14,9 @@
 #include "global.h"
 
 ssize_t read_all(int fd, char *buf, size_t count);
+ssize_t pread_all(int fd, void *buf, size_t count, off_t off);
 int write_all(int fd, const void *buf, size_t count);
+int pwrite_all(int fd, const void *buf, size_t count, off_t off);
 ssize_t sendfile_all(int out, int in, off_t *off, size_t count);
 int fwrite_all(const void *ptr, size_t size, size_t nmemb, FILE *stream);
 
@@ -0,0 +1,569 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                 /* statx() */
+#endif
+
+#include "async-io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+
+/* no liburing, the three syscalls are all we need */
+# ifndef __NR_io_uring_setup
+#  define __NR_io_uring_setup       425
+# endif
+# ifndef __NR_io_uring_enter
+#  define __NR_io_uring_enter       426
+# endif
+# ifndef __NR_io_uring_register
+#  define __NR_io_uring_register    427
+# endif
+
+/* the len field of a read SQE is 32 bits */
+# define ASYNC_IO_URING_MAX_READ    (1U << 30)
+#endif
+
+static void async_io_dispatch(AsyncIo* aio, AsyncIoReq* req);
+static void async_io_refill(AsyncIo* aio);
+static void async_io_execute(AsyncIoReq* req);
+static void* async_io_worker(void* arg);
+static int async_io_pool_init(AsyncIo* aio);
+static void async_io_pool_deinit(AsyncIo* aio);
+static int async_io_pool_wait(AsyncIo* aio, unsigned int min);
+#ifdef HAVE_LINUX_IO_URING_H
+static int async_io_uring_supported(int fd);
+static int async_io_uring_init(AsyncIo* aio);
+static void async_io_uring_deinit(AsyncIo* aio);
+static void async_io_uring_queue(AsyncIo* aio, AsyncIoReq* req);
+static void async_io_uring_reclaim(AsyncIo* aio, AsyncIoReq*** last);
+static int async_io_uring_wait(AsyncIo* aio, unsigned int min);
+#endif
+
+static void async_io_dispatch(AsyncIo* aio, AsyncIoReq* req)
+{
+    req->next = NULL;
+
+    if (aio->inflight >= aio->depth) {
+        if (aio->backlogTail)
+            aio->backlogTail->next = req;
+        else
+            aio->backlog = req;
+        aio->backlogTail = req;
+        return;
+    }
+    aio->inflight++;
+
+#ifdef HAVE_LINUX_IO_URING_H
+    if (aio->backend == ASYNC_IO_BACKEND_URING) {
+        async_io_uring_queue(aio, req);
+        return;
+    }
+#endif
+
+    pthread_mutex_lock(&aio->lock);
+    if (aio->pendingTail)
+        aio->pendingTail->next = req;
+    else
+        aio->pending = req;
+    aio->pendingTail = req;
+    pthread_cond_signal(&aio->workCond);
+    pthread_mutex_unlock(&aio->lock);
+}
+
+/* move backlogged requests into the slots completions have freed */
+static void async_io_refill(AsyncIo* aio)
+{
+    while (aio->backlog && aio->inflight < aio->depth) {
+        AsyncIoReq* req = aio->backlog;
+
+        aio->backlog = req->next;
+        if (!aio->backlog)
+            aio->backlogTail = NULL;
+        async_io_dispatch(aio, req);
+    }
+}
+
+/* the blocking version of a request, run by the pool */
+static void async_io_execute(AsyncIoReq* req)
+{
+    ssize_t ret;
+
+    switch (req->op) {
+        case ASYNC_IO_OPENAT:
+            ret = openat(req->fd, req->path, req->flags, (mode_t) req->mode);
+            req->res = ret < 0 ? -errno : ret;
+            break;
+        case ASYNC_IO_STATX:
+            ret = statx(req->fd, req->path, req->flags, req->mode, (struct statx*) req->buf);
+            req->res = ret < 0 ? -errno : 0;
+            break;
+        case ASYNC_IO_READ:
+            ret = 0;
+            while (req->done < req->len) {
+                ret = pread(req->fd, (char*) req->buf + req->done, req->len - req->done,
+                            (off_t) (req->off + req->done));
+                if (ret < 0) {
+                    if (errno == EINTR || errno == EAGAIN)
+                        continue;
+                    ret = -errno;
+                    break;
+                }
+                if (ret == 0)
+                    break;
+                req->done += ret;
+            }
+            req->res = ret < 0 && !req->done ? ret : (ssize_t) req->done;
+            break;
+        case ASYNC_IO_CLOSE:
+            req->res = close(req->fd) < 0 ? -errno : 0;
+            break;
+        default:
+            req->res = -EINVAL;
+            break;
+    }
+}
+
+static void* async_io_worker(void* arg)
+{
+    AsyncIo* aio = (AsyncIo*) arg;
+
+    pthread_mutex_lock(&aio->lock);
+    while (1) {
+        AsyncIoReq* req;
+
+        while (!aio->pending && !aio->stop)
+            pthread_cond_wait(&aio->workCond, &aio->lock);
+        if (!aio->pending)
+            break;
+
+        req = aio->pending;
+        aio->pending = req->next;
+        if (!aio->pending)
+            aio->pendingTail = NULL;
+        pthread_mutex_unlock(&aio->lock);
+
+        async_io_execute(req);
+
+        pthread_mutex_lock(&aio->lock);
+        req->next = aio->completed;
+        aio->completed = req;
+        pthread_cond_signal(&aio->doneCond);
+    }
+    pthread_mutex_unlock(&aio->lock);
+
+    return NULL;
+}
+
+static int async_io_pool_init(AsyncIo* aio)
+{
+    unsigned int i;
+    int err = 0;
+
+    aio->backend = ASYNC_IO_BACKEND_THREADS;
+    aio->nthreads = aio->depth < ASYNC_IO_THREADS ? aio->depth : ASYNC_IO_THREADS;
+    aio->threads = calloc(aio->nthreads, sizeof(pthread_t));
+    if (!aio->threads)
+        return -ENOMEM;
+
+    pthread_mutex_init(&aio->lock, NULL);
+    pthread_cond_init(&aio->workCond, NULL);
+    pthread_cond_init(&aio->doneCond, NULL);
+
+    for (i = 0; i < aio->nthreads; i++) {
+        err = pthread_create(&aio->threads[i], NULL, async_io_worker, aio);
+        if (err)
+            break;
+    }
+    /* fewer workers only mean less parallelism */
+    aio->nthreads = i;
+    if (!i) {
+        async_io_pool_deinit(aio);
+        return -err;
+    }
+
+    return 0;
+}
+
+static void async_io_pool_deinit(AsyncIo* aio)
+{
+    unsigned int i;
+
+    pthread_mutex_lock(&aio->lock);
+    aio->stop = 1;
+    pthread_cond_broadcast(&aio->workCond);
+    pthread_mutex_unlock(&aio->lock);
+
+    for (i = 0; i < aio->nthreads; i++)
+        pthread_join(aio->threads[i], NULL);
+    free(aio->threads);
+    aio->threads = NULL;
+    aio->nthreads = 0;
+
+    pthread_cond_destroy(&aio->doneCond);
+    pthread_cond_destroy(&aio->workCond);
+    pthread_mutex_destroy(&aio->lock);
+}
+
+static int async_io_pool_wait(AsyncIo* aio, unsigned int min)
+{
+    int handled = 0;
+
+    while (1) {
+        AsyncIoReq* list;
+
+        pthread_mutex_lock(&aio->lock);
+        while (!aio->completed && aio->inflight > 0 && (unsigned int) handled < min)
+            pthread_cond_wait(&aio->doneCond, &aio->lock);
+        list = aio->completed;
+        aio->completed = NULL;
+        pthread_mutex_unlock(&aio->lock);
+
+        /* callbacks run unlocked, they may submit more */
+        while (list) {
+            AsyncIoReq* req = list;
+
+            list = req->next;
+            aio->inflight--;
+            handled++;
+            if (req->func)
+                req->func(req, req->data);
+        }
+        async_io_refill(aio);
+
+        if ((unsigned int) handled >= min || !aio->inflight)
+            break;
+    }
+
+    return handled;
+}
+
+#ifdef HAVE_LINUX_IO_URING_H
+/* IORING_REGISTER_PROBE came with 5.6, as did all operations used here */
+static int async_io_uring_supported(int fd)
+{
+    static const int ops[] = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE };
+    struct io_uring_probe* probe;
+    size_t i;
+    int ok = 1;
+
+    probe = calloc(1, sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op));
+    if (!probe)
+        return 0;
+
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+        free(probe);
+        return 0;
+    }
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+            ok = 0;
+    }
+    free(probe);
+
+    return ok;
+}
+
+static int async_io_uring_init(AsyncIo* aio)
+{
+    struct io_uring_params p;
+    unsigned char* sq, *cq;
+    int fd, rc;
+
+    memset(&p, 0, sizeof(p));
+    fd = (int) syscall(__NR_io_uring_setup, aio->depth, &p);
+    if (fd < 0)
+        return -errno;
+    if (!async_io_uring_supported(fd)) {
+        close(fd);
+        return -EOPNOTSUPP;
+    }
+
+    aio->ringFd = fd;
+    aio->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    aio->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (aio->cqRingSize > aio->sqRingSize)
+            aio->sqRingSize = aio->cqRingSize;
+        aio->cqRingSize = 0;
+    }
+
+    aio->sqRing = mmap(NULL, aio->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       fd, IORING_OFF_SQ_RING);
+    if (aio->sqRing == MAP_FAILED)
+        goto fail;
+
+    /* a single mapping carries both rings, cqRingSize 0 marks that */
+    aio->cqRing = aio->sqRing;
+    if (aio->cqRingSize) {
+        aio->cqRing = mmap(NULL, aio->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           fd, IORING_OFF_CQ_RING);
+        if (aio->cqRing == MAP_FAILED)
+            goto fail;
+    }
+
+    aio->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    aio->sqes = mmap(NULL, aio->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (aio->sqes == MAP_FAILED)
+        goto fail;
+
+    sq = (unsigned char*) aio->sqRing;
+    cq = (unsigned char*) aio->cqRing;
+    aio->sqHead = (unsigned int*) (sq + p.sq_off.head);
+    aio->sqTail = (unsigned int*) (sq + p.sq_off.tail);
+    aio->sqMask = *(unsigned int*) (sq + p.sq_off.ring_mask);
+    aio->sqArray = (unsigned int*) (sq + p.sq_off.array);
+    aio->cqHead = (unsigned int*) (cq + p.cq_off.head);
+    aio->cqTail = (unsigned int*) (cq + p.cq_off.tail);
+    aio->cqMask = *(unsigned int*) (cq + p.cq_off.ring_mask);
+    aio->cqes = cq + p.cq_off.cqes;
+
+    /* the kernel rounds up, the CQ ring is twice as large and never overflows */
+    if (aio->depth > p.sq_entries)
+        aio->depth = p.sq_entries;
+    aio->backend = ASYNC_IO_BACKEND_URING;
+
+    return 0;
+
+fail:
+    rc = -errno;
+    async_io_uring_deinit(aio);
+    return rc;
+}
+
+static void async_io_uring_deinit(AsyncIo* aio)
+{
+    if (aio->sqes && aio->sqes != MAP_FAILED)
+        munmap(aio->sqes, aio->sqesSize);
+    if (aio->cqRingSize && aio->cqRing && aio->cqRing != MAP_FAILED)
+        munmap(aio->cqRing, aio->cqRingSize);
+    if (aio->sqRing && aio->sqRing != MAP_FAILED)
+        munmap(aio->sqRing, aio->sqRingSize);
+    if (aio->ringFd >= 0)
+        close(aio->ringFd);
+
+    aio->sqes = aio->sqRing = aio->cqRing = NULL;
+    aio->ringFd = -1;
+}
+
+/* there is always room: unconsumed SQEs never outnumber the requests in flight */
+static void async_io_uring_queue(AsyncIo* aio, AsyncIoReq* req)
+{
+    unsigned int tail = *aio->sqTail;
+    unsigned int idx = tail & aio->sqMask;
+    struct io_uring_sqe* sqe = &((struct io_uring_sqe*) aio->sqes)[idx];
+    size_t len;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = req->fd;
+    sqe->user_data = (uint64_t) (uintptr_t) req;
+
+    switch (req->op) {
+        case ASYNC_IO_OPENAT:
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->addr = (uint64_t) (uintptr_t) req->path;
+            sqe->len = req->mode;
+            sqe->open_flags = (uint32_t) req->flags;
+            break;
+        case ASYNC_IO_STATX:
+            sqe->opcode = IORING_OP_STATX;
+            sqe->addr = (uint64_t) (uintptr_t) req->path;
+            sqe->len = req->mode;
+            sqe->off = (uint64_t) (uintptr_t) req->buf;
+            sqe->statx_flags = (uint32_t) req->flags;
+            break;
+        case ASYNC_IO_READ:
+            len = req->len - req->done;
+            sqe->opcode = IORING_OP_READ;
+            sqe->addr = (uint64_t) (uintptr_t) ((char*) req->buf + req->done);
+            sqe->len = len < ASYNC_IO_URING_MAX_READ ? (uint32_t) len : ASYNC_IO_URING_MAX_READ;
+            sqe->off = req->off + req->done;
+            break;
+        case ASYNC_IO_CLOSE:
+            sqe->opcode = IORING_OP_CLOSE;
+            break;
+        default:
+            sqe->opcode = IORING_OP_NOP;
+            break;
+    }
+
+    aio->sqArray[idx] = idx;
+    __atomic_store_n(aio->sqTail, tail + 1, __ATOMIC_RELEASE);
+    aio->toSubmit++;
+}
+
+/*
+ * io_uring_enter() failed for good. The kernel only consumes SQEs inside
+ * io_uring_enter(), so the ones it has not taken are pulled back out of the
+ * ring and run here the blocking way, like the pool would; the ones it has
+ * taken still complete into the CQ ring. Either way every request reaches
+ * its callback and nothing is freed while the kernel may still use it.
+ */
+static void async_io_uring_reclaim(AsyncIo* aio, AsyncIoReq*** last)
+{
+    unsigned int first = __atomic_load_n(aio->sqHead, __ATOMIC_ACQUIRE);
+    unsigned int head, tail = *aio->sqTail;
+
+    for (head = first; head != tail; head++) {
+        struct io_uring_sqe* sqe = &((struct io_uring_sqe*) aio->sqes)[aio->sqArray[head & aio->sqMask]];
+        AsyncIoReq* req = (AsyncIoReq*) (uintptr_t) sqe->user_data;
+
+        async_io_execute(req);
+        **last = req;
+        *last = &req->next;
+    }
+    __atomic_store_n(aio->sqTail, first, __ATOMIC_RELEASE);
+    aio->toSubmit = 0;
+}
+
+static int async_io_uring_wait(AsyncIo* aio, unsigned int min)
+{
+    static const struct timespec pause = { 0, 1000000 };
+    int handled = 0;
+
+    while (1) {
+        unsigned int want = (unsigned int) handled < min ? min - handled : 0;
+        AsyncIoReq* list = NULL, **last = &list;
+        unsigned int head, tail;
+
+        if (aio->toSubmit || want) {
+            long ret = syscall(__NR_io_uring_enter, aio->ringFd, aio->toSubmit, want,
+                               want ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+            if (ret >= 0) {
+                aio->toSubmit -= (unsigned int) ret;
+            } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                if (aio->toSubmit)
+                    async_io_uring_reclaim(aio, &last);
+                else
+                    /* cannot block in the kernel, look at the CQ ring every now and then */
+                    nanosleep(&pause, NULL);
+            }
+        }
+
+        head = *aio->cqHead;
+        tail = __atomic_load_n(aio->cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe* cqe = &((struct io_uring_cqe*) aio->cqes)[head & aio->cqMask];
+            AsyncIoReq* req = (AsyncIoReq*) (uintptr_t) cqe->user_data;
+            int res = cqe->res;
+
+            if (req->op == ASYNC_IO_READ) {
+                if (res == -EINTR || res == -EAGAIN) {
+                    async_io_uring_queue(aio, req);
+                    continue;
+                }
+                if (res > 0) {
+                    req->done += res;
+                    /* short read, go on with the rest */
+                    if (req->done < req->len) {
+                        async_io_uring_queue(aio, req);
+                        continue;
+                    }
+                }
+                req->res = res < 0 && !req->done ? res : (ssize_t) req->done;
+            } else {
+                req->res = res;
+            }
+            *last = req;
+            last = &req->next;
+        }
+        *last = NULL;
+        __atomic_store_n(aio->cqHead, head, __ATOMIC_RELEASE);
+
+        while (list) {
+            AsyncIoReq* req = list;
+
+            list = req->next;
+            aio->inflight--;
+            handled++;
+            if (req->func)
+                req->func(req, req->data);
+        }
+        async_io_refill(aio);
+
+        if ((!aio->toSubmit && (unsigned int) handled >= min) || !aio->inflight)
+            break;
+    }
+
+    return handled;
+}
+#endif
+
+int async_io_init(AsyncIo* aio, unsigned int depth, unsigned int flags)
+{
+    memset(aio, 0, sizeof(*aio));
+    aio->ringFd = -1;
+    aio->depth = depth ? depth : ASYNC_IO_DEPTH;
+
+#ifdef HAVE_LINUX_IO_URING_H
+    if (!(flags & ASYNC_IO_NO_URING) && async_io_uring_init(aio) == 0)
+        return 0;
+#else
+    (void) flags;
+#endif
+
+    return async_io_pool_init(aio);
+}
+
+void async_io_deinit(AsyncIo* aio)
+{
+    async_io_run(aio);
+
+#ifdef HAVE_LINUX_IO_URING_H
+    if (aio->backend == ASYNC_IO_BACKEND_URING) {
+        async_io_uring_deinit(aio);
+        return;
+    }
+#endif
+    async_io_pool_deinit(aio);
+}
+
+void async_io_submit(AsyncIo* aio, AsyncIoReq* req)
+{
+    req->res = 0;
+    req->done = 0;
+    async_io_dispatch(aio, req);
+}
+
+int async_io_wait(AsyncIo* aio, unsigned int min)
+{
+    if (!aio->inflight && !aio->backlog)
+        return 0;
+
+#ifdef HAVE_LINUX_IO_URING_H
+    if (aio->backend == ASYNC_IO_BACKEND_URING)
+        return async_io_uring_wait(aio, min);
+#endif
+
+    return async_io_pool_wait(aio, min);
+}
+
+void async_io_run(AsyncIo* aio)
+{
+    while (aio->inflight || aio->backlog)
+        async_io_wait(aio, 1);
+}
+
+const char* async_io_backend_to_name(AsyncIoBackend backend)
+{
+    switch (backend) {
+        case ASYNC_IO_BACKEND_URING:
+            return "io_uring";
+        case ASYNC_IO_BACKEND_THREADS:
+            return "threads";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,135 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_ASYNC_IO_H
+#define GRACEFUL_PARTITION_ASYNC_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+/* requests in flight if the caller passes 0 */
+#define ASYNC_IO_DEPTH              64
+
+/* upper bound of worker threads of the fallback */
+#define ASYNC_IO_THREADS            16
+
+/* async_io_init() flags */
+#define ASYNC_IO_NO_URING           (1 << 0)            /* always use the thread pool */
+
+typedef struct _AsyncIo             AsyncIo;
+typedef struct _AsyncIoReq          AsyncIoReq;
+
+typedef void (*AsyncIoFunc) (AsyncIoReq* req, void* data);
+
+typedef enum
+{
+    ASYNC_IO_BACKEND_URING = 0,
+    ASYNC_IO_BACKEND_THREADS,
+} AsyncIoBackend;
+
+typedef enum
+{
+    ASYNC_IO_OPENAT = 0,
+    ASYNC_IO_STATX,
+    ASYNC_IO_READ,
+    ASYNC_IO_CLOSE,
+} AsyncIoOp;
+
+/*
+ * One operation. The request and everything it points to belong to the
+ * caller until @func has been called.
+ */
+struct _AsyncIoReq
+{
+    AsyncIoOp                       op;
+    int                             fd;                 /* dirfd for openat and statx */
+    const char*                     path;
+    int                             flags;              /* open flags or AT_* flags */
+    unsigned int                    mode;               /* open mode or statx mask */
+
+    void*                           buf;                /* read buffer or struct statx */
+    size_t                          len;
+    uint64_t                        off;
+
+    AsyncIoFunc                     func;               /* called from async_io_wait() */
+    void*                           data;
+    ssize_t                         res;                /* fd, bytes read (short only at EOF) or -errno */
+
+    /* private */
+    size_t                          done;
+    AsyncIoReq*                     next;
+};
+
+struct _AsyncIo
+{
+    AsyncIoBackend                  backend;
+    unsigned int                    depth;
+    unsigned int                    inflight;           /* handed to the kernel or the pool */
+    AsyncIoReq*                     backlog;            /* waiting for a free slot */
+    AsyncIoReq*                     backlogTail;
+
+    /* io_uring */
+    int                             ringFd;
+    void*                           sqRing;
+    size_t                          sqRingSize;
+    void*                           cqRing;
+    size_t                          cqRingSize;
+    void*                           sqes;
+    size_t                          sqesSize;
+    unsigned int*                   sqHead;
+    unsigned int*                   sqTail;
+    unsigned int                    sqMask;
+    unsigned int*                   sqArray;
+    unsigned int*                   cqHead;
+    unsigned int*                   cqTail;
+    unsigned int                    cqMask;
+    void*                           cqes;
+    unsigned int                    toSubmit;           /* queued in the SQ ring, not entered yet */
+
+    /* thread pool */
+    pthread_t*                      threads;
+    unsigned int                    nthreads;
+    pthread_mutex_t                 lock;
+    pthread_cond_t                  workCond;
+    pthread_cond_t                  doneCond;
+    AsyncIoReq*                     pending;
+    AsyncIoReq*                     pendingTail;
+    AsyncIoReq*                     completed;
+    int                             stop;
+};
+
+/*
+ * Set up a ring of @depth entries (0 for ASYNC_IO_DEPTH). Falls back to a
+ * pool of worker threads if the kernel has no io_uring, or it lacks one of
+ * the operations. Returns 0 or -errno.
+ */
+int async_io_init(AsyncIo* aio, unsigned int depth, unsigned int flags);
+
+/* waits for everything in flight, then tears down */
+void async_io_deinit(AsyncIo* aio);
+
+/*
+ * Queue @req. Nothing blocks here: with io_uring the request goes to the SQ
+ * ring and is handed to the kernel, together with the others, at the next
+ * async_io_wait(). Beyond @depth requests wait in a backlog.
+ */
+void async_io_submit(AsyncIo* aio, AsyncIoReq* req);
+
+/*
+ * Submit what is queued, wait for at least @min completions and call their
+ * callbacks, which may submit new requests. Returns the number of
+ * completions handled or 0 if nothing is in flight. Errors are reported per
+ * request: if the ring stops taking submissions, the requests it refused
+ * run synchronously instead.
+ */
+int async_io_wait(AsyncIo* aio, unsigned int min);
+
+/* wait until nothing is queued or in flight anymore */
+void async_io_run(AsyncIo* aio);
+
+const char* async_io_backend_to_name(AsyncIoBackend backend);
+
+#endif //GRACEFUL_PARTITION_ASYNC_IO_H
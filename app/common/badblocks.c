@@ -0,0 +1,465 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "badblocks.h"
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#include "blkra.h"
+#include "all-io.h"
+#include "blkdev.h"
+#include "bitops.h"
+#include "bufpool.h"
+
+#define BADBLOCKS_LEAF_BYTES        (BADBLOCKS_LEAF_SECTORS / NBBY)
+
+typedef struct _BadBlocksJob        BadBlocksJob;
+
+struct _BadBlocksJob
+{
+    int                             fd;
+    int                             direct;
+    BadBlocks*                      bb;
+    BadBlocksMode                   mode;
+    uint32_t                        pattern;
+    unsigned int                    sectorSize;
+
+    uint64_t                        next;               /* atomic, next chunk */
+    uint64_t                        end;
+    uint64_t                        chunk;
+    uint64_t                        done;               /* atomic */
+    int                             rc;                 /* atomic, first error */
+    BlkReadahead                    ra;                 /* buffered reads only */
+
+    pthread_mutex_t                 lock;
+    pthread_cond_t                  cond;
+    unsigned int                    running;
+};
+
+static double badblocks_now(void);
+static int badblocks_is_media_error(int err);
+static int badblocks_pio(BadBlocksJob* job, int write, unsigned char* buf, uint64_t start, uint64_t len);
+static void badblocks_fill(BadBlocksJob* job, unsigned char* buf, uint64_t start, uint64_t len);
+static int badblocks_check(BadBlocksJob* job, unsigned char* buf, unsigned char* vbuf, uint64_t start, uint64_t len);
+static void* badblocks_worker(void* arg);
+static void badblocks_progress(BadBlocksJob* job, double start, uint64_t total, BadBlocksProgress* p);
+
+int badblocks_init(BadBlocks* bb, uint64_t nsectors, unsigned int sectorSize)
+{
+    memset(bb, 0, sizeof(*bb));
+    if (!sectorSize)
+        return -EINVAL;
+
+    bb->nsectors = nsectors;
+    bb->sectorSize = sectorSize;
+    bb->nleaves = (size_t) ((nsectors + BADBLOCKS_LEAF_SECTORS - 1) >> BADBLOCKS_LEAF_SHIFT);
+    if (bb->nleaves) {
+        bb->leaves = calloc(bb->nleaves, sizeof(unsigned char*));
+        if (!bb->leaves)
+            return -ENOMEM;
+    }
+    pthread_mutex_init(&bb->lock, NULL);
+
+    return 0;
+}
+
+void badblocks_deinit(BadBlocks* bb)
+{
+    size_t i;
+
+    if (bb->leaves) {
+        for (i = 0; i < bb->nleaves; i++)
+            free(bb->leaves[i]);
+        free(bb->leaves);
+    }
+    if (bb->sectorSize)
+        pthread_mutex_destroy(&bb->lock);
+    memset(bb, 0, sizeof(*bb));
+}
+
+int badblocks_mark(BadBlocks* bb, uint64_t sector, uint64_t count)
+{
+    int rc = 0;
+
+    if (sector >= bb->nsectors || count > bb->nsectors - sector)
+        return -ERANGE;
+
+    pthread_mutex_lock(&bb->lock);
+    for (; count; sector++, count--) {
+        unsigned char** leaf = &bb->leaves[sector >> BADBLOCKS_LEAF_SHIFT];
+        uint64_t i = sector & (BADBLOCKS_LEAF_SECTORS - 1);
+
+        if (!*leaf) {
+            *leaf = calloc(1, BADBLOCKS_LEAF_BYTES);
+            if (!*leaf) {
+                rc = -ENOMEM;
+                break;
+            }
+        }
+        if (isclr(*leaf, i)) {
+            setbit(*leaf, i);
+            bb->nbad++;
+        }
+    }
+    pthread_mutex_unlock(&bb->lock);
+
+    return rc;
+}
+
+int badblocks_is_bad(const BadBlocks* bb, uint64_t sector)
+{
+    const unsigned char* leaf;
+
+    if (sector >= bb->nsectors)
+        return 0;
+    leaf = bb->leaves[sector >> BADBLOCKS_LEAF_SHIFT];
+
+    return leaf && isset(leaf, sector & (BADBLOCKS_LEAF_SECTORS - 1));
+}
+
+int badblocks_next_range(const BadBlocks* bb, uint64_t from, uint64_t* start, uint64_t* count)
+{
+    uint64_t s = from, e;
+
+    /* whole leaves and whole bytes are skipped at once */
+    while (s < bb->nsectors) {
+        const unsigned char* leaf = bb->leaves[s >> BADBLOCKS_LEAF_SHIFT];
+        uint64_t i = s & (BADBLOCKS_LEAF_SECTORS - 1);
+
+        if (!leaf) {
+            s = ((s >> BADBLOCKS_LEAF_SHIFT) + 1) << BADBLOCKS_LEAF_SHIFT;
+            continue;
+        }
+        if (i % NBBY == 0 && !leaf[i / NBBY]) {
+            s += NBBY;
+            continue;
+        }
+        if (isset(leaf, i))
+            break;
+        s++;
+    }
+    if (s >= bb->nsectors)
+        return 0;
+
+    e = s + 1;
+    while (e < bb->nsectors && badblocks_is_bad(bb, e))
+        e++;
+
+    *start = s;
+    *count = e - s;
+    return 1;
+}
+
+int badblocks_write_list(const BadBlocks* bb, FILE* f)
+{
+    uint64_t from = 0, start, count;
+
+    while (badblocks_next_range(bb, from, &start, &count)) {
+        fprintf(f, "%" PRIu64 " %" PRIu64 "\n", start, count);
+        from = start + count;
+    }
+
+    return fflush(f) != 0 || ferror(f) ? -EIO : 0;
+}
+
+int badblocks_read_list(BadBlocks* bb, FILE* f)
+{
+    char line[128];
+
+    while (fgets(line, sizeof(line), f)) {
+        uint64_t start, count;
+        int rc;
+
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (sscanf(line, "%" SCNu64 " %" SCNu64, &start, &count) != 2)
+            return -EINVAL;
+        rc = badblocks_mark(bb, start, count);
+        if (rc)
+            return rc;
+    }
+
+    return ferror(f) ? -EIO : 0;
+}
+
+static double badblocks_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* what a failing medium reports, anything else stops the scan */
+static int badblocks_is_media_error(int err)
+{
+    switch (err) {
+        case EIO:
+        case ENODATA:
+        case EILSEQ:
+        case ETIMEDOUT:
+        case EREMOTEIO:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* whole request or -errno, a short transfer inside the device is an I/O error */
+static int badblocks_pio(BadBlocksJob* job, int write, unsigned char* buf, uint64_t start, uint64_t len)
+{
+    ssize_t ret;
+
+    if (write)
+        return pwrite_all(job->fd, buf, len, (off_t) start) ? -errno : 0;
+
+    ret = pread_all(job->fd, buf, len, (off_t) start);
+    if (ret < 0)
+        return -errno;
+
+    return (uint64_t) ret < len ? -EIO : 0;
+}
+
+/* every sector starts with its number, a misdirected write shows up too */
+static void badblocks_fill(BadBlocksJob* job, unsigned char* buf, uint64_t start, uint64_t len)
+{
+    uint64_t sector = start / job->sectorSize;
+    uint64_t off;
+    size_t i;
+
+    for (off = 0; off < len; off += job->sectorSize, sector++) {
+        uint64_t le = cpu_to_le64(sector);
+        uint32_t pat = job->pattern;
+
+        memcpy(buf + off, &le, sizeof(le));
+        for (i = sizeof(le); i + sizeof(pat) <= job->sectorSize; i += sizeof(pat))
+            memcpy(buf + off + i, &pat, sizeof(pat));
+    }
+}
+
+static int badblocks_check(BadBlocksJob* job, unsigned char* buf, unsigned char* vbuf, uint64_t start, uint64_t len)
+{
+    uint64_t half, off;
+    int rc;
+
+    if (job->mode == BADBLOCKS_WRITE) {
+        badblocks_fill(job, buf, start, len);
+        rc = badblocks_pio(job, 1, buf, start, len);
+        if (!rc && !job->direct) {
+            /* read the medium, not the page cache */
+            if (fdatasync(job->fd) != 0)
+                rc = -errno;
+            else
+                posix_fadvise(job->fd, (off_t) start, (off_t) len, POSIX_FADV_DONTNEED);
+        }
+        if (!rc)
+            rc = badblocks_pio(job, 0, vbuf, start, len);
+        if (!rc) {
+            for (off = 0; off < len; off += job->sectorSize) {
+                if (memcmp(buf + off, vbuf + off, job->sectorSize)) {
+                    rc = badblocks_mark(job->bb, (start + off) / job->sectorSize, 1);
+                    if (rc)
+                        return rc;
+                }
+            }
+            return 0;
+        }
+    } else {
+        rc = badblocks_pio(job, 0, buf, start, len);
+        if (!rc)
+            return 0;
+    }
+
+    if (!badblocks_is_media_error(-rc))
+        return rc;
+    if (len <= job->sectorSize)
+        return badblocks_mark(job->bb, start / job->sectorSize, 1);
+
+    /* the good half costs one more request, the bad one is split again */
+    half = len / job->sectorSize / 2 * job->sectorSize;
+    rc = badblocks_check(job, buf, vbuf, start, half);
+    if (rc)
+        return rc;
+
+    return badblocks_check(job, buf, vbuf, start + half, len - half);
+}
+
+static void* badblocks_worker(void* arg)
+{
+    BadBlocksJob* job = (BadBlocksJob*) arg;
+    unsigned char* buf = bufpool_get(job->chunk);
+    unsigned char* vbuf = job->mode == BADBLOCKS_WRITE ? bufpool_get(job->chunk) : NULL;
+    int zero = 0, rc = 0;
+
+    if (!buf || (job->mode == BADBLOCKS_WRITE && !vbuf))
+        rc = -ENOMEM;
+
+    while (!rc && !__atomic_load_n(&job->rc, __ATOMIC_RELAXED)) {
+        uint64_t start = __atomic_fetch_add(&job->next, job->chunk, __ATOMIC_RELAXED);
+        uint64_t len;
+
+        if (start >= job->end)
+            break;
+        len = job->end - start < job->chunk ? job->end - start : job->chunk;
+
+        rc = badblocks_check(job, buf, vbuf, start, len);
+        if (!rc)
+            __atomic_add_fetch(&job->done, len, __ATOMIC_RELAXED);
+        if (!rc && job->mode == BADBLOCKS_READ)
+            blkra_drop(&job->ra, start, len);
+    }
+    if (rc)
+        __atomic_compare_exchange_n(&job->rc, &zero, rc, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    bufpool_put(buf, job->chunk);
+    bufpool_put(vbuf, job->chunk);
+
+    pthread_mutex_lock(&job->lock);
+    job->running--;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+
+    return NULL;
+}
+
+static void badblocks_progress(BadBlocksJob* job, double start, uint64_t total, BadBlocksProgress* p)
+{
+    p->done = __atomic_load_n(&job->done, __ATOMIC_RELAXED);
+    p->total = total;
+    p->seconds = badblocks_now() - start;
+    p->bytesPerSec = p->seconds > 0 ? p->done / p->seconds : 0;
+    pthread_mutex_lock(&job->bb->lock);
+    p->nbad = job->bb->nbad;
+    pthread_mutex_unlock(&job->bb->lock);
+    p->direct = job->direct;
+}
+
+int badblocks_scan(const char* path, const BadBlocksScan* opts, BadBlocks* bb, BadBlocksProgress* result)
+{
+    unsigned int i, nthreads, started = 0;
+    pthread_condattr_t attr;
+    pthread_t* threads;
+    BadBlocksProgress p;
+    BlkdevTopology tp;
+    BadBlocksJob job;
+    uint64_t total;
+    double start;
+    int fd, rc;
+
+    memset(&job, 0, sizeof(job));
+    memset(bb, 0, sizeof(*bb));
+    job.ra.fd = -1;
+    fd = blkdev_open_direct(path, (opts->mode == BADBLOCKS_WRITE ? O_RDWR : O_RDONLY) | O_CLOEXEC, &job.direct);
+    if (fd < 0)
+        return fd;
+
+    rc = blkdev_get_topology(fd, &tp);
+    if (rc)
+        goto out;
+
+    job.fd = fd;
+    job.bb = bb;
+    job.mode = opts->mode;
+    job.pattern = opts->pattern ? opts->pattern : BADBLOCKS_PATTERN;
+    job.sectorSize = tp.logicalSectorSize;
+    if (tp.dioOffsetAlign > job.sectorSize)
+        job.sectorSize = tp.dioOffsetAlign;
+
+    job.next = opts->offset;
+    job.end = opts->length ? opts->offset + opts->length : tp.size;
+    if (opts->offset > tp.size || job.end > tp.size || job.end < opts->offset
+        || job.next % job.sectorSize || job.end % job.sectorSize) {
+        rc = -EINVAL;
+        goto out;
+    }
+    total = job.end - job.next;
+
+    job.chunk = opts->chunkSize ? opts->chunkSize : BADBLOCKS_CHUNK_SIZE;
+    job.chunk -= job.chunk % job.sectorSize;
+    if (!job.chunk)
+        job.chunk = job.sectorSize;
+    nthreads = opts->nthreads ? opts->nthreads : BADBLOCKS_THREADS;
+
+    rc = badblocks_init(bb, tp.size / job.sectorSize, job.sectorSize);
+    if (rc)
+        goto out;
+
+    threads = calloc(nthreads, sizeof(pthread_t));
+    if (!threads) {
+        rc = -ENOMEM;
+        goto out;
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&job.cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    /* without O_DIRECT the scan lives off readahead */
+    if (!job.direct && job.mode == BADBLOCKS_READ)
+        blkra_begin(&job.ra, fd, job.next, total);
+
+    start = badblocks_now();
+    job.running = nthreads;
+    for (i = 0; i < nthreads; i++) {
+        int err = pthread_create(&threads[i], NULL, badblocks_worker, &job);
+        if (err) {
+            /* the started workers take over the remaining chunks */
+            pthread_mutex_lock(&job.lock);
+            job.running -= nthreads - i;
+            pthread_mutex_unlock(&job.lock);
+            if (!i)
+                job.rc = -err;
+            break;
+        }
+        started++;
+    }
+
+    pthread_mutex_lock(&job.lock);
+    while (job.running > 0) {
+        struct timespec ts;
+        unsigned int ms = opts->intervalMs ? opts->intervalMs : BADBLOCKS_INTERVAL_MS;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += ms / 1000;
+        ts.tv_nsec += (long) (ms % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+
+        if (pthread_cond_timedwait(&job.cond, &job.lock, &ts) == ETIMEDOUT && opts->func) {
+            pthread_mutex_unlock(&job.lock);
+            badblocks_progress(&job, start, total, &p);
+            opts->func(&p, opts->data);
+            pthread_mutex_lock(&job.lock);
+        }
+    }
+    pthread_mutex_unlock(&job.lock);
+
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+    blkra_end(&job.ra);
+    rc = job.rc;
+
+    badblocks_progress(&job, start, total, &p);
+    if (opts->func)
+        opts->func(&p, opts->data);
+    if (result)
+        *result = p;
+
+out:
+    close(fd);
+    return rc;
+}
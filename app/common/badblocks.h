@@ -0,0 +1,111 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_BADBLOCKS_H
+#define GRACEFUL_PARTITION_BADBLOCKS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* defaults if the caller leaves them 0 */
+#define BADBLOCKS_THREADS           4
+#define BADBLOCKS_CHUNK_SIZE        (4 * 1024 * 1024)
+#define BADBLOCKS_INTERVAL_MS       1000
+#define BADBLOCKS_PATTERN           0xaa55aa55U
+
+/* sectors per leaf of the map, a leaf is 4K of bits */
+#define BADBLOCKS_LEAF_SHIFT        15
+#define BADBLOCKS_LEAF_SECTORS      (1ULL << BADBLOCKS_LEAF_SHIFT)
+
+typedef struct _BadBlocks           BadBlocks;
+typedef struct _BadBlocksScan       BadBlocksScan;
+typedef struct _BadBlocksProgress   BadBlocksProgress;
+
+typedef enum
+{
+    BADBLOCKS_READ = 0,
+    BADBLOCKS_WRITE,                                    /* write a pattern, read it back, destroys the data */
+} BadBlocksMode;
+
+/*
+ * One bit per sector. Leaves are only allocated where a bad sector was
+ * found, so even a large disk with a few bad spots costs a few pages plus
+ * one pointer per BADBLOCKS_LEAF_SECTORS sectors.
+ */
+struct _BadBlocks
+{
+    uint64_t                        nsectors;
+    unsigned int                    sectorSize;
+    uint64_t                        nbad;
+
+    unsigned char**                 leaves;
+    size_t                          nleaves;
+    pthread_mutex_t                 lock;               /* scanner threads mark concurrently */
+};
+
+struct _BadBlocksProgress
+{
+    uint64_t                        done;               /* bytes */
+    uint64_t                        total;
+    double                          seconds;
+    double                          bytesPerSec;
+    uint64_t                        nbad;               /* sectors */
+    int                             direct;             /* O_DIRECT was used */
+};
+
+typedef void (*BadBlocksProgressFunc) (const BadBlocksProgress* p, void* data);
+
+struct _BadBlocksScan
+{
+    BadBlocksMode                   mode;
+    uint64_t                        offset;             /* bytes, sector aligned */
+    uint64_t                        length;             /* 0 = up to the end */
+
+    unsigned int                    nthreads;
+    unsigned int                    chunkSize;          /* bytes per request */
+    uint32_t                        pattern;            /* BADBLOCKS_WRITE, 0 = BADBLOCKS_PATTERN */
+
+    BadBlocksProgressFunc           func;               /* may be NULL */
+    void*                           data;
+    unsigned int                    intervalMs;
+};
+
+/* an empty map of @nsectors sectors, 0 or -errno */
+int badblocks_init(BadBlocks* bb, uint64_t nsectors, unsigned int sectorSize);
+void badblocks_deinit(BadBlocks* bb);
+
+/* mark @count sectors at @sector bad, 0, -ERANGE or -ENOMEM */
+int badblocks_mark(BadBlocks* bb, uint64_t sector, uint64_t count);
+
+int badblocks_is_bad(const BadBlocks* bb, uint64_t sector);
+
+/*
+ * Find the first run of bad sectors at or behind @from. Returns 1 and the
+ * run in @start and @count, or 0 if there is none.
+ */
+int badblocks_next_range(const BadBlocks* bb, uint64_t from, uint64_t* start, uint64_t* count);
+
+/* "<first sector> <count>" per run, in units of bb->sectorSize, 0 or -errno */
+int badblocks_write_list(const BadBlocks* bb, FILE* f);
+
+/* mark the runs of such a list, lines starting with '#' are skipped, 0 or -errno */
+int badblocks_read_list(BadBlocks* bb, FILE* f);
+
+/*
+ * Scan @path (block device or image file) and fill @bb, which is set up
+ * here to the size and logical sector size of the device and has to be
+ * released with badblocks_deinit() even if the scan failed. Requests of
+ * @opts->chunkSize bytes are read with O_DIRECT, if the file takes it, by
+ * @opts->nthreads workers. A request which fails with a media error is
+ * bisected down to the failing sectors; with BADBLOCKS_WRITE sectors which
+ * read back different are bad, too.
+ *
+ * @opts->func is called every @opts->intervalMs from the calling thread
+ * and once at the end, the final numbers are stored in @result (may be
+ * NULL). Returns 0 or the first error which is not a media error.
+ */
+int badblocks_scan(const char* path, const BadBlocksScan* opts, BadBlocks* bb, BadBlocksProgress* result);
+
+#endif //GRACEFUL_PARTITION_BADBLOCKS_H
@@ -0,0 +1,438 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "blkbench.h"
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "blkdev.h"
+#include "bufpool.h"
+
+/* log-linear latency histogram: 16 sub-buckets per power of two nanoseconds */
+#define BLKBENCH_LAT_BUCKETS        1024
+
+typedef struct _BlkBenchJob         BlkBenchJob;
+typedef struct _BlkBenchWorker      BlkBenchWorker;
+
+/* one point, shared by its workers */
+struct _BlkBenchJob
+{
+    int                             fd;
+    BlkBenchPattern                 pattern;
+    unsigned int                    blockSize;
+    uint64_t                        base;
+    uint64_t                        nblocks;
+
+    uint64_t                        next;               /* sequential cursor, atomic */
+    int                             stop;               /* atomic */
+    int                             rc;                 /* atomic, first error */
+};
+
+struct _BlkBenchWorker
+{
+    BlkBenchJob*                    job;
+    pthread_t                       thread;
+    uint64_t                        seed;
+
+    uint64_t                        ios;
+    uint64_t                        bytes;
+    uint64_t                        latSum;             /* nanoseconds */
+    uint64_t                        latMax;
+    uint32_t                        hist[BLKBENCH_LAT_BUCKETS];
+};
+
+static const double blkbenchPercentiles[BLKBENCH_NPERCENTILES] = { 0.50, 0.90, 0.99, 0.999 };
+
+static uint64_t blkbench_now(void);
+static unsigned int blkbench_lat_bucket(uint64_t ns);
+static double blkbench_lat_value(unsigned int bucket);
+static uint64_t blkbench_random(uint64_t* state);
+static void* blkbench_worker(void* arg);
+static void blkbench_point(int fd, const BlkBenchInfo* info, unsigned int runtimeMs, BlkBenchResult* r);
+
+static uint64_t blkbench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static unsigned int blkbench_lat_bucket(uint64_t ns)
+{
+    int e;
+
+    if (ns < 16)
+        return (unsigned int) ns;
+
+    e = 63 - __builtin_clzll(ns);
+    return (unsigned int) ((e - 3) * 16 + ((ns >> (e - 4)) & 15));
+}
+
+/* middle of the bucket, in nanoseconds */
+static double blkbench_lat_value(unsigned int bucket)
+{
+    unsigned int e, sub;
+
+    if (bucket < 16)
+        return bucket;
+
+    e = bucket / 16 + 3;
+    sub = bucket % 16;
+    return (double) ((16ULL + sub) << (e - 4)) + (double) (1ULL << (e - 4)) / 2;
+}
+
+/* xorshift64, good enough to spread offsets */
+static uint64_t blkbench_random(uint64_t* state)
+{
+    uint64_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+
+    return x;
+}
+
+static void* blkbench_worker(void* arg)
+{
+    BlkBenchWorker* w = (BlkBenchWorker*) arg;
+    BlkBenchJob* job = w->job;
+    int write = job->pattern == BLKBENCH_SEQ_WRITE || job->pattern == BLKBENCH_RAND_WRITE;
+    int seq = job->pattern == BLKBENCH_SEQ_READ || job->pattern == BLKBENCH_SEQ_WRITE;
+    unsigned char* buf;
+    int zero = 0, rc = 0;
+    size_t i;
+
+    buf = bufpool_get(job->blockSize);
+    if (!buf) {
+        rc = -ENOMEM;
+        goto out;
+    }
+    /* no zeroes, some devices compress or skip them */
+    for (i = 0; i + sizeof(uint64_t) <= job->blockSize; i += sizeof(uint64_t)) {
+        uint64_t x = blkbench_random(&w->seed);
+        memcpy(buf + i, &x, sizeof(x));
+    }
+
+    while (!__atomic_load_n(&job->stop, __ATOMIC_RELAXED)) {
+        uint64_t k, off, t0, lat;
+        ssize_t ret;
+
+        if (seq)
+            k = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED) % job->nblocks;
+        else
+            k = blkbench_random(&w->seed) % job->nblocks;
+        off = job->base + k * job->blockSize;
+
+        t0 = blkbench_now();
+        if (write)
+            ret = pwrite(job->fd, buf, job->blockSize, (off_t) off);
+        else
+            ret = pread(job->fd, buf, job->blockSize, (off_t) off);
+        lat = blkbench_now() - t0;
+
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            rc = -errno;
+            break;
+        }
+        if (ret == 0) {
+            rc = -EIO;
+            break;
+        }
+
+        w->ios++;
+        w->bytes += (uint64_t) ret;
+        w->latSum += lat;
+        if (lat > w->latMax)
+            w->latMax = lat;
+        w->hist[blkbench_lat_bucket(lat)]++;
+    }
+
+out:
+    bufpool_put(buf, job->blockSize);
+    if (rc) {
+        __atomic_compare_exchange_n(&job->rc, &zero, rc, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        __atomic_store_n(&job->stop, 1, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+static void blkbench_point(int fd, const BlkBenchInfo* info, unsigned int runtimeMs, BlkBenchResult* r)
+{
+    int write = r->pattern == BLKBENCH_SEQ_WRITE || r->pattern == BLKBENCH_RAND_WRITE;
+    unsigned int i, started = 0;
+    uint64_t hist[BLKBENCH_LAT_BUCKETS];
+    uint64_t latSum = 0, start, seen;
+    BlkBenchWorker* workers;
+    struct timespec ts;
+    BlkBenchJob job;
+    int p;
+
+    memset(&job, 0, sizeof(job));
+    job.fd = fd;
+    job.pattern = r->pattern;
+    job.blockSize = r->blockSize;
+    job.base = info->offset;
+    job.nblocks = info->length / r->blockSize;
+    if (!job.nblocks) {
+        r->rc = -EINVAL;
+        return;
+    }
+
+    workers = calloc(r->depth, sizeof(BlkBenchWorker));
+    if (!workers) {
+        r->rc = -ENOMEM;
+        return;
+    }
+
+    /* the reads have to come from the device, not from the previous point */
+    if (!info->direct && !write)
+        posix_fadvise(fd, (off_t) info->offset, (off_t) info->length, POSIX_FADV_DONTNEED);
+
+    start = blkbench_now();
+    for (i = 0; i < r->depth; i++) {
+        workers[i].job = &job;
+        workers[i].seed = (start ^ ((uint64_t) (i + 1) * 0x9E3779B97F4A7C15ULL)) | 1;
+        if (pthread_create(&workers[i].thread, NULL, blkbench_worker, &workers[i]) != 0)
+            break;
+        started++;
+    }
+    if (!started) {
+        free(workers);
+        r->rc = -EAGAIN;
+        return;
+    }
+
+    ts.tv_sec = (time_t) ((start / 1000000000ULL) + runtimeMs / 1000);
+    ts.tv_nsec = (long) (start % 1000000000ULL) + (long) (runtimeMs % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+    __atomic_store_n(&job.stop, 1, __ATOMIC_RELAXED);
+
+    for (i = 0; i < started; i++)
+        pthread_join(workers[i].thread, NULL);
+    /* buffered writes only count once they reached the device */
+    if (write && !info->direct && fdatasync(fd) != 0 && !job.rc)
+        job.rc = -errno;
+    r->seconds = (double) (blkbench_now() - start) / 1e9;
+    r->depth = started;
+    r->rc = job.rc;
+
+    memset(hist, 0, sizeof(hist));
+    for (i = 0; i < started; i++) {
+        unsigned int b;
+
+        r->ios += workers[i].ios;
+        r->bytes += workers[i].bytes;
+        latSum += workers[i].latSum;
+        if (workers[i].latMax / 1e3 > r->latMax)
+            r->latMax = (double) workers[i].latMax / 1e3;
+        for (b = 0; b < BLKBENCH_LAT_BUCKETS; b++)
+            hist[b] += workers[i].hist[b];
+    }
+    free(workers);
+
+    if (!r->ios)
+        return;
+    r->bytesPerSec = r->bytes / r->seconds;
+    r->iops = r->ios / r->seconds;
+    r->latAvg = (double) latSum / r->ios / 1e3;
+
+    seen = 0;
+    p = 0;
+    for (i = 0; i < BLKBENCH_LAT_BUCKETS && p < BLKBENCH_NPERCENTILES; i++) {
+        seen += hist[i];
+        while (p < BLKBENCH_NPERCENTILES && seen >= blkbenchPercentiles[p] * r->ios) {
+            double v = blkbench_lat_value(i) / 1e3;
+
+            /* the bucket middle may overshoot the largest sample */
+            r->lat[p++] = v < r->latMax ? v : r->latMax;
+        }
+    }
+}
+
+int blkbench_run(const char* path, const BlkBench* opts, BlkBenchInfo* info,
+                 BlkBenchResult* res, size_t max, size_t* n)
+{
+    static const unsigned int defSizes[] = BLKBENCH_BLOCK_SIZES;
+    static const unsigned int defDepths[] = BLKBENCH_DEPTHS;
+    unsigned int sizes[BLKBENCH_MAX_POINTS], depths[BLKBENCH_MAX_POINTS];
+    size_t nsizes = 0, ndepths = 0, i, j;
+    unsigned int align, phys, alignOff;
+    uint64_t end, rem;
+    BlkdevTopology tp;
+    int fd, direct, rc, pattern;
+
+    *n = 0;
+    if (opts->buffered) {
+        direct = 0;
+        fd = open(path, (opts->write ? O_RDWR | O_EXCL : O_RDONLY) | O_CLOEXEC);
+        fd = fd < 0 ? -errno : fd;
+    } else {
+        fd = blkdev_open_direct(path, (opts->write ? O_RDWR : O_RDONLY) | O_CLOEXEC, &direct);
+    }
+    if (fd < 0)
+        return fd;
+
+    rc = blkdev_get_topology(fd, &tp);
+    if (rc)
+        goto done;
+
+    memset(info, 0, sizeof(*info));
+    info->size = tp.size;
+    info->logicalSectorSize = tp.logicalSectorSize;
+    info->physicalSectorSize = tp.physicalSectorSize;
+    info->ioMin = tp.ioMin;
+    info->ioOpt = tp.ioOpt;
+    info->alignmentOffset = tp.alignmentOffset;
+    info->rotational = tp.rotational;
+    info->direct = direct;
+
+    /* block sizes and offsets in whole physical sectors, never below what O_DIRECT needs */
+    align = tp.logicalSectorSize;
+    if (tp.dioOffsetAlign > align)
+        align = tp.dioOffsetAlign;
+    phys = tp.physicalSectorSize > align && tp.physicalSectorSize % align == 0 ? tp.physicalSectorSize : align;
+    alignOff = tp.alignmentOffset > 0 ? (unsigned int) tp.alignmentOffset % phys : 0;
+
+    end = opts->length ? opts->offset + opts->length : tp.size;
+    if (opts->offset > tp.size || end > tp.size || end < opts->offset) {
+        rc = -EINVAL;
+        goto done;
+    }
+    info->offset = opts->offset;
+    rem = (info->offset + phys - alignOff) % phys;
+    if (rem)
+        info->offset += phys - rem;
+    info->length = end > info->offset ? end - info->offset : 0;
+
+    for (i = 0; i < BLKBENCH_MAX_POINTS && opts->blockSizes[i]; i++) {
+        unsigned int bs = opts->blockSizes[i];
+
+        sizes[nsizes++] = bs % phys ? bs + phys - bs % phys : bs;
+    }
+    if (!nsizes) {
+        for (i = 0; i < sizeof(defSizes) / sizeof(defSizes[0]); i++)
+            sizes[nsizes++] = defSizes[i] % phys ? defSizes[i] + phys - defSizes[i] % phys : defSizes[i];
+    }
+    for (i = 0; i < BLKBENCH_MAX_POINTS && opts->depths[i]; i++)
+        depths[ndepths++] = opts->depths[i] < BLKBENCH_MAX_DEPTH ? opts->depths[i] : BLKBENCH_MAX_DEPTH;
+    if (!ndepths) {
+        for (i = 0; i < sizeof(defDepths) / sizeof(defDepths[0]); i++)
+            depths[ndepths++] = defDepths[i];
+    }
+
+    for (pattern = 0; pattern < BLKBENCH_NPATTERNS; pattern++) {
+        if (!opts->write && (pattern == BLKBENCH_SEQ_WRITE || pattern == BLKBENCH_RAND_WRITE))
+            continue;
+
+        for (i = 0; i < nsizes; i++) {
+            for (j = 0; j < ndepths && *n < max; j++) {
+                BlkBenchResult* r = &res[(*n)++];
+
+                memset(r, 0, sizeof(*r));
+                r->pattern = (BlkBenchPattern) pattern;
+                r->blockSize = sizes[i];
+                r->depth = depths[j];
+                blkbench_point(fd, info, opts->runtimeMs ? opts->runtimeMs : BLKBENCH_RUNTIME_MS, r);
+                if (opts->func)
+                    opts->func(r, opts->data);
+            }
+        }
+    }
+
+done:
+    close(fd);
+    return rc;
+}
+
+int blkbench_pick(const BlkBenchResult* res, size_t n, BlkBenchPattern pattern)
+{
+    double best = 0;
+    uint64_t cost, minCost = UINT64_MAX;
+    int pick = -1;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (res[i].pattern == pattern && !res[i].rc && res[i].bytesPerSec > best)
+            best = res[i].bytesPerSec;
+    }
+    if (best <= 0)
+        return -1;
+
+    for (i = 0; i < n; i++) {
+        if (res[i].pattern != pattern || res[i].rc || res[i].bytesPerSec * 100 < best * BLKBENCH_PICK_PERCENT)
+            continue;
+
+        cost = (uint64_t) res[i].blockSize * res[i].depth;
+        if (cost < minCost || (cost == minCost && res[i].bytesPerSec > res[pick].bytesPerSec)) {
+            minCost = cost;
+            pick = (int) i;
+        }
+    }
+
+    return pick;
+}
+
+int blkbench_write_profile(FILE* f, const char* path, const BlkBenchInfo* info, const BlkBenchResult* res, size_t n)
+{
+    int pattern, p;
+    size_t i;
+
+    fprintf(f, "device %s size=%llu logical=%u physical=%u io_min=%u io_opt=%u align=%d rotational=%d direct=%d\n",
+            path, (unsigned long long) info->size, info->logicalSectorSize, info->physicalSectorSize,
+            info->ioMin, info->ioOpt, info->alignmentOffset, info->rotational, info->direct);
+    fprintf(f, "# pattern bs qd MiB/s iops avg p50 p90 p99 p99.9 max rc\n");
+
+    for (i = 0; i < n; i++) {
+        const BlkBenchResult* r = &res[i];
+
+        fprintf(f, "%s %u %u %.1f %.0f %.1f", blkbench_pattern_to_name(r->pattern), r->blockSize, r->depth,
+                r->bytesPerSec / (1024 * 1024), r->iops, r->latAvg);
+        for (p = 0; p < BLKBENCH_NPERCENTILES; p++)
+            fprintf(f, " %.1f", r->lat[p]);
+        fprintf(f, " %.1f %d\n", r->latMax, r->rc);
+    }
+
+    for (pattern = 0; pattern < BLKBENCH_NPATTERNS; pattern++) {
+        int k = blkbench_pick(res, n, (BlkBenchPattern) pattern);
+
+        if (k >= 0)
+            fprintf(f, "pick %s %u %u\n", blkbench_pattern_to_name((BlkBenchPattern) pattern),
+                    res[k].blockSize, res[k].depth);
+    }
+
+    return fflush(f) != 0 || ferror(f) ? -EIO : 0;
+}
+
+const char* blkbench_pattern_to_name(BlkBenchPattern pattern)
+{
+    switch (pattern) {
+        case BLKBENCH_SEQ_READ:
+            return "seqread";
+        case BLKBENCH_RAND_READ:
+            return "randread";
+        case BLKBENCH_SEQ_WRITE:
+            return "seqwrite";
+        case BLKBENCH_RAND_WRITE:
+            return "randwrite";
+        default:
+            return "unknown";
+    }
+}
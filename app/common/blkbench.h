@@ -0,0 +1,129 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_BLKBENCH_H
+#define GRACEFUL_PARTITION_BLKBENCH_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* entries of the block size and queue depth lists, 0 terminates them early */
+#define BLKBENCH_MAX_POINTS         8
+
+/* defaults if the caller leaves them 0 */
+#define BLKBENCH_RUNTIME_MS         1000
+#define BLKBENCH_BLOCK_SIZES        { 4096, 65536, 1048576 }
+#define BLKBENCH_DEPTHS             { 1, 4, 16 }
+
+#define BLKBENCH_MAX_DEPTH          256
+
+/* the pick is the cheapest point within this share of the best throughput */
+#define BLKBENCH_PICK_PERCENT       90
+
+/* p50, p90, p99, p99.9 */
+#define BLKBENCH_NPERCENTILES       4
+
+typedef struct _BlkBench            BlkBench;
+typedef struct _BlkBenchInfo        BlkBenchInfo;
+typedef struct _BlkBenchResult      BlkBenchResult;
+
+typedef enum
+{
+    BLKBENCH_SEQ_READ = 0,
+    BLKBENCH_RAND_READ,
+    BLKBENCH_SEQ_WRITE,
+    BLKBENCH_RAND_WRITE,
+    BLKBENCH_NPATTERNS,
+} BlkBenchPattern;
+
+struct _BlkBenchResult
+{
+    BlkBenchPattern                 pattern;
+    unsigned int                    blockSize;          /* bytes, after alignment */
+    unsigned int                    depth;
+
+    uint64_t                        ios;
+    uint64_t                        bytes;
+    double                          seconds;
+    double                          bytesPerSec;
+    double                          iops;
+
+    double                          latAvg;             /* microseconds */
+    double                          latMax;
+    double                          lat[BLKBENCH_NPERCENTILES];
+    int                             rc;                 /* 0 or the first -errno */
+};
+
+typedef void (*BlkBenchFunc) (const BlkBenchResult* res, void* data);
+
+struct _BlkBench
+{
+    unsigned int                    blockSizes[BLKBENCH_MAX_POINTS];
+    unsigned int                    depths[BLKBENCH_MAX_POINTS];
+    unsigned int                    runtimeMs;          /* per point */
+
+    uint64_t                        offset;             /* region, bytes */
+    uint64_t                        length;             /* 0 = up to the end */
+
+    int                             write;              /* also run the write patterns, destroys the region */
+    int                             buffered;           /* do not try O_DIRECT */
+
+    BlkBenchFunc                    func;               /* after each point, may be NULL */
+    void*                           data;
+};
+
+/* what the numbers were measured on */
+struct _BlkBenchInfo
+{
+    uint64_t                        size;
+    uint64_t                        offset;             /* region actually used, aligned */
+    uint64_t                        length;
+    unsigned int                    logicalSectorSize;
+    unsigned int                    physicalSectorSize;
+    unsigned int                    ioMin;
+    unsigned int                    ioOpt;
+    int                             alignmentOffset;
+    int                             rotational;
+    int                             direct;             /* O_DIRECT was used */
+};
+
+/*
+ * Measure @path (a block device or an image file) for every pattern, block
+ * size and queue depth. The queue depth is the number of threads with one
+ * pread()/pwrite() each in flight. Block sizes are rounded up to whole
+ * physical sectors, never below the direct I/O offset alignment, and every
+ * offset is a multiple of the block size from a start that honours the
+ * device's alignment offset. O_DIRECT is used if the file supports it, otherwise
+ * the page cache is dropped before each read point.
+ *
+ * Up to @max results are stored in @res, their number in @n. Returns 0 or
+ * -errno if @path could not be opened or measured at all; errors of
+ * single points end up in BlkBenchResult.rc.
+ */
+int blkbench_run(const char* path, const BlkBench* opts, BlkBenchInfo* info,
+                 BlkBenchResult* res, size_t max, size_t* n);
+
+/*
+ * Index of the point with the smallest block size times depth which still
+ * reaches BLKBENCH_PICK_PERCENT of the best throughput of @pattern, -1 if
+ * @pattern was not measured.
+ */
+int blkbench_pick(const BlkBenchResult* res, size_t n, BlkBenchPattern pattern);
+
+/*
+ * One line for the device, one per point and one pick per pattern:
+ *
+ *   device <path> size=<bytes> logical=.. physical=.. io_min=.. io_opt=.. align=.. rotational=.. direct=..
+ *   # <column names>
+ *   <pattern> <bs> <qd> <MiB/s> <iops> <avg> <p50> <p90> <p99> <p99.9> <max> <rc>
+ *   pick <pattern> <bs> <qd>
+ *
+ * Latencies are in microseconds. Returns 0 or -errno.
+ */
+int blkbench_write_profile(FILE* f, const char* path, const BlkBenchInfo* info, const BlkBenchResult* res, size_t n);
+
+const char* blkbench_pattern_to_name(BlkBenchPattern pattern);
+
+#endif //GRACEFUL_PARTITION_BLKBENCH_H
@@ -0,0 +1,457 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "blkcache.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include "all-io.h"
+#include "blkdev.h"
+
+#define BLKCACHE_NONE               (-1)
+#define BLKCACHE_FREE               (-2)                /* hnext of a slot on the free list */
+
+typedef struct _BlkCache            BlkCache;
+typedef struct _BlkCacheSlot        BlkCacheSlot;
+
+struct _BlkCacheSlot
+{
+    uint64_t                        blkno;
+    uint32_t                        len;                /* valid bytes, short at the end of the device */
+    int32_t                         hnext;              /* hash chain */
+    int32_t                         prev;               /* LRU list, or the free list through next */
+    int32_t                         next;
+};
+
+struct _BlkCache
+{
+    int                             fd;
+    unsigned int                    refs;
+    uint64_t                        size;               /* device size in bytes */
+    unsigned int                    blockSize;
+
+    BlkCacheSlot*                   slots;
+    unsigned char*                  data;               /* nslots * blockSize, aligned for O_DIRECT */
+    uint32_t                        nslots;
+    uint32_t                        nused;              /* slots handed out at least once */
+
+    int32_t*                        buckets;
+    uint32_t                        bucketMask;
+
+    int32_t                         lruHead;            /* most recently used */
+    int32_t                         lruTail;
+    int32_t                         freeList;
+
+    BlkCacheStats                   stats;
+    pthread_mutex_t                 lock;
+};
+
+static BlkCache* blkcacheTable[BLKCACHE_MAX_DEVICES];
+/* caches in blkcacheTable, lets reads of uncached fds skip the table lock */
+static unsigned int blkcacheCount;
+static pthread_mutex_t blkcacheTableLock = PTHREAD_MUTEX_INITIALIZER;
+
+static BlkCache* blkcache_find(int fd, int* idx);
+static uint32_t blkcache_hash(const BlkCache* c, uint64_t blkno);
+static int32_t blkcache_lookup(BlkCache* c, uint64_t blkno);
+static void blkcache_lru_unlink(BlkCache* c, int32_t i);
+static void blkcache_lru_push(BlkCache* c, int32_t i);
+static void blkcache_release(BlkCache* c, int32_t i);
+static int32_t blkcache_alloc(BlkCache* c, uint64_t blkno);
+static int blkcache_fill(BlkCache* c, uint64_t first, uint64_t last);
+static ssize_t blkcache_read(BlkCache* c, unsigned char* buf, size_t count, uint64_t off);
+static void blkcache_free(BlkCache* c);
+
+/* called with blkcacheTableLock held */
+static BlkCache* blkcache_find(int fd, int* idx)
+{
+    int i;
+
+    for (i = 0; i < BLKCACHE_MAX_DEVICES; i++) {
+        if (blkcacheTable[i] && blkcacheTable[i]->fd == fd) {
+            if (idx)
+                *idx = i;
+            return blkcacheTable[i];
+        }
+    }
+
+    return NULL;
+}
+
+static uint32_t blkcache_hash(const BlkCache* c, uint64_t blkno)
+{
+    return (uint32_t) ((blkno * 0x9e3779b97f4a7c15ULL) >> 32) & c->bucketMask;
+}
+
+static int32_t blkcache_lookup(BlkCache* c, uint64_t blkno)
+{
+    int32_t i = c->buckets[blkcache_hash(c, blkno)];
+
+    while (i != BLKCACHE_NONE && c->slots[i].blkno != blkno)
+        i = c->slots[i].hnext;
+
+    return i;
+}
+
+static void blkcache_lru_unlink(BlkCache* c, int32_t i)
+{
+    BlkCacheSlot* s = &c->slots[i];
+
+    if (s->prev != BLKCACHE_NONE)
+        c->slots[s->prev].next = s->next;
+    else
+        c->lruHead = s->next;
+    if (s->next != BLKCACHE_NONE)
+        c->slots[s->next].prev = s->prev;
+    else
+        c->lruTail = s->prev;
+    s->prev = s->next = BLKCACHE_NONE;
+}
+
+static void blkcache_lru_push(BlkCache* c, int32_t i)
+{
+    BlkCacheSlot* s = &c->slots[i];
+
+    s->prev = BLKCACHE_NONE;
+    s->next = c->lruHead;
+    if (c->lruHead != BLKCACHE_NONE)
+        c->slots[c->lruHead].prev = i;
+    else
+        c->lruTail = i;
+    c->lruHead = i;
+}
+
+/* take slot @i out of the hash and the LRU list and put it on the free list */
+static void blkcache_release(BlkCache* c, int32_t i)
+{
+    int32_t* p = &c->buckets[blkcache_hash(c, c->slots[i].blkno)];
+
+    while (*p != i)
+        p = &c->slots[*p].hnext;
+    *p = c->slots[i].hnext;
+
+    blkcache_lru_unlink(c, i);
+    c->slots[i].hnext = BLKCACHE_FREE;
+    c->slots[i].next = c->freeList;
+    c->freeList = i;
+}
+
+static int32_t blkcache_alloc(BlkCache* c, uint64_t blkno)
+{
+    uint32_t h;
+    int32_t i;
+
+    if (c->freeList != BLKCACHE_NONE) {
+        i = c->freeList;
+        c->freeList = c->slots[i].next;
+    } else if (c->nused < c->nslots) {
+        i = (int32_t) c->nused++;
+    } else {
+        i = c->lruTail;
+        blkcache_release(c, i);
+        c->freeList = c->slots[i].next;
+        c->stats.evictions++;
+    }
+
+    h = blkcache_hash(c, blkno);
+    c->slots[i].blkno = blkno;
+    c->slots[i].len = 0;
+    c->slots[i].hnext = c->buckets[h];
+    c->buckets[h] = i;
+    blkcache_lru_push(c, i);
+
+    return i;
+}
+
+/* read blocks @first to @last (not cached, at most BLKCACHE_MAX_COALESCE) with one preadv() */
+static int blkcache_fill(BlkCache* c, uint64_t first, uint64_t last)
+{
+    struct iovec iov[BLKCACHE_MAX_COALESCE];
+    int32_t idx[BLKCACHE_MAX_COALESCE];
+    int n = (int) (last - first + 1), k, iovcnt = n;
+    struct iovec* v = iov;
+    uint64_t off = first * c->blockSize, total = 0;
+
+    for (k = 0; k < n; k++) {
+        idx[k] = blkcache_alloc(c, first + k);
+        iov[k].iov_base = c->data + (size_t) idx[k] * c->blockSize;
+        iov[k].iov_len = c->blockSize;
+    }
+
+    while (iovcnt > 0) {
+        ssize_t ret = preadv(c->fd, v, iovcnt, (off_t) off);
+
+        if (ret < 0) {
+            int err = errno;
+
+            if (err == EINTR || err == EAGAIN)
+                continue;
+            for (k = 0; k < n; k++)
+                blkcache_release(c, idx[k]);
+            errno = err;
+            return -1;
+        }
+        c->stats.reads++;
+        if (ret == 0)
+            break;
+        c->stats.bytesRead += ret;
+        off += ret;
+        total += ret;
+
+        while (iovcnt > 0 && (size_t) ret >= v->iov_len) {
+            ret -= v->iov_len;
+            v++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            v->iov_base = (char*) v->iov_base + ret;
+            v->iov_len -= ret;
+        }
+    }
+
+    for (k = 0; k < n; k++) {
+        uint64_t at = (uint64_t) k * c->blockSize;
+        c->slots[idx[k]].len = total <= at ? 0 : total - at >= c->blockSize ? c->blockSize : (uint32_t) (total - at);
+    }
+
+    return 0;
+}
+
+static ssize_t blkcache_read(BlkCache* c, unsigned char* buf, size_t count, uint64_t off)
+{
+    uint64_t bs = c->blockSize, nblocks, b, last, fetchedEnd = 0;
+    uint32_t maxRun = c->nslots < BLKCACHE_MAX_COALESCE ? c->nslots : BLKCACHE_MAX_COALESCE;
+    size_t done = 0;
+
+    if (off >= c->size || !count)
+        return 0;
+    if (count > c->size - off)
+        count = (size_t) (c->size - off);
+
+    nblocks = (c->size + bs - 1) / bs;
+    last = (off + count - 1) / bs;
+
+    for (b = off / bs; b <= last; b++) {
+        int32_t i = blkcache_lookup(c, b);
+        size_t boff = b == off / bs ? (size_t) (off % bs) : 0;
+        size_t n = bs - boff;
+
+        if (i == BLKCACHE_NONE) {
+            uint64_t e = b;
+
+            /* a run of misses, and some readahead if it ends the request */
+            while (e < last && e - b + 1 < maxRun && blkcache_lookup(c, e + 1) == BLKCACHE_NONE)
+                e++;
+            if (e == last) {
+                while (e + 1 < nblocks && e - b + 1 < maxRun && e - last < BLKCACHE_READAHEAD
+                       && blkcache_lookup(c, e + 1) == BLKCACHE_NONE)
+                    e++;
+            }
+            if (blkcache_fill(c, b, e) != 0)
+                return done ? (ssize_t) done : -1;
+            fetchedEnd = e + 1;
+            i = blkcache_lookup(c, b);
+        }
+
+        /* blocks of the run just read are misses, the rest were there before */
+        if (b < fetchedEnd) {
+            c->stats.misses++;
+        } else {
+            c->stats.hits++;
+            blkcache_lru_unlink(c, i);
+            blkcache_lru_push(c, i);
+        }
+
+        if (n > count - done)
+            n = count - done;
+        if (c->slots[i].len <= boff)
+            break;
+        if (n > c->slots[i].len - boff)
+            n = c->slots[i].len - boff;
+        memcpy(buf + done, c->data + (size_t) i * bs + boff, n);
+        done += n;
+        /* a short block is the end of the device */
+        if (boff + n < bs && done < count)
+            break;
+    }
+
+    return (ssize_t) done;
+}
+
+static void blkcache_free(BlkCache* c)
+{
+    pthread_mutex_destroy(&c->lock);
+    free(c->slots);
+    free(c->data);
+    free(c->buckets);
+    free(c);
+}
+
+int blkcache_attach(int fd, unsigned int blockSize, size_t nblocks)
+{
+    uint32_t nbuckets = 1, i;
+    unsigned long long end;
+    BlkCache* c, *other;
+    int slot;
+
+    if (!blockSize)
+        blockSize = BLKCACHE_BLOCK_SIZE;
+    if (!nblocks)
+        nblocks = BLKCACHE_NBLOCKS;
+    if (nblocks > INT32_MAX / 2)
+        return -EINVAL;
+
+    /* attaching again is the common case of nested readers, no need to allocate for it */
+    pthread_mutex_lock(&blkcacheTableLock);
+    other = blkcache_find(fd, NULL);
+    if (other)
+        other->refs++;
+    pthread_mutex_unlock(&blkcacheTableLock);
+    if (other)
+        return 0;
+
+    errno = 0;
+    if (blkdev_get_size(fd, &end) != 0)
+        return errno ? -errno : -EINVAL;
+
+    c = calloc(1, sizeof(BlkCache));
+    if (!c)
+        return -ENOMEM;
+    while (nbuckets < nblocks)
+        nbuckets <<= 1;
+
+    c->fd = fd;
+    c->refs = 1;
+    c->size = end;
+    c->blockSize = blockSize;
+    c->nslots = (uint32_t) nblocks;
+    c->bucketMask = nbuckets - 1;
+    c->lruHead = c->lruTail = c->freeList = BLKCACHE_NONE;
+    c->slots = calloc(nblocks, sizeof(BlkCacheSlot));
+    c->buckets = malloc(sizeof(int32_t) * nbuckets);
+    if (!c->slots || !c->buckets || posix_memalign((void**) &c->data, BLKCACHE_BLOCK_SIZE, nblocks * blockSize)) {
+        free(c->slots);
+        free(c->buckets);
+        free(c);
+        return -ENOMEM;
+    }
+    for (i = 0; i < nbuckets; i++)
+        c->buckets[i] = BLKCACHE_NONE;
+    pthread_mutex_init(&c->lock, NULL);
+
+    /* another thread may have attached while this one allocated */
+    pthread_mutex_lock(&blkcacheTableLock);
+    other = blkcache_find(fd, NULL);
+    for (slot = 0; !other && slot < BLKCACHE_MAX_DEVICES && blkcacheTable[slot]; slot++)
+        ;
+    if (other || slot == BLKCACHE_MAX_DEVICES) {
+        if (other)
+            other->refs++;
+        pthread_mutex_unlock(&blkcacheTableLock);
+        blkcache_free(c);
+        return other ? 0 : -EMFILE;
+    }
+    blkcacheTable[slot] = c;
+    __atomic_add_fetch(&blkcacheCount, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&blkcacheTableLock);
+
+    return 0;
+}
+
+void blkcache_detach(int fd)
+{
+    BlkCache* c;
+    int slot;
+
+    pthread_mutex_lock(&blkcacheTableLock);
+    c = blkcache_find(fd, &slot);
+    if (!c || --c->refs) {
+        pthread_mutex_unlock(&blkcacheTableLock);
+        return;
+    }
+    blkcacheTable[slot] = NULL;
+    __atomic_sub_fetch(&blkcacheCount, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&blkcacheTableLock);
+
+    /* wait for a reader which found it before it was removed */
+    pthread_mutex_lock(&c->lock);
+    pthread_mutex_unlock(&c->lock);
+    blkcache_free(c);
+}
+
+ssize_t blkcache_pread(int fd, void* buf, size_t count, uint64_t off)
+{
+    BlkCache* c;
+    ssize_t ret;
+
+    /* the common case, nobody caches anything */
+    if (!__atomic_load_n(&blkcacheCount, __ATOMIC_ACQUIRE))
+        return pread_all(fd, buf, count, (off_t) off);
+
+    pthread_mutex_lock(&blkcacheTableLock);
+    c = blkcache_find(fd, NULL);
+    if (!c) {
+        pthread_mutex_unlock(&blkcacheTableLock);
+        return pread_all(fd, buf, count, (off_t) off);
+    }
+    pthread_mutex_lock(&c->lock);
+    pthread_mutex_unlock(&blkcacheTableLock);
+
+    ret = blkcache_read(c, (unsigned char*) buf, count, off);
+    pthread_mutex_unlock(&c->lock);
+
+    return ret;
+}
+
+void blkcache_invalidate(int fd, uint64_t off, uint64_t len)
+{
+    uint64_t first, last;
+    BlkCache* c;
+    uint32_t i;
+
+    if (!len || !__atomic_load_n(&blkcacheCount, __ATOMIC_ACQUIRE))
+        return;
+
+    pthread_mutex_lock(&blkcacheTableLock);
+    c = blkcache_find(fd, NULL);
+    if (!c) {
+        pthread_mutex_unlock(&blkcacheTableLock);
+        return;
+    }
+    pthread_mutex_lock(&c->lock);
+    pthread_mutex_unlock(&blkcacheTableLock);
+
+    /* walk the slots, the range may be the whole device */
+    first = off / c->blockSize;
+    last = (off + len - 1) / c->blockSize;
+    for (i = 0; i < c->nused; i++) {
+        if (c->slots[i].hnext != BLKCACHE_FREE && c->slots[i].blkno >= first && c->slots[i].blkno <= last)
+            blkcache_release(c, (int32_t) i);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+int blkcache_get_stats(int fd, BlkCacheStats* st)
+{
+    BlkCache* c;
+
+    pthread_mutex_lock(&blkcacheTableLock);
+    c = blkcache_find(fd, NULL);
+    if (!c) {
+        pthread_mutex_unlock(&blkcacheTableLock);
+        return -ENOENT;
+    }
+    pthread_mutex_lock(&c->lock);
+    pthread_mutex_unlock(&blkcacheTableLock);
+
+    *st = c->stats;
+    pthread_mutex_unlock(&c->lock);
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_BLKCACHE_H
+#define GRACEFUL_PARTITION_BLKCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/* defaults for blkcache_attach(), the head and tail probe areas fit twice */
+#define BLKCACHE_BLOCK_SIZE         4096
+#define BLKCACHE_NBLOCKS            1024
+
+/* misses are read together up to this many blocks, at most IOV_MAX */
+#define BLKCACHE_MAX_COALESCE       256
+
+/* blocks read behind a miss which ends a request */
+#define BLKCACHE_READAHEAD          16
+
+/* devices with a cache at the same time */
+#define BLKCACHE_MAX_DEVICES        64
+
+typedef struct _BlkCacheStats       BlkCacheStats;
+
+struct _BlkCacheStats
+{
+    uint64_t                        hits;               /* blocks */
+    uint64_t                        misses;
+    uint64_t                        evictions;
+    uint64_t                        reads;              /* preadv() calls */
+    uint64_t                        bytesRead;
+};
+
+/*
+ * Put an LRU cache of @nblocks blocks of @blockSize bytes in front of @fd,
+ * 0 takes the defaults. @blockSize has to be a multiple of the logical
+ * sector size if @fd uses O_DIRECT. Attaching twice only counts a reference.
+ * Returns 0 or -errno.
+ *
+ * The cache is looked up by fd: detach it before the fd is closed.
+ */
+int blkcache_attach(int fd, unsigned int blockSize, size_t nblocks);
+void blkcache_detach(int fd);
+
+/*
+ * pread_all() which goes through the cache if one is attached to @fd,
+ * adjacent missing blocks are fetched with one preadv(). While no cache
+ * is attached at all no lock is taken. Returns the bytes read or -1 with
+ * errno set.
+ */
+ssize_t blkcache_pread(int fd, void* buf, size_t count, uint64_t off);
+
+/* forget cached blocks overlapping a range that was written behind the cache's back */
+void blkcache_invalidate(int fd, uint64_t off, uint64_t len);
+
+/* -ENOENT if no cache is attached */
+int blkcache_get_stats(int fd, BlkCacheStats* st);
+
+#endif //GRACEFUL_PARTITION_BLKCACHE_H
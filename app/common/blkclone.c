@@ -0,0 +1,564 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                 /* O_DIRECT */
+#endif
+
+#include "blkclone.h"
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+
+#include "blkra.h"
+#include "all-io.h"
+#include "blkdev.h"
+#include "bufpool.h"
+#include "extents.h"
+#include "buffer-zero.h"
+
+typedef struct _BlkCloneJob         BlkCloneJob;
+typedef struct _BlkCloneSlot        BlkCloneSlot;
+
+struct _BlkCloneSlot
+{
+    unsigned char*                  buf;
+    uint64_t                        offset;
+    uint64_t                        len;
+    int                             hole;               /* nothing was read, the range is zero */
+    int                             last;               /* nothing follows, also after an error */
+    int                             rc;
+    int                             full;               /* read, waiting for the writer */
+};
+
+struct _BlkCloneJob
+{
+    int                             src;
+    int                             dst;
+    int                             dstDirect;
+    uint64_t                        size;
+    unsigned int                    chunk;
+    unsigned int                    block;
+    unsigned int                    align;              /* read length granularity with O_DIRECT */
+    BlkReadahead                    ra;                 /* of the source, buffered reads only */
+
+    BlkCloneSlot                    slots[BLKCLONE_MAX_BUFFERS];
+    unsigned int                    nslots;
+    pthread_mutex_t                 lock;
+    pthread_cond_t                  cond;
+    int                             stop;
+
+    BlkCloneZero                    method;
+    unsigned char*                  zeroBuf;
+    uint64_t                        zeroStart;          /* pending run of zero blocks */
+    uint64_t                        zeroLen;
+
+    BlkCloneProgress                p;
+};
+
+static double blkclone_now(void);
+static void blkclone_deadline(struct timespec* ts, unsigned int ms);
+static int blkclone_open_target(const char* dst, const struct stat* srcSt, uint64_t size, BlkCloneJob* job);
+static int blkclone_read(BlkCloneJob* job, unsigned char* buf, uint64_t offset, size_t len);
+static int blkclone_write(BlkCloneJob* job, const unsigned char* buf, uint64_t offset, size_t len);
+static int blkclone_write_zeroes(BlkCloneJob* job, uint64_t offset, uint64_t len);
+static int blkclone_flush_zero(BlkCloneJob* job);
+static int blkclone_add_zero(BlkCloneJob* job, uint64_t offset, uint64_t len);
+static int blkclone_write_chunk(BlkCloneJob* job, const BlkCloneSlot* slot);
+static BlkCloneSlot* blkclone_reader_slot(BlkCloneJob* job, unsigned int* i);
+static void blkclone_reader_post(BlkCloneJob* job, BlkCloneSlot* slot);
+static void* blkclone_reader(void* arg);
+static void blkclone_progress(BlkCloneJob* job, double start);
+
+int blkclone_run(const char* src, const char* dst, const BlkClone* opts, BlkCloneProgress* result)
+{
+    unsigned int i, ms, block;
+    pthread_condattr_t attr;
+    struct timespec next;
+    BlkdevTopology tp;
+    pthread_t reader;
+    BlkCloneJob job;
+    struct stat st;
+    double start;
+    int rc, err, last;
+
+    memset(&job, 0, sizeof(job));
+    job.dst = -1;
+    job.ra.fd = -1;
+    job.src = blkdev_open_direct(src, O_RDONLY | O_CLOEXEC, &job.p.direct);
+    if (job.src < 0)
+        return job.src;
+
+    if (fstat(job.src, &st) != 0) {
+        rc = -errno;
+        goto out;
+    }
+    rc = blkdev_get_topology(job.src, &tp);
+    if (rc)
+        goto out;
+    job.size = tp.size;
+    job.align = job.p.direct ? tp.logicalSectorSize : 1;
+    if (job.p.direct && tp.dioOffsetAlign > job.align)
+        job.align = tp.dioOffsetAlign;
+
+    rc = blkclone_open_target(dst, &st, job.size, &job);
+    if (rc)
+        goto out;
+    if (opts->noSparse)
+        job.method = BLKCLONE_ZERO_WRITE;
+    else if (job.method == BLKCLONE_ZERO_ZEROOUT && opts->discard)
+        job.method = BLKCLONE_ZERO_DISCARD;
+    job.p.method = job.method;
+    job.p.total = job.size;
+
+    /* zero blocks are whole target sectors, chunks whole blocks */
+    block = opts->blockSize ? opts->blockSize : BLKCLONE_BLOCK_SIZE;
+    if (job.align > 1 && block % job.align)
+        block += job.align - block % job.align;
+    job.block = block;
+    job.chunk = opts->chunkSize ? opts->chunkSize : BLKCLONE_CHUNK_SIZE;
+    job.chunk -= job.chunk % block;
+    if (!job.chunk)
+        job.chunk = block;
+
+    job.nslots = opts->nbuffers ? opts->nbuffers : BLKCLONE_BUFFERS;
+    if (job.nslots > BLKCLONE_MAX_BUFFERS)
+        job.nslots = BLKCLONE_MAX_BUFFERS;
+    for (i = 0; i < job.nslots; i++) {
+        job.slots[i].buf = bufpool_get(job.chunk);
+        if (!job.slots[i].buf) {
+            rc = -ENOMEM;
+            goto out;
+        }
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&job.cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (!job.p.direct)
+        blkra_begin(&job.ra, job.src, 0, job.size);
+
+    err = pthread_create(&reader, NULL, blkclone_reader, &job);
+    if (err) {
+        rc = -err;
+        goto destroy;
+    }
+
+    start = blkclone_now();
+    ms = opts->intervalMs ? opts->intervalMs : BLKCLONE_INTERVAL_MS;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    blkclone_deadline(&next, ms);
+    for (i = 0, last = 0; !rc && !last; i = (i + 1) % job.nslots) {
+        BlkCloneSlot* slot = &job.slots[i];
+
+        pthread_mutex_lock(&job.lock);
+        while (!slot->full) {
+            if (pthread_cond_timedwait(&job.cond, &job.lock, &next) == ETIMEDOUT) {
+                blkclone_deadline(&next, ms);
+                if (opts->func) {
+                    pthread_mutex_unlock(&job.lock);
+                    blkclone_progress(&job, start);
+                    opts->func(&job.p, opts->data);
+                    pthread_mutex_lock(&job.lock);
+                }
+            }
+        }
+        pthread_mutex_unlock(&job.lock);
+
+        last = slot->last;
+        if (slot->rc) {
+            rc = slot->rc;
+        } else if (slot->hole) {
+            job.p.skipped += slot->len;
+            rc = blkclone_add_zero(&job, slot->offset, slot->len);
+        } else if (slot->len) {
+            rc = blkclone_write_chunk(&job, slot);
+        }
+        if (!rc)
+            job.p.done += slot->len;
+
+        pthread_mutex_lock(&job.lock);
+        slot->full = 0;
+        pthread_cond_broadcast(&job.cond);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    pthread_mutex_lock(&job.lock);
+    job.stop = 1;
+    pthread_cond_broadcast(&job.cond);
+    pthread_mutex_unlock(&job.lock);
+    pthread_join(reader, NULL);
+
+    if (!rc)
+        rc = blkclone_flush_zero(&job);
+    if (!rc && fdatasync(job.dst) != 0)
+        rc = -errno;
+
+    blkclone_progress(&job, start);
+    if (opts->func)
+        opts->func(&job.p, opts->data);
+    if (result)
+        *result = job.p;
+
+destroy:
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+
+out:
+    for (i = 0; i < job.nslots; i++) {
+        if (job.slots[i].buf)
+            bufpool_put(job.slots[i].buf, job.chunk);
+    }
+    if (job.zeroBuf)
+        bufpool_put(job.zeroBuf, job.chunk);
+    if (job.dst >= 0)
+        close(job.dst);
+    blkra_end(&job.ra);
+    close(job.src);
+
+    return rc;
+}
+
+const char* blkclone_zero_to_name(BlkCloneZero method)
+{
+    switch (method) {
+        case BLKCLONE_ZERO_WRITE:
+            return "write";
+        case BLKCLONE_ZERO_HOLE:
+            return "hole";
+        case BLKCLONE_ZERO_ZEROOUT:
+            return "zeroout";
+        case BLKCLONE_ZERO_DISCARD:
+            return "discard";
+    }
+
+    return "unknown";
+}
+
+static double blkclone_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void blkclone_deadline(struct timespec* ts, unsigned int ms)
+{
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long) (ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+/* a device is overwritten in place, a file is recreated sparse at the full size */
+static int blkclone_open_target(const char* dst, const struct stat* srcSt, uint64_t size, BlkCloneJob* job)
+{
+    BlkdevTopology tp;
+    struct stat st;
+    int fd, rc;
+
+    if (stat(dst, &st) == 0) {
+        if (S_ISBLK(st.st_mode) ? st.st_rdev == srcSt->st_rdev && S_ISBLK(srcSt->st_mode)
+                                : st.st_dev == srcSt->st_dev && st.st_ino == srcSt->st_ino)
+            return -EINVAL;
+        if (!S_ISBLK(st.st_mode) && !S_ISREG(st.st_mode))
+            return -ENOTBLK;
+    } else if (errno != ENOENT) {
+        return -errno;
+    } else {
+        st.st_mode = S_IFREG;
+    }
+
+    if (S_ISREG(st.st_mode)) {
+        fd = open(dst, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return -errno;
+        job->dst = fd;
+        job->method = BLKCLONE_ZERO_HOLE;
+        return ftruncate(fd, (off_t) size) != 0 ? -errno : 0;
+    }
+
+    fd = blkdev_open_direct(dst, O_WRONLY | O_CLOEXEC, &job->dstDirect);
+    if (fd < 0)
+        return fd;
+    job->dst = fd;
+    job->method = BLKCLONE_ZERO_ZEROOUT;
+    rc = blkdev_get_topology(fd, &tp);
+    if (rc)
+        return rc;
+    if (tp.size < size)
+        return -ENOSPC;
+    if (tp.logicalSectorSize > job->align)
+        job->align = tp.logicalSectorSize;
+
+    return 0;
+}
+
+/* @len bytes, the request is rounded up for O_DIRECT and may end short at EOF */
+static int blkclone_read(BlkCloneJob* job, unsigned char* buf, uint64_t offset, size_t len)
+{
+    size_t want = len;
+    ssize_t ret;
+
+    if (want % job->align)
+        want += job->align - want % job->align;
+
+    ret = pread_all(job->src, buf, want, (off_t) offset);
+    if (ret < 0)
+        return -errno;
+    if ((size_t) ret < len)
+        return -EIO;
+    blkra_drop(&job->ra, offset, len);
+
+    return 0;
+}
+
+static int blkclone_write(BlkCloneJob* job, const unsigned char* buf, uint64_t offset, size_t len)
+{
+    if (pwrite_all(job->dst, buf, len, (off_t) offset) == 0)
+        return 0;
+
+    /* an odd sized tail does not go through O_DIRECT, rewriting what already landed is harmless */
+    if (errno == EINVAL && job->dstDirect) {
+        job->dstDirect = 0;
+        if (fcntl(job->dst, F_SETFL, fcntl(job->dst, F_GETFL) & ~O_DIRECT) != 0)
+            return -EINVAL;
+        if (pwrite_all(job->dst, buf, len, (off_t) offset) == 0)
+            return 0;
+    }
+
+    return -errno;
+}
+
+static int blkclone_write_zeroes(BlkCloneJob* job, uint64_t offset, uint64_t len)
+{
+    int rc;
+
+    if (!len)
+        return 0;
+    if (!job->zeroBuf) {
+        job->zeroBuf = bufpool_get(job->chunk);
+        if (!job->zeroBuf)
+            return -ENOMEM;
+        memset(job->zeroBuf, 0, job->chunk);
+    }
+
+    while (len) {
+        size_t n = len < job->chunk ? (size_t) len : job->chunk;
+
+        rc = blkclone_write(job, job->zeroBuf, offset, n);
+        if (rc)
+            return rc;
+        offset += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+static int blkclone_flush_zero(BlkCloneJob* job)
+{
+    uint64_t range[2] = { job->zeroStart, job->zeroLen };
+    uint64_t tail;
+
+    if (!job->zeroLen)
+        return 0;
+    job->zeroLen = 0;
+    if (job->method == BLKCLONE_ZERO_HOLE)
+        return 0;
+
+    /* the ioctls take whole sectors, the odd tail of an image source is written */
+    tail = range[1] % job->align;
+    range[1] -= tail;
+
+    if (range[1] && job->method == BLKCLONE_ZERO_DISCARD) {
+        if (ioctl(job->dst, BLKDISCARD, range) == 0) {
+            range[0] += range[1];
+            range[1] = 0;
+        } else if (errno == EOPNOTSUPP || errno == ENOTTY) {
+            job->method = job->p.method = BLKCLONE_ZERO_ZEROOUT;
+        } else {
+            return -errno;
+        }
+    }
+
+    if (range[1] && job->method == BLKCLONE_ZERO_ZEROOUT) {
+        if (ioctl(job->dst, BLKZEROOUT, range) == 0) {
+            range[0] += range[1];
+            range[1] = 0;
+        } else if (errno == EOPNOTSUPP || errno == ENOTTY) {
+            job->method = job->p.method = BLKCLONE_ZERO_WRITE;
+        } else {
+            return -errno;
+        }
+    }
+
+    return blkclone_write_zeroes(job, range[0], range[1] + tail);
+}
+
+/* neighbouring zero blocks, also across chunks, are flushed as one range */
+static int blkclone_add_zero(BlkCloneJob* job, uint64_t offset, uint64_t len)
+{
+    int rc;
+
+    job->p.zeroed += len;
+    if (job->zeroLen && job->zeroStart + job->zeroLen == offset) {
+        job->zeroLen += len;
+        return 0;
+    }
+
+    rc = blkclone_flush_zero(job);
+    job->zeroStart = offset;
+    job->zeroLen = len;
+
+    return rc;
+}
+
+static int blkclone_write_chunk(BlkCloneJob* job, const BlkCloneSlot* slot)
+{
+    size_t pos, n, dataStart = 0, dataLen = 0;
+    int rc;
+
+    if (job->method == BLKCLONE_ZERO_WRITE && !job->zeroLen) {
+        job->p.written += slot->len;
+        return blkclone_write(job, slot->buf, slot->offset, slot->len);
+    }
+
+    for (pos = 0; pos < slot->len; pos += n) {
+        n = slot->len - pos < job->block ? slot->len - pos : job->block;
+
+        if (buffer_is_zero(slot->buf + pos, n)) {
+            if (dataLen) {
+                rc = blkclone_write(job, slot->buf + dataStart, slot->offset + dataStart, dataLen);
+                if (rc)
+                    return rc;
+                job->p.written += dataLen;
+                dataLen = 0;
+            }
+            rc = blkclone_add_zero(job, slot->offset + pos, n);
+        } else {
+            if (!dataLen) {
+                rc = blkclone_flush_zero(job);
+                dataStart = pos;
+            }
+            dataLen += n;
+        }
+        if (rc)
+            return rc;
+    }
+
+    if (!dataLen)
+        return 0;
+    job->p.written += dataLen;
+
+    return blkclone_write(job, slot->buf + dataStart, slot->offset + dataStart, dataLen);
+}
+
+/* the next slot once the writer is done with it, NULL if it stopped */
+static BlkCloneSlot* blkclone_reader_slot(BlkCloneJob* job, unsigned int* i)
+{
+    BlkCloneSlot* slot = &job->slots[*i];
+    int stop;
+
+    pthread_mutex_lock(&job->lock);
+    while (slot->full && !job->stop)
+        pthread_cond_wait(&job->cond, &job->lock);
+    stop = job->stop;
+    pthread_mutex_unlock(&job->lock);
+    if (stop)
+        return NULL;
+
+    *i = (*i + 1) % job->nslots;
+    slot->hole = 0;
+    slot->last = 0;
+    slot->rc = 0;
+
+    return slot;
+}
+
+static void blkclone_reader_post(BlkCloneJob* job, BlkCloneSlot* slot)
+{
+    pthread_mutex_lock(&job->lock);
+    slot->full = 1;
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+}
+
+/* reads the data extents in whole blocks and passes the holes on unread */
+static void* blkclone_reader(void* arg)
+{
+    BlkCloneJob* job = arg;
+    uint64_t pos = 0, start, end;
+    BlkCloneSlot* slot;
+    unsigned int i = 0;
+    ExtentIter it;
+    Extent ext;
+    int rc;
+
+    rc = extent_iter_init(&it, job->src, 0, job->size, 0);
+    while (!rc && (rc = extent_iter_next(&it, &ext)) > 0) {
+        rc = 0;
+        start = ext.offset - ext.offset % job->block;
+        end = ext.offset + ext.length;
+        if (end % job->block)
+            end += job->block - end % job->block;
+        if (end > job->size)
+            end = job->size;
+        if (start < pos)
+            start = pos;
+        if (end <= start)
+            continue;
+
+        if (start > pos) {
+            if (!(slot = blkclone_reader_slot(job, &i)))
+                goto out;
+            slot->offset = pos;
+            slot->len = start - pos;
+            slot->hole = 1;
+            blkclone_reader_post(job, slot);
+        }
+
+        for (pos = start; pos < end && !rc; pos += slot->len) {
+            if (!(slot = blkclone_reader_slot(job, &i)))
+                goto out;
+            slot->offset = pos;
+            slot->len = end - pos < job->chunk ? end - pos : job->chunk;
+            rc = slot->rc = blkclone_read(job, slot->buf, pos, slot->len);
+            blkclone_reader_post(job, slot);
+        }
+    }
+
+    /* the trailing hole, or the error which ended the walk */
+    if ((slot = blkclone_reader_slot(job, &i))) {
+        slot->offset = pos;
+        slot->len = rc ? 0 : job->size - pos;
+        slot->hole = 1;
+        slot->last = 1;
+        slot->rc = rc;
+        blkclone_reader_post(job, slot);
+    }
+
+out:
+    extent_iter_deinit(&it);
+    return NULL;
+}
+
+static void blkclone_progress(BlkCloneJob* job, double start)
+{
+    job->p.seconds = blkclone_now() - start;
+    job->p.bytesPerSec = job->p.seconds > 0 ? job->p.done / job->p.seconds : 0;
+}
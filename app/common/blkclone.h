@@ -0,0 +1,83 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_BLKCLONE_H
+#define GRACEFUL_PARTITION_BLKCLONE_H
+
+#include <stdint.h>
+
+/* defaults if the caller leaves them 0 */
+#define BLKCLONE_CHUNK_SIZE         (4 * 1024 * 1024)
+#define BLKCLONE_BLOCK_SIZE         4096
+#define BLKCLONE_BUFFERS            2
+#define BLKCLONE_INTERVAL_MS        1000
+
+#define BLKCLONE_MAX_BUFFERS        16
+
+typedef struct _BlkClone            BlkClone;
+typedef struct _BlkCloneProgress    BlkCloneProgress;
+
+/* what happens to a run of zero blocks on the target */
+typedef enum
+{
+    BLKCLONE_ZERO_WRITE = 0,                            /* written like any other data */
+    BLKCLONE_ZERO_HOLE,                                 /* skipped, the target file is sparse */
+    BLKCLONE_ZERO_ZEROOUT,                              /* BLKZEROOUT, offloaded if the device can */
+    BLKCLONE_ZERO_DISCARD,                              /* BLKDISCARD */
+} BlkCloneZero;
+
+struct _BlkCloneProgress
+{
+    uint64_t                        done;               /* bytes */
+    uint64_t                        total;
+    uint64_t                        written;            /* bytes of data written */
+    uint64_t                        zeroed;             /* bytes found zero and not written */
+    uint64_t                        skipped;            /* part of those in holes of the source, never read */
+    double                          seconds;
+    double                          bytesPerSec;
+    BlkCloneZero                    method;             /* may fall back to BLKCLONE_ZERO_WRITE on the way */
+    int                             direct;             /* the source was read with O_DIRECT */
+};
+
+typedef void (*BlkCloneProgressFunc) (const BlkCloneProgress* p, void* data);
+
+struct _BlkClone
+{
+    unsigned int                    chunkSize;          /* bytes per read */
+    unsigned int                    blockSize;          /* zero detection granularity */
+    unsigned int                    nbuffers;           /* chunks in flight between reader and writer */
+
+    int                             noSparse;           /* write zero blocks like data */
+    int                             discard;            /* discard zero runs on a device target, see below */
+
+    BlkCloneProgressFunc            func;               /* may be NULL */
+    void*                           data;
+    unsigned int                    intervalMs;
+};
+
+/*
+ * Copy all of @src (block device or image file) to @dst. A reader thread
+ * fills @opts->nbuffers chunks while the calling thread writes the previous
+ * ones, so reading and writing overlap. Holes of an image source are not
+ * read at all (see extent_iter_init()), every other @opts->blockSize block
+ * is checked for zeroes first. Runs of zero blocks are not written:
+ *
+ *  - a regular file @dst is truncated and the runs are left as holes; a
+ *    missing @dst is created as such a file,
+ *  - on a block device @dst they are zeroed with BLKZEROOUT, which thin and
+ *    NVMe devices do without moving the data. With @opts->discard they are
+ *    discarded instead, which is only correct if the device reads
+ *    discarded blocks back as zeroes or their content does not matter.
+ *
+ * Ranges the kernel refuses to zero out are written after all. The source
+ * is read with O_DIRECT if possible, a device target is opened with
+ * O_DIRECT and O_EXCL. @opts->func is called every @opts->intervalMs and
+ * once at the end, the final numbers are stored in @result (may be NULL).
+ * Returns 0 or -errno, -ENOSPC if a device @dst is smaller than @src.
+ */
+int blkclone_run(const char* src, const char* dst, const BlkClone* opts, BlkCloneProgress* result);
+
+const char* blkclone_zero_to_name(BlkCloneZero method);
+
+#endif //GRACEFUL_PARTITION_BLKCLONE_H
@@ -2,14 +2,28 @@
 // Created by dingjing on 4/24/22.
 //
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                 /* program_invocation_short_name */
+#endif
+
 #include "blkdev.h"
 
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/file.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <pthread.h>
+#ifdef __linux__
+# include <sys/sysmacros.h>
+#endif
 
 #ifdef HAVE_LINUX_FD_H
 #include <linux/fd.h>
@@ -34,8 +48,30 @@
 #include "blkdev.h"
 #include "linux-version.h"
 #include "file-utils.h"
+#include "path-name.h"
+#include "path.h"
 #include "nls.h"
 
+/* number of devices whose searched size and topology are remembered */
+#define BLKDEV_SIZE_CACHE_SIZE      64
+#define BLKDEV_TOPOLOGY_CACHE_SIZE  64
+
+typedef struct _BlkdevSizeCache     BlkdevSizeCache;
+
+/* a searched size stays valid as long as the disk sequence number does */
+struct _BlkdevSizeCache
+{
+    dev_t                           devno;
+    uint64_t                        diskseq;
+    unsigned long long              bytes;
+};
+
+static BlkdevSizeCache blkdevSizeCache[BLKDEV_SIZE_CACHE_SIZE];
+static unsigned int blkdevSizeCacheNext;
+static BlkdevTopology blkdevTopologyCache[BLKDEV_TOPOLOGY_CACHE_SIZE];
+static unsigned int blkdevTopologyCacheNext;
+static pthread_mutex_t blkdevCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
 static long
 blkdev_valid_offset (int fd, off_t offset) {
     char ch;
@@ -82,6 +118,167 @@ blkdev_find_size (int fd) {
     return (low + 1);
 }
 
+/* does the device have at least @n sectors? */
+static int
+blkdev_has_sectors (int fd, unsigned char *buf, unsigned int ss, uint64_t n) {
+    if (!n)
+        return 1;
+    return pread (fd, buf, ss, (off_t) ((n - 1) * ss)) == (ssize_t) ss;
+}
+
+static uint64_t
+blkdev_get_size_estimate (int fd, const struct stat *st) {
+    uint64_t sectors = 0;
+    PathCxt *pc;
+
+    if (!S_ISBLK(st->st_mode))
+        return st->st_size;
+
+    pc = path_new_path (_PATH_SYS_DEVBLOCK "/%d:%d", major(st->st_rdev), minor(st->st_rdev));
+    if (!pc)
+        return 0;
+    if (path_read_u64 (pc, &sectors, "size") != 0)
+        sectors = 0;
+    path_unref_path (pc);
+
+    /* sysfs counts 512-byte sectors whatever the logical sector size is */
+    return sectors << 9;
+}
+
+off_t
+blkdev_find_size_fast (int fd) {
+    uint64_t lo = 0, hi = 0, step, max, est;
+    unsigned char *buf = NULL;
+    unsigned int ss = DEFAULT_SECTOR_SIZE;
+    char self[64];
+    int dfd, sz = 0;
+    struct stat st;
+
+    if (fstat (fd, &st) != 0)
+        return -1;
+    if (S_ISREG(st.st_mode))
+        return st.st_size;
+
+    if (blkdev_get_sector_size (fd, &sz) == 0 && sz > 0)
+        ss = sz;
+    if (posix_memalign ((void **) &buf, getpagesize (), ss))
+        return -1;
+
+    /*
+     * O_DIRECT keeps the page cache out of it. The flag belongs to the open
+     * file description, which the caller may share with other threads, so
+     * the probes go through an own one opened via /proc; without it they
+     * are buffered on @fd, pread does not move the file offset.
+     */
+    snprintf (self, sizeof(self), _PATH_PROC_FDDIR "/%d", fd);
+    dfd = open (self, O_RDONLY | O_DIRECT | O_CLOEXEC);
+    if (dfd >= 0 && pread (dfd, buf, ss, 0) < 0 && errno == EINVAL) {
+        close (dfd);
+        dfd = -1;
+    }
+    if (dfd >= 0)
+        fd = dfd;
+
+    max = (uint64_t) INT64_MAX / ss;
+    est = blkdev_get_size_estimate (fd, &st) / ss;
+    if (est > max)
+        est = max;
+
+    if (est && blkdev_has_sectors (fd, buf, ss, est)) {
+        lo = est;
+        if (!blkdev_has_sectors (fd, buf, ss, est + 1))
+            hi = est + 1;
+    } else if (est) {
+        /* too big, gallop down */
+        hi = est;
+        for (step = 1; hi > 0; step <<= 1) {
+            uint64_t n = hi > step ? hi - step : 0;
+
+            if (blkdev_has_sectors (fd, buf, ss, n)) {
+                lo = n;
+                break;
+            }
+            hi = n;
+        }
+    }
+
+    /* no estimate or too small, gallop up */
+    if (!hi) {
+        for (step = 1; lo + step <= max && blkdev_has_sectors (fd, buf, ss, lo + step); ) {
+            lo += step;
+            if (step < max / 2)
+                step <<= 1;
+        }
+        hi = lo + step;
+    }
+
+    while (lo + 1 < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+
+        if (blkdev_has_sectors (fd, buf, ss, mid))
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    if (dfd >= 0)
+        close (dfd);
+    free (buf);
+
+    return (off_t) (lo * ss);
+}
+
+int
+blkdev_get_diskseq(int fd, uint64_t *seq)
+{
+#ifdef BLKGETDISKSEQ
+    if (ioctl(fd, BLKGETDISKSEQ, seq) >= 0)
+        return 0;
+#endif
+    return -1;
+}
+
+/* search the size, remembered per device until the media changes */
+static int
+blkdev_find_size_cached (int fd, const struct stat *st, unsigned long long *bytes) {
+    uint64_t seq = 0;
+    unsigned int i;
+    off_t sz;
+    int cached = S_ISBLK(st->st_mode) && blkdev_get_diskseq (fd, &seq) == 0;
+
+    if (cached) {
+        pthread_mutex_lock (&blkdevCacheLock);
+        for (i = 0; i < BLKDEV_SIZE_CACHE_SIZE; i++) {
+            BlkdevSizeCache *c = &blkdevSizeCache[i];
+
+            if (c->diskseq == seq && c->devno == st->st_rdev) {
+                *bytes = c->bytes;
+                pthread_mutex_unlock (&blkdevCacheLock);
+                return 0;
+            }
+        }
+        pthread_mutex_unlock (&blkdevCacheLock);
+    }
+
+    sz = blkdev_find_size_fast (fd);
+    if (sz < 0)
+        sz = blkdev_find_size (fd);
+    if (sz < 0)
+        return -1;
+    *bytes = sz;
+
+    if (cached) {
+        pthread_mutex_lock (&blkdevCacheLock);
+        blkdevSizeCache[blkdevSizeCacheNext].devno = st->st_rdev;
+        blkdevSizeCache[blkdevSizeCacheNext].diskseq = seq;
+        blkdevSizeCache[blkdevSizeCacheNext].bytes = *bytes;
+        blkdevSizeCacheNext = (blkdevSizeCacheNext + 1) % BLKDEV_SIZE_CACHE_SIZE;
+        pthread_mutex_unlock (&blkdevCacheLock);
+    }
+
+    return 0;
+}
+
 /* get size in bytes */
 int
 blkdev_get_size(int fd, unsigned long long *bytes)
@@ -161,16 +358,17 @@ blkdev_get_size(int fd, unsigned long long *bytes)
     {
         struct stat st;
 
-        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (fstat(fd, &st) != 0)
+            return -1;
+        if (S_ISREG(st.st_mode)) {
             *bytes = st.st_size;
             return 0;
         }
         if (!S_ISBLK(st.st_mode))
             return -1;
-    }
 
-    *bytes = blkdev_find_size(fd);
-    return 0;
+        return blkdev_find_size_cached(fd, &st, bytes);
+    }
 }
 
 /* get 512-byte sector count */
@@ -280,6 +478,75 @@ int open_blkdev_or_file(const struct stat *st, const char *name, const int oflag
     return fd;
 }
 
+/*
+ * Does @fd, opened with O_DIRECT, take direct I/O? STATX_DIOALIGN answers
+ * without touching the media, block devices always take sector aligned
+ * requests. Regular files on kernels without it get one aligned read, and
+ * only EINVAL counts as a refusal: a read error says nothing about O_DIRECT.
+ */
+static int
+blkdev_direct_works (int fd, const struct stat *st, int oflag) {
+    void *buf;
+    int works = 1;
+
+#ifdef STATX_DIOALIGN
+    struct statx stx;
+
+    if (statx (fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 && (stx.stx_mask & STATX_DIOALIGN))
+        return stx.stx_dio_offset_align != 0;
+#endif
+    if (S_ISBLK(st->st_mode) || (oflag & O_ACCMODE) == O_WRONLY)
+        return 1;
+
+    if (posix_memalign (&buf, 4096, 4096))
+        return 1;
+    if (pread (fd, buf, 4096, 0) < 0 && errno == EINVAL)
+        works = 0;
+    free (buf);
+
+    return works;
+}
+
+int blkdev_open_direct(const char *name, int oflag, int *direct)
+{
+    struct stat st;
+    int fd;
+
+    *direct = 0;
+    if (stat(name, &st) != 0)
+        return -errno;
+    if (!S_ISBLK(st.st_mode) && !S_ISREG(st.st_mode))
+        return -ENOTBLK;
+    if (S_ISBLK(st.st_mode) && (oflag & O_ACCMODE) != O_RDONLY)
+        oflag |= O_EXCL;
+
+    /* like open_blkdev_or_file(), the path must not have been swapped since stat() */
+    fd = open(name, oflag | O_DIRECT);
+    if (fd < 0) {
+        /* tmpfs and friends refuse O_DIRECT right at open() */
+        if (errno != EINVAL)
+            return -errno;
+    } else if (!is_same_inode(fd, &st)) {
+        close(fd);
+        return -EBADFD;
+    } else if (blkdev_direct_works (fd, &st, oflag)) {
+        *direct = 1;
+        return fd;
+    } else {
+        close(fd);
+    }
+
+    fd = open(name, oflag);
+    if (fd < 0)
+        return -errno;
+    if (!is_same_inode(fd, &st)) {
+        close(fd);
+        return -EBADFD;
+    }
+
+    return fd;
+}
+
 #ifdef CDROM_GET_CAPABILITY
 int blkdev_is_cdrom(int fd)
 {
@@ -325,6 +592,184 @@ int blkdev_get_geometry(int fd, unsigned int *h, unsigned int *s)
     return -1;
 }
 
+/* queue attributes of a partition are found in the directory of the whole disk */
+static int
+blkdev_read_queue_u64 (PathCxt *pc, const char *attr, uint64_t *res) {
+    if (path_readf_u64 (pc, res, "queue/%s", attr) == 0)
+        return 0;
+    return path_readf_u64 (pc, res, "../queue/%s", attr);
+}
+
+static void
+blkdev_read_sysfs_topology (const struct stat *st, BlkdevTopology *tp) {
+    char buf[32];
+    uint64_t x;
+    PathCxt *pc;
+
+    pc = path_new_path (_PATH_SYS_DEVBLOCK "/%d:%d", major(st->st_rdev), minor(st->st_rdev));
+    if (!pc)
+        return;
+
+    if (blkdev_read_queue_u64 (pc, "discard_granularity", &x) == 0)
+        tp->discardGranularity = (unsigned int) x;
+    if (blkdev_read_queue_u64 (pc, "discard_max_bytes", &x) == 0)
+        tp->discardMaxBytes = x;
+    if (blkdev_read_queue_u64 (pc, "write_zeroes_max_bytes", &x) == 0)
+        tp->writeZeroesMaxBytes = x;
+    if (blkdev_read_queue_u64 (pc, "max_sectors_kb", &x) == 0)
+        tp->maxIoBytes = (unsigned int) (x << 10);
+    if (blkdev_read_queue_u64 (pc, "rotational", &x) == 0)
+        tp->rotational = x ? 1 : 0;
+
+    if (path_read_buffer (pc, buf, sizeof(buf), "queue/zoned") > 0
+        || path_read_buffer (pc, buf, sizeof(buf), "../queue/zoned") > 0) {
+        if (strcmp (buf, "host-aware") == 0)
+            tp->zoned = BLKDEV_ZONED_HOST_AWARE;
+        else if (strcmp (buf, "host-managed") == 0)
+            tp->zoned = BLKDEV_ZONED_HOST_MANAGED;
+    }
+    /* chunk_sectors is the zone size of zoned devices, in 512-byte sectors */
+    if (tp->zoned != BLKDEV_ZONED_NONE && blkdev_read_queue_u64 (pc, "chunk_sectors", &x) == 0)
+        tp->zoneSize = x << 9;
+    if (tp->zoned != BLKDEV_ZONED_NONE && blkdev_read_queue_u64 (pc, "zone_append_max_bytes", &x) == 0)
+        tp->zoneAppendMaxBytes = (unsigned int) x;
+
+    path_unref_path (pc);
+}
+
+static int
+blkdev_query_topology (int fd, const struct stat *st, BlkdevTopology *tp) {
+    unsigned long long bytes = 0;
+    int ss = 0, pbs = 0;
+
+    memset (tp, 0, sizeof(*tp));
+    tp->rotational = -1;
+
+    if (blkdev_get_size (fd, &bytes) != 0)
+        return -EIO;
+    tp->size = bytes;
+
+    if (!S_ISBLK(st->st_mode)) {
+        tp->logicalSectorSize = DEFAULT_SECTOR_SIZE;
+        tp->physicalSectorSize = DEFAULT_SECTOR_SIZE;
+        goto dio;
+    }
+    tp->devno = st->st_rdev;
+
+    if (blkdev_get_sector_size (fd, &ss) != 0 || ss <= 0)
+        ss = DEFAULT_SECTOR_SIZE;
+    tp->logicalSectorSize = ss;
+    if (blkdev_get_physector_size (fd, &pbs) != 0 || pbs <= 0)
+        pbs = ss;
+    tp->physicalSectorSize = pbs;
+
+#ifdef BLKIOMIN
+    if (ioctl (fd, BLKIOMIN, &tp->ioMin) < 0)
+        tp->ioMin = 0;
+    if (ioctl (fd, BLKIOOPT, &tp->ioOpt) < 0)
+        tp->ioOpt = 0;
+#endif
+#ifdef BLKALIGNOFF
+    if (ioctl (fd, BLKALIGNOFF, &tp->alignmentOffset) < 0)
+        tp->alignmentOffset = 0;
+#endif
+
+    blkdev_read_sysfs_topology (st, tp);
+    blkdev_get_geometry (fd, &tp->heads, &tp->sectors);
+
+dio:
+#ifdef STATX_DIOALIGN
+    {
+        struct statx stx;
+
+        if (statx (fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 && (stx.stx_mask & STATX_DIOALIGN)) {
+            tp->dioMemAlign = stx.stx_dio_mem_align;
+            tp->dioOffsetAlign = stx.stx_dio_offset_align;
+        }
+    }
+#endif
+    return 0;
+}
+
+int
+blkdev_get_topology(int fd, BlkdevTopology *tp)
+{
+    unsigned long long bytes;
+    struct stat st;
+    uint64_t seq = 0;
+    unsigned int i, slot;
+    int cached, rc;
+
+    if (fstat(fd, &st) != 0)
+        return -errno;
+
+    cached = S_ISBLK(st.st_mode) && blkdev_get_diskseq(fd, &seq) == 0;
+    if (cached) {
+        pthread_mutex_lock(&blkdevCacheLock);
+        for (i = 0; i < BLKDEV_TOPOLOGY_CACHE_SIZE; i++) {
+            if (blkdevTopologyCache[i].devno == st.st_rdev && blkdevTopologyCache[i].diskseq == seq) {
+                *tp = blkdevTopologyCache[i];
+                pthread_mutex_unlock(&blkdevCacheLock);
+                /* BLKPG resizes partitions under the same sequence number, the size is read anew */
+                if (blkdev_get_size(fd, &bytes) != 0)
+                    return -EIO;
+                tp->size = bytes;
+                return 0;
+            }
+        }
+        pthread_mutex_unlock(&blkdevCacheLock);
+    }
+
+    rc = blkdev_query_topology(fd, &st, tp);
+    if (rc)
+        return rc;
+    tp->diskseq = seq;
+
+    if (cached) {
+        pthread_mutex_lock(&blkdevCacheLock);
+        /* a new media replaces the stale record of the same device */
+        slot = blkdevTopologyCacheNext;
+        for (i = 0; i < BLKDEV_TOPOLOGY_CACHE_SIZE; i++) {
+            if (blkdevTopologyCache[i].devno == st.st_rdev) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot == blkdevTopologyCacheNext)
+            blkdevTopologyCacheNext = (blkdevTopologyCacheNext + 1) % BLKDEV_TOPOLOGY_CACHE_SIZE;
+        blkdevTopologyCache[slot] = *tp;
+        pthread_mutex_unlock(&blkdevCacheLock);
+    }
+
+    return 0;
+}
+
+void
+blkdev_invalidate_topology(int fd)
+{
+    struct stat st;
+    uint64_t seq = 0;
+    unsigned int i;
+
+    if (fstat(fd, &st) != 0 || !S_ISBLK(st.st_mode))
+        return;
+
+    /* partitions report the sequence number of their disk, that catches them all */
+    if (blkdev_get_diskseq(fd, &seq) != 0)
+        seq = 0;
+
+    pthread_mutex_lock(&blkdevCacheLock);
+    for (i = 0; i < BLKDEV_TOPOLOGY_CACHE_SIZE; i++) {
+        if (blkdevTopologyCache[i].devno == st.st_rdev || (seq && blkdevTopologyCache[i].diskseq == seq))
+            memset(&blkdevTopologyCache[i], 0, sizeof(BlkdevTopology));
+    }
+    for (i = 0; i < BLKDEV_SIZE_CACHE_SIZE; i++) {
+        if (blkdevSizeCache[i].devno == st.st_rdev || (seq && blkdevSizeCache[i].diskseq == seq))
+            memset(&blkdevSizeCache[i], 0, sizeof(BlkdevSizeCache));
+    }
+    pthread_mutex_unlock(&blkdevCacheLock);
+}
+
 /*
  * Convert scsi type to human readable string.
  */
@@ -424,7 +869,7 @@ struct blk_zone_report *blkdev_get_zonereport(int fd, uint64_t sector, uint32_t
 	size_t rep_size;
 	int ret;
 
-	rep_size = sizeof(struct blk_zone_report) + sizeof(struct blk_zone) * 2;
+	rep_size = sizeof(struct blk_zone_report) + sizeof(struct blk_zone) * nzones;
 	rep = calloc(1, rep_size);
 	if (!rep)
 		return NULL;
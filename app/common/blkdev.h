@@ -62,6 +62,22 @@
 #  define BLKDISCARDZEROES _IO(0x12,124)
 # endif
 
+/* discard and zero out, introduced in 2.6.28, 2.6.36 and 3.7 */
+# ifndef BLKDISCARD
+#  define BLKDISCARD _IO(0x12,119)
+# endif
+# ifndef BLKSECDISCARD
+#  define BLKSECDISCARD _IO(0x12,125)
+# endif
+# ifndef BLKZEROOUT
+#  define BLKZEROOUT _IO(0x12,127)
+# endif
+
+/* disk sequence number, introduced in 5.15 (commit 7957d93b) */
+# ifndef BLKGETDISKSEQ
+#  define BLKGETDISKSEQ _IOR(0x12,128,uint64_t)
+# endif
+
 /* filesystem freeze, introduced in 2.6.29 (commit fcccf502) */
 # ifndef FIFREEZE
 #  define FIFREEZE   _IOWR('X', 119, int)    /* Freeze */
@@ -101,9 +117,28 @@ int is_blkdev(int fd);
 /* open block device or file */
 int open_blkdev_or_file(const struct stat *st, const char *name, const int oflag);
 
+/*
+ * Open a block device or regular file with O_DIRECT if it takes it and
+ * without otherwise. Support is learnt from STATX_DIOALIGN, nothing is
+ * read from a block device, so an unreadable first sector does not keep
+ * it from opening. Block devices get O_EXCL if @oflag asks for writing.
+ * @direct tells which open it was. Returns the fd or -errno, -EBADFD if
+ * @name was replaced by another file between the stat() and the open().
+ */
+int blkdev_open_direct(const char *name, int oflag, int *direct);
+
 /* Determine size in bytes */
 off_t blkdev_find_size (int fd);
 
+/*
+ * Determine size in bytes with sector aligned O_DIRECT preads, starting at
+ * the sysfs (or st_size) estimate, so a correct estimate costs two reads
+ */
+off_t blkdev_find_size_fast (int fd);
+
+/* get disk sequence number, it changes whenever the media does */
+int blkdev_get_diskseq(int fd, uint64_t *seq);
+
 /* get size in bytes */
 int blkdev_get_size(int fd, unsigned long long *bytes);
 
@@ -125,6 +160,60 @@ int blkdev_is_cdrom(int fd);
 /* get device's geometry - legacy */
 int blkdev_get_geometry(int fd, unsigned int *h, unsigned int *s);
 
+/* zoned block device models, see queue/zoned in sysfs */
+typedef enum
+{
+    BLKDEV_ZONED_NONE = 0,
+    BLKDEV_ZONED_HOST_AWARE,
+    BLKDEV_ZONED_HOST_MANAGED,
+} BlkdevZonedModel;
+
+typedef struct _BlkdevTopology      BlkdevTopology;
+
+/* everything callers usually ask one ioctl at a time, sizes in bytes */
+struct _BlkdevTopology
+{
+    dev_t                           devno;              /* st_rdev, 0 for regular files */
+    uint64_t                        diskseq;            /* 0 if unknown */
+
+    uint64_t                        size;
+    unsigned int                    logicalSectorSize;
+    unsigned int                    physicalSectorSize;
+    unsigned int                    ioMin;
+    unsigned int                    ioOpt;
+    int                             alignmentOffset;    /* -1 for incompatible stacked devices */
+
+    unsigned int                    discardGranularity; /* 0 if discard is not supported */
+    uint64_t                        discardMaxBytes;
+    uint64_t                        writeZeroesMaxBytes;
+    unsigned int                    maxIoBytes;         /* queue/max_sectors_kb, 0 if unknown */
+
+    int                             rotational;         /* 1, 0 or -1 if unknown */
+    BlkdevZonedModel                zoned;
+    uint64_t                        zoneSize;           /* 0 if not zoned */
+    unsigned int                    zoneAppendMaxBytes;
+
+    unsigned int                    dioMemAlign;        /* STATX_DIOALIGN, 0 if unknown */
+    unsigned int                    dioOffsetAlign;
+
+    unsigned int                    heads;              /* legacy geometry, 0 if unknown */
+    unsigned int                    sectors;
+};
+
+/*
+ * Fill @tp with the topology of @fd in one go. The record of a block
+ * device is cached per dev_t and reused as long as its disk sequence number
+ * (BLKGETDISKSEQ) does not change, kernels without it query every time.
+ * The size is read again on every call. Returns 0 or -errno.
+ */
+int blkdev_get_topology(int fd, BlkdevTopology *tp);
+
+/*
+ * Drop the cached records of @fd and, for a whole disk, of its partitions,
+ * after the partitions were changed (BLKPG, a new label).
+ */
+void blkdev_invalidate_topology(int fd);
+
 /* SCSI device types.  Copied almost as-is from kernel header.
  * http://git.kernel.org/cgit/linux/kernel/git/torvalds/linux.git/tree/include/scsi/scsi.h */
 #define SCSI_TYPE_DISK              0x00
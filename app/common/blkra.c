@@ -0,0 +1,356 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "blkra.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
+
+#include "path.h"
+#include "blkdev.h"
+#include "path-name.h"
+
+typedef struct _BlkRaRecord         BlkRaRecord;
+
+struct _BlkRaRecord
+{
+    unsigned long                   orig;
+    unsigned long                   raised;
+    pid_t                           pid;
+    char                            device[PATH_MAX];
+};
+
+static dev_t blkra_whole_disk(dev_t devno);
+static void blkra_record_path(dev_t disk, char* buf, size_t len);
+static int blkra_record_read(int fd, BlkRaRecord* rec);
+static int blkra_record_write(const char* path, const BlkRaRecord* rec);
+static int blkra_record_lock(const char* path, BlkRaRecord* rec, int* stale);
+static int blkra_undo(dev_t disk, const char* path, const BlkRaRecord* rec);
+
+unsigned long blkra_pick(unsigned int ioOpt)
+{
+    unsigned long bytes = (unsigned long) ioOpt * BLKRA_STRIPES;
+
+    if (bytes < BLKRA_MIN_BYTES)
+        bytes = BLKRA_MIN_BYTES;
+    if (bytes > BLKRA_MAX_BYTES)
+        bytes = BLKRA_MAX_BYTES;
+
+    /* whole stripes, a partial one costs the same as a full one */
+    if (ioOpt && ioOpt <= bytes)
+        bytes -= bytes % ioOpt;
+
+    return bytes;
+}
+
+int blkra_begin(BlkReadahead* ra, int fd, uint64_t offset, uint64_t length)
+{
+    char path[PATH_MAX], self[64];
+    unsigned long cur, want;
+    BlkdevTopology tp;
+    struct stat st;
+    BlkRaRecord rec;
+    int lfd, stale, rc;
+    ssize_t n;
+
+    memset(ra, 0, sizeof(*ra));
+    ra->fd = fd;
+    ra->lockFd = -1;
+    ra->offset = offset;
+    ra->length = length;
+    posix_fadvise(fd, (off_t) offset, (off_t) length, POSIX_FADV_SEQUENTIAL);
+
+    if (fstat(fd, &st) != 0)
+        return -errno;
+    if (!S_ISBLK(st.st_mode))
+        return 0;
+
+    rc = blkdev_get_topology(fd, &tp);
+    if (rc)
+        return rc;
+    if (ioctl(fd, BLKRAGET, &cur) != 0)
+        return -errno;
+
+    ra->disk = blkra_whole_disk(st.st_rdev);
+    blkra_record_path(ra->disk, path, sizeof(path));
+    want = blkra_pick(tp.ioOpt) >> 9;
+
+    while (1) {
+        lfd = blkra_record_lock(path, &rec, &stale);
+        if (lfd >= 0 && !stale) {
+            /* another scope has raised it, the last one of us puts it back */
+            ra->orig = rec.orig;
+            ra->raised = rec.raised;
+            ra->lockFd = lfd;
+            return 0;
+        }
+        if (lfd >= 0) {
+            /* left behind by a process which died */
+            if (rec.raised && rec.raised == cur && ioctl(fd, BLKRASET, rec.orig) == 0)
+                cur = rec.orig;
+            unlink(path);
+            close(lfd);
+            continue;
+        }
+        if (lfd != -ENOENT)
+            return lfd;
+
+        ra->orig = cur;
+        if (cur >= want)
+            return 0;
+
+        if ((mkdir(_PATH_RUN_GRACEFUL, 0755) != 0 && errno != EEXIST)
+            || (mkdir(_PATH_RUN_READAHEAD, 0755) != 0 && errno != EEXIST))
+            return -errno;
+
+        memset(&rec, 0, sizeof(rec));
+        rec.orig = cur;
+        rec.raised = want;
+        rec.pid = getpid();
+        snprintf(self, sizeof(self), _PATH_PROC_FDDIR "/%d", fd);
+        n = readlink(self, rec.device, sizeof(rec.device) - 1);
+        rec.device[n > 0 ? n : 0] = '\0';
+
+        lfd = blkra_record_write(path, &rec);
+        /* lost the race against another scope, join it */
+        if (lfd == -EEXIST)
+            continue;
+        if (lfd < 0)
+            return lfd;
+        break;
+    }
+
+    if (ioctl(fd, BLKRASET, want) != 0) {
+        rc = -errno;
+        /* whoever joined meanwhile finds nothing to put back and removes it */
+        if (flock(lfd, LOCK_EX | LOCK_NB) == 0)
+            unlink(path);
+        close(lfd);
+        return rc;
+    }
+    ra->raised = want;
+    ra->lockFd = lfd;
+
+    return 0;
+}
+
+void blkra_drop(const BlkReadahead* ra, uint64_t offset, uint64_t length)
+{
+    if (ra->fd >= 0)
+        posix_fadvise(ra->fd, (off_t) offset, (off_t) length, POSIX_FADV_DONTNEED);
+}
+
+int blkra_end(BlkReadahead* ra)
+{
+    char path[PATH_MAX];
+    unsigned long cur;
+    struct stat st;
+    int rc = 0;
+
+    if (ra->fd < 0)
+        return 0;
+
+    posix_fadvise(ra->fd, (off_t) ra->offset, (off_t) ra->length, POSIX_FADV_NORMAL);
+    /* only the last user gets the lock exclusively, the others just drop theirs */
+    if (ra->lockFd >= 0 && flock(ra->lockFd, LOCK_EX | LOCK_NB) == 0
+        && fstat(ra->lockFd, &st) == 0 && st.st_nlink) {
+        /* somebody tuned it during the pass, their value wins */
+        if (ioctl(ra->fd, BLKRAGET, &cur) == 0 && cur == ra->raised
+            && ioctl(ra->fd, BLKRASET, ra->orig) != 0)
+            rc = -errno;
+        blkra_record_path(ra->disk, path, sizeof(path));
+        if (unlink(path) != 0 && errno != ENOENT && !rc)
+            rc = -errno;
+    }
+    if (ra->lockFd >= 0)
+        close(ra->lockFd);
+
+    ra->fd = -1;
+    ra->lockFd = -1;
+    ra->raised = 0;
+
+    return rc;
+}
+
+int blkra_recover(void)
+{
+    char path[PATH_MAX];
+    unsigned int maj, min;
+    struct dirent* d;
+    BlkRaRecord rec;
+    int n = 0, lfd, stale, rc;
+    DIR* dir;
+    char c;
+
+    dir = opendir(_PATH_RUN_READAHEAD);
+    if (!dir)
+        return errno == ENOENT ? 0 : -errno;
+
+    while ((d = readdir(dir))) {
+        /* temporary files start with a dot */
+        if (sscanf(d->d_name, "%u:%u%c", &maj, &min, &c) != 2)
+            continue;
+        snprintf(path, sizeof(path), _PATH_RUN_READAHEAD "/%s", d->d_name);
+        lfd = blkra_record_lock(path, &rec, &stale);
+        if (lfd < 0)
+            continue;
+
+        /* nobody holds it, the process which raised the disk is gone */
+        if (stale) {
+            rc = blkra_undo(makedev(maj, min), path, &rec);
+            if (rc > 0)
+                n++;
+        }
+        close(lfd);
+    }
+    closedir(dir);
+
+    return n;
+}
+
+/* partitions share the readahead of their disk */
+static dev_t blkra_whole_disk(dev_t devno)
+{
+    dev_t disk = devno;
+    PathCxt* pc;
+
+    pc = path_new_path(_PATH_SYS_DEVBLOCK "/%d:%d", major(devno), minor(devno));
+    if (!pc)
+        return devno;
+    if (path_access(pc, F_OK, "partition") == 0 && path_read_majmin(pc, &disk, "../dev") != 0)
+        disk = devno;
+    path_unref_path(pc);
+
+    return disk;
+}
+
+static void blkra_record_path(dev_t disk, char* buf, size_t len)
+{
+    snprintf(buf, len, _PATH_RUN_READAHEAD "/%u:%u", major(disk), minor(disk));
+}
+
+static int blkra_record_read(int fd, BlkRaRecord* rec)
+{
+    char buf[PATH_MAX + 64];
+    ssize_t n;
+
+    memset(rec, 0, sizeof(*rec));
+    n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n < 0)
+        return -errno;
+    buf[n] = '\0';
+
+    return sscanf(buf, "%lu %lu %d %4095s", &rec->orig, &rec->raised, &rec->pid, rec->device) >= 3 ? 0 : -EBADMSG;
+}
+
+/*
+ * The record is written to a temporary file first and link() claims the
+ * name only if there is none (-EEXIST), so a reader never sees half a
+ * record and two scopes never both create one. The shared lock is taken
+ * before the name appears, so a record is never seen without a user.
+ * Returns the locked fd or -errno.
+ */
+static int blkra_record_write(const char* path, const BlkRaRecord* rec)
+{
+    char tmp[PATH_MAX];
+    const char* name;
+    int fd, rc = 0;
+
+    name = strrchr(path, '/') + 1;
+    snprintf(tmp, sizeof(tmp), "%.*s.%s.%d", (int) (name - path), path, name, (int) getpid());
+
+    fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -errno;
+    if (flock(fd, LOCK_SH) != 0
+        || dprintf(fd, "%lu %lu %d %s\n", rec->orig, rec->raised, (int) rec->pid, rec->device) < 0)
+        rc = -errno;
+
+    if (!rc && link(tmp, path) != 0)
+        rc = -errno;
+    unlink(tmp);
+    if (rc) {
+        close(fd);
+        return rc;
+    }
+
+    return fd;
+}
+
+/*
+ * Open and lock the record at @path. Returns the fd with a shared lock
+ * and *stale = 0 while scopes use the disk, with an exclusive lock and
+ * *stale = 1 if none does, or -ENOENT if there is no record. A record
+ * removed while we waited for the lock is looked up again.
+ */
+static int blkra_record_lock(const char* path, BlkRaRecord* rec, int* stale)
+{
+    struct stat st;
+    int fd, rc;
+
+    while (1) {
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return -errno;
+
+        *stale = flock(fd, LOCK_EX | LOCK_NB) == 0;
+        if (!*stale) {
+            rc = errno == EWOULDBLOCK ? 0 : -errno;
+            while (!rc && flock(fd, LOCK_SH) != 0)
+                rc = errno == EINTR ? 0 : -errno;
+            if (rc) {
+                close(fd);
+                return rc;
+            }
+        }
+
+        if (fstat(fd, &st) != 0 || !st.st_nlink) {
+            close(fd);
+            continue;
+        }
+
+        /* a broken record is only of interest to the one removing it */
+        rc = blkra_record_read(fd, rec);
+        if (rc && !*stale) {
+            close(fd);
+            return rc;
+        }
+
+        return fd;
+    }
+}
+
+/* 1 if the readahead of @disk was put back, 0 if there was nothing to do, or -errno */
+static int blkra_undo(dev_t disk, const char* path, const BlkRaRecord* rec)
+{
+    unsigned long cur;
+    struct stat st;
+    int fd, rc = 0;
+
+    fd = rec->device[0] ? open(rec->device, O_RDONLY | O_NONBLOCK | O_CLOEXEC) : -1;
+    if (fd < 0 && (errno == EACCES || errno == EPERM))
+        return -errno;
+
+    /* the name may belong to another disk by now */
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISBLK(st.st_mode) && blkra_whole_disk(st.st_rdev) == disk
+        && ioctl(fd, BLKRAGET, &cur) == 0 && cur == rec->raised && rec->raised) {
+        rc = ioctl(fd, BLKRASET, rec->orig) == 0 ? 1 : -errno;
+    }
+    if (fd >= 0)
+        close(fd);
+
+    if (rc >= 0)
+        unlink(path);
+
+    return rc;
+}
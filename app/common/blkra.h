@@ -0,0 +1,77 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_BLKRA_H
+#define GRACEFUL_PARTITION_BLKRA_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* readahead of a scope, a few full stripes but never below/above these */
+#define BLKRA_MIN_BYTES             (4 * 1024 * 1024)
+#define BLKRA_MAX_BYTES             (64 * 1024 * 1024)
+#define BLKRA_STRIPES               4
+
+typedef struct _BlkReadahead        BlkReadahead;
+
+/*
+ * Readahead is a property of the whole disk, not of the open file, so a
+ * raised value outlives the process unless it is put back. blkra_begin()
+ * leaves "<original> <raised> <pid> <device>" in a record below
+ * _PATH_RUN_READAHEAD before it raises anything.
+ *
+ * Every scope on the disk, in this or another process, holds a shared
+ * flock() on the record for as long as it runs, so the lock is the
+ * reference count: blkra_end() puts the original value back and removes
+ * the record only if it can take the lock exclusively, i.e. it is the
+ * last user. The kernel drops the locks of a process which dies, a
+ * record nobody holds a lock on is undone by blkra_recover() or the next
+ * scope on the same disk. /run does not survive a reboot, just like the
+ * raised value.
+ */
+struct _BlkReadahead
+{
+    int                             fd;                 /* -1 outside a scope */
+    uint64_t                        offset;             /* range given to posix_fadvise() */
+    uint64_t                        length;
+
+    dev_t                           disk;               /* whole disk, 0 for regular files */
+    unsigned long                   orig;               /* 512-byte sectors, as BLKRAGET */
+    unsigned long                   raised;             /* 0 if the disk was left alone */
+    int                             lockFd;             /* the record, shared lock held; -1 if none */
+};
+
+/* readahead in bytes for a sequential pass over a device with @ioOpt */
+unsigned long blkra_pick(unsigned int ioOpt);
+
+/*
+ * Start a sequential pass over [@offset, @offset + @length) of @fd
+ * (@length 0 = up to the end): POSIX_FADV_SEQUENTIAL for the range and,
+ * for block devices, readahead raised to blkra_pick() if it is lower. A
+ * disk another scope raised already is left as it is, this one joins its
+ * users instead. @ra can be passed to blkra_drop() and blkra_end() even
+ * if this fails.
+ *
+ * Returns 0 or -errno if the readahead could not be raised (usually
+ * EACCES, BLKRASET needs CAP_SYS_ADMIN); the fadvise hints apply anyway.
+ */
+int blkra_begin(BlkReadahead* ra, int fd, uint64_t offset, uint64_t length);
+
+/* the pass is done with a range, drop it from the page cache (POSIX_FADV_DONTNEED) */
+void blkra_drop(const BlkReadahead* ra, uint64_t offset, uint64_t length);
+
+/*
+ * Leave the scope. The last user of a raised disk puts the original
+ * readahead back, unless somebody changed it during the pass, and removes
+ * the record. Returns 0 or -errno.
+ */
+int blkra_end(BlkReadahead* ra);
+
+/*
+ * Undo the records no running scope holds. Returns the number of disks
+ * whose readahead was put back or -errno.
+ */
+int blkra_recover(void);
+
+#endif //GRACEFUL_PARTITION_BLKRA_H
@@ -0,0 +1,515 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "blkverify.h"
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <inttypes.h>
+
+#include "hash64.h"
+#include "blkra.h"
+#include "all-io.h"
+#include "bitops.h"
+#include "blkdev.h"
+#include "bufpool.h"
+#include "extents.h"
+
+typedef struct _BlkVerifyJob        BlkVerifyJob;
+typedef struct _BlkVerifyDiff       BlkVerifyDiff;
+
+struct _BlkVerifyJob
+{
+    int                             fd;
+    unsigned int                    align;              /* read length granularity with O_DIRECT */
+    BlkReadahead                    ra;                 /* buffered reads only */
+    BlkVerifyManifest*              m;
+    unsigned char*                  hasData;            /* per chunk, NULL if everything is data */
+    uint64_t                        zeroHash;           /* of a whole chunk of zeroes */
+    uint64_t                        zeroTailHash;       /* of the last, shorter one */
+
+    uint64_t                        next;               /* atomic, next chunk */
+    uint64_t                        done;               /* atomic */
+    uint64_t                        skipped;            /* atomic */
+    int                             rc;                 /* atomic, first error */
+
+    pthread_mutex_t                 lock;
+    pthread_cond_t                  cond;
+    unsigned int                    running;
+};
+
+struct _BlkVerifyDiff
+{
+    const BlkVerifyManifest*        a;
+    const BlkVerifyManifest*        b;
+    BlkVerifyDiffFunc               func;
+    void*                           data;
+    int64_t                         count;
+    uint64_t                        runStart;           /* chunks */
+    uint64_t                        runLen;
+};
+
+static double blkverify_now(void);
+static uint64_t blkverify_node(const uint64_t* children, uint64_t n, unsigned int level);
+static void blkverify_manifest_update(BlkVerifyManifest* m);
+static int blkverify_map_data(BlkVerifyJob* job);
+static uint64_t blkverify_zero_hash(uint64_t len, int* rc);
+static int blkverify_read(BlkVerifyJob* job, unsigned char* buf, uint64_t offset, size_t len);
+static void* blkverify_worker(void* arg);
+static void blkverify_progress(BlkVerifyJob* job, double start, BlkVerifyProgress* p);
+static void blkverify_diff_flush(BlkVerifyDiff* d);
+static void blkverify_diff_walk(BlkVerifyDiff* d, unsigned int level, uint64_t index);
+
+int blkverify_manifest_init(BlkVerifyManifest* m, uint64_t offset, uint64_t size, unsigned int chunkSize)
+{
+    uint64_t n, total = 0;
+    unsigned int l;
+
+    memset(m, 0, sizeof(*m));
+    if (!chunkSize)
+        return -EINVAL;
+
+    m->offset = offset;
+    m->size = size;
+    m->chunkSize = chunkSize;
+    m->nchunks = (size + chunkSize - 1) / chunkSize;
+
+    /* an empty range still has a root, the hash of nothing */
+    n = m->nchunks ? m->nchunks : 1;
+    for (l = 0; l < BLKVERIFY_MAX_LEVELS; l++) {
+        m->levelStart[l] = total;
+        m->levelCount[l] = n;
+        total += n;
+        if (n == 1)
+            break;
+        n = (n + 1) / 2;
+    }
+    m->nlevels = l + 1;
+
+    m->nodes = calloc(total, sizeof(uint64_t));
+    return m->nodes ? 0 : -ENOMEM;
+}
+
+void blkverify_manifest_deinit(BlkVerifyManifest* m)
+{
+    free(m->nodes);
+    m->nodes = NULL;
+}
+
+uint64_t blkverify_manifest_root(const BlkVerifyManifest* m)
+{
+    return m->nodes ? m->nodes[m->levelStart[m->nlevels - 1]] : 0;
+}
+
+int blkverify_run(const char* path, const BlkVerify* opts, BlkVerifyManifest* m, BlkVerifyProgress* result)
+{
+    unsigned int i, nthreads, chunk, started = 0;
+    pthread_condattr_t attr;
+    BlkVerifyProgress p;
+    BlkdevTopology tp;
+    pthread_t* threads;
+    BlkVerifyJob job;
+    uint64_t size;
+    double start;
+    long ncpus;
+    int rc;
+
+    memset(&job, 0, sizeof(job));
+    memset(&p, 0, sizeof(p));
+    memset(m, 0, sizeof(*m));
+    job.ra.fd = -1;
+    if (opts->direct) {
+        job.fd = blkdev_open_direct(path, O_RDONLY | O_CLOEXEC, &p.direct);
+        if (job.fd < 0)
+            return job.fd;
+    } else {
+        job.fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (job.fd < 0)
+            return -errno;
+    }
+
+    rc = blkdev_get_topology(job.fd, &tp);
+    if (rc)
+        goto out;
+
+    job.align = 1;
+    if (p.direct) {
+        job.align = tp.logicalSectorSize;
+        if (tp.dioOffsetAlign > job.align)
+            job.align = tp.dioOffsetAlign;
+    }
+    size = opts->length ? opts->length : tp.size - (opts->offset < tp.size ? opts->offset : tp.size);
+    chunk = opts->chunkSize ? opts->chunkSize : BLKVERIFY_CHUNK_SIZE;
+    chunk -= chunk % job.align;
+    if (opts->offset + size > tp.size || opts->offset + size < opts->offset
+        || opts->offset % job.align || !chunk) {
+        rc = -EINVAL;
+        goto out;
+    }
+
+    rc = blkverify_manifest_init(m, opts->offset, size, chunk);
+    if (rc)
+        goto out;
+    job.m = m;
+    rc = blkverify_map_data(&job);
+    if (rc)
+        goto out;
+
+    ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = opts->nthreads ? opts->nthreads : (ncpus > 0 ? (unsigned int) ncpus : 1);
+    if (nthreads > BLKVERIFY_MAX_THREADS)
+        nthreads = BLKVERIFY_MAX_THREADS;
+    if (m->nchunks && nthreads > m->nchunks)
+        nthreads = (unsigned int) m->nchunks;
+    p.nthreads = nthreads;
+    p.total = size;
+
+    threads = calloc(nthreads, sizeof(pthread_t));
+    if (!threads) {
+        rc = -ENOMEM;
+        goto out;
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&job.cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (!p.direct)
+        blkra_begin(&job.ra, job.fd, opts->offset, size);
+
+    start = blkverify_now();
+    job.running = nthreads;
+    for (i = 0; i < nthreads; i++) {
+        int err = pthread_create(&threads[i], NULL, blkverify_worker, &job);
+        if (err) {
+            /* the started workers take over the remaining chunks */
+            pthread_mutex_lock(&job.lock);
+            job.running -= nthreads - i;
+            pthread_mutex_unlock(&job.lock);
+            if (!i)
+                job.rc = -err;
+            break;
+        }
+        started++;
+    }
+
+    pthread_mutex_lock(&job.lock);
+    while (job.running > 0) {
+        struct timespec ts;
+        unsigned int ms = opts->intervalMs ? opts->intervalMs : BLKVERIFY_INTERVAL_MS;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += ms / 1000;
+        ts.tv_nsec += (long) (ms % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+
+        if (pthread_cond_timedwait(&job.cond, &job.lock, &ts) == ETIMEDOUT && opts->func) {
+            pthread_mutex_unlock(&job.lock);
+            blkverify_progress(&job, start, &p);
+            opts->func(&p, opts->data);
+            pthread_mutex_lock(&job.lock);
+        }
+    }
+    pthread_mutex_unlock(&job.lock);
+
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+    blkra_end(&job.ra);
+    rc = job.rc;
+
+    if (!rc)
+        blkverify_manifest_update(m);
+    blkverify_progress(&job, start, &p);
+    if (opts->func)
+        opts->func(&p, opts->data);
+    if (result)
+        *result = p;
+
+out:
+    free(job.hasData);
+    close(job.fd);
+    return rc;
+}
+
+int blkverify_write_manifest(const BlkVerifyManifest* m, FILE* f)
+{
+    uint64_t i;
+
+    fprintf(f, "manifest version=%d hash=hash64 offset=%" PRIu64 " size=%" PRIu64 " chunk=%u chunks=%" PRIu64
+               " root=%016" PRIx64 "\n", BLKVERIFY_VERSION, m->offset, m->size, m->chunkSize, m->nchunks,
+            blkverify_manifest_root(m));
+    for (i = 0; i < m->nchunks; i++)
+        fprintf(f, "%" PRIu64 " %016" PRIx64 "\n", i * m->chunkSize, m->nodes[i]);
+
+    return fflush(f) == 0 && !ferror(f) ? 0 : -EIO;
+}
+
+int blkverify_read_manifest(BlkVerifyManifest* m, FILE* f)
+{
+    uint64_t offset, size, nchunks, root, off, i;
+    unsigned int chunk;
+    int version, rc;
+
+    memset(m, 0, sizeof(*m));
+    if (fscanf(f, " manifest version=%d hash=hash64 offset=%" SCNu64 " size=%" SCNu64 " chunk=%u chunks=%" SCNu64
+                  " root=%" SCNx64, &version, &offset, &size, &chunk, &nchunks, &root) != 6)
+        return -EBADMSG;
+    if (version != BLKVERIFY_VERSION)
+        return -EBADMSG;
+
+    rc = blkverify_manifest_init(m, offset, size, chunk);
+    if (rc)
+        return rc == -EINVAL ? -EBADMSG : rc;
+    if (nchunks != m->nchunks)
+        return -EBADMSG;
+
+    for (i = 0; i < nchunks; i++) {
+        if (fscanf(f, " %" SCNu64 " %" SCNx64, &off, &m->nodes[i]) != 2 || off != i * chunk)
+            return -EBADMSG;
+    }
+
+    blkverify_manifest_update(m);
+    return blkverify_manifest_root(m) == root ? 0 : -EBADMSG;
+}
+
+int64_t blkverify_compare(const BlkVerifyManifest* a, const BlkVerifyManifest* b, BlkVerifyDiffFunc func, void* data)
+{
+    BlkVerifyDiff d;
+
+    if (a->size != b->size || a->chunkSize != b->chunkSize || !a->nodes || !b->nodes)
+        return -EINVAL;
+
+    memset(&d, 0, sizeof(d));
+    d.a = a;
+    d.b = b;
+    d.func = func;
+    d.data = data;
+    if (a->nchunks)
+        blkverify_diff_walk(&d, a->nlevels - 1, 0);
+    blkverify_diff_flush(&d);
+
+    return d.count;
+}
+
+static double blkverify_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t blkverify_node(const uint64_t* children, uint64_t n, unsigned int level)
+{
+    uint64_t buf[2];
+
+    buf[0] = cpu_to_le64(children[0]);
+    if (n > 1)
+        buf[1] = cpu_to_le64(children[1]);
+
+    return hash64(buf, (n > 1 ? 2 : 1) * sizeof(uint64_t), level);
+}
+
+/* everything above the leaves */
+static void blkverify_manifest_update(BlkVerifyManifest* m)
+{
+    const uint64_t* below;
+    unsigned int l;
+    uint64_t i, n;
+
+    if (!m->nchunks) {
+        m->nodes[0] = hash64(NULL, 0, 0);
+        return;
+    }
+
+    for (l = 1; l < m->nlevels; l++) {
+        below = m->nodes + m->levelStart[l - 1];
+        n = m->levelCount[l - 1];
+        for (i = 0; i < m->levelCount[l]; i++)
+            m->nodes[m->levelStart[l] + i] = blkverify_node(below + 2 * i, n - 2 * i, l);
+    }
+}
+
+/* which chunks of an image touch data at all, nothing to do for devices */
+static int blkverify_map_data(BlkVerifyJob* job)
+{
+    BlkVerifyManifest* m = job->m;
+    uint64_t first, last, tail;
+    ExtentIter it;
+    Extent ext;
+    int rc;
+
+    if (!m->nchunks)
+        return 0;
+    rc = extent_iter_init(&it, job->fd, m->offset, m->size, 0);
+    if (rc || it.method == EXTENT_ITER_ALL) {
+        extent_iter_deinit(&it);
+        return rc;
+    }
+
+    job->hasData = calloc(m->nchunks, 1);
+    if (!job->hasData) {
+        extent_iter_deinit(&it);
+        return -ENOMEM;
+    }
+    while ((rc = extent_iter_next(&it, &ext)) > 0) {
+        first = (ext.offset - m->offset) / m->chunkSize;
+        last = (ext.offset + ext.length - 1 - m->offset) / m->chunkSize;
+        memset(job->hasData + first, 1, last - first + 1);
+    }
+    extent_iter_deinit(&it);
+    if (rc)
+        return rc;
+
+    job->zeroHash = blkverify_zero_hash(m->chunkSize, &rc);
+    tail = m->size - (m->nchunks - 1) * m->chunkSize;
+    if (!rc)
+        job->zeroTailHash = blkverify_zero_hash(tail, &rc);
+
+    return rc;
+}
+
+static uint64_t blkverify_zero_hash(uint64_t len, int* rc)
+{
+    unsigned char* buf = bufpool_get(len);
+    uint64_t h;
+
+    if (!buf) {
+        *rc = -ENOMEM;
+        return 0;
+    }
+    memset(buf, 0, len);
+    h = hash64(buf, len, 0);
+    bufpool_put(buf, len);
+
+    return h;
+}
+
+/* @len bytes, the request is rounded up for O_DIRECT and may end short at EOF */
+static int blkverify_read(BlkVerifyJob* job, unsigned char* buf, uint64_t offset, size_t len)
+{
+    size_t want = len;
+    ssize_t ret;
+
+    if (want % job->align)
+        want += job->align - want % job->align;
+
+    ret = pread_all(job->fd, buf, want, (off_t) offset);
+    if (ret < 0)
+        return -errno;
+    if ((size_t) ret < len)
+        return -EIO;
+    blkra_drop(&job->ra, offset, len);
+
+    return 0;
+}
+
+static void* blkverify_worker(void* arg)
+{
+    BlkVerifyJob* job = arg;
+    BlkVerifyManifest* m = job->m;
+    unsigned char* buf;
+    uint64_t idx, off;
+    size_t len;
+    int rc = 0;
+
+    buf = bufpool_get(m->chunkSize);
+    if (!buf)
+        rc = -ENOMEM;
+
+    while (!rc && !__atomic_load_n(&job->rc, __ATOMIC_RELAXED)) {
+        idx = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (idx >= m->nchunks)
+            break;
+        off = idx * m->chunkSize;
+        len = m->size - off < m->chunkSize ? (size_t) (m->size - off) : m->chunkSize;
+
+        if (job->hasData && !job->hasData[idx]) {
+            m->nodes[idx] = idx == m->nchunks - 1 ? job->zeroTailHash : job->zeroHash;
+            __atomic_fetch_add(&job->skipped, len, __ATOMIC_RELAXED);
+        } else {
+            rc = blkverify_read(job, buf, m->offset + off, len);
+            if (rc)
+                break;
+            m->nodes[idx] = hash64(buf, len, 0);
+        }
+        __atomic_fetch_add(&job->done, len, __ATOMIC_RELAXED);
+    }
+
+    if (rc) {
+        int expected = 0;
+        __atomic_compare_exchange_n(&job->rc, &expected, rc, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+    if (buf)
+        bufpool_put(buf, m->chunkSize);
+
+    pthread_mutex_lock(&job->lock);
+    job->running--;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+
+    return NULL;
+}
+
+static void blkverify_progress(BlkVerifyJob* job, double start, BlkVerifyProgress* p)
+{
+    p->done = __atomic_load_n(&job->done, __ATOMIC_RELAXED);
+    p->skipped = __atomic_load_n(&job->skipped, __ATOMIC_RELAXED);
+    p->seconds = blkverify_now() - start;
+    p->bytesPerSec = p->seconds > 0 ? p->done / p->seconds : 0;
+}
+
+static void blkverify_diff_flush(BlkVerifyDiff* d)
+{
+    uint64_t off, len;
+
+    if (!d->runLen)
+        return;
+
+    off = d->runStart * d->a->chunkSize;
+    len = d->runLen * d->a->chunkSize;
+    if (off + len > d->a->size)
+        len = d->a->size - off;
+    if (d->func)
+        d->func(off, len, d->data);
+    d->runLen = 0;
+}
+
+/* left before right, so the leaves come out in ascending order */
+static void blkverify_diff_walk(BlkVerifyDiff* d, unsigned int level, uint64_t index)
+{
+    const BlkVerifyManifest* a = d->a;
+
+    if (a->nodes[a->levelStart[level] + index] == d->b->nodes[d->b->levelStart[level] + index])
+        return;
+
+    if (level == 0) {
+        if (d->runLen && d->runStart + d->runLen == index) {
+            d->runLen++;
+        } else {
+            blkverify_diff_flush(d);
+            d->runStart = index;
+            d->runLen = 1;
+        }
+        d->count++;
+        return;
+    }
+
+    blkverify_diff_walk(d, level - 1, 2 * index);
+    if (2 * index + 1 < a->levelCount[level - 1])
+        blkverify_diff_walk(d, level - 1, 2 * index + 1);
+}
@@ -0,0 +1,111 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_BLKVERIFY_H
+#define GRACEFUL_PARTITION_BLKVERIFY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define BLKVERIFY_VERSION           1
+
+/* defaults if the caller leaves them 0 */
+#define BLKVERIFY_CHUNK_SIZE        (4 * 1024 * 1024)
+#define BLKVERIFY_INTERVAL_MS       1000
+
+#define BLKVERIFY_MAX_THREADS       256
+#define BLKVERIFY_MAX_LEVELS        64
+
+typedef struct _BlkVerify           BlkVerify;
+typedef struct _BlkVerifyManifest   BlkVerifyManifest;
+typedef struct _BlkVerifyProgress   BlkVerifyProgress;
+
+/*
+ * Chunk hashes and the hash tree above them. Level 0 are the hash64() of
+ * the chunks, a node above is the hash of its two children (or its only
+ * one) seeded with its level, the last level is the root. All levels live
+ * in @nodes, level l starting at @levelStart[l].
+ */
+struct _BlkVerifyManifest
+{
+    uint64_t                        offset;             /* of the range on the device, bytes */
+    uint64_t                        size;
+    unsigned int                    chunkSize;
+    uint64_t                        nchunks;
+
+    uint64_t*                       nodes;
+    unsigned int                    nlevels;
+    uint64_t                        levelStart[BLKVERIFY_MAX_LEVELS];
+    uint64_t                        levelCount[BLKVERIFY_MAX_LEVELS];
+};
+
+struct _BlkVerifyProgress
+{
+    uint64_t                        done;               /* bytes */
+    uint64_t                        total;
+    uint64_t                        skipped;            /* holes of an image, hashed without reading */
+    double                          seconds;
+    double                          bytesPerSec;
+    unsigned int                    nthreads;
+    int                             direct;             /* O_DIRECT was used */
+};
+
+typedef void (*BlkVerifyProgressFunc) (const BlkVerifyProgress* p, void* data);
+
+/* a run of differing chunks, in bytes relative to the manifests' offset */
+typedef void (*BlkVerifyDiffFunc) (uint64_t offset, uint64_t length, void* data);
+
+struct _BlkVerify
+{
+    uint64_t                        offset;             /* bytes */
+    uint64_t                        length;             /* 0 = up to the end */
+    unsigned int                    chunkSize;
+    unsigned int                    nthreads;           /* 0 = one per online CPU */
+    int                             direct;             /* read with O_DIRECT, past the page cache */
+
+    BlkVerifyProgressFunc           func;               /* may be NULL */
+    void*                           data;
+    unsigned int                    intervalMs;
+};
+
+/* room for the tree of @size bytes in @chunkSize chunks, 0 or -errno */
+int blkverify_manifest_init(BlkVerifyManifest* m, uint64_t offset, uint64_t size, unsigned int chunkSize);
+void blkverify_manifest_deinit(BlkVerifyManifest* m);
+
+uint64_t blkverify_manifest_root(const BlkVerifyManifest* m);
+
+/*
+ * Hash @path (block device or image file) chunk by chunk on @opts->nthreads
+ * threads into @m, which is set up here and has to be released with
+ * blkverify_manifest_deinit() even on error. Chunks which lie in holes of
+ * an image are hashed as zeroes without reading them. @opts->func is
+ * called every @opts->intervalMs from the calling thread and once at the
+ * end, the final numbers are stored in @result (may be NULL). Returns 0 or
+ * -errno; -EINVAL if @opts->direct is set and the range is not aligned.
+ */
+int blkverify_run(const char* path, const BlkVerify* opts, BlkVerifyManifest* m, BlkVerifyProgress* result);
+
+/*
+ * Text manifest:
+ *
+ *   manifest version=1 hash=hash64 offset=<bytes> size=<bytes> chunk=<bytes> chunks=<n> root=<hex>
+ *   <chunk offset> <hex>
+ *   ...
+ *
+ * Returns 0 or -errno.
+ */
+int blkverify_write_manifest(const BlkVerifyManifest* m, FILE* f);
+
+/* read such a manifest into @m, -EBADMSG if it is malformed or the root does not match */
+int blkverify_read_manifest(BlkVerifyManifest* m, FILE* f);
+
+/*
+ * Walk both trees from the root and descend only where they differ, so
+ * equal halves cost one comparison. @func (may be NULL) gets the differing
+ * runs in ascending order. Returns the number of differing chunks or
+ * -EINVAL if the manifests do not cover the same size in the same chunks.
+ */
+int64_t blkverify_compare(const BlkVerifyManifest* a, const BlkVerifyManifest* b, BlkVerifyDiffFunc func, void* data);
+
+#endif //GRACEFUL_PARTITION_BLKVERIFY_H
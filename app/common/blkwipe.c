@@ -0,0 +1,341 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                 /* fallocate() */
+#endif
+
+#include "blkwipe.h"
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+
+#include "all-io.h"
+#include "blkdev.h"
+#include "blkcache.h"
+#include "bufpool.h"
+
+#ifndef FALLOC_FL_KEEP_SIZE
+# define FALLOC_FL_KEEP_SIZE        0x01
+#endif
+#ifndef FALLOC_FL_PUNCH_HOLE
+# define FALLOC_FL_PUNCH_HOLE       0x02
+#endif
+#ifndef FALLOC_FL_ZERO_RANGE
+# define FALLOC_FL_ZERO_RANGE       0x10
+#endif
+
+/* never split finer than this, the per request overhead would dominate */
+#define BLKWIPE_MIN_CHUNK           (1024 * 1024)
+
+typedef struct _BlkWipeJob          BlkWipeJob;
+
+/* shared by all workers, the counters are updated with atomics */
+struct _BlkWipeJob
+{
+    int                             fd;
+    BlkWipeOp                       op;
+    uint64_t                        end;
+    uint64_t                        chunk;
+
+    uint64_t                        next;               /* offset of the next chunk to take */
+    uint64_t                        done;
+    int                             method;             /* BlkWipeMethod, only ever degrades */
+    int                             fallocMode;
+    int                             rc;
+
+    unsigned int                    running;
+    pthread_mutex_t                 lock;
+    pthread_cond_t                  cond;
+};
+
+static double blkwipe_now(void);
+static int blkwipe_write_zeroes(BlkWipeJob* job, unsigned char** zeroes, uint64_t start, uint64_t len);
+static int blkwipe_chunk(BlkWipeJob* job, unsigned char** zeroes, uint64_t start, uint64_t len);
+static void* blkwipe_worker(void* arg);
+static void blkwipe_progress(BlkWipeJob* job, double start, uint64_t total, BlkWipeProgress* p);
+
+static double blkwipe_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int blkwipe_write_zeroes(BlkWipeJob* job, unsigned char** zeroes, uint64_t start, uint64_t len)
+{
+    if (!*zeroes) {
+        *zeroes = bufpool_get(BLKWIPE_WRITE_BUFFER);
+        if (!*zeroes)
+            return -ENOMEM;
+        memset(*zeroes, 0, BLKWIPE_WRITE_BUFFER);
+    }
+
+    while (len) {
+        size_t n = len < BLKWIPE_WRITE_BUFFER ? (size_t) len : BLKWIPE_WRITE_BUFFER;
+
+        if (pwrite_all(job->fd, *zeroes, n, (off_t) start) != 0)
+            return -errno;
+        start += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+static int blkwipe_chunk(BlkWipeJob* job, unsigned char** zeroes, uint64_t start, uint64_t len)
+{
+    int method = __atomic_load_n(&job->method, __ATOMIC_RELAXED);
+
+    if (method == BLKWIPE_METHOD_IOCTL) {
+        uint64_t range[2] = { start, len };
+        unsigned long req = job->op == BLKWIPE_ZEROOUT ? BLKZEROOUT
+                            : job->op == BLKWIPE_SECDISCARD ? BLKSECDISCARD : BLKDISCARD;
+
+        if (ioctl(job->fd, req, &range) == 0)
+            return 0;
+        /* a discard cannot be emulated, zeroes can */
+        if (job->op != BLKWIPE_ZEROOUT || (errno != EOPNOTSUPP && errno != ENOTTY))
+            return -errno;
+        __atomic_store_n(&job->method, BLKWIPE_METHOD_WRITE, __ATOMIC_RELAXED);
+        method = BLKWIPE_METHOD_WRITE;
+    }
+
+    if (method == BLKWIPE_METHOD_FALLOCATE) {
+        int mode = __atomic_load_n(&job->fallocMode, __ATOMIC_RELAXED);
+
+        while (1) {
+            if (fallocate(job->fd, mode, (off_t) start, (off_t) len) == 0)
+                return 0;
+            if (errno != EOPNOTSUPP)
+                return -errno;
+            /* writing zeroes does not give the blocks back, that is no discard */
+            if (job->op != BLKWIPE_ZEROOUT)
+                return -EOPNOTSUPP;
+            /* a punched hole reads back as zeroes, too */
+            if (!(mode & FALLOC_FL_ZERO_RANGE))
+                break;
+            mode = FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE;
+            __atomic_store_n(&job->fallocMode, mode, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&job->method, BLKWIPE_METHOD_WRITE, __ATOMIC_RELAXED);
+    }
+
+    return blkwipe_write_zeroes(job, zeroes, start, len);
+}
+
+static void* blkwipe_worker(void* arg)
+{
+    BlkWipeJob* job = (BlkWipeJob*) arg;
+    unsigned char* zeroes = NULL;
+
+    while (!__atomic_load_n(&job->rc, __ATOMIC_RELAXED)) {
+        uint64_t start = __atomic_fetch_add(&job->next, job->chunk, __ATOMIC_RELAXED);
+        uint64_t len;
+        int rc, zero = 0;
+
+        if (start >= job->end)
+            break;
+        len = job->end - start < job->chunk ? job->end - start : job->chunk;
+
+        rc = blkwipe_chunk(job, &zeroes, start, len);
+        if (rc) {
+            __atomic_compare_exchange_n(&job->rc, &zero, rc, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            break;
+        }
+        __atomic_add_fetch(&job->done, len, __ATOMIC_RELAXED);
+    }
+    bufpool_put(zeroes, BLKWIPE_WRITE_BUFFER);
+
+    pthread_mutex_lock(&job->lock);
+    job->running--;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+
+    return NULL;
+}
+
+static void blkwipe_progress(BlkWipeJob* job, double start, uint64_t total, BlkWipeProgress* p)
+{
+    p->done = __atomic_load_n(&job->done, __ATOMIC_RELAXED);
+    p->total = total;
+    p->seconds = blkwipe_now() - start;
+    p->bytesPerSec = p->seconds > 0 ? p->done / p->seconds : 0;
+    p->method = (BlkWipeMethod) __atomic_load_n(&job->method, __ATOMIC_RELAXED);
+}
+
+int blkwipe_run(int fd, const BlkWipe* opts, BlkWipeProgress* result)
+{
+    unsigned long long size = 0;
+    unsigned int i, nthreads, started = 0;
+    uint64_t total, limit, align = 1;
+    pthread_condattr_t attr;
+    pthread_t* threads;
+    BlkWipeProgress p;
+    BlkWipeJob job;
+    struct stat st;
+    double start;
+
+    if (fstat(fd, &st) != 0)
+        return -errno;
+    if (!S_ISBLK(st.st_mode) && !S_ISREG(st.st_mode))
+        return -ENOTBLK;
+    if (blkdev_get_size(fd, &size) != 0)
+        return -EIO;
+
+    memset(&job, 0, sizeof(job));
+    job.fd = fd;
+    job.op = opts->op;
+    job.next = opts->offset;
+    job.end = opts->length ? opts->offset + opts->length : size;
+    if (opts->offset > size || job.end > size || job.end < opts->offset)
+        return -EINVAL;
+    total = job.end - job.next;
+
+    nthreads = opts->nthreads ? opts->nthreads : BLKWIPE_THREADS;
+    limit = opts->chunkSize;
+
+    if (S_ISBLK(st.st_mode)) {
+        BlkdevTopology tp;
+        int rc = blkdev_get_topology(fd, &tp);
+
+        if (rc)
+            return rc;
+        align = tp.logicalSectorSize;
+        if (job.next % align || job.end % align)
+            return -EINVAL;
+
+        job.method = BLKWIPE_METHOD_IOCTL;
+        if (opts->op == BLKWIPE_ZEROOUT) {
+            /* without write zeroes support the kernel writes zero pages itself */
+            if (!limit)
+                limit = tp.writeZeroesMaxBytes ? tp.writeZeroesMaxBytes : BLKWIPE_CHUNK_SIZE;
+        } else {
+            if (!tp.discardMaxBytes)
+                return -EOPNOTSUPP;
+            if (!limit)
+                limit = tp.discardMaxBytes;
+            /* keep chunk borders on discard granularity */
+            if (tp.discardGranularity > align && tp.discardGranularity % align == 0)
+                align = tp.discardGranularity;
+        }
+    } else {
+        /* a punched hole may leave the old data on the medium, nothing secure about it */
+        if (opts->op == BLKWIPE_SECDISCARD)
+            return -EOPNOTSUPP;
+        job.method = BLKWIPE_METHOD_FALLOCATE;
+        job.fallocMode = opts->op == BLKWIPE_ZEROOUT ? FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE
+                                                      : FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE;
+        if (!limit)
+            limit = BLKWIPE_CHUNK_SIZE;
+    }
+
+    /* several chunks per worker, so a slow chunk does not leave the others idle */
+    job.chunk = (total + (uint64_t) nthreads * 4 - 1) / ((uint64_t) nthreads * 4);
+    if (job.chunk < BLKWIPE_MIN_CHUNK)
+        job.chunk = BLKWIPE_MIN_CHUNK;
+    if (job.chunk > limit)
+        job.chunk = limit;
+    job.chunk -= job.chunk % align;
+    if (!job.chunk)
+        job.chunk = align;
+
+    if (!total)
+        goto report;
+
+    threads = calloc(nthreads, sizeof(pthread_t));
+    if (!threads)
+        return -ENOMEM;
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&job.cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    start = blkwipe_now();
+    job.running = nthreads;
+    for (i = 0; i < nthreads; i++) {
+        int err = pthread_create(&threads[i], NULL, blkwipe_worker, &job);
+        if (err) {
+            /* the started workers take over the remaining chunks */
+            pthread_mutex_lock(&job.lock);
+            job.running -= nthreads - i;
+            pthread_mutex_unlock(&job.lock);
+            if (!i)
+                job.rc = -err;
+            break;
+        }
+        started++;
+    }
+
+    pthread_mutex_lock(&job.lock);
+    while (job.running > 0) {
+        struct timespec ts;
+        unsigned int ms = opts->intervalMs ? opts->intervalMs : BLKWIPE_INTERVAL_MS;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += ms / 1000;
+        ts.tv_nsec += (long) (ms % 1000) * 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+
+        if (pthread_cond_timedwait(&job.cond, &job.lock, &ts) == ETIMEDOUT && opts->func) {
+            pthread_mutex_unlock(&job.lock);
+            blkwipe_progress(&job, start, total, &p);
+            opts->func(&p, opts->data);
+            pthread_mutex_lock(&job.lock);
+        }
+    }
+    pthread_mutex_unlock(&job.lock);
+
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    blkcache_invalidate(fd, opts->offset, total);
+    free(threads);
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+
+    /* zeroes written through the page cache are only done once they are on disk */
+    if (!job.rc && job.method == BLKWIPE_METHOD_WRITE && fdatasync(fd) != 0)
+        job.rc = -errno;
+
+    blkwipe_progress(&job, start, total, &p);
+    goto done;
+
+report:
+    memset(&p, 0, sizeof(p));
+    p.method = (BlkWipeMethod) job.method;
+done:
+    if (opts->func)
+        opts->func(&p, opts->data);
+    if (result)
+        *result = p;
+
+    return job.rc;
+}
+
+const char* blkwipe_method_to_name(BlkWipeMethod method)
+{
+    switch (method) {
+        case BLKWIPE_METHOD_IOCTL:
+            return "ioctl";
+        case BLKWIPE_METHOD_FALLOCATE:
+            return "fallocate";
+        case BLKWIPE_METHOD_WRITE:
+            return "write";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,78 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_BLKWIPE_H
+#define GRACEFUL_PARTITION_BLKWIPE_H
+
+#include <stdint.h>
+
+/* defaults if the caller leaves them 0 */
+#define BLKWIPE_THREADS             4
+#define BLKWIPE_CHUNK_SIZE          (64ULL * 1024 * 1024)
+#define BLKWIPE_INTERVAL_MS         1000
+
+/* zeroes written at once by the write fallback */
+#define BLKWIPE_WRITE_BUFFER        (8 * 1024 * 1024)
+
+typedef struct _BlkWipe             BlkWipe;
+typedef struct _BlkWipeProgress     BlkWipeProgress;
+
+typedef enum
+{
+    BLKWIPE_DISCARD = 0,
+    BLKWIPE_ZEROOUT,
+    BLKWIPE_SECDISCARD,
+} BlkWipeOp;
+
+/* how the range was wiped in the end */
+typedef enum
+{
+    BLKWIPE_METHOD_IOCTL = 0,                           /* BLKDISCARD, BLKZEROOUT or BLKSECDISCARD */
+    BLKWIPE_METHOD_FALLOCATE,                           /* punch hole or zero range */
+    BLKWIPE_METHOD_WRITE,                               /* plain zeroes */
+} BlkWipeMethod;
+
+struct _BlkWipeProgress
+{
+    uint64_t                        done;               /* bytes */
+    uint64_t                        total;
+    double                          seconds;
+    double                          bytesPerSec;
+    BlkWipeMethod                   method;
+};
+
+typedef void (*BlkWipeProgressFunc) (const BlkWipeProgress* p, void* data);
+
+struct _BlkWipe
+{
+    BlkWipeOp                       op;
+    uint64_t                        offset;             /* bytes, sector aligned for devices */
+    uint64_t                        length;             /* 0 = up to the end */
+
+    unsigned int                    nthreads;
+    uint64_t                        chunkSize;          /* 0 = discard_max_bytes or write_zeroes_max_bytes */
+
+    BlkWipeProgressFunc             func;               /* may be NULL */
+    void*                           data;
+    unsigned int                    intervalMs;
+};
+
+/*
+ * Discard, zero or securely discard a range of @fd. The range is cut into
+ * chunks of the device's per-request limit and the chunks are issued by
+ * @opts->nthreads workers at once. Regular files (e.g. from
+ * open_blkdev_or_file()) are punched or zero-ranged with fallocate(). Only
+ * BLKWIPE_ZEROOUT falls back to writing zeroes if neither the ioctl nor
+ * fallocate() is supported, the discards fail with -EOPNOTSUPP then;
+ * BLKWIPE_SECDISCARD always does for regular files.
+ *
+ * @opts->func is called every @opts->intervalMs from the calling thread
+ * and once at the end. The final numbers are stored in @result (may be
+ * NULL). Returns 0 or the first -errno of any worker.
+ */
+int blkwipe_run(int fd, const BlkWipe* opts, BlkWipeProgress* result);
+
+const char* blkwipe_method_to_name(BlkWipeMethod method);
+
+#endif //GRACEFUL_PARTITION_BLKWIPE_H
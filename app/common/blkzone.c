@@ -0,0 +1,572 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "blkzone.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "blkdev.h"
+#include "all-io.h"
+
+#ifdef HAVE_LINUX_BLKZONED_H
+
+/* capacity reporting came with 5.9 (commit 82394db7) */
+#ifndef BLK_ZONE_REP_CAPACITY
+# define BLK_ZONE_REP_CAPACITY      (1 << 0)
+#endif
+
+static int blkzone_report(BlkZoneIter* it);
+static uint64_t blkzone_writer_index(const BlkZoneWriter* w, uint64_t sector);
+static int blkzone_is_sequential(const BlkZoneState* z);
+static uint64_t blkzone_writer_limit(const BlkZoneState* z);
+static int blkzone_writer_check(const BlkZoneWriter* w, uint64_t i, uint64_t pos);
+static int blkzone_writer_write_buffer(BlkZoneWriter* w);
+static int blkzone_writer_manage(BlkZoneWriter* w, unsigned long op, uint64_t sector, uint64_t nsectors);
+
+static int blkzone_report(BlkZoneIter* it)
+{
+    struct blk_zone_report* rep = it->rep;
+
+    memset(rep, 0, sizeof(*rep));
+    rep->sector = it->sector;
+    rep->nr_zones = it->batch;
+
+    if (ioctl(it->fd, BLKREPORTZONE, rep) != 0)
+        return errno == ENOTTY ? -ENOTSUP : -errno;
+
+    it->idx = 0;
+    it->hasCapacity = (rep->flags & BLK_ZONE_REP_CAPACITY) != 0;
+
+    if (rep->nr_zones) {
+        const struct blk_zone* last = &rep->zones[rep->nr_zones - 1];
+        it->sector = last->start + last->len;
+    } else
+        it->sector = it->end;
+
+    return 0;
+}
+
+int blkzone_iter_init(BlkZoneIter* it, int fd, uint64_t sector, uint32_t batch)
+{
+    unsigned long long sectors = 0;
+
+    memset(it, 0, sizeof(*it));
+
+    if (blkdev_get_sectors(fd, &sectors) != 0)
+        return -EIO;
+
+    it->fd = fd;
+    it->sector = sector;
+    it->end = sectors;
+    it->batch = batch ? batch : BLKZONE_REPORT_BATCH;
+
+    it->rep = malloc(sizeof(struct blk_zone_report) + (size_t) it->batch * sizeof(struct blk_zone));
+    if (!it->rep)
+        return -ENOMEM;
+
+    /* nothing reported yet, the first next() refills */
+    it->rep->nr_zones = 0;
+
+    return 0;
+}
+
+void blkzone_iter_deinit(BlkZoneIter* it)
+{
+    free(it->rep);
+    it->rep = NULL;
+}
+
+int blkzone_iter_next(BlkZoneIter* it, const struct blk_zone** zone)
+{
+    if (it->idx >= it->rep->nr_zones) {
+        int rc;
+
+        if (it->sector >= it->end)
+            return 0;
+        rc = blkzone_report(it);
+        if (rc)
+            return rc;
+        if (!it->rep->nr_zones)
+            return 0;
+    }
+
+    *zone = &it->rep->zones[it->idx++];
+
+    return 1;
+}
+
+uint64_t blkzone_get_capacity(const BlkZoneIter* it, const struct blk_zone* zone)
+{
+    return it->hasCapacity ? zone->capacity : zone->len;
+}
+
+int blkzone_get_stats(int fd, BlkZoneStats* st)
+{
+    const struct blk_zone* z;
+    BlkZoneIter it;
+    int rc;
+
+    memset(st, 0, sizeof(*st));
+
+    rc = blkzone_iter_init(&it, fd, 0, 0);
+    if (rc)
+        return rc;
+
+    while ((rc = blkzone_iter_next(&it, &z)) == 1) {
+        uint64_t cap = blkzone_get_capacity(&it, z);
+
+        if (!st->nzones)
+            st->zoneSectors = z->len;
+        st->nzones++;
+
+        switch (z->type) {
+            case BLK_ZONE_TYPE_CONVENTIONAL:
+                st->nconventional++;
+                continue;
+            case BLK_ZONE_TYPE_SEQWRITE_REQ:
+                st->nseqRequired++;
+                break;
+            case BLK_ZONE_TYPE_SEQWRITE_PREF:
+                st->nseqPreferred++;
+                break;
+            default:
+                break;
+        }
+        st->capacitySectors += cap;
+
+        switch (z->cond) {
+            case BLK_ZONE_COND_EMPTY:
+                st->nempty++;
+                break;
+            case BLK_ZONE_COND_IMP_OPEN:
+                st->nimpOpen++;
+                break;
+            case BLK_ZONE_COND_EXP_OPEN:
+                st->nexpOpen++;
+                break;
+            case BLK_ZONE_COND_CLOSED:
+                st->nclosed++;
+                break;
+            case BLK_ZONE_COND_FULL:
+                st->nfull++;
+                st->writtenSectors += cap;
+                continue;
+            case BLK_ZONE_COND_READONLY:
+                st->nreadOnly++;
+                continue;
+            case BLK_ZONE_COND_OFFLINE:
+                st->noffline++;
+                continue;
+            default:
+                continue;
+        }
+
+        /* open and closed zones are partially written */
+        if (z->wp > z->start && cap) {
+            uint64_t used = z->wp - z->start;
+            unsigned int b = (unsigned int) (used * BLKZONE_WP_BUCKETS / cap);
+
+            st->writtenSectors += used;
+            st->wpHistogram[b < BLKZONE_WP_BUCKETS ? b : BLKZONE_WP_BUCKETS - 1]++;
+        }
+    }
+    blkzone_iter_deinit(&it);
+
+    return rc < 0 ? rc : 0;
+}
+
+/*
+ * The zone @sector lies in, the last one for sectors behind the end. The
+ * zones are looked up in the report, sizes need not be equal: the last
+ * zone is often smaller and nothing forbids mixed layouts.
+ */
+static uint64_t blkzone_writer_index(const BlkZoneWriter* w, uint64_t sector)
+{
+    uint64_t lo = 0, hi = w->nzones;
+
+    while (hi - lo > 1) {
+        uint64_t mid = lo + (hi - lo) / 2;
+
+        if (w->zones[mid].start <= sector)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+static int blkzone_is_sequential(const BlkZoneState* z)
+{
+    return z->type != BLK_ZONE_TYPE_CONVENTIONAL;
+}
+
+/* last sector + 1 which may be written in @z */
+static uint64_t blkzone_writer_limit(const BlkZoneState* z)
+{
+    return z->start + (blkzone_is_sequential(z) ? z->capacity : z->len);
+}
+
+/* can the stream continue at @pos of zone @i? */
+static int blkzone_writer_check(const BlkZoneWriter* w, uint64_t i, uint64_t pos)
+{
+    const BlkZoneState* z = &w->zones[i];
+
+    if (pos >= blkzone_writer_limit(z))
+        return -EINVAL;
+    if (!blkzone_is_sequential(z))
+        return 0;
+    if (z->cond == BLK_ZONE_COND_READONLY || z->cond == BLK_ZONE_COND_OFFLINE)
+        return -EROFS;
+
+    return z->wp == pos ? 0 : (pos == z->start ? -EBUSY : -EINVAL);
+}
+
+static int blkzone_writer_write_buffer(BlkZoneWriter* w)
+{
+    BlkZoneState* z = &w->zones[w->zone];
+
+    if (!w->bufLen)
+        return 0;
+
+    if (lseek(w->fd, (off_t) (w->pos << 9), SEEK_SET) == (off_t) -1)
+        return -errno;
+    if (write_all(w->fd, w->buf, w->bufLen) != 0)
+        return errno ? -errno : -EIO;
+
+    w->pos += w->bufLen >> 9;
+    w->nbytes += w->bufLen;
+    w->nwrites++;
+    w->bufLen = 0;
+
+    if (blkzone_is_sequential(z)) {
+        z->wp = w->pos;
+        z->cond = w->pos == blkzone_writer_limit(z) ? BLK_ZONE_COND_FULL : BLK_ZONE_COND_IMP_OPEN;
+    }
+
+    return 0;
+}
+
+int blkzone_writer_init(BlkZoneWriter* w, int fd, uint64_t sector)
+{
+    const struct blk_zone* z;
+    BlkdevTopology tp;
+    BlkZoneIter it;
+    size_t max = 0;
+    int rc;
+
+    memset(w, 0, sizeof(*w));
+    w->fd = fd;
+
+    rc = blkdev_get_topology(fd, &tp);
+    if (rc)
+        return rc;
+    w->blockSize = tp.logicalSectorSize;
+
+    rc = blkzone_iter_init(&it, fd, 0, 0);
+    if (rc)
+        return rc;
+
+    while ((rc = blkzone_iter_next(&it, &z)) == 1) {
+        BlkZoneState* s;
+
+        if (w->nzones == max) {
+            BlkZoneState* tmp = realloc(w->zones, sizeof(BlkZoneState) * (max ? max * 2 : 1024));
+            if (!tmp) {
+                rc = -ENOMEM;
+                break;
+            }
+            w->zones = tmp;
+            max = max ? max * 2 : 1024;
+        }
+        s = &w->zones[w->nzones++];
+        s->start = z->start;
+        s->len = z->len;
+        s->capacity = blkzone_get_capacity(&it, z);
+        s->wp = z->wp;
+        s->type = z->type;
+        s->cond = z->cond;
+    }
+    blkzone_iter_deinit(&it);
+    if (rc < 0)
+        goto fail;
+    if (!w->nzones) {
+        rc = -ENOTSUP;
+        goto fail;
+    }
+    w->zoneSectors = w->zones[0].len;
+
+    /* one write must fit into what the device takes at once */
+    w->bufSize = tp.zoneAppendMaxBytes ? tp.zoneAppendMaxBytes : tp.maxIoBytes;
+    if (!w->bufSize || w->bufSize > BLKZONE_WRITE_MAX)
+        w->bufSize = BLKZONE_WRITE_MAX;
+    w->bufSize -= w->bufSize % w->blockSize;
+    if (!w->bufSize)
+        w->bufSize = w->blockSize;
+    if (posix_memalign((void**) &w->buf, getpagesize(), w->bufSize)) {
+        rc = -ENOMEM;
+        goto fail;
+    }
+
+    w->zone = blkzone_writer_index(w, sector);
+    w->pos = sector;
+    rc = blkzone_writer_check(w, w->zone, sector);
+    if (rc)
+        goto fail;
+
+    return 0;
+fail:
+    blkzone_writer_deinit(w);
+    return rc;
+}
+
+void blkzone_writer_deinit(BlkZoneWriter* w)
+{
+    free(w->zones);
+    free(w->buf);
+    w->zones = NULL;
+    w->buf = NULL;
+    w->nzones = 0;
+}
+
+int blkzone_writer_write(BlkZoneWriter* w, const void* data, size_t len)
+{
+    const unsigned char* p = (const unsigned char*) data;
+    int rc;
+
+    while (len) {
+        BlkZoneState* z = &w->zones[w->zone];
+        uint64_t room;
+        size_t n;
+
+        if (w->pos >= blkzone_writer_limit(z))
+            return -ENOSPC;
+        /* entering a zone, it has to take the data where the stream is */
+        if (!w->bufLen) {
+            rc = blkzone_writer_check(w, w->zone, w->pos);
+            if (rc)
+                return rc;
+        }
+
+        room = ((blkzone_writer_limit(z) - w->pos) << 9) - w->bufLen;
+        n = w->bufSize - w->bufLen;
+        if (n > room)
+            n = (size_t) room;
+        if (n > len)
+            n = len;
+
+        memcpy(w->buf + w->bufLen, p, n);
+        w->bufLen += n;
+        p += n;
+        len -= n;
+
+        if (w->bufLen < w->bufSize && n < room)
+            continue;
+
+        rc = blkzone_writer_write_buffer(w);
+        if (rc)
+            return rc;
+
+        /* split at the zone end, continue at the start of the next one */
+        if (w->pos == blkzone_writer_limit(z) && w->zone + 1 < w->nzones) {
+            w->zone++;
+            w->pos = w->zones[w->zone].start;
+        }
+    }
+
+    return 0;
+}
+
+int blkzone_writer_flush(BlkZoneWriter* w)
+{
+    size_t pad = w->bufLen % w->blockSize;
+
+    if (pad) {
+        pad = w->blockSize - pad;
+        memset(w->buf + w->bufLen, 0, pad);
+        w->bufLen += pad;
+    }
+
+    return blkzone_writer_write_buffer(w);
+}
+
+/* one ioctl for each run of neighbouring zones which need @op */
+static int blkzone_writer_manage(BlkZoneWriter* w, unsigned long op, uint64_t sector, uint64_t nsectors)
+{
+    uint64_t i, first, last, end, run = UINT64_MAX;
+
+    if (!nsectors)
+        return 0;
+    end = sector + nsectors;
+    if (end < sector)
+        return -EINVAL;
+    first = blkzone_writer_index(w, sector);
+    last = blkzone_writer_index(w, end - 1);
+    /* whole zones only, a partial one would lose data outside the range */
+    if (w->zones[first].start != sector || w->zones[last].start + w->zones[last].len != end)
+        return -EINVAL;
+
+    for (i = first; i <= last + 1; i++) {
+        int need = 0;
+
+        if (i <= last) {
+            const BlkZoneState* z = &w->zones[i];
+
+            if (blkzone_is_sequential(z)
+                && z->cond != BLK_ZONE_COND_READONLY && z->cond != BLK_ZONE_COND_OFFLINE)
+                need = op == BLKRESETZONE ? z->cond != BLK_ZONE_COND_EMPTY : z->cond != BLK_ZONE_COND_FULL;
+        }
+
+        if (need && run == UINT64_MAX)
+            run = i;
+        else if (!need && run != UINT64_MAX) {
+            struct blk_zone_range range;
+            uint64_t j;
+
+            range.sector = w->zones[run].start;
+            range.nr_sectors = w->zones[i - 1].start + w->zones[i - 1].len - range.sector;
+            if (ioctl(w->fd, op, &range) != 0)
+                return -errno;
+
+            for (j = run; j < i; j++) {
+                BlkZoneState* z = &w->zones[j];
+
+                z->wp = op == BLKRESETZONE ? z->start : z->start + z->len;
+                z->cond = op == BLKRESETZONE ? BLK_ZONE_COND_EMPTY : BLK_ZONE_COND_FULL;
+            }
+            run = UINT64_MAX;
+        }
+    }
+
+    return 0;
+}
+
+int blkzone_writer_reset(BlkZoneWriter* w, uint64_t sector, uint64_t nsectors)
+{
+    return blkzone_writer_manage(w, BLKRESETZONE, sector, nsectors);
+}
+
+int blkzone_writer_finish(BlkZoneWriter* w, uint64_t sector, uint64_t nsectors)
+{
+    return blkzone_writer_manage(w, BLKFINISHZONE, sector, nsectors);
+}
+
+const char* blkzone_type_to_name(int type)
+{
+    switch (type) {
+        case BLK_ZONE_TYPE_CONVENTIONAL:
+            return "conventional";
+        case BLK_ZONE_TYPE_SEQWRITE_REQ:
+            return "seq-write-required";
+        case BLK_ZONE_TYPE_SEQWRITE_PREF:
+            return "seq-write-preferred";
+        default:
+            return "unknown";
+    }
+}
+
+const char* blkzone_cond_to_name(int cond)
+{
+    switch (cond) {
+        case BLK_ZONE_COND_NOT_WP:
+            return "not-wp";
+        case BLK_ZONE_COND_EMPTY:
+            return "empty";
+        case BLK_ZONE_COND_IMP_OPEN:
+            return "implicit-open";
+        case BLK_ZONE_COND_EXP_OPEN:
+            return "explicit-open";
+        case BLK_ZONE_COND_CLOSED:
+            return "closed";
+        case BLK_ZONE_COND_READONLY:
+            return "read-only";
+        case BLK_ZONE_COND_FULL:
+            return "full";
+        case BLK_ZONE_COND_OFFLINE:
+            return "offline";
+        default:
+            return "unknown";
+    }
+}
+
+#else /* !HAVE_LINUX_BLKZONED_H */
+
+int blkzone_iter_init(BlkZoneIter* it, int fd __attribute__((__unused__)),
+                      uint64_t sector __attribute__((__unused__)), uint32_t batch __attribute__((__unused__)))
+{
+    memset(it, 0, sizeof(*it));
+    return -ENOTSUP;
+}
+
+void blkzone_iter_deinit(BlkZoneIter* it __attribute__((__unused__)))
+{
+}
+
+int blkzone_iter_next(BlkZoneIter* it __attribute__((__unused__)),
+                      const struct blk_zone** zone __attribute__((__unused__)))
+{
+    return -ENOTSUP;
+}
+
+uint64_t blkzone_get_capacity(const BlkZoneIter* it __attribute__((__unused__)),
+                              const struct blk_zone* zone __attribute__((__unused__)))
+{
+    return 0;
+}
+
+int blkzone_get_stats(int fd __attribute__((__unused__)), BlkZoneStats* st)
+{
+    memset(st, 0, sizeof(*st));
+    return -ENOTSUP;
+}
+
+int blkzone_writer_init(BlkZoneWriter* w, int fd __attribute__((__unused__)),
+                        uint64_t sector __attribute__((__unused__)))
+{
+    memset(w, 0, sizeof(*w));
+    return -ENOTSUP;
+}
+
+void blkzone_writer_deinit(BlkZoneWriter* w __attribute__((__unused__)))
+{
+}
+
+int blkzone_writer_write(BlkZoneWriter* w __attribute__((__unused__)),
+                         const void* data __attribute__((__unused__)), size_t len __attribute__((__unused__)))
+{
+    return -ENOTSUP;
+}
+
+int blkzone_writer_flush(BlkZoneWriter* w __attribute__((__unused__)))
+{
+    return -ENOTSUP;
+}
+
+int blkzone_writer_reset(BlkZoneWriter* w __attribute__((__unused__)),
+                         uint64_t sector __attribute__((__unused__)), uint64_t nsectors __attribute__((__unused__)))
+{
+    return -ENOTSUP;
+}
+
+int blkzone_writer_finish(BlkZoneWriter* w __attribute__((__unused__)),
+                          uint64_t sector __attribute__((__unused__)), uint64_t nsectors __attribute__((__unused__)))
+{
+    return -ENOTSUP;
+}
+
+const char* blkzone_type_to_name(int type __attribute__((__unused__)))
+{
+    return "unknown";
+}
+
+const char* blkzone_cond_to_name(int cond __attribute__((__unused__)))
+{
+    return "unknown";
+}
+
+#endif /* HAVE_LINUX_BLKZONED_H */
@@ -0,0 +1,157 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_BLKZONE_H
+#define GRACEFUL_PARTITION_BLKZONE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef HAVE_LINUX_BLKZONED_H
+# include <linux/blkzoned.h>
+#endif
+
+struct blk_zone;
+struct blk_zone_report;
+
+/* zones asked from the kernel per BLKREPORTZONE call */
+#define BLKZONE_REPORT_BATCH        4096
+
+/* number of buckets of the write pointer histogram, 10% each */
+#define BLKZONE_WP_BUCKETS          10
+
+/* upper bound of one write of the zone writer */
+#define BLKZONE_WRITE_MAX           (4 * 1024 * 1024)
+
+typedef struct _BlkZoneIter         BlkZoneIter;
+typedef struct _BlkZoneState        BlkZoneState;
+typedef struct _BlkZoneStats        BlkZoneStats;
+typedef struct _BlkZoneWriter       BlkZoneWriter;
+
+/*
+ * Streams the zones of a device. One report buffer of @batch zones is
+ * allocated at init and refilled by BLKREPORTZONE whenever it runs dry.
+ */
+struct _BlkZoneIter
+{
+    int                             fd;
+    uint64_t                        sector;             /* where the next report starts */
+    uint64_t                        end;                /* device size in 512-byte sectors */
+    uint32_t                        batch;
+
+    struct blk_zone_report*         rep;
+    uint32_t                        idx;                /* next zone in rep */
+    int                             hasCapacity;        /* rep reports zone capacities */
+};
+
+/* all numbers in zones unless noted */
+struct _BlkZoneStats
+{
+    uint64_t                        nzones;
+    uint64_t                        nconventional;
+    uint64_t                        nseqRequired;
+    uint64_t                        nseqPreferred;
+
+    uint64_t                        nempty;
+    uint64_t                        nimpOpen;
+    uint64_t                        nexpOpen;
+    uint64_t                        nclosed;
+    uint64_t                        nfull;
+    uint64_t                        nreadOnly;
+    uint64_t                        noffline;
+
+    uint64_t                        zoneSectors;        /* length of the first zone */
+    uint64_t                        capacitySectors;    /* writable sectors of sequential zones */
+    uint64_t                        writtenSectors;     /* below the write pointers */
+
+    /* partially written zones by fill level, bucket i is i*10% to (i+1)*10% */
+    uint64_t                        wpHistogram[BLKZONE_WP_BUCKETS];
+};
+
+/* what the writer keeps of a zone, in 512-byte sectors */
+struct _BlkZoneState
+{
+    uint64_t                        start;
+    uint64_t                        len;
+    uint64_t                        capacity;
+    uint64_t                        wp;
+    unsigned char                   type;
+    unsigned char                   cond;
+};
+
+/*
+ * Sequential writer for zoned devices. Data is collected into one aligned
+ * buffer and written with write_all() exactly at the write pointer of the
+ * current zone, never across its end or capacity. A zone whose capacity is
+ * smaller than its size leaves a gap, the stream continues at the start of
+ * the next zone.
+ */
+struct _BlkZoneWriter
+{
+    int                             fd;
+    unsigned int                    blockSize;          /* logical block size in bytes */
+
+    BlkZoneState*                   zones;
+    uint64_t                        nzones;
+    uint64_t                        zoneSectors;        /* of the first zone, informational */
+
+    uint64_t                        zone;               /* index of the zone written to */
+    uint64_t                        pos;                /* next sector on the device */
+
+    unsigned char*                  buf;
+    size_t                          bufSize;            /* max append size, at most BLKZONE_WRITE_MAX */
+    size_t                          bufLen;
+
+    uint64_t                        nbytes;             /* written so far, padding included */
+    uint64_t                        nwrites;
+};
+
+/*
+ * Start iterating at @sector (512-byte units) with @batch zones per report,
+ * 0 for BLKZONE_REPORT_BATCH. Returns 0, -ENOTSUP if the device or the
+ * build has no zone support, or -errno.
+ */
+int blkzone_iter_init(BlkZoneIter* it, int fd, uint64_t sector, uint32_t batch);
+void blkzone_iter_deinit(BlkZoneIter* it);
+
+/*
+ * Store the next zone into *zone, valid until the following call. Returns
+ * 1, 0 at the end of the device or -errno.
+ */
+int blkzone_iter_next(BlkZoneIter* it, const struct blk_zone** zone);
+
+/* writable length of @zone, its capacity if the kernel reports one */
+uint64_t blkzone_get_capacity(const BlkZoneIter* it, const struct blk_zone* zone);
+
+/* walk all zones of @fd once and count them, 0 or -errno */
+int blkzone_get_stats(int fd, BlkZoneStats* st);
+
+/*
+ * Load the zones of @fd and start writing at @sector, which has to be the
+ * write pointer of a sequential zone or anywhere in a conventional one.
+ * Returns 0, -ENOTSUP for devices without zones, -EINVAL if @sector is
+ * not writable or -errno. fd opened with O_DIRECT is fine.
+ */
+int blkzone_writer_init(BlkZoneWriter* w, int fd, uint64_t sector);
+void blkzone_writer_deinit(BlkZoneWriter* w);
+
+/* append @len bytes, -ENOSPC at the end of the device, -EBUSY if the next zone is not empty */
+int blkzone_writer_write(BlkZoneWriter* w, const void* data, size_t len);
+
+/* write what is buffered, a partial block is padded with zeros */
+int blkzone_writer_flush(BlkZoneWriter* w);
+
+/*
+ * Reset or finish the sequential zones in @nsectors at @sector. Both ends
+ * of the range have to be zone boundaries (or the end of the device),
+ * -EINVAL otherwise. Neighbouring zones which need it are handled by a
+ * single ioctl, zones already in the wanted state are skipped.
+ */
+int blkzone_writer_reset(BlkZoneWriter* w, uint64_t sector, uint64_t nsectors);
+int blkzone_writer_finish(BlkZoneWriter* w, uint64_t sector, uint64_t nsectors);
+
+const char* blkzone_type_to_name(int type);
+const char* blkzone_cond_to_name(int cond);
+
+#endif //GRACEFUL_PARTITION_BLKZONE_H
@@ -0,0 +1,155 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "buffer-zero.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define BUFFER_ZERO_X86
+#endif
+
+typedef int (*BufferZeroFunc) (const unsigned char* p, size_t len);
+
+static pthread_once_t gBufferZeroOnce = PTHREAD_ONCE_INIT;
+static BufferZeroFunc gBufferZeroFunc;
+static const char* gBufferZeroName;
+
+static int buffer_is_zero_scalar(const unsigned char* p, size_t len);
+#ifdef BUFFER_ZERO_X86
+static int buffer_is_zero_sse2(const unsigned char* p, size_t len);
+static int buffer_is_zero_avx2(const unsigned char* p, size_t len);
+#endif
+static void buffer_is_zero_select(void);
+
+int buffer_is_zero(const void* buf, size_t len)
+{
+    const unsigned char* p = buf;
+    uint64_t head;
+
+    if (len < sizeof(head) * 4)
+        return buffer_is_zero_scalar(p, len);
+
+    /* cheap early exit for the common case of real data */
+    memcpy(&head, p, sizeof(head));
+    if (head)
+        return 0;
+
+    pthread_once(&gBufferZeroOnce, buffer_is_zero_select);
+    return gBufferZeroFunc(p, len);
+}
+
+const char* buffer_is_zero_impl(void)
+{
+    pthread_once(&gBufferZeroOnce, buffer_is_zero_select);
+    return gBufferZeroName;
+}
+
+int buffer_is_zero_set_impl(const char* name)
+{
+    pthread_once(&gBufferZeroOnce, buffer_is_zero_select);
+
+    if (strcmp(name, "scalar") == 0) {
+        gBufferZeroFunc = buffer_is_zero_scalar;
+        gBufferZeroName = "scalar";
+        return 0;
+    }
+#ifdef BUFFER_ZERO_X86
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        gBufferZeroFunc = buffer_is_zero_avx2;
+        gBufferZeroName = "avx2";
+        return 0;
+    }
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        gBufferZeroFunc = buffer_is_zero_sse2;
+        gBufferZeroName = "sse2";
+        return 0;
+    }
+#endif
+
+    return -ENOTSUP;
+}
+
+static int buffer_is_zero_scalar(const unsigned char* p, size_t len)
+{
+    uint64_t a, b, c, d;
+
+    while (len && ((uintptr_t) p & (sizeof(a) - 1))) {
+        if (*p)
+            return 0;
+        p++;
+        len--;
+    }
+
+    for (; len >= sizeof(a) * 4; p += sizeof(a) * 4, len -= sizeof(a) * 4) {
+        memcpy(&a, p, sizeof(a));
+        memcpy(&b, p + 8, sizeof(b));
+        memcpy(&c, p + 16, sizeof(c));
+        memcpy(&d, p + 24, sizeof(d));
+        if (a | b | c | d)
+            return 0;
+    }
+
+    while (len--) {
+        if (*p++)
+            return 0;
+    }
+
+    return 1;
+}
+
+#ifdef BUFFER_ZERO_X86
+__attribute__((target("sse2")))
+static int buffer_is_zero_sse2(const unsigned char* p, size_t len)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; len >= 64; p += 64, len -= 64) {
+        __m128i v = _mm_or_si128(_mm_or_si128(_mm_loadu_si128((const __m128i*) p),
+                                              _mm_loadu_si128((const __m128i*) (p + 16))),
+                                 _mm_or_si128(_mm_loadu_si128((const __m128i*) (p + 32)),
+                                              _mm_loadu_si128((const __m128i*) (p + 48))));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xffff)
+            return 0;
+    }
+
+    return buffer_is_zero_scalar(p, len);
+}
+
+__attribute__((target("avx2")))
+static int buffer_is_zero_avx2(const unsigned char* p, size_t len)
+{
+    for (; len >= 128; p += 128, len -= 128) {
+        __m256i v = _mm256_or_si256(_mm256_or_si256(_mm256_loadu_si256((const __m256i*) p),
+                                                    _mm256_loadu_si256((const __m256i*) (p + 32))),
+                                    _mm256_or_si256(_mm256_loadu_si256((const __m256i*) (p + 64)),
+                                                    _mm256_loadu_si256((const __m256i*) (p + 96))));
+        if (!_mm256_testz_si256(v, v))
+            return 0;
+    }
+
+    return buffer_is_zero_sse2(p, len);
+}
+#endif
+
+static void buffer_is_zero_select(void)
+{
+    gBufferZeroFunc = buffer_is_zero_scalar;
+    gBufferZeroName = "scalar";
+
+#ifdef BUFFER_ZERO_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        gBufferZeroFunc = buffer_is_zero_avx2;
+        gBufferZeroName = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        gBufferZeroFunc = buffer_is_zero_sse2;
+        gBufferZeroName = "sse2";
+    }
+#endif
+}
@@ -0,0 +1,27 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_BUFFER_ZERO_H
+#define GRACEFUL_PARTITION_BUFFER_ZERO_H
+
+#include <stddef.h>
+
+/*
+ * 1 if all @len bytes at @buf are zero, 0 otherwise. Uses AVX2 or SSE2 if
+ * the CPU has it and a word loop everywhere else; data blocks usually fail
+ * within the first few bytes, which are checked before any vector setup.
+ */
+int buffer_is_zero(const void* buf, size_t len);
+
+/* "avx2", "sse2" or "scalar", whatever buffer_is_zero() ended up with */
+const char* buffer_is_zero_impl(void);
+
+/*
+ * Switch to the implementation @name ("avx2", "sse2" or "scalar") to
+ * compare them, -ENOTSUP if this CPU cannot run it. Not thread safe, call
+ * it before any checking starts.
+ */
+int buffer_is_zero_set_impl(const char* name);
+
+#endif //GRACEFUL_PARTITION_BUFFER_ZERO_H
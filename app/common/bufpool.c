@@ -0,0 +1,233 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "bufpool.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+typedef struct _BufPoolCache        BufPoolCache;
+
+/* per thread, no locking */
+struct _BufPoolCache
+{
+    void*                           bufs[BUFPOOL_NCLASSES][BUFPOOL_THREAD_CACHE];
+    unsigned int                    count[BUFPOOL_NCLASSES];
+    int                             registered;         /* flushed at thread exit */
+};
+
+static __thread BufPoolCache        bufpoolCache;
+
+/* shared lists, linked through the first bytes of the free buffers */
+static pthread_mutex_t              bufpoolLock = PTHREAD_MUTEX_INITIALIZER;
+static void*                        bufpoolFree[BUFPOOL_NCLASSES];
+static unsigned int                 bufpoolFreeCount[BUFPOOL_NCLASSES];
+
+static pthread_once_t               bufpoolOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t                bufpoolKey;
+
+static BufPoolStats                 bufpoolStats;
+
+static int bufpool_class(size_t size);
+static unsigned int bufpool_thread_limit(int c);
+static unsigned int bufpool_global_limit(int c);
+static void* bufpool_alloc(size_t size);
+static void bufpool_release(int c, void* buf);
+static void bufpool_make_key(void);
+static void bufpool_thread_exit(void* arg);
+
+/* BUFPOOL_NCLASSES if @size is not pooled */
+static int bufpool_class(size_t size)
+{
+    int shift = BUFPOOL_MIN_SHIFT;
+
+    while (shift <= BUFPOOL_MAX_SHIFT && ((size_t) 1 << shift) < size)
+        shift++;
+
+    return shift - BUFPOOL_MIN_SHIFT;
+}
+
+static unsigned int bufpool_thread_limit(int c)
+{
+    return ((size_t) 1 << (c + BUFPOOL_MIN_SHIFT)) >= BUFPOOL_HUGE_SIZE
+           ? BUFPOOL_THREAD_CACHE_HUGE : BUFPOOL_THREAD_CACHE;
+}
+
+/* a 64M class keeps one buffer, not 32 of them */
+static unsigned int bufpool_global_limit(int c)
+{
+    size_t n = BUFPOOL_GLOBAL_CACHE_BYTES >> (c + BUFPOOL_MIN_SHIFT);
+
+    if (n > BUFPOOL_GLOBAL_CACHE)
+        return BUFPOOL_GLOBAL_CACHE;
+
+    return n ? (unsigned int) n : 1;
+}
+
+static void* bufpool_alloc(size_t size)
+{
+    size_t align = size < BUFPOOL_HUGE_SIZE ? size : BUFPOOL_HUGE_SIZE;
+    long page = sysconf(_SC_PAGESIZE);
+    void* buf;
+    int rc;
+
+    if (page > 0 && align < (size_t) page)
+        align = (size_t) page;
+    /* unpooled sizes are not powers of two */
+    while (align & (align - 1))
+        align &= align - 1;
+
+    rc = posix_memalign(&buf, align, size);
+    if (rc) {
+        errno = rc;
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    /* a hint only, the buffer works the same without */
+    if (size >= BUFPOOL_HUGE_SIZE)
+        madvise(buf, size - size % BUFPOOL_HUGE_SIZE, MADV_HUGEPAGE);
+#endif
+    __atomic_add_fetch(&bufpoolStats.allocs, 1, __ATOMIC_RELAXED);
+
+    return buf;
+}
+
+static void bufpool_release(int c, void* buf)
+{
+    pthread_mutex_lock(&bufpoolLock);
+    if (bufpoolFreeCount[c] < bufpool_global_limit(c)) {
+        *(void**) buf = bufpoolFree[c];
+        bufpoolFree[c] = buf;
+        bufpoolFreeCount[c]++;
+        buf = NULL;
+    }
+    pthread_mutex_unlock(&bufpoolLock);
+
+    if (buf) {
+        free(buf);
+        __atomic_add_fetch(&bufpoolStats.frees, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void bufpool_make_key(void)
+{
+    pthread_key_create(&bufpoolKey, bufpool_thread_exit);
+}
+
+/* hand the cache of an exiting thread to the shared lists */
+static void bufpool_thread_exit(void* arg)
+{
+    BufPoolCache* tc = (BufPoolCache*) arg;
+    int c;
+
+    for (c = 0; c < BUFPOOL_NCLASSES; c++) {
+        while (tc->count[c])
+            bufpool_release(c, tc->bufs[c][--tc->count[c]]);
+    }
+    tc->registered = 0;
+}
+
+void* bufpool_get(size_t size)
+{
+    BufPoolCache* tc = &bufpoolCache;
+    int c = bufpool_class(size);
+    void* buf = NULL;
+
+    if (c == BUFPOOL_NCLASSES)
+        return bufpool_alloc(size);
+
+    if (tc->count[c]) {
+        __atomic_add_fetch(&bufpoolStats.threadHits, 1, __ATOMIC_RELAXED);
+        return tc->bufs[c][--tc->count[c]];
+    }
+
+    pthread_mutex_lock(&bufpoolLock);
+    if (bufpoolFree[c]) {
+        buf = bufpoolFree[c];
+        bufpoolFree[c] = *(void**) buf;
+        bufpoolFreeCount[c]--;
+    }
+    pthread_mutex_unlock(&bufpoolLock);
+
+    if (buf) {
+        __atomic_add_fetch(&bufpoolStats.globalHits, 1, __ATOMIC_RELAXED);
+        return buf;
+    }
+
+    return bufpool_alloc((size_t) 1 << (c + BUFPOOL_MIN_SHIFT));
+}
+
+void bufpool_put(void* buf, size_t size)
+{
+    BufPoolCache* tc = &bufpoolCache;
+    int c;
+
+    if (!buf)
+        return;
+
+    c = bufpool_class(size);
+    if (c == BUFPOOL_NCLASSES) {
+        free(buf);
+        __atomic_add_fetch(&bufpoolStats.frees, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    if (tc->count[c] < bufpool_thread_limit(c)) {
+        if (!tc->registered) {
+            pthread_once(&bufpoolOnce, bufpool_make_key);
+            tc->registered = pthread_setspecific(bufpoolKey, tc) == 0;
+        }
+        /* without the destructor the cache would leak at thread exit */
+        if (tc->registered) {
+            tc->bufs[c][tc->count[c]++] = buf;
+            return;
+        }
+    }
+
+    bufpool_release(c, buf);
+}
+
+void bufpool_trim(void)
+{
+    BufPoolCache* tc = &bufpoolCache;
+    void* lists[BUFPOOL_NCLASSES];
+    uint64_t n = 0;
+    int c;
+
+    for (c = 0; c < BUFPOOL_NCLASSES; c++) {
+        while (tc->count[c]) {
+            free(tc->bufs[c][--tc->count[c]]);
+            n++;
+        }
+    }
+
+    pthread_mutex_lock(&bufpoolLock);
+    memcpy(lists, bufpoolFree, sizeof(lists));
+    memset(bufpoolFree, 0, sizeof(bufpoolFree));
+    memset(bufpoolFreeCount, 0, sizeof(bufpoolFreeCount));
+    pthread_mutex_unlock(&bufpoolLock);
+
+    for (c = 0; c < BUFPOOL_NCLASSES; c++) {
+        while (lists[c]) {
+            void* next = *(void**) lists[c];
+
+            free(lists[c]);
+            lists[c] = next;
+            n++;
+        }
+    }
+    __atomic_add_fetch(&bufpoolStats.frees, n, __ATOMIC_RELAXED);
+}
+
+void bufpool_get_stats(BufPoolStats* st)
+{
+    st->threadHits = __atomic_load_n(&bufpoolStats.threadHits, __ATOMIC_RELAXED);
+    st->globalHits = __atomic_load_n(&bufpoolStats.globalHits, __ATOMIC_RELAXED);
+    st->allocs = __atomic_load_n(&bufpoolStats.allocs, __ATOMIC_RELAXED);
+    st->frees = __atomic_load_n(&bufpoolStats.frees, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,61 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_BUFPOOL_H
+#define GRACEFUL_PARTITION_BUFPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* size classes are the powers of two from 4K to 64M, larger buffers are not pooled */
+#define BUFPOOL_MIN_SHIFT           12
+#define BUFPOOL_MAX_SHIFT           26
+#define BUFPOOL_NCLASSES            (BUFPOOL_MAX_SHIFT - BUFPOOL_MIN_SHIFT + 1)
+
+/* from this size on buffers are aligned to it and backed by transparent huge pages */
+#define BUFPOOL_HUGE_SIZE           (2 * 1024 * 1024)
+
+/* free buffers a thread keeps per class, below and from BUFPOOL_HUGE_SIZE on */
+#define BUFPOOL_THREAD_CACHE        8
+#define BUFPOOL_THREAD_CACHE_HUGE   2
+
+/*
+ * Free buffers shared by all threads per class, beyond that they are
+ * freed: at most BUFPOOL_GLOBAL_CACHE of them and at most
+ * BUFPOOL_GLOBAL_CACHE_BYTES, but always one.
+ */
+#define BUFPOOL_GLOBAL_CACHE        32
+#define BUFPOOL_GLOBAL_CACHE_BYTES  (64 * 1024 * 1024)
+
+typedef struct _BufPoolStats        BufPoolStats;
+
+struct _BufPoolStats
+{
+    uint64_t                        threadHits;         /* served from the caller's cache */
+    uint64_t                        globalHits;         /* served from the shared lists */
+    uint64_t                        allocs;             /* new buffers */
+    uint64_t                        frees;              /* buffers given back to the system */
+};
+
+/*
+ * Get a buffer of at least @size bytes, not zeroed. It is aligned to its
+ * size class, capped at BUFPOOL_HUGE_SIZE: always to the page size and so
+ * to every logical block size, which is what O_DIRECT asks for. Returns
+ * NULL with errno set.
+ */
+void* bufpool_get(size_t size);
+
+/*
+ * Give @buf back, @size has to be the one passed to bufpool_get(). The
+ * buffer goes to the calling thread's cache, which is handed to the shared
+ * lists when the thread exits. NULL is ignored.
+ */
+void bufpool_put(void* buf, size_t size);
+
+/* free the shared lists and the calling thread's cache */
+void bufpool_trim(void);
+
+void bufpool_get_stats(BufPoolStats* st);
+
+#endif //GRACEFUL_PARTITION_BUFPOOL_H
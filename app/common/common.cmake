@@ -7,4 +7,20 @@ FILE(GLOB GRACEFUL_PARTITION_COMMON
         ${CMAKE_SOURCE_DIR}/app/common/all-io.h ${CMAKE_SOURCE_DIR}/app/common/all-io.c
         ${CMAKE_SOURCE_DIR}/app/common/file-utils.h ${CMAKE_SOURCE_DIR}/app/common/file-utils.c
         ${CMAKE_SOURCE_DIR}/app/common/linux-version.h ${CMAKE_SOURCE_DIR}/app/common/linux-version.c
+        ${CMAKE_SOURCE_DIR}/app/common/nls.h
+        ${CMAKE_SOURCE_DIR}/app/common/crc32.h ${CMAKE_SOURCE_DIR}/app/common/crc32.c
+        ${CMAKE_SOURCE_DIR}/app/common/blkzone.h ${CMAKE_SOURCE_DIR}/app/common/blkzone.c
+        ${CMAKE_SOURCE_DIR}/app/common/blkwipe.h ${CMAKE_SOURCE_DIR}/app/common/blkwipe.c
+        ${CMAKE_SOURCE_DIR}/app/common/blkcache.h ${CMAKE_SOURCE_DIR}/app/common/blkcache.c
+        ${CMAKE_SOURCE_DIR}/app/common/async-io.h ${CMAKE_SOURCE_DIR}/app/common/async-io.c
+        ${CMAKE_SOURCE_DIR}/app/common/bufpool.h ${CMAKE_SOURCE_DIR}/app/common/bufpool.c
+        ${CMAKE_SOURCE_DIR}/app/common/blkbench.h ${CMAKE_SOURCE_DIR}/app/common/blkbench.c
+        ${CMAKE_SOURCE_DIR}/app/common/badblocks.h ${CMAKE_SOURCE_DIR}/app/common/badblocks.c
+        ${CMAKE_SOURCE_DIR}/app/common/buffer-zero.h ${CMAKE_SOURCE_DIR}/app/common/buffer-zero.c
+        ${CMAKE_SOURCE_DIR}/app/common/extents.h ${CMAKE_SOURCE_DIR}/app/common/extents.c
+        ${CMAKE_SOURCE_DIR}/app/common/blkclone.h ${CMAKE_SOURCE_DIR}/app/common/blkclone.c
+        ${CMAKE_SOURCE_DIR}/app/common/hash64.h ${CMAKE_SOURCE_DIR}/app/common/hash64.c
+        ${CMAKE_SOURCE_DIR}/app/common/blkverify.h ${CMAKE_SOURCE_DIR}/app/common/blkverify.c
+        ${CMAKE_SOURCE_DIR}/app/common/loopdev.h ${CMAKE_SOURCE_DIR}/app/common/loopdev.c
+        ${CMAKE_SOURCE_DIR}/app/common/blkra.h ${CMAKE_SOURCE_DIR}/app/common/blkra.c
         )
\ No newline at end of file
@@ -0,0 +1,242 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "crc32.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+# define HAVE_CRC32_PCLMUL
+# include <immintrin.h>
+#endif
+
+#define CRC32_POLY_LE               0xEDB88320U
+
+/* the carry-less multiply path folds 64 byte blocks */
+#define CRC32_PCLMUL_MIN_LEN        64
+
+static uint32_t crc32Table[8][256];
+static int crc32Accel;
+
+static inline uint32_t __crc32_load_4le(const unsigned char *p);
+static uint32_t crc32_update_table(uint32_t crc, const unsigned char *buf, size_t len);
+static uint32_t crc32_update_zeroes(uint32_t crc, size_t len);
+
+/* tables and CPU features are set up once, before any thread can run */
+__attribute__((constructor))
+static void crc32_init(void)
+{
+    uint32_t i, j, c;
+
+    for (i = 0; i < 256; i++) {
+        c = i;
+        for (j = 0; j < 8; j++)
+            c = (c & 1) ? (c >> 1) ^ CRC32_POLY_LE : (c >> 1);
+        crc32Table[0][i] = c;
+    }
+
+    for (i = 0; i < 256; i++) {
+        c = crc32Table[0][i];
+        for (j = 1; j < 8; j++) {
+            c = crc32Table[0][c & 0xff] ^ (c >> 8);
+            crc32Table[j][i] = c;
+        }
+    }
+
+#ifdef HAVE_CRC32_PCLMUL
+    __builtin_cpu_init();
+    crc32Accel = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+}
+
+static inline uint32_t __crc32_load_4le(const unsigned char *p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* slicing-by-8 */
+static uint32_t crc32_update_table(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    while (len >= 8) {
+        uint32_t one = __crc32_load_4le(buf) ^ crc;
+        uint32_t two = __crc32_load_4le(buf + 4);
+
+        crc = crc32Table[7][one & 0xff] ^
+              crc32Table[6][(one >> 8) & 0xff] ^
+              crc32Table[5][(one >> 16) & 0xff] ^
+              crc32Table[4][one >> 24] ^
+              crc32Table[3][two & 0xff] ^
+              crc32Table[2][(two >> 8) & 0xff] ^
+              crc32Table[1][(two >> 16) & 0xff] ^
+              crc32Table[0][two >> 24];
+        buf += 8;
+        len -= 8;
+    }
+
+    while (len--)
+        crc = crc32Table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
+
+static uint32_t crc32_update_zeroes(uint32_t crc, size_t len)
+{
+    static const unsigned char zeroes[64];
+
+    while (len) {
+        size_t n = len < sizeof(zeroes) ? len : sizeof(zeroes);
+
+        crc = crc32_update(crc, zeroes, n);
+        len -= n;
+    }
+    return crc;
+}
+
+#ifdef HAVE_CRC32_PCLMUL
+/*
+ * Fold 16 byte multiples of @buf (at least 64 bytes) with PCLMULQDQ and
+ * reduce the remainder with Barrett reduction, see Intel's "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction". The
+ * constants are the bit-reflected ones for 0x04C11DB7.
+ */
+__attribute__((target("sse4.1,pclmul")))
+static uint32_t crc32_update_pclmul(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    static const uint64_t __attribute__((aligned(16))) k1k2[] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+    static const uint64_t __attribute__((aligned(16))) k3k4[] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+    static const uint64_t __attribute__((aligned(16))) k5k0[] = { 0x0163cd6124ULL, 0x0000000000ULL };
+    static const uint64_t __attribute__((aligned(16))) poly[] = { 0x01db710641ULL, 0x01f7011641ULL };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i *) (buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *) (buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *) (buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *) (buf + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+    x0 = _mm_load_si128((const __m128i *) k1k2);
+
+    buf += 64;
+    len -= 64;
+
+    /* parallel fold of 64 byte blocks */
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i *) (buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *) (buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *) (buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *) (buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+        len -= 64;
+    }
+
+    /* fold into 128 bits */
+    x0 = _mm_load_si128((const __m128i *) k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* single fold of 16 byte blocks */
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *) buf);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    /* fold 128 bits to 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i *) k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_load_si128((const __m128i *) poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t) _mm_extract_epi32(x1, 1);
+}
+#endif
+
+int crc32_is_accelerated(void)
+{
+    return crc32Accel;
+}
+
+uint32_t crc32_update(uint32_t crc, const unsigned char *buf, size_t len)
+{
+#ifdef HAVE_CRC32_PCLMUL
+    if (len >= CRC32_PCLMUL_MIN_LEN && crc32_is_accelerated()) {
+        size_t bulk = len & ~(size_t) 15;
+
+        crc = crc32_update_pclmul(crc, buf, bulk);
+        buf += bulk;
+        len -= bulk;
+    }
+#endif
+    return crc32_update_table(crc, buf, len);
+}
+
+uint32_t crc32_checksum(const void *buf, size_t len)
+{
+    return ~crc32_update(~0U, (const unsigned char *) buf, len);
+}
+
+uint32_t crc32_exclude_offset(const void *buf, size_t len, size_t exOff, size_t exLen)
+{
+    const unsigned char *p = (const unsigned char *) buf;
+    uint32_t crc = ~0U;
+
+    if (exOff >= len)
+        return crc32_checksum(buf, len);
+    if (exLen > len - exOff)
+        exLen = len - exOff;
+
+    crc = crc32_update(crc, p, exOff);
+    crc = crc32_update_zeroes(crc, exLen);
+    crc = crc32_update(crc, p + exOff + exLen, len - exOff - exLen);
+
+    return ~crc;
+}
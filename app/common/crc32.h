@@ -0,0 +1,33 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_CRC32_H
+#define GRACEFUL_PARTITION_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * IEEE 802.3 CRC32 (reflected polynomial 0xEDB88320), as used by GPT.
+ *
+ * crc32_update() works on the raw register value, so the usual pre and
+ * post inversion is left to the caller:
+ *
+ *      crc = ~crc32_update(~0U, buf, len);
+ *
+ * On x86 with PCLMULQDQ the bulk of the buffer is folded with carry-less
+ * multiplication, everything else uses a slicing-by-8 table.
+ */
+uint32_t crc32_update(uint32_t crc, const unsigned char *buf, size_t len);
+
+/* the finished (inverted) checksum of @buf */
+uint32_t crc32_checksum(const void *buf, size_t len);
+
+/* the checksum of @buf, with @exLen bytes at @exOff treated as zeroes */
+uint32_t crc32_exclude_offset(const void *buf, size_t len, size_t exOff, size_t exLen);
+
+/* returns 1 if the carry-less multiply path is in use */
+int crc32_is_accelerated(void);
+
+#endif //GRACEFUL_PARTITION_CRC32_H
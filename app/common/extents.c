@@ -0,0 +1,231 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                 /* SEEK_DATA, SEEK_HOLE */
+#endif
+
+#include "extents.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+#include "blkdev.h"
+
+static int extent_next_seek(ExtentIter* it, Extent* ext);
+static int extent_next_fiemap(ExtentIter* it, Extent* ext);
+static int extent_fiemap_fetch(ExtentIter* it);
+
+int extent_iter_init(ExtentIter* it, int fd, uint64_t offset, uint64_t length, int flags)
+{
+    unsigned long long bytes;
+    struct stat st;
+    off_t ret;
+
+    memset(it, 0, sizeof(*it));
+    it->fd = fd;
+    it->pos = offset;
+
+    if (fstat(fd, &st) != 0)
+        return -errno;
+    if (S_ISBLK(st.st_mode)) {
+        if (blkdev_get_size(fd, &bytes) != 0)
+            return -errno;
+        it->end = bytes;
+    } else {
+        it->end = st.st_size;
+    }
+    if (length && offset + length < it->end)
+        it->end = offset + length;
+    if (!S_ISREG(st.st_mode) || it->pos >= it->end)
+        return 0;
+
+    if (!(flags & EXTENT_ITER_NO_SEEK)) {
+        ret = lseek(fd, (off_t) it->pos, SEEK_DATA);
+        if (ret >= 0 || errno == ENXIO) {
+            it->method = EXTENT_ITER_SEEK;
+            return 0;
+        }
+        if (errno != EINVAL && errno != EOPNOTSUPP)
+            return -errno;
+    }
+
+    it->fm = calloc(1, sizeof(struct fiemap) + EXTENT_FIEMAP_COUNT * sizeof(struct fiemap_extent));
+    if (!it->fm)
+        return -ENOMEM;
+    it->method = EXTENT_ITER_FIEMAP;
+    ret = extent_fiemap_fetch(it);
+    if (ret == -EOPNOTSUPP || ret == -ENOTTY) {
+        /* no idea where the holes are, read everything */
+        free(it->fm);
+        it->fm = NULL;
+        it->method = EXTENT_ITER_ALL;
+        return 0;
+    }
+
+    return (int) ret;
+}
+
+void extent_iter_deinit(ExtentIter* it)
+{
+    free(it->fm);
+    it->fm = NULL;
+}
+
+int extent_iter_next(ExtentIter* it, Extent* ext)
+{
+    if (it->pos >= it->end)
+        return 0;
+
+    switch (it->method) {
+        case EXTENT_ITER_SEEK:
+            return extent_next_seek(it, ext);
+        case EXTENT_ITER_FIEMAP:
+            return extent_next_fiemap(it, ext);
+        case EXTENT_ITER_ALL:
+            break;
+    }
+
+    ext->offset = it->pos;
+    ext->length = it->end - it->pos;
+    it->pos = it->end;
+
+    return 1;
+}
+
+int extent_data_bytes(int fd, uint64_t offset, uint64_t length, uint64_t* bytes)
+{
+    ExtentIter it;
+    Extent ext;
+    int rc;
+
+    *bytes = 0;
+    rc = extent_iter_init(&it, fd, offset, length, 0);
+    while (!rc && (rc = extent_iter_next(&it, &ext)) > 0) {
+        *bytes += ext.length;
+        rc = 0;
+    }
+    extent_iter_deinit(&it);
+
+    return rc;
+}
+
+const char* extent_iter_method_to_name(ExtentIterMethod method)
+{
+    switch (method) {
+        case EXTENT_ITER_ALL:
+            return "all";
+        case EXTENT_ITER_SEEK:
+            return "seek";
+        case EXTENT_ITER_FIEMAP:
+            return "fiemap";
+    }
+
+    return "unknown";
+}
+
+static int extent_next_seek(ExtentIter* it, Extent* ext)
+{
+    off_t data, hole;
+
+    data = lseek(it->fd, (off_t) it->pos, SEEK_DATA);
+    if (data < 0) {
+        if (errno != ENXIO)
+            return -errno;
+        it->pos = it->end;
+        return 0;
+    }
+    if ((uint64_t) data >= it->end) {
+        it->pos = it->end;
+        return 0;
+    }
+
+    /* the file may have been truncated in between, then the rest is a hole */
+    hole = lseek(it->fd, data, SEEK_HOLE);
+    if (hole < 0 && errno != ENXIO)
+        return -errno;
+    if (hole < 0 || (uint64_t) hole > it->end)
+        hole = (off_t) it->end;
+
+    ext->offset = data;
+    ext->length = hole - data;
+    it->pos = hole;
+
+    return 1;
+}
+
+/* unwritten extents read as zeroes and are skipped, touching ones are merged */
+static int extent_next_fiemap(ExtentIter* it, Extent* ext)
+{
+    struct fiemap_extent* fe;
+    uint64_t start, end;
+    int rc, found = 0;
+
+    while (it->pos < it->end) {
+        if (it->fmNext >= it->fm->fm_mapped_extents) {
+            if (found)
+                break;
+            if (it->fmLast) {
+                it->pos = it->end;
+                break;
+            }
+            rc = extent_fiemap_fetch(it);
+            if (rc)
+                return rc;
+            if (!it->fm->fm_mapped_extents) {
+                it->pos = it->end;
+                break;
+            }
+        }
+
+        fe = &it->fm->fm_extents[it->fmNext];
+        start = fe->fe_logical > it->pos ? fe->fe_logical : it->pos;
+        end = fe->fe_logical + fe->fe_length < it->end ? fe->fe_logical + fe->fe_length : it->end;
+        if (found && start != ext->offset + ext->length)
+            break;
+        it->fmNext++;
+        if (fe->fe_flags & FIEMAP_EXTENT_LAST)
+            it->fmLast = 1;
+
+        if (end > start && !(fe->fe_flags & FIEMAP_EXTENT_UNWRITTEN)) {
+            if (!found) {
+                ext->offset = start;
+                ext->length = 0;
+                found = 1;
+            }
+            ext->length = end - ext->offset;
+        }
+        if (end > it->pos)
+            it->pos = end;
+    }
+
+    return found;
+}
+
+static int extent_fiemap_fetch(ExtentIter* it)
+{
+    struct fiemap* fm = it->fm;
+
+    memset(fm, 0, sizeof(*fm));
+    fm->fm_start = it->pos;
+    fm->fm_length = it->end - it->pos;
+    fm->fm_extent_count = EXTENT_FIEMAP_COUNT;
+    /* delayed allocations have no extent until they are written back */
+    fm->fm_flags = it->fmSynced ? 0 : FIEMAP_FLAG_SYNC;
+    it->fmNext = 0;
+
+    if (ioctl(it->fd, FS_IOC_FIEMAP, fm) != 0) {
+        fm->fm_mapped_extents = 0;
+        return -errno;
+    }
+    it->fmSynced = 1;
+
+    return 0;
+}
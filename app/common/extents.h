@@ -0,0 +1,64 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_EXTENTS_H
+#define GRACEFUL_PARTITION_EXTENTS_H
+
+#include <stdint.h>
+
+/* extents asked per FS_IOC_FIEMAP call */
+#define EXTENT_FIEMAP_COUNT         256
+
+/* extent_iter_init() flags */
+#define EXTENT_ITER_NO_SEEK         (1 << 0)            /* go straight to FIEMAP */
+
+typedef struct _Extent              Extent;
+typedef struct _ExtentIter          ExtentIter;
+
+typedef enum
+{
+    EXTENT_ITER_ALL = 0,                                /* block device or no hole info, one extent */
+    EXTENT_ITER_SEEK,                                   /* lseek() SEEK_DATA / SEEK_HOLE */
+    EXTENT_ITER_FIEMAP,                                 /* FS_IOC_FIEMAP */
+} ExtentIterMethod;
+
+/* a range which may hold data, everything between two of them reads as zeroes */
+struct _Extent
+{
+    uint64_t                        offset;             /* bytes */
+    uint64_t                        length;
+};
+
+struct _ExtentIter
+{
+    int                             fd;
+    uint64_t                        pos;
+    uint64_t                        end;
+    ExtentIterMethod                method;
+
+    struct fiemap*                  fm;                 /* EXTENT_ITER_FIEMAP, extents of the last call */
+    unsigned int                    fmNext;
+    int                             fmLast;             /* FIEMAP_EXTENT_LAST was seen */
+    int                             fmSynced;
+};
+
+/*
+ * Walk the data of @fd between @offset and @offset + @length (0 = up to
+ * the end). For a regular file holes are skipped with SEEK_DATA/SEEK_HOLE;
+ * if the kernel does not know those, FS_IOC_FIEMAP is asked, which also
+ * skips preallocated but unwritten extents. Anything else, block devices
+ * included, comes back as one extent. Returns 0 or -errno.
+ */
+int extent_iter_init(ExtentIter* it, int fd, uint64_t offset, uint64_t length, int flags);
+void extent_iter_deinit(ExtentIter* it);
+
+/* 1 and the next extent in @ext, in ascending order, 0 at the end, or -errno */
+int extent_iter_next(ExtentIter* it, Extent* ext);
+
+/* sum of the extents, i.e. what is worth reading, 0 or -errno */
+int extent_data_bytes(int fd, uint64_t offset, uint64_t length, uint64_t* bytes);
+
+const char* extent_iter_method_to_name(ExtentIterMethod method);
+
+#endif //GRACEFUL_PARTITION_EXTENTS_H
@@ -2,6 +2,10 @@
 // Created by dingjing on 4/24/22.
 //
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                 /* asprintf() */
+#endif
+
 #include "file-utils.h"
 
 #include <stdio.h>
@@ -16,7 +20,9 @@
 #include "global.h"
 #include "all-io.h"
 #include "file-utils.h"
-#include "path-names.h"
+#include "path-name.h"
+#include "bufpool.h"
+#include "extents.h"
 
 int mkstemp_cloexec(char *template)
 {
@@ -121,7 +127,7 @@ unsigned int get_fd_tabsize(void)
 
 	getrlimit(RLIMIT_NOFILE, &rl);
 	m = rl.rlim_cur;
-#elif defined(HAVE_SYSCONF) && defined(_SC_OPEN_MAX)
+#elif defined(_SC_OPEN_MAX)
     m = sysconf(_SC_OPEN_MAX);
 #else
     m = OPEN_MAX;
@@ -253,22 +259,120 @@ char *stripoff_last_component(char *path)
 static int copy_file_simple(int from, int to)
 {
     ssize_t nr;
-    char buf[BUFSIZ];
+    int rc = 0;
+    char *buf = bufpool_get(UL_COPY_BUFSIZ);
+
+    if (!buf)
+        return UL_COPY_READ_ERROR;
 
-    while ((nr = read_all(from, buf, sizeof(buf))) > 0)
-        if (write_all(to, buf, nr) == -1)
-            return UL_COPY_WRITE_ERROR;
+    while ((nr = read_all(from, buf, UL_COPY_BUFSIZ)) > 0)
+        if (write_all(to, buf, nr) == -1) {
+            rc = UL_COPY_WRITE_ERROR;
+            break;
+        }
     if (nr < 0)
+        rc = UL_COPY_READ_ERROR;
+#ifdef HAVE_EXPLICIT_BZERO
+    explicit_bzero(buf, UL_COPY_BUFSIZ);
+#endif
+    bufpool_put(buf, UL_COPY_BUFSIZ);
+    return rc;
+}
+
+/*
+ * Regular file into an empty tail of another one: only the data extents
+ * of @from are read, the holes are left as holes in @to. Both offsets end
+ * up behind the copy like with read()/write(). Returns 1 if the files do
+ * not qualify and have not been touched.
+ */
+static int copy_file_sparse(int from, int to)
+{
+    struct stat in, out;
+    off_t inPos, outPos;
+    ExtentIter it;
+    Extent ext;
+    ssize_t nr;
+    char *buf;
+    int rc;
+
+    if (fstat(from, &in) == -1 || fstat(to, &out) == -1)
+        return 1;
+    if (!S_ISREG(in.st_mode) || !S_ISREG(out.st_mode) || (fcntl(to, F_GETFL) & O_APPEND))
+        return 1;
+    inPos = lseek(from, 0, SEEK_CUR);
+    outPos = lseek(to, 0, SEEK_CUR);
+    /* a skipped hole must not leave old data behind */
+    if (inPos < 0 || outPos < 0 || out.st_size > outPos || inPos >= in.st_size)
+        return 1;
+    if (extent_iter_init(&it, from, inPos, 0, 0) != 0)
+        return 1;
+    if (it.method == EXTENT_ITER_ALL) {
+        extent_iter_deinit(&it);
+        return 1;
+    }
+
+    buf = bufpool_get(UL_COPY_BUFSIZ);
+    if (!buf) {
+        extent_iter_deinit(&it);
         return UL_COPY_READ_ERROR;
+    }
+
+    for (;;) {
+        uint64_t pos, end;
+
+        rc = extent_iter_next(&it, &ext);
+        if (rc <= 0) {
+            rc = rc < 0 ? UL_COPY_READ_ERROR : 0;
+            break;
+        }
+        pos = ext.offset;
+        end = ext.offset + ext.length;
+        if (lseek(from, (off_t) pos, SEEK_SET) < 0) {
+            rc = UL_COPY_READ_ERROR;
+            break;
+        }
+        if (lseek(to, outPos + (off_t) (pos - inPos), SEEK_SET) < 0) {
+            rc = UL_COPY_WRITE_ERROR;
+            break;
+        }
+
+        rc = 0;
+        while (pos < end && !rc) {
+            nr = read_all(from, buf, end - pos < UL_COPY_BUFSIZ ? end - pos : UL_COPY_BUFSIZ);
+            if (nr <= 0)
+                rc = UL_COPY_READ_ERROR;
+            else if (write_all(to, buf, nr) == -1)
+                rc = UL_COPY_WRITE_ERROR;
+            else
+                pos += nr;
+        }
+        if (rc)
+            break;
+    }
+    if (!rc && lseek(from, (off_t) it.end, SEEK_SET) < 0)
+        rc = UL_COPY_READ_ERROR;
+    /* a trailing hole is only there once the size is set */
+    if (!rc && (ftruncate(to, outPos + (off_t) (it.end - inPos)) == -1 || lseek(to, 0, SEEK_END) < 0))
+        rc = UL_COPY_WRITE_ERROR;
+
+    extent_iter_deinit(&it);
 #ifdef HAVE_EXPLICIT_BZERO
-    explicit_bzero(buf, sizeof(buf));
+    explicit_bzero(buf, UL_COPY_BUFSIZ);
 #endif
-    return 0;
+    bufpool_put(buf, UL_COPY_BUFSIZ);
+    return rc;
 }
 
-/* Copies the contents of a file. Returns -1 on read error, -2 on write error. */
+/*
+ * Copies the contents of a file, sparse if both are regular files. Returns
+ * -1 on read error, -2 on write error.
+ */
 int ul_copy_file(int from, int to)
 {
+    int rc = copy_file_sparse(from, to);
+
+    if (rc <= 0)
+        return rc;
 #ifdef HAVE_SENDFILE
     struct stat st;
 	ssize_t nw;
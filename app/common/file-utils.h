@@ -6,10 +6,13 @@
 #define GRACEFUL_PARTITION_FILE_UTILS_H
 #include <stdio.h>
 #include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <sys/stat.h>
 
+#include "global.h"
+
 extern int mkstemp_cloexec(char *template);
 
 extern int xmkstemp(char **tmpname, const char *dir, const char *prefix);
@@ -96,6 +99,8 @@ extern void ul_close_all_fds(unsigned int first, unsigned int last);
 
 #define UL_COPY_READ_ERROR (-1)
 #define UL_COPY_WRITE_ERROR (-2)
+/* page aligned pool buffer, so O_DIRECT descriptors work too */
+#define UL_COPY_BUFSIZ (1024 * 1024)
 int ul_copy_file(int from, int to);
 
 
@@ -0,0 +1,336 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "hash64.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "bitops.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define HASH64_X86
+#endif
+
+#define HASH64_STRIPE               64
+#define HASH64_SECRET_SIZE          192
+#define HASH64_BLOCK_STRIPES        ((HASH64_SECRET_SIZE - HASH64_STRIPE) / 8)
+#define HASH64_BLOCK                (HASH64_STRIPE * HASH64_BLOCK_STRIPES)
+
+#define PRIME32_1                   0x9E3779B1U
+#define PRIME32_2                   0x85EBCA77U
+#define PRIME32_3                   0xC2B2AE3DU
+#define PRIME64_1                   0x9E3779B185EBCA87ULL
+#define PRIME64_2                   0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3                   0x165667B19E3779F9ULL
+#define PRIME64_4                   0x85EBCA77C2B2AE63ULL
+#define PRIME64_5                   0x27D4EB2F165667C5ULL
+
+typedef void (*Hash64AccumulateFunc) (uint64_t* acc, const unsigned char* p, size_t nstripes, const unsigned char* key);
+typedef void (*Hash64ScrambleFunc) (uint64_t* acc, const unsigned char* key);
+
+static unsigned char hash64Secret[HASH64_SECRET_SIZE];
+static Hash64AccumulateFunc hash64Accumulate;
+static Hash64ScrambleFunc hash64Scramble;
+static const char* hash64Name;
+
+static inline uint64_t hash64_read64(const unsigned char* p);
+static inline uint32_t hash64_read32(const unsigned char* p);
+static inline uint64_t hash64_rotl(uint64_t v, int n);
+static inline uint64_t hash64_fold(uint64_t a, uint64_t b);
+static uint64_t hash64_short(const unsigned char* p, size_t len, uint64_t seed);
+static uint64_t hash64_long(const unsigned char* p, size_t len, uint64_t seed);
+static void hash64_accumulate_scalar(uint64_t* acc, const unsigned char* p, size_t nstripes, const unsigned char* key);
+static void hash64_scramble_scalar(uint64_t* acc, const unsigned char* key);
+#ifdef HASH64_X86
+static void hash64_accumulate_sse2(uint64_t* acc, const unsigned char* p, size_t nstripes, const unsigned char* key);
+static void hash64_scramble_sse2(uint64_t* acc, const unsigned char* key);
+static void hash64_accumulate_avx2(uint64_t* acc, const unsigned char* p, size_t nstripes, const unsigned char* key);
+static void hash64_scramble_avx2(uint64_t* acc, const unsigned char* key);
+#endif
+
+/* the key and the CPU features are set up once, before any thread can run */
+__attribute__((constructor))
+static void hash64_init(void)
+{
+    uint64_t x = PRIME64_3, z;
+    int i;
+
+    /* splitmix64, stored little endian so the key is the same everywhere */
+    for (i = 0; i < HASH64_SECRET_SIZE; i += 8) {
+        z = (x += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z = cpu_to_le64(z ^ (z >> 31));
+        memcpy(hash64Secret + i, &z, sizeof(z));
+    }
+
+    hash64Accumulate = hash64_accumulate_scalar;
+    hash64Scramble = hash64_scramble_scalar;
+    hash64Name = "scalar";
+
+#ifdef HASH64_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        hash64Accumulate = hash64_accumulate_avx2;
+        hash64Scramble = hash64_scramble_avx2;
+        hash64Name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        hash64Accumulate = hash64_accumulate_sse2;
+        hash64Scramble = hash64_scramble_sse2;
+        hash64Name = "sse2";
+    }
+#endif
+}
+
+uint64_t hash64(const void* buf, size_t len, uint64_t seed)
+{
+    if (len < HASH64_SHORT_MAX)
+        return hash64_short(buf, len, seed);
+
+    return hash64_long(buf, len, seed);
+}
+
+const char* hash64_impl(void)
+{
+    return hash64Name;
+}
+
+int hash64_set_impl(const char* name)
+{
+    if (strcmp(name, "scalar") == 0) {
+        hash64Accumulate = hash64_accumulate_scalar;
+        hash64Scramble = hash64_scramble_scalar;
+        hash64Name = "scalar";
+        return 0;
+    }
+#ifdef HASH64_X86
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        hash64Accumulate = hash64_accumulate_avx2;
+        hash64Scramble = hash64_scramble_avx2;
+        hash64Name = "avx2";
+        return 0;
+    }
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        hash64Accumulate = hash64_accumulate_sse2;
+        hash64Scramble = hash64_scramble_sse2;
+        hash64Name = "sse2";
+        return 0;
+    }
+#endif
+
+    return -ENOTSUP;
+}
+
+static inline uint64_t hash64_read64(const unsigned char* p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return le64_to_cpu(v);
+}
+
+static inline uint32_t hash64_read32(const unsigned char* p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return le32_to_cpu(v);
+}
+
+static inline uint64_t hash64_rotl(uint64_t v, int n)
+{
+    return (v << n) | (v >> (64 - n));
+}
+
+/* 64x64->128 multiply, both halves xored */
+static inline uint64_t hash64_fold(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 r = (unsigned __int128) a * b;
+
+    return (uint64_t) r ^ (uint64_t) (r >> 64);
+#else
+    uint64_t lolo = (a & 0xffffffff) * (b & 0xffffffff);
+    uint64_t hilo = (a >> 32) * (b & 0xffffffff);
+    uint64_t lohi = (a & 0xffffffff) * (b >> 32);
+    uint64_t hihi = (a >> 32) * (b >> 32);
+    uint64_t cross = (lolo >> 32) + (hilo & 0xffffffff) + lohi;
+    uint64_t hi = (hilo >> 32) + (cross >> 32) + hihi;
+    uint64_t lo = (cross << 32) | (lolo & 0xffffffff);
+
+    return lo ^ hi;
+#endif
+}
+
+static uint64_t hash64_short(const unsigned char* p, size_t len, uint64_t seed)
+{
+    uint64_t h = seed + PRIME64_5 + len, k;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        k = hash64_rotl(hash64_read64(p) * PRIME64_2, 31) * PRIME64_1;
+        h = hash64_rotl(h ^ k, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (len >= 4) {
+        h = hash64_rotl(h ^ (hash64_read32(p) * PRIME64_1), 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+        len -= 4;
+    }
+    while (len--)
+        h = hash64_rotl(h ^ (*p++ * PRIME64_5), 11) * PRIME64_1;
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+static uint64_t hash64_long(const unsigned char* p, size_t len, uint64_t seed)
+{
+    uint64_t acc[8] __attribute__((aligned(32))) = {
+        PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+    };
+    const unsigned char* lastKey = hash64Secret + HASH64_SECRET_SIZE - HASH64_STRIPE;
+    size_t i, nblocks = (len - 1) / HASH64_BLOCK;
+    uint64_t h;
+
+    for (i = 0; i < 8; i += 2) {
+        acc[i] += seed;
+        acc[i + 1] -= seed;
+    }
+
+    for (i = 0; i < nblocks; i++) {
+        hash64Accumulate(acc, p + i * HASH64_BLOCK, HASH64_BLOCK_STRIPES, hash64Secret);
+        hash64Scramble(acc, lastKey);
+    }
+
+    /* the rest of the last block, then the final stripe which may overlap it */
+    hash64Accumulate(acc, p + nblocks * HASH64_BLOCK, ((len - 1) - nblocks * HASH64_BLOCK) / HASH64_STRIPE, hash64Secret);
+    hash64Accumulate(acc, p + len - HASH64_STRIPE, 1, lastKey - 7);
+
+    h = len * PRIME64_1;
+    for (i = 0; i < 4; i++) {
+        h += hash64_fold(acc[2 * i] ^ hash64_read64(hash64Secret + 11 + 16 * i),
+                         acc[2 * i + 1] ^ hash64_read64(hash64Secret + 19 + 16 * i));
+    }
+
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+
+    return h;
+}
+
+static void hash64_accumulate_scalar(uint64_t* acc, const unsigned char* p, size_t nstripes, const unsigned char* key)
+{
+    uint64_t v, k;
+    size_t n;
+    int i;
+
+    for (n = 0; n < nstripes; n++, p += HASH64_STRIPE, key += 8) {
+        for (i = 0; i < 8; i++) {
+            v = hash64_read64(p + 8 * i);
+            k = v ^ hash64_read64(key + 8 * i);
+            acc[i ^ 1] += v;
+            acc[i] += (k & 0xffffffff) * (k >> 32);
+        }
+    }
+}
+
+static void hash64_scramble_scalar(uint64_t* acc, const unsigned char* key)
+{
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        acc[i] ^= acc[i] >> 47;
+        acc[i] ^= hash64_read64(key + 8 * i);
+        acc[i] *= PRIME32_1;
+    }
+}
+
+#ifdef HASH64_X86
+__attribute__((target("sse2")))
+static void hash64_accumulate_sse2(uint64_t* acc, const unsigned char* p, size_t nstripes, const unsigned char* key)
+{
+    __m128i a[4], d, k;
+    size_t n;
+    int i;
+
+    for (i = 0; i < 4; i++)
+        a[i] = _mm_loadu_si128((const __m128i*) acc + i);
+
+    for (n = 0; n < nstripes; n++, p += HASH64_STRIPE, key += 8) {
+        for (i = 0; i < 4; i++) {
+            d = _mm_loadu_si128((const __m128i*) p + i);
+            k = _mm_xor_si128(d, _mm_loadu_si128((const __m128i*) key + i));
+            a[i] = _mm_add_epi64(a[i], _mm_mul_epu32(k, _mm_srli_epi64(k, 32)));
+            a[i] = _mm_add_epi64(a[i], _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+        }
+    }
+
+    for (i = 0; i < 4; i++)
+        _mm_storeu_si128((__m128i*) acc + i, a[i]);
+}
+
+__attribute__((target("sse2")))
+static void hash64_scramble_sse2(uint64_t* acc, const unsigned char* key)
+{
+    const __m128i prime = _mm_set1_epi32((int) PRIME32_1);
+    __m128i a, lo, hi;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        a = _mm_loadu_si128((const __m128i*) acc + i);
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i*) key + i));
+        lo = _mm_mul_epu32(a, prime);
+        hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+        _mm_storeu_si128((__m128i*) acc + i, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+    }
+}
+
+__attribute__((target("avx2")))
+static void hash64_accumulate_avx2(uint64_t* acc, const unsigned char* p, size_t nstripes, const unsigned char* key)
+{
+    __m256i a0 = _mm256_loadu_si256((const __m256i*) acc);
+    __m256i a1 = _mm256_loadu_si256((const __m256i*) acc + 1);
+    __m256i d0, d1, k0, k1;
+    size_t n;
+
+    for (n = 0; n < nstripes; n++, p += HASH64_STRIPE, key += 8) {
+        d0 = _mm256_loadu_si256((const __m256i*) p);
+        d1 = _mm256_loadu_si256((const __m256i*) p + 1);
+        k0 = _mm256_xor_si256(d0, _mm256_loadu_si256((const __m256i*) key));
+        k1 = _mm256_xor_si256(d1, _mm256_loadu_si256((const __m256i*) key + 1));
+        a0 = _mm256_add_epi64(a0, _mm256_mul_epu32(k0, _mm256_srli_epi64(k0, 32)));
+        a1 = _mm256_add_epi64(a1, _mm256_mul_epu32(k1, _mm256_srli_epi64(k1, 32)));
+        a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2)));
+        a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+    _mm256_storeu_si256((__m256i*) acc, a0);
+    _mm256_storeu_si256((__m256i*) acc + 1, a1);
+}
+
+__attribute__((target("avx2")))
+static void hash64_scramble_avx2(uint64_t* acc, const unsigned char* key)
+{
+    const __m256i prime = _mm256_set1_epi32((int) PRIME32_1);
+    __m256i a, lo, hi;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        a = _mm256_loadu_si256((const __m256i*) acc + i);
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i*) key + i));
+        lo = _mm256_mul_epu32(a, prime);
+        hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), prime);
+        _mm256_storeu_si256((__m256i*) acc + i, _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+    }
+}
+#endif
@@ -0,0 +1,34 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_HASH64_H
+#define GRACEFUL_PARTITION_HASH64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Fast 64 bit non-cryptographic hash for comparing data, built like XXH3:
+ * 64 byte stripes are folded into eight 64 bit lanes with a 32x32->64
+ * multiply against a key, the lanes are scrambled every 1K and merged at
+ * the end. The lanes are processed with AVX2 or SSE2 where the CPU has
+ * them, all paths give the same value on every machine. It is not XXH3
+ * and does not interoperate with it. Inputs shorter than
+ * HASH64_SHORT_MAX take a simple word loop.
+ */
+#define HASH64_SHORT_MAX            240
+
+uint64_t hash64(const void* buf, size_t len, uint64_t seed);
+
+/* "avx2", "sse2" or "scalar" */
+const char* hash64_impl(void);
+
+/*
+ * Switch to the implementation @name ("avx2", "sse2" or "scalar") to
+ * compare them, -ENOTSUP if this CPU cannot run it. Not thread safe, call
+ * it before any hashing starts.
+ */
+int hash64_set_impl(const char* name);
+
+#endif //GRACEFUL_PARTITION_HASH64_H
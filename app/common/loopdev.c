@@ -0,0 +1,364 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "loopdev.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/loop.h>
+
+#include "blkdev.h"
+#include "path-name.h"
+
+/* linux 4.4 and 4.14, older headers do not have them */
+#ifndef LOOP_SET_DIRECT_IO
+#define LOOP_SET_DIRECT_IO          0x4C08
+#endif
+#ifndef LOOP_SET_BLOCK_SIZE
+#define LOOP_SET_BLOCK_SIZE         0x4C09
+#endif
+
+/* devices looked at behind LOOP_CTL_GET_FREE before giving up */
+#define LOOPDEV_SCAN_MAX            256
+
+static int loopdev_open(int nr, LoopDev* dev);
+static int loopdev_is_free(int fd);
+static int loopdev_pool_fill(LoopDevPool* pool, unsigned int want);
+static int loopdev_pool_get(LoopDevPool* pool, LoopDev* dev);
+static void loopdev_release(LoopDevPool* pool, LoopDev* dev);
+static uint32_t loopdev_lo_flags(int flags);
+static int loopdev_configure_supported(int fd);
+static int loopdev_configure(const LoopDev* dev, int imageFd, const char* name, const LoopDevConfig* cfg, int flags);
+static int loopdev_set_fd(const LoopDev* dev, int imageFd, const char* name, const LoopDevConfig* cfg, int flags);
+
+int loopdev_pool_init(LoopDevPool* pool, unsigned int warm)
+{
+    int rc;
+
+    memset(pool, 0, sizeof(*pool));
+    pool->warm = warm ? warm : LOOPDEV_POOL_WARM;
+    if (pool->warm > LOOPDEV_POOL_MAX)
+        pool->warm = LOOPDEV_POOL_MAX;
+
+    pool->ctl = open(_PATH_DEV_LOOPCTL, O_RDWR | O_CLOEXEC);
+    if (pool->ctl < 0)
+        return -errno;
+
+    pthread_mutex_init(&pool->lock, NULL);
+
+    rc = loopdev_pool_fill(pool, pool->warm);
+    if (rc) {
+        loopdev_pool_deinit(pool);
+        return rc;
+    }
+    pool->noConfigure = !loopdev_configure_supported(pool->free[0].fd);
+
+    return 0;
+}
+
+void loopdev_pool_deinit(LoopDevPool* pool)
+{
+    unsigned int i;
+
+    if (pool->ctl < 0)
+        return;
+
+    for (i = 0; i < pool->nfree; i++)
+        close(pool->free[i].fd);
+    pool->nfree = 0;
+
+    close(pool->ctl);
+    pool->ctl = -1;
+    pthread_mutex_destroy(&pool->lock);
+}
+
+int loopdev_attach(LoopDevPool* pool, const char* image, const LoopDevConfig* cfg, LoopDev* dev)
+{
+    int flags = cfg ? cfg->flags : 0;
+    int fd, rc;
+
+    fd = open(image, ((flags & LOOPDEV_READ_ONLY) ? O_RDONLY : O_RDWR) | O_CLOEXEC);
+    if (fd < 0)
+        return -errno;
+
+    /* the device holds its own reference to the file */
+    rc = loopdev_attach_fd(pool, fd, image, cfg, dev);
+    close(fd);
+
+    return rc;
+}
+
+int loopdev_attach_fd(LoopDevPool* pool, int imageFd, const char* name, const LoopDevConfig* cfg, LoopDev* dev)
+{
+    static const LoopDevConfig whole;
+    struct loop_info64 info;
+    int tries, rc;
+
+    if (!cfg)
+        cfg = &whole;
+
+    for (tries = 0; tries < LOOPDEV_ATTACH_TRIES; tries++) {
+        rc = loopdev_pool_get(pool, dev);
+        if (rc)
+            return rc;
+
+        if (!pool->noConfigure) {
+            dev->method = LOOPDEV_CONFIGURE;
+            rc = loopdev_configure(dev, imageFd, name, cfg, cfg->flags);
+            /* the backing file may not do direct I/O, LOOP_SET_DIRECT_IO is allowed to fail, too */
+            if (rc == -EINVAL && (cfg->flags & LOOPDEV_DIRECT_IO))
+                rc = loopdev_configure(dev, imageFd, name, cfg, cfg->flags & ~LOOPDEV_DIRECT_IO);
+        } else {
+            dev->method = LOOPDEV_SET_FD;
+            rc = loopdev_set_fd(dev, imageFd, name, cfg, cfg->flags);
+        }
+
+        /* somebody else attached it since it went into the pool */
+        if (rc == -EBUSY) {
+            close(dev->fd);
+            dev->fd = -1;
+            continue;
+        }
+
+        if (rc) {
+            loopdev_release(pool, dev);
+            return rc;
+        }
+
+        dev->direct = !ioctl(dev->fd, LOOP_GET_STATUS64, &info) && (info.lo_flags & LO_FLAGS_DIRECT_IO);
+
+        return 0;
+    }
+
+    return -EBUSY;
+}
+
+int loopdev_detach(LoopDevPool* pool, LoopDev* dev)
+{
+    int rc = 0;
+
+    if (dev->fd < 0)
+        return -EBADF;
+
+    /* ENXIO: autoclear got there first */
+    if (ioctl(dev->fd, LOOP_CLR_FD) && errno != ENXIO)
+        rc = -errno;
+
+    loopdev_release(pool, dev);
+
+    return rc;
+}
+
+int loopdev_rescan(const LoopDev* dev)
+{
+    return ioctl(dev->fd, BLKRRPART) ? -errno : 0;
+}
+
+const char* loopdev_method_to_name(LoopDevMethod method)
+{
+    switch (method) {
+        case LOOPDEV_CONFIGURE:
+            return "configure";
+        case LOOPDEV_SET_FD:
+            return "set-fd";
+    }
+
+    return "unknown";
+}
+
+static int loopdev_open(int nr, LoopDev* dev)
+{
+    memset(dev, 0, sizeof(*dev));
+    dev->nr = nr;
+    snprintf(dev->path, sizeof(dev->path), _PATH_DEV_LOOP "%d", nr);
+
+    dev->fd = open(dev->path, O_RDWR | O_CLOEXEC);
+
+    return dev->fd < 0 ? -errno : 0;
+}
+
+static int loopdev_is_free(int fd)
+{
+    struct loop_info64 info;
+
+    return ioctl(fd, LOOP_GET_STATUS64, &info) && errno == ENXIO;
+}
+
+/*
+ * LOOP_CTL_GET_FREE only knows the lowest free device, which may be pooled
+ * already, so the devices behind it are tried in turn and added with
+ * LOOP_CTL_ADD where they do not exist yet. Called with the lock held.
+ */
+static int loopdev_pool_fill(LoopDevPool* pool, unsigned int want)
+{
+    LoopDev dev;
+    int nr, last, rc = -ENODEV;
+    unsigned int i;
+
+    nr = ioctl(pool->ctl, LOOP_CTL_GET_FREE);
+    if (nr < 0)
+        return -errno;
+
+    for (last = nr + LOOPDEV_SCAN_MAX; pool->nfree < want && nr < last; nr++) {
+        for (i = 0; i < pool->nfree && pool->free[i].nr != nr; i++);
+        if (i < pool->nfree)
+            continue;
+
+        rc = loopdev_open(nr, &dev);
+        if (rc == -ENOENT || rc == -ENXIO) {
+            if (ioctl(pool->ctl, LOOP_CTL_ADD, nr) < 0 && errno != EEXIST)
+                continue;
+            rc = loopdev_open(nr, &dev);
+        }
+        if (rc)
+            continue;
+
+        if (!loopdev_is_free(dev.fd)) {
+            close(dev.fd);
+            continue;
+        }
+        pool->free[pool->nfree++] = dev;
+    }
+
+    return pool->nfree ? 0 : rc;
+}
+
+static int loopdev_pool_get(LoopDevPool* pool, LoopDev* dev)
+{
+    int rc = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    if (!pool->nfree)
+        rc = loopdev_pool_fill(pool, pool->warm);
+    if (!rc)
+        *dev = pool->free[--pool->nfree];
+    pthread_mutex_unlock(&pool->lock);
+
+    return rc;
+}
+
+/*
+ * On newer kernels LOOP_CLR_FD only marks the device and the last close
+ * tears it down, so close and open again before pooling it.
+ */
+static void loopdev_release(LoopDevPool* pool, LoopDev* dev)
+{
+    LoopDev fresh;
+    int nr = dev->nr;
+
+    close(dev->fd);
+    dev->fd = -1;
+
+    if (loopdev_open(nr, &fresh))
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->nfree < LOOPDEV_POOL_MAX) {
+        pool->free[pool->nfree++] = fresh;
+        fresh.fd = -1;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (fresh.fd >= 0)
+        close(fresh.fd);
+}
+
+static uint32_t loopdev_lo_flags(int flags)
+{
+    uint32_t lo = 0;
+
+    if (flags & LOOPDEV_READ_ONLY)
+        lo |= LO_FLAGS_READ_ONLY;
+    if (flags & LOOPDEV_DIRECT_IO)
+        lo |= LO_FLAGS_DIRECT_IO;
+    if (flags & LOOPDEV_PARTSCAN)
+        lo |= LO_FLAGS_PARTSCAN;
+    if (flags & LOOPDEV_AUTOCLEAR)
+        lo |= LO_FLAGS_AUTOCLEAR;
+
+    return lo;
+}
+
+/*
+ * Old kernels answer unknown loop ioctls with EINVAL, which is also the
+ * answer to a bad configuration, so support is found out once up front: a
+ * LOOP_CONFIGURE without a backing file fails with EBADF where it exists.
+ */
+static int loopdev_configure_supported(int fd)
+{
+#ifdef LOOP_CONFIGURE
+    struct loop_config lc;
+
+    memset(&lc, 0, sizeof(lc));
+    lc.fd = (uint32_t) -1;
+
+    return ioctl(fd, LOOP_CONFIGURE, &lc) != 0 && errno == EBADF;
+#else
+    (void) fd;
+
+    return 0;
+#endif
+}
+
+static int loopdev_configure(const LoopDev* dev, int imageFd, const char* name, const LoopDevConfig* cfg, int flags)
+{
+#ifdef LOOP_CONFIGURE
+    struct loop_config lc;
+
+    memset(&lc, 0, sizeof(lc));
+    lc.fd = imageFd;
+    lc.block_size = cfg->blockSize;
+    lc.info.lo_offset = cfg->offset;
+    lc.info.lo_sizelimit = cfg->sizeLimit;
+    lc.info.lo_flags = loopdev_lo_flags(flags);
+    if (name)
+        strncpy((char*) lc.info.lo_file_name, name, LO_NAME_SIZE - 1);
+
+    return ioctl(dev->fd, LOOP_CONFIGURE, &lc) ? -errno : 0;
+#else
+    (void) dev; (void) imageFd; (void) name; (void) cfg; (void) flags;
+
+    return -ENOTTY;
+#endif
+}
+
+/*
+ * The pre 5.8 sequence. LOOP_SET_STATUS64 only takes autoclear and
+ * partscan, read-only comes from the mode of @imageFd and direct I/O has
+ * its own ioctl, which is allowed to fail like with LOOP_CONFIGURE.
+ */
+static int loopdev_set_fd(const LoopDev* dev, int imageFd, const char* name, const LoopDevConfig* cfg, int flags)
+{
+    struct loop_info64 info;
+    int rc;
+
+    if (ioctl(dev->fd, LOOP_SET_FD, imageFd))
+        return -errno;
+
+    memset(&info, 0, sizeof(info));
+    info.lo_offset = cfg->offset;
+    info.lo_sizelimit = cfg->sizeLimit;
+    info.lo_flags = loopdev_lo_flags(flags) & (LO_FLAGS_AUTOCLEAR | LO_FLAGS_PARTSCAN);
+    if (name)
+        strncpy((char*) info.lo_file_name, name, LO_NAME_SIZE - 1);
+
+    if (ioctl(dev->fd, LOOP_SET_STATUS64, &info))
+        goto err;
+    if (cfg->blockSize && ioctl(dev->fd, LOOP_SET_BLOCK_SIZE, (unsigned long) cfg->blockSize))
+        goto err;
+    if (flags & LOOPDEV_DIRECT_IO)
+        ioctl(dev->fd, LOOP_SET_DIRECT_IO, 1UL);
+
+    return 0;
+
+err:
+    rc = -errno;
+    ioctl(dev->fd, LOOP_CLR_FD);
+
+    return rc;
+}
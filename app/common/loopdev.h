@@ -0,0 +1,117 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_LOOPDEV_H
+#define GRACEFUL_PARTITION_LOOPDEV_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/* upper bound of free devices kept open by a pool */
+#define LOOPDEV_POOL_MAX            32
+
+/* defaults if the caller leaves them 0 */
+#define LOOPDEV_POOL_WARM           4
+
+/* attempts to find a device nobody else took in the meantime */
+#define LOOPDEV_ATTACH_TRIES        8
+
+typedef struct _LoopDev             LoopDev;
+typedef struct _LoopDevPool         LoopDevPool;
+typedef struct _LoopDevConfig       LoopDevConfig;
+
+typedef enum
+{
+    LOOPDEV_READ_ONLY               = 1 << 0,
+    LOOPDEV_DIRECT_IO               = 1 << 1,           /* bypass the page cache of the backing file */
+    LOOPDEV_PARTSCAN                = 1 << 2,           /* let the kernel parse the partition table */
+    LOOPDEV_AUTOCLEAR               = 1 << 3,           /* detach on the last close */
+} LoopDevFlags;
+
+typedef enum
+{
+    LOOPDEV_CONFIGURE = 0,                              /* one LOOP_CONFIGURE ioctl, linux 5.8 */
+    LOOPDEV_SET_FD,                                     /* LOOP_SET_FD + LOOP_SET_STATUS64 + ... */
+} LoopDevMethod;
+
+struct _LoopDevConfig
+{
+    uint64_t                        offset;             /* bytes into the backing file */
+    uint64_t                        sizeLimit;          /* 0 = up to the end */
+    unsigned int                    blockSize;          /* logical block size, 0 = 512 */
+    int                             flags;              /* LoopDevFlags */
+};
+
+struct _LoopDev
+{
+    int                             fd;                 /* open device, -1 if none */
+    int                             nr;
+    char                            path[32];           /* /dev/loopN */
+
+    LoopDevMethod                   method;
+    int                             direct;             /* the kernel took LOOPDEV_DIRECT_IO */
+};
+
+/*
+ * Free devices which are open already. Devices are found with
+ * LOOP_CTL_GET_FREE and LOOP_CTL_ADD once, attaching is then a single
+ * ioctl on an open descriptor and detaching hands the device back to the
+ * pool, so a test loop never scans /sys or forks losetup.
+ */
+struct _LoopDevPool
+{
+    int                             ctl;                /* /dev/loop-control */
+    unsigned int                    warm;               /* free devices to keep at hand */
+    int                             noConfigure;        /* LOOP_CONFIGURE is not supported, probed at init */
+
+    LoopDev                         free[LOOPDEV_POOL_MAX];
+    unsigned int                    nfree;
+    pthread_mutex_t                 lock;
+};
+
+/*
+ * Open /dev/loop-control and @warm (0 = LOOPDEV_POOL_WARM, at most
+ * LOOPDEV_POOL_MAX) free devices, adding devices if there are not enough.
+ * Returns 0 or -errno.
+ */
+int loopdev_pool_init(LoopDevPool* pool, unsigned int warm);
+
+/* close the pooled devices, attached ones are left alone */
+void loopdev_pool_deinit(LoopDevPool* pool);
+
+/*
+ * Attach @image (an image file or anything else open() takes) to a free
+ * device with @cfg (NULL for the whole file, read-write, 512 byte blocks).
+ * LOOP_CONFIGURE is used where the kernel has it, older kernels get
+ * LOOP_SET_FD, LOOP_SET_STATUS64, LOOP_SET_BLOCK_SIZE and
+ * LOOP_SET_DIRECT_IO. Direct I/O is a hint, the kernel falls back to
+ * buffered I/O if the backing file cannot do it, @dev->direct tells which
+ * one it is.
+ *
+ * Returns 0 and fills @dev or -errno, e.g. -EINVAL for a block size or
+ * offset the kernel refuses.
+ */
+int loopdev_attach(LoopDevPool* pool, const char* image, const LoopDevConfig* cfg, LoopDev* dev);
+
+/*
+ * The same with an open backing file, @imageFd is not closed and @name
+ * (may be NULL) ends up in lo_file_name. Without LOOP_CONFIGURE the device
+ * is only read-only if @imageFd is.
+ */
+int loopdev_attach_fd(LoopDevPool* pool, int imageFd, const char* name, const LoopDevConfig* cfg, LoopDev* dev);
+
+/*
+ * Detach @dev and hand it back to the pool. Newer kernels only finish
+ * LOOP_CLR_FD on the last close, so the device is closed and opened again
+ * before it goes back; if somebody else still has it open it stays busy
+ * until they close it and the next attach skips it. Returns 0 or -errno.
+ */
+int loopdev_detach(LoopDevPool* pool, LoopDev* dev);
+
+/* ask the kernel to parse the partition table of an attached @dev again, 0 or -errno */
+int loopdev_rescan(const LoopDev* dev);
+
+const char* loopdev_method_to_name(LoopDevMethod method);
+
+#endif //GRACEFUL_PARTITION_LOOPDEV_H
@@ -0,0 +1,15 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_NLS_H
+#define GRACEFUL_PARTITION_NLS_H
+
+#ifdef ENABLE_NLS
+# include <libintl.h>
+# define _(Text) gettext (Text)
+#else
+# define _(Text) (Text)
+#endif
+
+#endif //GRACEFUL_PARTITION_NLS_H
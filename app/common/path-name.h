@@ -68,11 +68,20 @@
 
 #define _PATH_OS_RELEASE_ETC            "/etc/os-release"
 #define _PATH_OS_RELEASE_USR            "/usr/lib/os-release"
+
+#ifndef _PATH_RUNSTATEDIR
+#define _PATH_RUNSTATEDIR               "/run"
+#endif
+
 #define _PATH_NUMLOCK_ON                _PATH_RUNSTATEDIR "/numlock-on"
 #define _PATH_LOGINDEFS	                "/etc/login.defs"
 
 #define _PATH_SD_UNITSLOAD              _PATH_RUNSTATEDIR "/systemd/systemd-units-load"
 
+/* state of running operations, gone after a reboot */
+#define _PATH_RUN_GRACEFUL              _PATH_RUNSTATEDIR "/graceful-partition"
+#define _PATH_RUN_READAHEAD             _PATH_RUN_GRACEFUL "/readahead"
+
 /* misc paths */
 #define _PATH_WORDS                     "/usr/share/dict/words"
 #define _PATH_WORDS_ALT                 "/usr/share/dict/web2"
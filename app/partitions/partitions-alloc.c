@@ -0,0 +1,554 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "partitions-alloc.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/blkdev.h"
+
+struct _PartAllocNode
+{
+    uint64_t                        start;
+    uint64_t                        end;                /* exclusive */
+    uint64_t                        fit;                /* aligned sectors in this region */
+    uint64_t                        maxLen;             /* largest region in this subtree */
+    uint64_t                        maxFit;             /* largest fit in this subtree */
+    uint32_t                        prio;
+
+    PartAllocNode*                  left;
+    PartAllocNode*                  right;
+};
+
+static uint32_t palloc_random(PartAlloc* pa);
+static inline void palloc_node_update(PartAllocNode* n);
+static void palloc_node_free_all(PartAllocNode* n);
+static PartAllocNode* palloc_node_new(PartAlloc* pa, uint64_t start, uint64_t end);
+static void palloc_node_set(const PartAlloc* pa, PartAllocNode* n, uint64_t start, uint64_t end);
+static PartAllocNode* palloc_merge(PartAllocNode* a, PartAllocNode* b);
+static void palloc_split(PartAllocNode* t, uint64_t key, PartAllocNode** l, PartAllocNode** r);
+static PartAllocNode* palloc_pop_max(PartAllocNode* t, PartAllocNode** max);
+static PartAllocNode* palloc_pop_min(PartAllocNode* t, PartAllocNode** min);
+static int palloc_carve(PartAlloc* pa, uint64_t start, uint64_t end);
+static const PartAllocNode* palloc_find_fit(const PartAllocNode* n, uint64_t size);
+
+int palloc_topology_from_fd(PartAllocTopology* topo, int fd)
+{
+    BlkdevTopology tp;
+    int rc;
+
+    memset(topo, 0, sizeof(*topo));
+
+    rc = blkdev_get_topology(fd, &tp);
+    if (rc)
+        return rc;
+
+    topo->sectorSize = tp.logicalSectorSize;
+    topo->physSectorSize = tp.physicalSectorSize;
+    topo->ioMin = tp.ioMin;
+    topo->ioOpt = tp.ioOpt;
+    /* -1 means that no compatible alignment exists for a stacked device */
+    topo->alignOffset = tp.alignmentOffset < 0 ? 0 : tp.alignmentOffset;
+
+    return 0;
+}
+
+uint64_t palloc_topology_get_grain(const PartAllocTopology* topo, uint64_t deviceSize)
+{
+    uint64_t ss = topo->sectorSize ? topo->sectorSize : DEFAULT_SECTOR_SIZE;
+    uint64_t pbs = topo->physSectorSize >= ss ? topo->physSectorSize : ss;
+    uint64_t grain = pbs;
+
+    if (topo->ioMin > grain && topo->ioMin % pbs == 0)
+        grain = topo->ioMin;
+    /* some devices report nonsense in io_opt, ignore it unless it fits */
+    if (topo->ioOpt > grain && topo->ioOpt % grain == 0)
+        grain = topo->ioOpt;
+
+    /* tiny devices, don't waste a megabyte */
+    if (deviceSize && deviceSize < 4 * PALLOC_DEFAULT_GRAIN)
+        return grain;
+
+    if (grain < PALLOC_DEFAULT_GRAIN)
+        grain = (PALLOC_DEFAULT_GRAIN + grain - 1) / grain * grain;
+
+    return grain;
+}
+
+static uint32_t palloc_random(PartAlloc* pa)
+{
+    uint32_t x = pa->seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return pa->seed = x;
+}
+
+static inline void palloc_node_update(PartAllocNode* n)
+{
+    n->maxLen = n->end - n->start;
+    n->maxFit = n->fit;
+    if (n->left && n->left->maxLen > n->maxLen)
+        n->maxLen = n->left->maxLen;
+    if (n->left && n->left->maxFit > n->maxFit)
+        n->maxFit = n->left->maxFit;
+    if (n->right && n->right->maxLen > n->maxLen)
+        n->maxLen = n->right->maxLen;
+    if (n->right && n->right->maxFit > n->maxFit)
+        n->maxFit = n->right->maxFit;
+}
+
+static PartAllocNode* palloc_node_new(PartAlloc* pa, uint64_t start, uint64_t end)
+{
+    PartAllocNode* n = calloc(1, sizeof(*n));
+
+    if (!n)
+        return NULL;
+
+    n->prio = palloc_random(pa);
+    palloc_node_set(pa, n, start, end);
+
+    return n;
+}
+
+/* the alignment is the same for the whole disk, so the fit of a region only changes with its bounds */
+static void palloc_node_set(const PartAlloc* pa, PartAllocNode* n, uint64_t start, uint64_t end)
+{
+    uint64_t s = palloc_align_up(pa, start);
+
+    n->start = start;
+    n->end = end;
+    n->fit = s < end ? end - s : 0;
+    palloc_node_update(n);
+}
+
+static void palloc_node_free_all(PartAllocNode* n)
+{
+    if (!n)
+        return;
+
+    palloc_node_free_all(n->left);
+    palloc_node_free_all(n->right);
+    free(n);
+}
+
+/* all keys of @a are smaller than the keys of @b */
+static PartAllocNode* palloc_merge(PartAllocNode* a, PartAllocNode* b)
+{
+    if (!a)
+        return b;
+    if (!b)
+        return a;
+
+    if (a->prio > b->prio) {
+        a->right = palloc_merge(a->right, b);
+        palloc_node_update(a);
+        return a;
+    }
+    b->left = palloc_merge(a, b->left);
+    palloc_node_update(b);
+
+    return b;
+}
+
+/* @l gets the regions starting before @key, @r the rest */
+static void palloc_split(PartAllocNode* t, uint64_t key, PartAllocNode** l, PartAllocNode** r)
+{
+    if (!t) {
+        *l = *r = NULL;
+        return;
+    }
+
+    if (t->start < key) {
+        palloc_split(t->right, key, &t->right, r);
+        *l = t;
+    } else {
+        palloc_split(t->left, key, l, &t->left);
+        *r = t;
+    }
+    palloc_node_update(t);
+}
+
+static PartAllocNode* palloc_pop_max(PartAllocNode* t, PartAllocNode** max)
+{
+    if (!t) {
+        *max = NULL;
+        return NULL;
+    }
+    if (!t->right) {
+        PartAllocNode* l = t->left;
+
+        t->left = NULL;
+        palloc_node_update(t);
+        *max = t;
+        return l;
+    }
+    t->right = palloc_pop_max(t->right, max);
+    palloc_node_update(t);
+
+    return t;
+}
+
+static PartAllocNode* palloc_pop_min(PartAllocNode* t, PartAllocNode** min)
+{
+    if (!t) {
+        *min = NULL;
+        return NULL;
+    }
+    if (!t->left) {
+        PartAllocNode* r = t->right;
+
+        t->right = NULL;
+        palloc_node_update(t);
+        *min = t;
+        return r;
+    }
+    t->left = palloc_pop_min(t->left, min);
+    palloc_node_update(t);
+
+    return t;
+}
+
+PartAlloc* palloc_new(uint64_t firstLba, uint64_t lastLba, const PartAllocTopology* topo)
+{
+    PartAlloc* pa;
+    uint64_t grain;
+
+    if (firstLba > lastLba)
+        return NULL;
+
+    pa = calloc(1, sizeof(*pa));
+    if (!pa)
+        return NULL;
+
+    pa->firstLba = firstLba;
+    pa->lastLba = lastLba;
+    pa->seed = 0x9e3779b9U;
+
+    if (topo) {
+        pa->sectorSize = topo->sectorSize ? topo->sectorSize : DEFAULT_SECTOR_SIZE;
+        grain = palloc_topology_get_grain(topo, (lastLba + 1) * pa->sectorSize);
+        pa->grain = grain / pa->sectorSize;
+        pa->alignLba = pa->grain ? ((uint64_t) topo->alignOffset / pa->sectorSize) % pa->grain : 0;
+    } else {
+        pa->sectorSize = DEFAULT_SECTOR_SIZE;
+        pa->grain = PALLOC_DEFAULT_GRAIN / DEFAULT_SECTOR_SIZE;
+    }
+    if (!pa->grain)
+        pa->grain = 1;
+
+    pa->root = palloc_node_new(pa, firstLba, lastLba + 1);
+    if (!pa->root) {
+        free(pa);
+        return NULL;
+    }
+    pa->nregions = 1;
+
+    return pa;
+}
+
+void palloc_free(PartAlloc* pa)
+{
+    if (!pa)
+        return;
+
+    palloc_node_free_all(pa->root);
+    free(pa);
+}
+
+uint64_t palloc_align_up(const PartAlloc* pa, uint64_t lba)
+{
+    uint64_t d;
+
+    if (pa->grain <= 1)
+        return lba;
+    if (lba < pa->alignLba)
+        return pa->alignLba;
+
+    d = (lba - pa->alignLba) % pa->grain;
+
+    return d ? lba + pa->grain - d : lba;
+}
+
+/* remove [start, end) from the free regions */
+static int palloc_carve(PartAlloc* pa, uint64_t start, uint64_t end)
+{
+    PartAllocNode *a, *b, *mid, *c, *n;
+
+    palloc_split(pa->root, start, &a, &b);
+    palloc_split(b, end, &mid, &c);
+
+    /* the region in front of @start may reach into the carved range */
+    a = palloc_pop_max(a, &n);
+    if (n) {
+        if (n->end > end) {
+            PartAllocNode* tail = palloc_node_new(pa, end, n->end);
+            if (!tail) {
+                pa->root = palloc_merge(palloc_merge(palloc_merge(a, n), mid), c);
+                return -ENOMEM;
+            }
+            c = palloc_merge(tail, c);
+            pa->nregions++;
+        }
+        if (n->end > start)
+            palloc_node_set(pa, n, n->start, start);
+        a = palloc_merge(a, n);
+    }
+
+    /* the last region inside of the range may reach behind @end */
+    mid = palloc_pop_max(mid, &n);
+    if (n) {
+        if (n->end > end) {
+            palloc_node_set(pa, n, end, n->end);
+            c = palloc_merge(n, c);
+        } else {
+            free(n);
+            pa->nregions--;
+        }
+    }
+    while (mid) {
+        mid = palloc_pop_min(mid, &n);
+        free(n);
+        pa->nregions--;
+    }
+
+    pa->root = palloc_merge(a, c);
+
+    return 0;
+}
+
+int palloc_add_used(PartAlloc* pa, uint64_t start, uint64_t size)
+{
+    if (!size || start > UINT64_MAX - size)
+        return -EINVAL;
+
+    return palloc_carve(pa, start, start + size);
+}
+
+int palloc_add_badblocks(PartAlloc* pa, const BadBlocks* bb)
+{
+    uint64_t from = 0, start, count;
+    int rc;
+
+    /* the map may count in other units than the label, round outwards */
+    while (badblocks_next_range(bb, from, &start, &count)) {
+        uint64_t first = start * bb->sectorSize / pa->sectorSize;
+        uint64_t end = ((start + count) * bb->sectorSize + pa->sectorSize - 1) / pa->sectorSize;
+
+        rc = palloc_add_used(pa, first, end - first);
+        if (rc)
+            return rc;
+        from = start + count;
+    }
+
+    return 0;
+}
+
+int palloc_add_free(PartAlloc* pa, uint64_t start, uint64_t size)
+{
+    PartAllocNode *a, *b, *n;
+    uint64_t end;
+    int rc;
+
+    if (!size || start > UINT64_MAX - size)
+        return -EINVAL;
+
+    end = start + size;
+    if (start < pa->firstLba)
+        start = pa->firstLba;
+    if (end > pa->lastLba + 1)
+        end = pa->lastLba + 1;
+    if (start >= end)
+        return -EINVAL;
+
+    /* drop overlaps, then merge with the adjacent neighbours */
+    rc = palloc_carve(pa, start, end);
+    if (rc)
+        return rc;
+
+    palloc_split(pa->root, start, &a, &b);
+
+    a = palloc_pop_max(a, &n);
+    if (n && n->end == start) {
+        start = n->start;
+        free(n);
+        pa->nregions--;
+    } else if (n) {
+        a = palloc_merge(a, n);
+    }
+
+    b = palloc_pop_min(b, &n);
+    if (n && n->start == end) {
+        end = n->end;
+        free(n);
+        pa->nregions--;
+    } else if (n) {
+        b = palloc_merge(n, b);
+    }
+
+    n = palloc_node_new(pa, start, end);
+    if (!n) {
+        pa->root = palloc_merge(a, b);
+        return -ENOMEM;
+    }
+    pa->nregions++;
+    pa->root = palloc_merge(palloc_merge(a, n), b);
+
+    return 0;
+}
+
+int palloc_largest_gap(const PartAlloc* pa, uint64_t* start, uint64_t* size)
+{
+    const PartAllocNode* n = pa->root;
+
+    if (!n || !n->maxLen)
+        return -ENOSPC;
+
+    while (n->end - n->start != n->maxLen) {
+        if (n->left && n->left->maxLen == n->maxLen)
+            n = n->left;
+        else
+            n = n->right;
+    }
+    *start = n->start;
+    *size = n->maxLen;
+
+    return 0;
+}
+
+/*
+ * Leftmost region with room for @size aligned sectors. Every subtree knows
+ * its largest fit, so one path from the root leads to it.
+ */
+static const PartAllocNode* palloc_find_fit(const PartAllocNode* n, uint64_t size)
+{
+    if (n && n->maxFit < size)
+        return NULL;
+
+    while (n) {
+        if (n->left && n->left->maxFit >= size)
+            n = n->left;
+        else if (n->fit >= size)
+            return n;
+        else
+            n = n->right;
+    }
+
+    return NULL;
+}
+
+int palloc_first_fit(const PartAlloc* pa, uint64_t size, uint64_t* start)
+{
+    const PartAllocNode* n;
+
+    if (!size)
+        return -EINVAL;
+
+    n = palloc_find_fit(pa->root, size);
+    if (!n)
+        return -ENOSPC;
+
+    *start = palloc_align_up(pa, n->start);
+
+    return 0;
+}
+
+int palloc_alloc(PartAlloc* pa, uint64_t size, uint64_t* start)
+{
+    uint64_t s;
+    int rc;
+
+    rc = palloc_first_fit(pa, size, &s);
+    if (rc)
+        return rc;
+
+    rc = palloc_carve(pa, s, s + size);
+    if (rc)
+        return rc;
+
+    *start = s;
+
+    return 0;
+}
+
+size_t palloc_alloc_batch(PartAlloc* pa, PartAllocRequest* reqs, size_t n)
+{
+    size_t* order;
+    size_t i, j, failed = 0;
+
+    order = malloc(n * sizeof(*order));
+    if (!order && n) {
+        for (i = 0; i < n; i++)
+            reqs[i].rc = -ENOMEM;
+        return n;
+    }
+
+    /* largest first, "rest" requests (size 0) last, stable */
+    for (i = 0; i < n; i++) {
+        for (j = i; j > 0; j--) {
+            uint64_t prev = reqs[order[j - 1]].size;
+            if (reqs[i].size == 0 || (prev != 0 && prev >= reqs[i].size))
+                break;
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+
+    for (i = 0; i < n; i++) {
+        PartAllocRequest* r = &reqs[order[i]];
+
+        r->start = 0;
+        if (r->size) {
+            r->rc = palloc_alloc(pa, r->size, &r->start);
+        } else {
+            uint64_t gs, gsz, s;
+
+            r->rc = palloc_largest_gap(pa, &gs, &gsz);
+            if (!r->rc) {
+                s = palloc_align_up(pa, gs);
+                if (s >= gs + gsz)
+                    r->rc = -ENOSPC;
+                else
+                    r->rc = palloc_carve(pa, s, gs + gsz);
+                if (!r->rc) {
+                    r->start = s;
+                    r->size = gs + gsz - s;
+                }
+            }
+        }
+        if (r->rc)
+            failed++;
+    }
+
+    free(order);
+
+    return failed;
+}
+
+int palloc_fill_dos_partition(DosPartition* p, unsigned char sysInd, uint64_t start, uint64_t size,
+                              unsigned int heads, unsigned int sectors)
+{
+    if (start > UINT32_MAX || size > UINT32_MAX)
+        return -ERANGE;
+
+    p->sysInd = sysInd;
+    dos_partition_set_start(p, (unsigned int) start);
+    dos_partition_set_size(p, (unsigned int) size);
+
+    if (heads && sectors && start < 1024ULL * heads * sectors) {
+        dos_partition_sync_chs(p, 0, sectors, heads);
+        return 0;
+    }
+
+    /* LBA only, 1023/254/63 tells the BIOS not to use CHS */
+    p->bh = p->eh = 0xfe;
+    p->bs = p->es = 0xff;
+    p->bc = p->ec = 0xff;
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_PARTITIONS_ALLOC_H
+#define GRACEFUL_PARTITION_PARTITIONS_ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "partitions-mbr.h"
+#include "../common/badblocks.h"
+
+/* default partition alignment if the device does not report anything bigger */
+#define PALLOC_DEFAULT_GRAIN        (1024 * 1024)
+
+typedef struct _PartAlloc           PartAlloc;
+typedef struct _PartAllocNode       PartAllocNode;
+typedef struct _PartAllocRequest    PartAllocRequest;
+typedef struct _PartAllocTopology   PartAllocTopology;
+
+/* all sizes in bytes */
+struct _PartAllocTopology
+{
+    unsigned int                    sectorSize;         /* BLKSSZGET */
+    unsigned int                    physSectorSize;     /* BLKPBSZGET */
+    unsigned int                    ioMin;              /* BLKIOMIN */
+    unsigned int                    ioOpt;              /* BLKIOOPT */
+    int                             alignOffset;        /* BLKALIGNOFF */
+};
+
+/*
+ * Index of the free regions of a disk. The regions live in a treap ordered
+ * by start LBA, every node knows the largest region and the largest
+ * aligned fit of its subtree, so "largest gap" and "first fit" are
+ * O(log n).
+ */
+struct _PartAlloc
+{
+    PartAllocNode*                  root;
+    size_t                          nregions;
+
+    uint64_t                        firstLba;
+    uint64_t                        lastLba;            /* inclusive */
+
+    unsigned int                    sectorSize;
+    uint64_t                        grain;              /* alignment in sectors */
+    uint64_t                        alignLba;           /* first aligned LBA modulo grain */
+
+    uint32_t                        seed;               /* treap priorities */
+};
+
+struct _PartAllocRequest
+{
+    uint64_t                        size;               /* in sectors, 0 = rest of the largest gap */
+    uint64_t                        start;              /* out: start LBA */
+    int                             rc;                 /* out: 0 or -ENOSPC */
+};
+
+/* query the alignment topology of a block device (blkdev_get_topology()), 0 or -errno */
+int palloc_topology_from_fd(PartAllocTopology* topo, int fd);
+
+/* partition alignment in bytes for @topo */
+uint64_t palloc_topology_get_grain(const PartAllocTopology* topo, uint64_t deviceSize);
+
+/*
+ * Create an index with one free region from @firstLba to @lastLba (inclusive)
+ * aligned according to @topo (may be NULL for 512 byte sectors and 1 MiB grain).
+ */
+PartAlloc* palloc_new(uint64_t firstLba, uint64_t lastLba, const PartAllocTopology* topo);
+void palloc_free(PartAlloc* pa);
+
+/* mark @size sectors at @start as used, e.g. existing partitions */
+int palloc_add_used(PartAlloc* pa, uint64_t start, uint64_t size);
+
+/* keep all bad runs of @bb, found on this disk, out of the free space */
+int palloc_add_badblocks(PartAlloc* pa, const BadBlocks* bb);
+
+/* return @size sectors at @start into the free space */
+int palloc_add_free(PartAlloc* pa, uint64_t start, uint64_t size);
+
+/* first aligned LBA at or behind @lba */
+uint64_t palloc_align_up(const PartAlloc* pa, uint64_t lba);
+
+/* largest free region (not aligned), returns -ENOSPC if there is no free space */
+int palloc_largest_gap(const PartAlloc* pa, uint64_t* start, uint64_t* size);
+
+/* find the first aligned region of at least @size sectors without taking it */
+int palloc_first_fit(const PartAlloc* pa, uint64_t size, uint64_t* start);
+
+/* find and take @size sectors, returns 0 or -ENOSPC */
+int palloc_alloc(PartAlloc* pa, uint64_t size, uint64_t* start);
+
+/*
+ * Place @n partitions at once. Requests are placed largest first to keep
+ * fragmentation low, requests with size 0 get what is left of the largest
+ * gap at the end. Returns the number of requests which could not be placed.
+ */
+size_t palloc_alloc_batch(PartAlloc* pa, PartAllocRequest* reqs, size_t n);
+
+/*
+ * Fill an MBR entry for @start/@size. CHS addresses are computed with
+ * dos_partition_sync_chs() only if @heads and @sectors are known and the
+ * partition is CHS addressable at all, otherwise the LBA-only marker is set.
+ * Returns 0, or -ERANGE if @start or @size do not fit in 32 bits; @p is
+ * left alone then.
+ */
+int palloc_fill_dos_partition(DosPartition* p, unsigned char sysInd, uint64_t start, uint64_t size,
+                              unsigned int heads, unsigned int sectors);
+
+#endif //GRACEFUL_PARTITION_PARTITIONS_ALLOC_H
@@ -0,0 +1,272 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "partitions-blkpg.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/blkpg.h>
+
+#include "partitions-mbr.h"
+#include "partitions-ebr.h"
+#include "../common/blkdev.h"
+
+/* resize came with 3.6 (commit c83f6bf9), older headers lack it */
+#ifndef BLKPG_RESIZE_PARTITION
+# define BLKPG_RESIZE_PARTITION     3
+#endif
+
+/* order in which the kernel has to see the operations */
+enum
+{
+    BLKPG_RANK_DEL = 0,
+    BLKPG_RANK_SHRINK,
+    BLKPG_RANK_GROW,
+    BLKPG_RANK_ADD,
+    BLKPG_RANK_NUM,
+};
+
+static int blkpg_layout_cmp(const void* a, const void* b);
+static int blkpg_ioctl(int fd, int op, const PartLayout* p, unsigned int sectorSize);
+
+static int blkpg_layout_cmp(const void* a, const void* b)
+{
+    const PartLayout* x = (const PartLayout*) a;
+    const PartLayout* y = (const PartLayout*) b;
+
+    return x->partno - y->partno;
+}
+
+static int blkpg_ioctl(int fd, int op, const PartLayout* p, unsigned int sectorSize)
+{
+    struct blkpg_partition part;
+    struct blkpg_ioctl_arg arg;
+
+    memset(&part, 0, sizeof(part));
+    part.pno = p->partno;
+    part.start = (long long) (p->start * sectorSize);
+    part.length = (long long) (p->size * sectorSize);
+
+    memset(&arg, 0, sizeof(arg));
+    arg.op = op;
+    arg.datalen = sizeof(part);
+    arg.data = &part;
+
+    if (ioctl(fd, BLKPG, &arg) != 0)
+        return -errno;
+
+    return 0;
+}
+
+int blkpg_diff(const PartLayout* old, size_t nold, const PartLayout* cur, size_t ncur, PartDelta** deltas)
+{
+    PartLayout* a = NULL, *b = NULL;
+    PartDelta* ops = NULL, *res = NULL;
+    size_t count[BLKPG_RANK_NUM + 1];
+    unsigned char* rank = NULL;
+    size_t i = 0, j = 0, n = 0, k;
+    int rc;
+
+    *deltas = NULL;
+
+    /* every partition changes at most twice (delete and add) */
+    a = malloc(sizeof(PartLayout) * (nold + 1));
+    b = malloc(sizeof(PartLayout) * (ncur + 1));
+    ops = malloc(sizeof(PartDelta) * (nold + ncur + 1));
+    rank = malloc(nold + ncur + 1);
+    if (!a || !b || !ops || !rank) {
+        rc = -ENOMEM;
+        goto done;
+    }
+    if (nold)
+        memcpy(a, old, sizeof(PartLayout) * nold);
+    if (ncur)
+        memcpy(b, cur, sizeof(PartLayout) * ncur);
+    qsort(a, nold, sizeof(PartLayout), blkpg_layout_cmp);
+    qsort(b, ncur, sizeof(PartLayout), blkpg_layout_cmp);
+
+    for (k = 1; k < nold || k < ncur; k++) {
+        if ((k < nold && a[k].partno == a[k - 1].partno)
+            || (k < ncur && b[k].partno == b[k - 1].partno)) {
+            rc = -EINVAL;
+            goto done;
+        }
+    }
+
+    while (i < nold || j < ncur) {
+        if (j == ncur || (i < nold && a[i].partno < b[j].partno)) {
+            ops[n].type = PART_DELTA_DEL;
+            ops[n].part = a[i++];
+            rank[n++] = BLKPG_RANK_DEL;
+        } else if (i == nold || b[j].partno < a[i].partno) {
+            ops[n].type = PART_DELTA_ADD;
+            ops[n].part = b[j++];
+            rank[n++] = BLKPG_RANK_ADD;
+        } else {
+            if (a[i].start != b[j].start) {
+                /* BLKPG cannot move a partition */
+                ops[n].type = PART_DELTA_DEL;
+                ops[n].part = a[i];
+                rank[n++] = BLKPG_RANK_DEL;
+                ops[n].type = PART_DELTA_ADD;
+                ops[n].part = b[j];
+                rank[n++] = BLKPG_RANK_ADD;
+            } else if (a[i].size != b[j].size) {
+                ops[n].type = PART_DELTA_RESIZE;
+                ops[n].part = b[j];
+                rank[n++] = b[j].size < a[i].size ? BLKPG_RANK_SHRINK : BLKPG_RANK_GROW;
+            }
+            i++;
+            j++;
+        }
+    }
+
+    rc = (int) n;
+    if (!n)
+        goto done;
+
+    /* stable counting sort by rank, partition numbers stay ascending within a rank */
+    res = malloc(sizeof(PartDelta) * n);
+    if (!res) {
+        rc = -ENOMEM;
+        goto done;
+    }
+    memset(count, 0, sizeof(count));
+    for (k = 0; k < n; k++)
+        count[rank[k] + 1]++;
+    for (k = 1; k <= BLKPG_RANK_NUM; k++)
+        count[k] += count[k - 1];
+    for (k = 0; k < n; k++)
+        res[count[rank[k]]++] = ops[k];
+    *deltas = res;
+
+done:
+    free(a);
+    free(b);
+    free(ops);
+    free(rank);
+    return rc;
+}
+
+int blkpg_apply(int fd, unsigned int sectorSize, const PartDelta* deltas, size_t ndeltas, size_t* done)
+{
+    size_t i;
+    int rc = 0;
+
+    for (i = 0; i < ndeltas; i++) {
+        switch (deltas[i].type) {
+            case PART_DELTA_DEL:
+                rc = blkpg_ioctl(fd, BLKPG_DEL_PARTITION, &deltas[i].part, sectorSize);
+                /* already gone is what we want */
+                if (rc == -ENXIO)
+                    rc = 0;
+                break;
+            case PART_DELTA_RESIZE:
+                rc = blkpg_ioctl(fd, BLKPG_RESIZE_PARTITION, &deltas[i].part, sectorSize);
+                break;
+            case PART_DELTA_ADD:
+                rc = blkpg_ioctl(fd, BLKPG_ADD_PARTITION, &deltas[i].part, sectorSize);
+                break;
+            default:
+                rc = -EINVAL;
+                break;
+        }
+        if (rc)
+            break;
+    }
+    if (done)
+        *done = i;
+    /* the partitions have new starts and sizes, so do their cached records */
+    if (i)
+        blkdev_invalidate_topology(fd);
+
+    return rc;
+}
+
+int blkpg_commit(int fd, unsigned int sectorSize, const PartLayout* old, size_t nold,
+                 const PartLayout* cur, size_t ncur)
+{
+    PartDelta* deltas;
+    int n, rc;
+
+    n = blkpg_diff(old, nold, cur, ncur, &deltas);
+    if (n <= 0)
+        return n;
+
+    rc = blkpg_apply(fd, sectorSize, deltas, (size_t) n, NULL);
+    free(deltas);
+
+    return rc;
+}
+
+int blkpg_layout_from_gpt(const GptTable* t, PartLayout** parts)
+{
+    PartLayout* res;
+    uint32_t i, n = 0;
+
+    *parts = NULL;
+    res = malloc(sizeof(PartLayout) * (t->nents + 1));
+    if (!res)
+        return -ENOMEM;
+
+    for (i = 0; i < t->nents; i++) {
+        const GptEntry* e = gpt_table_get_entry(t, i);
+
+        if (!e || !gpt_entry_is_used(e))
+            continue;
+        res[n].partno = (int) i + 1;
+        res[n].start = gpt_entry_get_start(e);
+        res[n].size = gpt_entry_get_size(e);
+        n++;
+    }
+    *parts = res;
+
+    return (int) n;
+}
+
+int blkpg_layout_from_mbr(int fd, unsigned int sectorSize, unsigned char* mbr, PartLayout** parts)
+{
+    EbrLogical logical[EBR_MAX_DEPTH];
+    size_t nlogical = 0, i;
+    PartLayout* res;
+    int n = 0, rc;
+
+    *parts = NULL;
+    rc = ebr_walk_mbr(fd, sectorSize, mbr, logical, EBR_MAX_DEPTH, &nlogical);
+    if (rc)
+        return rc;
+
+    res = malloc(sizeof(PartLayout) * (4 + nlogical));
+    if (!res)
+        return -ENOMEM;
+
+    for (i = 0; i < 4; i++) {
+        DosPartition* p = mbr_get_partition(mbr, (int) i);
+        uint64_t size = dos_partition_get_size(p);
+
+        if (p->sysInd == MBR_EMPTY_PARTITION || !size)
+            continue;
+        /* the kernel keeps two 512 byte sectors of an extended partition, for LILO */
+        if (mbr_is_extended_type(p->sysInd)) {
+            uint64_t max = sectorSize == 512 ? 2 : 1;
+            size = size < max ? size : max;
+        }
+        res[n].partno = (int) i + 1;
+        res[n].start = dos_partition_get_start(p);
+        res[n].size = size;
+        n++;
+    }
+
+    for (i = 0; i < nlogical; i++) {
+        res[n].partno = (int) (5 + i);
+        res[n].start = logical[i].start;
+        res[n].size = logical[i].size;
+        n++;
+    }
+    *parts = res;
+
+    return n;
+}
@@ -0,0 +1,73 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_PARTITIONS_BLKPG_H
+#define GRACEFUL_PARTITION_PARTITIONS_BLKPG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "partitions-gpt.h"
+
+typedef struct _PartDelta           PartDelta;
+typedef struct _PartLayout          PartLayout;
+
+typedef enum
+{
+    PART_DELTA_DEL = 0,
+    PART_DELTA_RESIZE,
+    PART_DELTA_ADD,
+} PartDeltaType;
+
+/* one kernel visible partition, numbered as the kernel does (from 1) */
+struct _PartLayout
+{
+    int                             partno;
+    uint64_t                        start;              /* in sectors */
+    uint64_t                        size;               /* in sectors */
+};
+
+struct _PartDelta
+{
+    PartDeltaType                   type;
+    PartLayout                      part;               /* the new geometry, the old one for DEL */
+};
+
+/*
+ * Compare two layouts and store the operations turning @old into @cur into
+ * *deltas (caller frees). Unchanged partitions produce nothing, a changed
+ * size is a resize and a moved start is a delete followed by an add.
+ *
+ * The result is ordered so the kernel never sees an overlap: deletes, then
+ * shrinking resizes, growing resizes and finally adds. Returns the number
+ * of operations or -errno.
+ */
+int blkpg_diff(const PartLayout* old, size_t nold, const PartLayout* cur, size_t ncur, PartDelta** deltas);
+
+/*
+ * Issue the BLKPG ioctls for @deltas on the whole disk @fd, stopping at
+ * the first failure. *done (may be NULL) is the number of applied
+ * operations. Returns 0 or -errno (-EBUSY for a mounted partition).
+ */
+int blkpg_apply(int fd, unsigned int sectorSize, const PartDelta* deltas, size_t ndeltas, size_t* done);
+
+/*
+ * Tell the kernel about the change from @old to @cur with as few BLKPG
+ * operations as possible. Unlike BLKRRPART untouched partitions are left
+ * alone, so this works while other partitions of the disk are in use.
+ */
+int blkpg_commit(int fd, unsigned int sectorSize, const PartLayout* old, size_t nold,
+                 const PartLayout* cur, size_t ncur);
+
+/* the used entries of @t as the kernel numbers them, returns the count or -errno */
+int blkpg_layout_from_gpt(const GptTable* t, PartLayout** parts);
+
+/*
+ * Primary and logical partitions of the DOS label in @mbr, the extended
+ * partition included (the kernel exposes it with a size of 1 KiB).
+ * Returns the count or -errno.
+ */
+int blkpg_layout_from_mbr(int fd, unsigned int sectorSize, unsigned char* mbr, PartLayout** parts);
+
+#endif //GRACEFUL_PARTITION_PARTITIONS_BLKPG_H
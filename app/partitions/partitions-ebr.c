@@ -0,0 +1,207 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "partitions-ebr.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "../common/blkcache.h"
+
+typedef struct _EbrReader           EbrReader;
+
+struct _EbrReader
+{
+    int                             fd;
+    unsigned int                    sectorSize;
+    uint64_t                        limitLba;           /* first LBA behind the extended partition */
+
+    unsigned char*                  window;
+    uint64_t                        windowLba;
+    size_t                          windowSectors;      /* valid sectors in window */
+
+    uint64_t                        prefetchLba;        /* last LBA handed to readahead */
+};
+
+static int ebr_reader_prefetch(EbrReader* r, uint64_t lba, int64_t stride);
+static unsigned char* ebr_reader_get_sector(EbrReader* r, uint64_t lba, int* rc);
+
+int mbr_is_extended_type(unsigned char sysInd)
+{
+    return sysInd == MBR_DOS_EXTENDED_PARTITION
+           || sysInd == MBR_W95_EXTENDED_PARTITION
+           || sysInd == MBR_LINUX_EXTENDED_PARTITION;
+}
+
+static unsigned char* ebr_reader_get_sector(EbrReader* r, uint64_t lba, int* rc)
+{
+    size_t len;
+    ssize_t ret;
+
+    if (r->window && lba >= r->windowLba && lba < r->windowLba + r->windowSectors)
+        return r->window + (lba - r->windowLba) * r->sectorSize;
+
+    len = EBR_READ_WINDOW;
+    if ((r->limitLba - lba) * r->sectorSize < len)
+        len = (r->limitLba - lba) * r->sectorSize;
+
+    ret = blkcache_pread(r->fd, r->window, len, lba * r->sectorSize);
+
+    if (ret < (ssize_t) r->sectorSize) {
+        r->windowSectors = 0;
+        *rc = ret < 0 ? -errno : -EIO;
+        return NULL;
+    }
+
+    r->windowLba = lba;
+    r->windowSectors = ret / r->sectorSize;
+
+    return r->window;
+}
+
+/*
+ * EBRs usually sit in front of their logical partition, and tools create
+ * the partitions with the same size over and over. Ask the kernel to pull
+ * the next few EBRs of that stride into the page cache while we parse, so
+ * the pread() of the next link is served from memory.
+ */
+static int ebr_reader_prefetch(EbrReader* r, uint64_t lba, int64_t stride)
+{
+    int i;
+
+    if (stride <= 0 || (uint64_t) stride * r->sectorSize < EBR_READ_WINDOW)
+        return 0;
+
+    for (i = 0; i < EBR_PREFETCH_DEPTH; i++) {
+        lba += stride;
+        if (lba >= r->limitLba)
+            break;
+        if (lba <= r->prefetchLba)
+            continue;
+        r->prefetchLba = lba;
+#ifdef POSIX_FADV_WILLNEED
+        posix_fadvise(r->fd, (off_t) (lba * r->sectorSize), r->sectorSize, POSIX_FADV_WILLNEED);
+#endif
+    }
+    return 0;
+}
+
+int ebr_walk_chain(int fd, unsigned int sectorSize, uint64_t extStart, uint64_t extSize,
+                   EbrLogical* parts, size_t maxParts, size_t* nparts)
+{
+    uint64_t visited[EBR_MAX_DEPTH];
+    uint64_t lba;
+    size_t depth = 0, i;
+    EbrReader r;
+    int rc = 0;
+
+    *nparts = 0;
+    if (!sectorSize || !extSize || extStart > UINT64_MAX - extSize)
+        return -EINVAL;
+
+    memset(&r, 0, sizeof(r));
+    r.fd = fd;
+    r.sectorSize = sectorSize;
+    r.limitLba = extStart + extSize;
+    if (posix_memalign((void**) &r.window, sectorSize, EBR_READ_WINDOW))
+        return -ENOMEM;
+
+    lba = extStart;
+    while (1) {
+        unsigned char* ebr;
+        uint64_t next = 0;
+        int haveNext = 0, j;
+
+        for (i = 0; i < depth; i++) {
+            if (visited[i] == lba) {
+                rc = -ELOOP;
+                goto done;
+            }
+        }
+        if (depth == EBR_MAX_DEPTH) {
+            rc = -E2BIG;
+            goto done;
+        }
+        visited[depth++] = lba;
+
+        ebr = ebr_reader_get_sector(&r, lba, &rc);
+        if (!ebr)
+            goto done;
+        if (!mbr_is_valid_magic(ebr))
+            break;
+
+        for (j = 0; j < 4; j++) {
+            DosPartition* p = mbr_get_partition(ebr, j);
+            uint64_t start = dos_partition_get_start(p);
+            uint64_t size = dos_partition_get_size(p);
+
+            if (!size || p->sysInd == MBR_EMPTY_PARTITION)
+                continue;
+
+            if (mbr_is_extended_type(p->sysInd)) {
+                /* link, relative to the start of the extended partition */
+                if (!haveNext) {
+                    next = extStart + start;
+                    haveNext = 1;
+                }
+                continue;
+            }
+
+            /* logical partition, relative to this EBR, and like the links kept inside the container */
+            if (start > r.limitLba - lba || size > r.limitLba - lba - start) {
+                rc = -EINVAL;
+                goto done;
+            }
+            if (*nparts == maxParts) {
+                rc = -E2BIG;
+                goto done;
+            }
+            parts[*nparts].ebrLba = lba;
+            parts[*nparts].start = lba + start;
+            parts[*nparts].size = size;
+            parts[*nparts].sysInd = p->sysInd;
+            parts[*nparts].bootInd = p->bootInd;
+            (*nparts)++;
+        }
+
+        if (!haveNext)
+            break;
+        if (next <= extStart || next >= r.limitLba) {
+            rc = -EINVAL;
+            goto done;
+        }
+
+        if (next > lba)
+            ebr_reader_prefetch(&r, next, (int64_t) (next - lba));
+
+        lba = next;
+    }
+
+done:
+    free(r.window);
+    return rc;
+}
+
+int ebr_walk_mbr(int fd, unsigned int sectorSize, unsigned char* mbr,
+                 EbrLogical* parts, size_t maxParts, size_t* nparts)
+{
+    int i;
+
+    *nparts = 0;
+    if (!mbr_is_valid_magic(mbr))
+        return -EINVAL;
+
+    for (i = 0; i < 4; i++) {
+        DosPartition* p = mbr_get_partition(mbr, i);
+
+        if (mbr_is_extended_type(p->sysInd) && dos_partition_get_size(p))
+            return ebr_walk_chain(fd, sectorSize, dos_partition_get_start(p),
+                                  dos_partition_get_size(p), parts, maxParts, nparts);
+    }
+    return 0;
+}
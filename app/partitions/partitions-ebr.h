@@ -0,0 +1,61 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_PARTITIONS_EBR_H
+#define GRACEFUL_PARTITION_PARTITIONS_EBR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "partitions-mbr.h"
+
+/* hard bound of the EBR chain, deeper chains are reported as -E2BIG */
+#define EBR_MAX_DEPTH               256
+
+/* one pread() covers this much of the extended partition */
+#define EBR_READ_WINDOW             (64 * 1024)
+
+/* number of predicted EBRs handed to the kernel readahead at once */
+#define EBR_PREFETCH_DEPTH          8
+
+typedef struct _EbrLogical          EbrLogical;
+
+struct _EbrLogical
+{
+    uint64_t                        ebrLba;             /* LBA of the EBR describing this partition */
+    uint64_t                        start;              /* absolute start LBA */
+    uint64_t                        size;               /* in sectors */
+    unsigned char                   sysInd;
+    unsigned char                   bootInd;
+};
+
+/* is @sysInd one of the DOS, W95 or Linux extended partition types? */
+int mbr_is_extended_type(unsigned char sysInd);
+
+/*
+ * Follow the EBR chain of the extended partition at @extStart (LBA, size
+ * @extSize sectors) and store up to @maxParts logical partitions into
+ * @parts, the count is returned in @nparts.
+ *
+ * EBR sectors are read in EBR_READ_WINDOW sized chunks, and the kernel is
+ * asked to prefetch the EBRs predicted from the stride of the chain, so
+ * a long chain costs a few round trips instead of one per link.
+ *
+ * Returns 0 on success, -ELOOP if the chain points back to itself,
+ * -E2BIG if it is deeper than EBR_MAX_DEPTH or @maxParts, -EINVAL if a
+ * link or a logical partition leaves the extended partition and -errno on
+ * read errors. @parts
+ * and @nparts are valid up to the failing link in all cases.
+ */
+int ebr_walk_chain(int fd, unsigned int sectorSize, uint64_t extStart, uint64_t extSize,
+                   EbrLogical* parts, size_t maxParts, size_t* nparts);
+
+/*
+ * Same as ebr_walk_chain() for the first extended partition found in the
+ * primary table of @mbr. Returns 0 with *nparts = 0 if there is none.
+ */
+int ebr_walk_mbr(int fd, unsigned int sectorSize, unsigned char* mbr,
+                 EbrLogical* parts, size_t maxParts, size_t* nparts);
+
+#endif //GRACEFUL_PARTITION_PARTITIONS_EBR_H
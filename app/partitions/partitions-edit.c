@@ -0,0 +1,383 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "partitions-edit.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "../common/crc32.h"
+#include "../common/bitops.h"
+#include "../common/blkdev.h"
+#include "../common/blkcache.h"
+
+#ifndef IOV_MAX
+# define IOV_MAX                    1024
+#endif
+
+static int label_run_cmp(const void* a, const void* b);
+static int label_pwritev_all(int fd, struct iovec* iov, int iovcnt, uint64_t off);
+
+static int label_pwritev_all(int fd, struct iovec* iov, int iovcnt, uint64_t off)
+{
+    while (iovcnt > 0) {
+        ssize_t ret = pwritev(fd, iov, iovcnt, (off_t) off);
+
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            return -errno;
+        }
+        if (ret == 0)
+            return -EIO;
+
+        off += ret;
+        /* skip what has been written, partial writes are rare but legal */
+        while (iovcnt > 0 && (size_t) ret >= iov->iov_len) {
+            ret -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*) iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+    return 0;
+}
+
+int label_edit_init(LabelEdit* le, int fd, unsigned int sectorSize)
+{
+    memset(le, 0, sizeof(*le));
+    if (!sectorSize)
+        return -EINVAL;
+
+    le->fd = fd;
+    le->sectorSize = sectorSize;
+
+    return 0;
+}
+
+void label_edit_deinit(LabelEdit* le)
+{
+    size_t i;
+
+    for (i = 0; i < le->nregions; i++) {
+        free(le->regions[i].data);
+        free(le->regions[i].orig);
+        free(le->regions[i].dirty);
+    }
+    free(le->regions);
+    le->regions = NULL;
+    le->nregions = 0;
+}
+
+unsigned char* label_edit_add_region(LabelEdit* le, uint64_t offset, size_t size)
+{
+    LabelRegion* regions;
+    LabelRegion r;
+    size_t i, nsect;
+    ssize_t ret;
+
+    if (!size || offset % le->sectorSize || size % le->sectorSize) {
+        errno = EINVAL;
+        return NULL;
+    }
+    for (i = 0; i < le->nregions; i++) {
+        if (offset < le->regions[i].offset + le->regions[i].size
+            && le->regions[i].offset < offset + size) {
+            errno = EEXIST;
+            return NULL;
+        }
+    }
+
+    memset(&r, 0, sizeof(r));
+    r.offset = offset;
+    r.size = size;
+    nsect = size / le->sectorSize;
+
+    if (posix_memalign((void**) &r.data, le->sectorSize, size))
+        goto nomem;
+    r.orig = malloc(size);
+    r.dirty = calloc((nsect + NBBY - 1) / NBBY, 1);
+    if (!r.orig || !r.dirty)
+        goto nomem;
+
+    ret = blkcache_pread(le->fd, r.data, size, offset);
+    if (ret < 0 || (size_t) ret != size) {
+        if (ret >= 0)
+            errno = EIO;
+        goto fail;
+    }
+    memcpy(r.orig, r.data, size);
+
+    regions = realloc(le->regions, sizeof(LabelRegion) * (le->nregions + 1));
+    if (!regions)
+        goto nomem;
+    le->regions = regions;
+    le->regions[le->nregions++] = r;
+
+    return r.data;
+nomem:
+    errno = ENOMEM;
+fail:
+    free(r.data);
+    free(r.orig);
+    free(r.dirty);
+    return NULL;
+}
+
+unsigned char* label_edit_get(LabelEdit* le, uint64_t offset, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < le->nregions; i++) {
+        LabelRegion* r = &le->regions[i];
+
+        if (offset >= r->offset && offset + len <= r->offset + r->size)
+            return r->data + (offset - r->offset);
+    }
+    return NULL;
+}
+
+size_t label_edit_update_dirty(LabelEdit* le)
+{
+    size_t i, s, n = 0;
+
+    for (i = 0; i < le->nregions; i++) {
+        LabelRegion* r = &le->regions[i];
+        size_t nsect = r->size / le->sectorSize;
+
+        for (s = 0; s < nsect; s++) {
+            size_t off = s * le->sectorSize;
+
+            if (memcmp(r->data + off, r->orig + off, le->sectorSize) != 0) {
+                setbit(r->dirty, s);
+                n++;
+            } else
+                clrbit(r->dirty, s);
+        }
+    }
+    return n;
+}
+
+static int label_run_cmp(const void* a, const void* b)
+{
+    const LabelWriteRun* x = (const LabelWriteRun*) a;
+    const LabelWriteRun* y = (const LabelWriteRun*) b;
+
+    return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+int label_edit_get_runs(LabelEdit* le, LabelWriteRun** runs)
+{
+    LabelWriteRun* res = NULL;
+    size_t i, s, n = 0, max = 0;
+
+    *runs = NULL;
+    label_edit_update_dirty(le);
+
+    for (i = 0; i < le->nregions; i++) {
+        LabelRegion* r = &le->regions[i];
+        size_t nsect = r->size / le->sectorSize;
+
+        for (s = 0; s < nsect; s++) {
+            size_t first = s;
+
+            if (!isset(r->dirty, s))
+                continue;
+            while (s + 1 < nsect && isset(r->dirty, s + 1))
+                s++;
+
+            if (n == max) {
+                LabelWriteRun* tmp = realloc(res, sizeof(*res) * (max ? max * 2 : 8));
+                if (!tmp) {
+                    free(res);
+                    return -ENOMEM;
+                }
+                res = tmp;
+                max = max ? max * 2 : 8;
+            }
+            res[n].offset = r->offset + (uint64_t) first * le->sectorSize;
+            res[n].size = (s - first + 1) * le->sectorSize;
+            res[n].data = r->data + first * le->sectorSize;
+            res[n].orig = r->orig + first * le->sectorSize;
+            n++;
+        }
+    }
+
+    if (n > 1)
+        qsort(res, n, sizeof(*res), label_run_cmp);
+    *runs = res;
+
+    return (int) n;
+}
+
+int label_edit_commit(LabelEdit* le)
+{
+    struct iovec iov[IOV_MAX > 64 ? 64 : IOV_MAX];
+    LabelWriteRun* runs;
+    int i, n, rc = 0;
+
+    n = label_edit_get_runs(le, &runs);
+    if (n <= 0)
+        return n;
+
+    /* runs which continue each other on disk go out in one pwritev() */
+    for (i = 0; i < n && !rc; ) {
+        uint64_t off = runs[i].offset;
+        int cnt = 0;
+
+        do {
+            iov[cnt].iov_base = (void*) runs[i].data;
+            iov[cnt].iov_len = runs[i].size;
+            cnt++;
+            i++;
+        } while (i < n && cnt < (int) (sizeof(iov) / sizeof(iov[0]))
+                 && runs[i].offset == runs[i - 1].offset + runs[i - 1].size);
+
+        rc = label_pwritev_all(le->fd, iov, cnt, off);
+        blkcache_invalidate(le->fd, off, runs[i - 1].offset + runs[i - 1].size - off);
+    }
+    free(runs);
+
+    if (!rc && fsync(le->fd) != 0)
+        rc = -errno;
+    blkdev_invalidate_topology(le->fd);
+
+    if (!rc) {
+        size_t r;
+
+        for (r = 0; r < le->nregions; r++) {
+            memcpy(le->regions[r].orig, le->regions[r].data, le->regions[r].size);
+            memset(le->regions[r].dirty, 0, (le->regions[r].size / le->sectorSize + NBBY - 1) / NBBY);
+        }
+    }
+
+    return rc;
+}
+
+void label_edit_rollback(LabelEdit* le)
+{
+    size_t i;
+
+    for (i = 0; i < le->nregions; i++)
+        memcpy(le->regions[i].data, le->regions[i].orig, le->regions[i].size);
+    label_edit_update_dirty(le);
+}
+
+int gpt_edit_init(GptEdit* ge, int fd, unsigned int sectorSize, uint64_t lastLba)
+{
+    LabelEdit* le = &ge->edit;
+    size_t esz, esects;
+    uint64_t elba, blba, belba;
+    int rc;
+
+    memset(ge, 0, sizeof(*ge));
+    rc = label_edit_init(le, fd, sectorSize);
+    if (rc)
+        return rc;
+
+    ge->primary = (GptHeader*) label_edit_add_region(le, (uint64_t) GPT_PRIMARY_HEADER_LBA * sectorSize, sectorSize);
+    if (!ge->primary) {
+        rc = -errno;
+        goto fail;
+    }
+    rc = gpt_header_check(ge->primary, sectorSize, GPT_PRIMARY_HEADER_LBA, lastLba);
+    if (rc)
+        goto fail;
+
+    esz = gpt_header_get_entries_size(ge->primary);
+    esects = (esz + sectorSize - 1) / sectorSize;
+    elba = le64_to_cpu(ge->primary->partitionEntryLba);
+    ge->nents = le32_to_cpu(ge->primary->npartitionEntries);
+    ge->entrySize = le32_to_cpu(ge->primary->sizeofPartitionEntry);
+
+    ge->primaryEntries = label_edit_add_region(le, elba * sectorSize, esects * sectorSize);
+    if (!ge->primaryEntries) {
+        rc = -errno;
+        goto fail;
+    }
+    if (crc32_checksum(ge->primaryEntries, esz) != le32_to_cpu(ge->primary->partitionEntryArrayCrc32)) {
+        rc = -EBADMSG;
+        goto fail;
+    }
+
+    blba = le64_to_cpu(ge->primary->alternativeLba);
+    if (!blba || blba > lastLba)
+        blba = lastLba;
+    ge->backup = (GptHeader*) label_edit_add_region(le, blba * sectorSize, sectorSize);
+    if (!ge->backup) {
+        rc = -errno;
+        goto fail;
+    }
+
+    if (gpt_header_check(ge->backup, sectorSize, blba, lastLba) == 0
+        && gpt_header_get_entries_size(ge->backup) == esz)
+        belba = le64_to_cpu(ge->backup->partitionEntryLba);
+    else {
+        /* broken backup, rebuild it from the primary header */
+        memset(ge->backup, 0, sectorSize);
+        memcpy(ge->backup, ge->primary, le32_to_cpu(ge->primary->size));
+        belba = blba - esects;
+        ge->backup->myLba = cpu_to_le64(blba);
+        ge->backup->alternativeLba = cpu_to_le64(GPT_PRIMARY_HEADER_LBA);
+        ge->backup->partitionEntryLba = cpu_to_le64(belba);
+    }
+
+    ge->backupEntries = label_edit_add_region(le, belba * sectorSize, esects * sectorSize);
+    if (!ge->backupEntries) {
+        rc = -errno;
+        goto fail;
+    }
+
+    return 0;
+fail:
+    gpt_edit_deinit(ge);
+    return rc;
+}
+
+void gpt_edit_deinit(GptEdit* ge)
+{
+    label_edit_deinit(&ge->edit);
+    ge->primary = ge->backup = NULL;
+    ge->primaryEntries = ge->backupEntries = NULL;
+}
+
+GptEntry* gpt_edit_get_entry(GptEdit* ge, uint32_t i)
+{
+    if (!ge->primaryEntries || i >= ge->nents)
+        return NULL;
+
+    return (GptEntry*) (ge->primaryEntries + (size_t) i * ge->entrySize);
+}
+
+void gpt_edit_update(GptEdit* ge)
+{
+    size_t esz = (size_t) ge->nents * ge->entrySize;
+    uint32_t crc;
+
+    /* identical bytes stay identical, so only the touched sectors get dirty */
+    memcpy(ge->backupEntries, ge->primaryEntries, esz);
+
+    crc = crc32_checksum(ge->primaryEntries, esz);
+    ge->primary->partitionEntryArrayCrc32 = cpu_to_le32(crc);
+    ge->backup->partitionEntryArrayCrc32 = cpu_to_le32(crc);
+
+    ge->primary->crc32 = 0;
+    ge->primary->crc32 = cpu_to_le32(crc32_checksum(ge->primary, le32_to_cpu(ge->primary->size)));
+    ge->backup->crc32 = 0;
+    ge->backup->crc32 = cpu_to_le32(crc32_checksum(ge->backup, le32_to_cpu(ge->backup->size)));
+}
+
+int gpt_edit_commit(GptEdit* ge)
+{
+    gpt_edit_update(ge);
+
+    return label_edit_commit(&ge->edit);
+}
@@ -0,0 +1,115 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_PARTITIONS_EDIT_H
+#define GRACEFUL_PARTITION_PARTITIONS_EDIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "partitions-gpt.h"
+
+typedef struct _GptEdit             GptEdit;
+typedef struct _LabelEdit           LabelEdit;
+typedef struct _LabelRegion         LabelRegion;
+typedef struct _LabelWriteRun       LabelWriteRun;
+
+/* a sector aligned area of the device loaded for editing */
+struct _LabelRegion
+{
+    uint64_t                        offset;             /* in bytes */
+    size_t                          size;
+    unsigned char*                  data;               /* edited copy */
+    unsigned char*                  orig;               /* as read from the device */
+    unsigned char*                  dirty;              /* one bit per sector */
+};
+
+/*
+ * In-memory edit model of the label sectors (MBR, EBRs, GPT headers and
+ * entry arrays). Callers modify the region buffers in place, commit writes
+ * back only the sectors whose content really changed.
+ */
+struct _LabelEdit
+{
+    int                             fd;
+    unsigned int                    sectorSize;
+
+    LabelRegion*                    regions;
+    size_t                          nregions;
+};
+
+/* one coalesced run of dirty sectors, as handed to pwritev() */
+struct _LabelWriteRun
+{
+    uint64_t                        offset;
+    size_t                          size;
+    const unsigned char*            data;
+    const unsigned char*            orig;               /* content on the device */
+};
+
+/* a GPT opened for editing: both headers and both entry arrays */
+struct _GptEdit
+{
+    LabelEdit                       edit;
+
+    GptHeader*                      primary;
+    GptHeader*                      backup;
+    unsigned char*                  primaryEntries;
+    unsigned char*                  backupEntries;
+
+    uint32_t                        nents;
+    uint32_t                        entrySize;
+};
+
+int label_edit_init(LabelEdit* le, int fd, unsigned int sectorSize);
+void label_edit_deinit(LabelEdit* le);
+
+/*
+ * Read @size bytes at @offset (both sector aligned) and return the buffer
+ * to edit. Regions must not overlap.
+ */
+unsigned char* label_edit_add_region(LabelEdit* le, uint64_t offset, size_t size);
+
+/* editable pointer to @len bytes at device offset @offset, NULL if not loaded */
+unsigned char* label_edit_get(LabelEdit* le, uint64_t offset, size_t len);
+
+/* compare the buffers with the device content, returns the number of dirty sectors */
+size_t label_edit_update_dirty(LabelEdit* le);
+
+/*
+ * Collect the dirty sectors as runs sorted by offset, adjacent dirty
+ * sectors of a region form one run. Returns the number of runs stored
+ * into *runs (caller frees) or -errno.
+ */
+int label_edit_get_runs(LabelEdit* le, LabelWriteRun** runs);
+
+/*
+ * Write the changed sectors, coalesced into as few pwritev() calls as
+ * possible, followed by a single fsync(). Returns 0 or -errno.
+ */
+int label_edit_commit(LabelEdit* le);
+
+/* forget all changes */
+void label_edit_rollback(LabelEdit* le);
+
+/*
+ * Load both GPT headers and entry arrays of @fd for editing. @lastLba is
+ * the last LBA of the device. The primary table has to be valid.
+ */
+int gpt_edit_init(GptEdit* ge, int fd, unsigned int sectorSize, uint64_t lastLba);
+void gpt_edit_deinit(GptEdit* ge);
+
+/* editable entry in the primary array */
+GptEntry* gpt_edit_get_entry(GptEdit* ge, uint32_t i);
+
+/*
+ * Mirror the changed primary entries into the backup array and recompute
+ * the entry array and header checksums of both headers.
+ */
+void gpt_edit_update(GptEdit* ge);
+
+/* gpt_edit_update() and label_edit_commit() */
+int gpt_edit_commit(GptEdit* ge);
+
+#endif //GRACEFUL_PARTITION_PARTITIONS_EDIT_H
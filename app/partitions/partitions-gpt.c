@@ -0,0 +1,297 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "partitions-gpt.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../common/crc32.h"
+#include "../common/bitops.h"
+#include "../common/blkcache.h"
+
+
+int gpt_header_check(const GptHeader* h, unsigned int sectorSize, uint64_t lba, uint64_t lastLba)
+{
+    uint32_t hsz;
+    uint64_t fu, lu;
+
+    if (le64_to_cpu(h->signature) != GPT_HEADER_SIGNATURE)
+        return -EINVAL;
+
+    hsz = le32_to_cpu(h->size);
+    if (hsz < GPT_HEADER_MIN_SIZE || hsz > sectorSize)
+        return -EINVAL;
+
+    if (crc32_exclude_offset(h, hsz, offsetof(GptHeader, crc32), sizeof(h->crc32)) != le32_to_cpu(h->crc32))
+        return -EBADMSG;
+
+    if (le64_to_cpu(h->myLba) != lba)
+        return -EINVAL;
+
+    fu = le64_to_cpu(h->firstUsableLba);
+    lu = le64_to_cpu(h->lastUsableLba);
+    if (fu > lu)
+        return -EINVAL;
+    if (lastLba && (lu > lastLba || le64_to_cpu(h->alternativeLba) > lastLba))
+        return -EINVAL;
+
+    if (!gpt_header_get_entries_size(h))
+        return -EINVAL;
+
+    return 0;
+}
+
+size_t gpt_header_get_entries_size(const GptHeader* h)
+{
+    uint32_t nents = le32_to_cpu(h->npartitionEntries);
+    uint32_t esz = le32_to_cpu(h->sizeofPartitionEntry);
+
+    if (!nents || nents > GPT_MAX_NPARTITIONS)
+        return 0;
+    if (esz < GPT_ENTRY_MIN_SIZE || esz > GPT_MAX_ENTRY_SIZE || (esz % 8))
+        return 0;
+
+    return (size_t) nents * esz;
+}
+
+size_t gpt_table_get_read_size(const GptHeader* h, unsigned int sectorSize)
+{
+    size_t esz = gpt_header_get_entries_size(h);
+    uint64_t lba = le64_to_cpu(h->partitionEntryLba);
+    uint64_t end;
+
+    if (!esz || lba > (UINT64_MAX - esz) / sectorSize)
+        return 0;
+
+    end = lba * sectorSize + esz;
+    /* round up to the sector size */
+    end = (end + sectorSize - 1) / sectorSize * sectorSize;
+    if (end > SIZE_MAX)
+        return 0;
+
+    return (size_t) end;
+}
+
+int gpt_table_parse(GptTable* t, const unsigned char* buf, size_t bufSize, unsigned int sectorSize, uint64_t lastLba)
+{
+    const GptHeader* h;
+    uint64_t elba;
+    size_t esz, need;
+    int rc;
+
+    memset(t, 0, sizeof(*t));
+
+    if (!sectorSize || bufSize < (size_t) sectorSize * 2)
+        return -ERANGE;
+
+    h = (const GptHeader*) (buf + sectorSize * GPT_PRIMARY_HEADER_LBA);
+    rc = gpt_header_check(h, sectorSize, GPT_PRIMARY_HEADER_LBA, lastLba);
+    if (rc)
+        return rc;
+
+    elba = le64_to_cpu(h->partitionEntryLba);
+    if (elba <= GPT_PRIMARY_HEADER_LBA || elba >= le64_to_cpu(h->firstUsableLba))
+        return -EINVAL;
+
+    need = gpt_table_get_read_size(h, sectorSize);
+    if (!need)
+        return -EINVAL;
+
+    t->buf = buf;
+    t->bufSize = bufSize;
+    t->sectorSize = sectorSize;
+    t->header = h;
+
+    if (bufSize < need)
+        return -ERANGE;
+
+    esz = gpt_header_get_entries_size(h);
+    if (crc32_checksum(buf + elba * sectorSize, esz) != le32_to_cpu(h->partitionEntryArrayCrc32))
+        return -EBADMSG;
+
+    t->entries = buf + elba * sectorSize;
+    t->nents = le32_to_cpu(h->npartitionEntries);
+    t->entrySize = le32_to_cpu(h->sizeofPartitionEntry);
+
+    return 0;
+}
+
+int gpt_table_read(GptTable* t, int fd, unsigned int sectorSize, uint64_t lastLba, unsigned char** buf)
+{
+    unsigned char* b = NULL;
+    size_t sz, need;
+    ssize_t ret;
+    int rc;
+
+    *buf = NULL;
+    if (!sectorSize)
+        return -EINVAL;
+
+    /* the header and the default sized entry array right behind it */
+    sz = (size_t) sectorSize * 2 + GPT_NPARTITIONS_DEFAULT * GPT_ENTRY_MIN_SIZE;
+    sz = (sz + sectorSize - 1) / sectorSize * sectorSize;
+
+    if (posix_memalign((void**) &b, sectorSize, sz))
+        return -ENOMEM;
+
+    ret = blkcache_pread(fd, b, sz, 0);
+    if (ret < 0) {
+        rc = -errno;
+        goto fail;
+    }
+    if ((size_t) ret < sz)
+        memset(b + ret, 0, sz - ret);
+
+    rc = gpt_table_parse(t, b, sz, sectorSize, lastLba);
+    if (rc == -ERANGE && t->header) {
+        /* the array is larger or further away than usual, read the rest */
+        unsigned char* nb = NULL;
+
+        need = gpt_table_get_read_size(t->header, sectorSize);
+        if (posix_memalign((void**) &nb, sectorSize, need)) {
+            rc = -ENOMEM;
+            goto fail;
+        }
+        memcpy(nb, b, sz);
+        free(b);
+        b = nb;
+
+        ret = blkcache_pread(fd, b + sz, need - sz, sz);
+        if (ret < 0 || (size_t) ret != need - sz) {
+            rc = ret < 0 ? -errno : -EIO;
+            goto fail;
+        }
+        sz = need;
+        rc = gpt_table_parse(t, b, sz, sectorSize, lastLba);
+    }
+    if (rc)
+        goto fail;
+
+    *buf = b;
+    return 0;
+fail:
+    memset(t, 0, sizeof(*t));
+    free(b);
+    return rc;
+}
+
+const GptEntry* gpt_table_get_entry(const GptTable* t, uint32_t i)
+{
+    if (!t->entries || i >= t->nents)
+        return NULL;
+
+    return (const GptEntry*) (t->entries + (size_t) i * t->entrySize);
+}
+
+uint32_t gpt_table_count_used(const GptTable* t)
+{
+    uint32_t i, n = 0;
+
+    for (i = 0; i < t->nents; i++) {
+        if (gpt_entry_is_used(gpt_table_get_entry(t, i)))
+            n++;
+    }
+    return n;
+}
+
+int gpt_entry_is_used(const GptEntry* e)
+{
+    return e && !gpt_guid_is_zero(&e->typeGuid);
+}
+
+uint64_t gpt_entry_get_start(const GptEntry* e)
+{
+    return le64_to_cpu(e->lbaStart);
+}
+
+uint64_t gpt_entry_get_end(const GptEntry* e)
+{
+    return le64_to_cpu(e->lbaEnd);
+}
+
+uint64_t gpt_entry_get_size(const GptEntry* e)
+{
+    uint64_t start = gpt_entry_get_start(e);
+    uint64_t end = gpt_entry_get_end(e);
+
+    return end >= start ? end - start + 1 : 0;
+}
+
+uint64_t gpt_entry_get_attrs(const GptEntry* e)
+{
+    return le64_to_cpu(e->attrs);
+}
+
+size_t gpt_entry_get_name(const GptEntry* e, char* buf, size_t bufSize)
+{
+    size_t i, len = 0;
+
+    if (!bufSize)
+        return 0;
+
+    for (i = 0; i < GPT_PART_NAME_LEN; i++) {
+        uint32_t c = le16_to_cpu(e->name[i]);
+        unsigned char u[4];
+        size_t n;
+
+        if (!c)
+            break;
+        if (c >= 0xD800 && c <= 0xDBFF && i + 1 < GPT_PART_NAME_LEN) {
+            uint32_t lo = le16_to_cpu(e->name[i + 1]);
+            if (lo >= 0xDC00 && lo <= 0xDFFF) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                i++;
+            }
+        }
+
+        if (c < 0x80) {
+            u[0] = c;
+            n = 1;
+        } else if (c < 0x800) {
+            u[0] = 0xC0 | (c >> 6);
+            u[1] = 0x80 | (c & 0x3F);
+            n = 2;
+        } else if (c < 0x10000) {
+            u[0] = 0xE0 | (c >> 12);
+            u[1] = 0x80 | ((c >> 6) & 0x3F);
+            u[2] = 0x80 | (c & 0x3F);
+            n = 3;
+        } else {
+            u[0] = 0xF0 | (c >> 18);
+            u[1] = 0x80 | ((c >> 12) & 0x3F);
+            u[2] = 0x80 | ((c >> 6) & 0x3F);
+            u[3] = 0x80 | (c & 0x3F);
+            n = 4;
+        }
+        if (len + n >= bufSize)
+            break;
+        memcpy(buf + len, u, n);
+        len += n;
+    }
+    buf[len] = '\0';
+
+    return len;
+}
+
+char* gpt_guid_to_string(const GptGuid* guid, char* buf)
+{
+    sprintf(buf, "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+            le32_to_cpu(guid->timeLow), le16_to_cpu(guid->timeMid),
+            le16_to_cpu(guid->timeHiAndVersion),
+            guid->clockSeqHi, guid->clockSeqLow,
+            guid->node[0], guid->node[1], guid->node[2],
+            guid->node[3], guid->node[4], guid->node[5]);
+    return buf;
+}
+
+int gpt_guid_is_zero(const GptGuid* guid)
+{
+    static const GptGuid zero;
+
+    return memcmp(guid, &zero, sizeof(zero)) == 0;
+}
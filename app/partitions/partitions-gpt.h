@@ -0,0 +1,139 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_PARTITIONS_GPT_H
+#define GRACEFUL_PARTITION_PARTITIONS_GPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define GPT_HEADER_SIGNATURE        0x5452415020494645ULL   /* "EFI PART" */
+#define GPT_HEADER_REVISION_V1_00   0x00010000
+#define GPT_HEADER_MIN_SIZE         92
+#define GPT_PRIMARY_HEADER_LBA      1
+#define GPT_ENTRY_MIN_SIZE          128
+#define GPT_NPARTITIONS_DEFAULT     128
+#define GPT_PART_NAME_LEN           (72 / sizeof(uint16_t))
+
+/* limits of the entry array we are willing to read */
+#define GPT_MAX_NPARTITIONS         4096
+#define GPT_MAX_ENTRY_SIZE          4096
+
+typedef struct _GptGuid             GptGuid;
+typedef struct _GptEntry            GptEntry;
+typedef struct _GptTable            GptTable;
+typedef struct _GptHeader           GptHeader;
+
+/*
+ * On-disk structures, all integers are little endian. GptHeader and
+ * GptEntry are never copied, GptTable hands out pointers into the buffer
+ * the table was parsed from.
+ */
+struct _GptGuid
+{
+    uint32_t                        timeLow;
+    uint16_t                        timeMid;
+    uint16_t                        timeHiAndVersion;
+    uint8_t                         clockSeqHi;
+    uint8_t                         clockSeqLow;
+    uint8_t                         node[6];
+} __attribute__ ((packed));
+
+struct _GptHeader
+{
+    uint64_t                        signature;          /* "EFI PART" */
+    uint32_t                        revision;
+    uint32_t                        size;               /* usually 92 bytes */
+    uint32_t                        crc32;              /* of this header with crc32 zeroed */
+    uint32_t                        reserved1;
+    uint64_t                        myLba;
+    uint64_t                        alternativeLba;
+    uint64_t                        firstUsableLba;
+    uint64_t                        lastUsableLba;
+    GptGuid                         diskGuid;
+    uint64_t                        partitionEntryLba;
+    uint32_t                        npartitionEntries;
+    uint32_t                        sizeofPartitionEntry;
+    uint32_t                        partitionEntryArrayCrc32;
+} __attribute__ ((packed));
+
+struct _GptEntry
+{
+    GptGuid                         typeGuid;
+    GptGuid                         partitionGuid;
+    uint64_t                        lbaStart;
+    uint64_t                        lbaEnd;
+    uint64_t                        attrs;
+    uint16_t                        name[GPT_PART_NAME_LEN];    /* UTF-16LE */
+} __attribute__ ((packed));
+
+struct _GptTable
+{
+    const unsigned char*            buf;                /* LBA 0 starts at buf[0] */
+    size_t                          bufSize;
+    unsigned int                    sectorSize;
+
+    const GptHeader*                header;             /* view into buf */
+    const unsigned char*            entries;            /* view into buf */
+    uint32_t                        nents;
+    uint32_t                        entrySize;
+};
+
+/*
+ * Validate the header at @lba of a buffer which holds the device from LBA 0.
+ * @lastLba is the last LBA of the device, or 0 if unknown.
+ *
+ * Returns 0 on success, -EINVAL for a broken header and -EBADMSG for
+ * a checksum mismatch.
+ */
+int gpt_header_check(const GptHeader* h, unsigned int sectorSize, uint64_t lba, uint64_t lastLba);
+
+/* size of the entry array described by @h in bytes, or 0 if it is insane */
+size_t gpt_header_get_entries_size(const GptHeader* h);
+
+/*
+ * Parse the primary table out of @buf (which starts at LBA 0). Nothing is
+ * copied, @t keeps pointers into @buf.
+ *
+ * Returns 0 on success, -EINVAL for a broken header, -EBADMSG for
+ * a checksum mismatch and -ERANGE if @buf does not hold the whole entry
+ * array; in that case gpt_table_get_read_size() tells how much to read.
+ */
+int gpt_table_parse(GptTable* t, const unsigned char* buf, size_t bufSize, unsigned int sectorSize, uint64_t lastLba);
+
+/* number of bytes from LBA 0 needed to parse the table headed by @h */
+size_t gpt_table_get_read_size(const GptHeader* h, unsigned int sectorSize);
+
+/*
+ * Read the primary table from @fd into a single buffer (*buf, caller frees)
+ * and parse it into @t.
+ */
+int gpt_table_read(GptTable* t, int fd, unsigned int sectorSize, uint64_t lastLba, unsigned char** buf);
+
+static inline uint32_t gpt_table_get_nents(const GptTable* t)
+{
+    return t->nents;
+}
+
+/* pointer to the @i-th entry inside the parsed buffer */
+const GptEntry* gpt_table_get_entry(const GptTable* t, uint32_t i);
+
+/* number of used entries */
+uint32_t gpt_table_count_used(const GptTable* t);
+
+int gpt_entry_is_used(const GptEntry* e);
+uint64_t gpt_entry_get_start(const GptEntry* e);
+uint64_t gpt_entry_get_end(const GptEntry* e);
+uint64_t gpt_entry_get_size(const GptEntry* e);
+uint64_t gpt_entry_get_attrs(const GptEntry* e);
+
+/* convert the UTF-16LE name to UTF-8 into @buf, returns its length */
+size_t gpt_entry_get_name(const GptEntry* e, char* buf, size_t bufSize);
+
+/* @buf must hold at least 37 bytes */
+char* gpt_guid_to_string(const GptGuid* guid, char* buf);
+int gpt_guid_is_zero(const GptGuid* guid);
+
+#endif //GRACEFUL_PARTITION_PARTITIONS_GPT_H
@@ -0,0 +1,314 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "partitions-journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../common/crc32.h"
+#include "../common/bitops.h"
+#include "../common/blkdev.h"
+#include "../common/all-io.h"
+#include "../common/bufpool.h"
+#include "../common/blkcache.h"
+
+static int journal_get_device(int devFd, uint64_t* devSize, uint64_t* devId);
+static int journal_sync_dir(const char* path);
+static int journal_load(const char* path, unsigned char** buf, size_t* size);
+
+static int journal_get_device(int devFd, uint64_t* devSize, uint64_t* devId)
+{
+    unsigned long long bytes = 0;
+    struct stat st;
+
+    if (fstat(devFd, &st) != 0)
+        return -errno;
+    if (blkdev_get_size(devFd, &bytes) != 0)
+        return -EIO;
+
+    *devSize = bytes;
+    *devId = S_ISBLK(st.st_mode) ? (uint64_t) st.st_rdev : (uint64_t) st.st_ino;
+
+    return 0;
+}
+
+/* a new or removed directory entry is only durable once the directory is synced */
+static int journal_sync_dir(const char* path)
+{
+    const char* p = strrchr(path, '/');
+    char* dir;
+    int fd, rc = 0;
+
+    if (!p)
+        dir = strdup(".");
+    else if (p == path)
+        dir = strdup("/");
+    else
+        dir = strndup(path, p - path);
+    if (!dir)
+        return -ENOMEM;
+
+    fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free(dir);
+    if (fd < 0)
+        return -errno;
+    if (fsync(fd) != 0)
+        rc = -errno;
+    close(fd);
+
+    return rc;
+}
+
+static int journal_load(const char* path, unsigned char** buf, size_t* size)
+{
+    struct stat st;
+    ssize_t ret;
+    int fd, rc = 0;
+
+    *buf = NULL;
+    *size = 0;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return errno == ENOENT ? 0 : -errno;
+
+    if (fstat(fd, &st) != 0) {
+        rc = -errno;
+        goto done;
+    }
+    if (st.st_size > LABEL_JOURNAL_MAX_SIZE) {
+        rc = -EFBIG;
+        goto done;
+    }
+    if (st.st_size == 0)
+        goto done;
+
+    *buf = malloc(st.st_size);
+    if (!*buf) {
+        rc = -ENOMEM;
+        goto done;
+    }
+    ret = read_all(fd, (char*) *buf, st.st_size);
+    if (ret < 0) {
+        rc = -errno;
+        free(*buf);
+        *buf = NULL;
+        goto done;
+    }
+    *size = ret;
+
+done:
+    close(fd);
+    return rc;
+}
+
+int label_journal_write(const char* path, int devFd, unsigned int sectorSize, const LabelWriteRun* runs, int nruns)
+{
+    LabelJournalHeader* hdr;
+    LabelJournalTrailer* tr;
+    unsigned char* buf, *p;
+    uint64_t devSize, devId;
+    size_t size;
+    uint32_t crc;
+    int i, fd, rc;
+
+    if (!path || nruns < 0 || !sectorSize)
+        return -EINVAL;
+
+    rc = journal_get_device(devFd, &devSize, &devId);
+    if (rc)
+        return rc;
+
+    size = sizeof(LabelJournalHeader) + sizeof(LabelJournalTrailer);
+    for (i = 0; i < nruns; i++) {
+        if (runs[i].size > UINT32_MAX)
+            return -E2BIG;
+        size += sizeof(LabelJournalRecord) + runs[i].size;
+    }
+    if (size > LABEL_JOURNAL_MAX_SIZE)
+        return -E2BIG;
+
+    /* built in memory and written at once, the journal is a few sectors */
+    buf = calloc(1, size);
+    if (!buf)
+        return -ENOMEM;
+
+    hdr = (LabelJournalHeader*) buf;
+    memcpy(hdr->magic, LABEL_JOURNAL_MAGIC, sizeof(hdr->magic));
+    hdr->version = cpu_to_le32(LABEL_JOURNAL_VERSION);
+    hdr->sectorSize = cpu_to_le32(sectorSize);
+    hdr->devSize = cpu_to_le64(devSize);
+    hdr->devId = cpu_to_le64(devId);
+    hdr->nrecords = cpu_to_le32((uint32_t) nruns);
+    hdr->crc32 = cpu_to_le32(crc32_checksum(hdr, sizeof(*hdr)));
+
+    p = buf + sizeof(LabelJournalHeader);
+    for (i = 0; i < nruns; i++) {
+        LabelJournalRecord* r = (LabelJournalRecord*) p;
+
+        r->offset = cpu_to_le64(runs[i].offset);
+        r->size = cpu_to_le32((uint32_t) runs[i].size);
+        r->crc32 = cpu_to_le32(crc32_checksum(runs[i].orig, runs[i].size));
+        memcpy(p + sizeof(*r), runs[i].orig, runs[i].size);
+        p += sizeof(*r) + runs[i].size;
+    }
+
+    crc = crc32_checksum(buf + sizeof(LabelJournalHeader), p - buf - sizeof(LabelJournalHeader));
+    tr = (LabelJournalTrailer*) p;
+    memcpy(tr->magic, LABEL_JOURNAL_END_MAGIC, sizeof(tr->magic));
+    tr->crc32 = cpu_to_le32(crc);
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        rc = -errno;
+        goto done;
+    }
+    rc = pwrite_all(fd, buf, size, 0) ? -errno : 0;
+    if (!rc && fsync(fd) != 0)
+        rc = -errno;
+    if (close(fd) != 0 && !rc)
+        rc = -errno;
+    if (!rc)
+        rc = journal_sync_dir(path);
+    if (rc)
+        unlink(path);
+
+done:
+    free(buf);
+    return rc;
+}
+
+int label_journal_discard(const char* path)
+{
+    if (unlink(path) != 0)
+        return errno == ENOENT ? 0 : -errno;
+
+    return journal_sync_dir(path);
+}
+
+int label_journal_replay(const char* path, int devFd)
+{
+    LabelJournalHeader* hdr;
+    LabelJournalTrailer* tr;
+    unsigned char* buf, *p, *end, *img;
+    uint64_t devSize, devId;
+    uint32_t crc, n, i;
+    size_t size;
+    int rc, ret;
+
+    rc = journal_load(path, &buf, &size);
+    if (rc || !buf)
+        return rc;
+
+    /* anything incomplete was torn before the device was touched */
+    if (size < sizeof(LabelJournalHeader) + sizeof(LabelJournalTrailer))
+        goto discard;
+
+    hdr = (LabelJournalHeader*) buf;
+    crc = le32_to_cpu(hdr->crc32);
+    hdr->crc32 = 0;
+    if (memcmp(hdr->magic, LABEL_JOURNAL_MAGIC, sizeof(hdr->magic)) != 0
+        || le32_to_cpu(hdr->version) != LABEL_JOURNAL_VERSION
+        || crc32_checksum(hdr, sizeof(*hdr)) != crc)
+        goto discard;
+
+    tr = (LabelJournalTrailer*) (buf + size - sizeof(LabelJournalTrailer));
+    if (memcmp(tr->magic, LABEL_JOURNAL_END_MAGIC, sizeof(tr->magic)) != 0
+        || crc32_checksum(buf + sizeof(*hdr), size - sizeof(*hdr) - sizeof(*tr)) != le32_to_cpu(tr->crc32))
+        goto discard;
+
+    rc = journal_get_device(devFd, &devSize, &devId);
+    if (rc)
+        goto done;
+    if (devSize != le64_to_cpu(hdr->devSize) || devId != le64_to_cpu(hdr->devId)) {
+        rc = -ENODEV;
+        goto done;
+    }
+
+    /* validate all records before the first byte goes to the device */
+    n = le32_to_cpu(hdr->nrecords);
+    end = (unsigned char*) tr;
+    for (i = 0, p = buf + sizeof(*hdr); i < n; i++) {
+        LabelJournalRecord* r = (LabelJournalRecord*) p;
+        uint32_t len;
+
+        if ((size_t) (end - p) < sizeof(*r))
+            break;
+        len = le32_to_cpu(r->size);
+        if ((size_t) (end - p) - sizeof(*r) < len
+            || le64_to_cpu(r->offset) + len > devSize
+            || crc32_checksum(p + sizeof(*r), len) != le32_to_cpu(r->crc32))
+            break;
+        p += sizeof(*r) + len;
+    }
+    if (i != n || p != end) {
+        rc = -EBADMSG;
+        goto done;
+    }
+
+    /* the pre-images sit behind 16 byte records, an O_DIRECT @devFd wants them aligned */
+    for (i = 0, p = buf + sizeof(*hdr); i < n; i++) {
+        LabelJournalRecord* r = (LabelJournalRecord*) p;
+        uint32_t len = le32_to_cpu(r->size);
+
+        img = bufpool_get(len);
+        if (!img) {
+            rc = -ENOMEM;
+            goto done;
+        }
+        memcpy(img, p + sizeof(*r), len);
+        rc = pwrite_all(devFd, img, len, (off_t) le64_to_cpu(r->offset)) ? -errno : 0;
+        bufpool_put(img, len);
+        if (rc)
+            goto done;
+        blkcache_invalidate(devFd, le64_to_cpu(r->offset), len);
+        p += sizeof(*r) + len;
+    }
+    if (fsync(devFd) != 0) {
+        rc = -errno;
+        goto done;
+    }
+    rc = 1;
+
+discard:
+    /* a journal which could not be applied is kept above, the next replay retries */
+    ret = label_journal_discard(path);
+    if (ret)
+        rc = ret;
+done:
+    free(buf);
+    return rc;
+}
+
+int label_edit_commit_journaled(LabelEdit* le, const char* path)
+{
+    LabelWriteRun* runs;
+    int n, rc;
+
+    n = label_edit_get_runs(le, &runs);
+    if (n <= 0)
+        return n;
+
+    rc = label_journal_write(path, le->fd, le->sectorSize, runs, n);
+    free(runs);
+    if (rc)
+        return rc;
+
+    rc = label_edit_commit(le);
+    if (rc) {
+        /*
+         * Maybe half written, put the old sectors back while we still can.
+         * The edits stay in the buffers, so the caller may retry.
+         */
+        label_journal_replay(path, le->fd);
+        return rc;
+    }
+
+    return label_journal_discard(path);
+}
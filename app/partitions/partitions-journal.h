@@ -0,0 +1,81 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_PARTITIONS_JOURNAL_H
+#define GRACEFUL_PARTITION_PARTITIONS_JOURNAL_H
+
+#include <stdint.h>
+
+#include "partitions-edit.h"
+
+#define LABEL_JOURNAL_MAGIC         "GPUNDO01"
+#define LABEL_JOURNAL_END_MAGIC     "GPUNDOOK"
+#define LABEL_JOURNAL_VERSION       1
+
+/* refuse to load anything bigger, a label journal is a few sectors */
+#define LABEL_JOURNAL_MAX_SIZE      (64 * 1024 * 1024)
+
+typedef struct _LabelJournalHeader  LabelJournalHeader;
+typedef struct _LabelJournalRecord  LabelJournalRecord;
+typedef struct _LabelJournalTrailer LabelJournalTrailer;
+
+/*
+ * Undo journal layout, all little endian:
+ *
+ *   header | record, pre-image | record, pre-image | ... | trailer
+ *
+ * The trailer is written last, a journal without a valid trailer was torn
+ * before the in-place write started and is simply dropped on replay.
+ */
+struct _LabelJournalHeader
+{
+    char                            magic[8];
+    uint32_t                        version;
+    uint32_t                        sectorSize;
+    uint64_t                        devSize;            /* in bytes */
+    uint64_t                        devId;              /* st_rdev or st_ino */
+    uint32_t                        nrecords;
+    uint32_t                        crc32;              /* of the header, this field zeroed */
+} __attribute__ ((packed));
+
+struct _LabelJournalRecord
+{
+    uint64_t                        offset;             /* in bytes */
+    uint32_t                        size;
+    uint32_t                        crc32;              /* of the pre-image */
+} __attribute__ ((packed));
+
+struct _LabelJournalTrailer
+{
+    char                            magic[8];
+    uint32_t                        crc32;              /* of all records and pre-images */
+    uint32_t                        reserved;
+} __attribute__ ((packed));
+
+/*
+ * Save the current device content under @runs to @path and make it durable
+ * (file and directory fsync) before anything is written to @devFd.
+ * Returns 0 or -errno.
+ */
+int label_journal_write(const char* path, int devFd, unsigned int sectorSize, const LabelWriteRun* runs, int nruns);
+
+/*
+ * Recover after a crash: if @path holds a complete journal for @devFd, write
+ * the pre-images back, fsync and remove the journal. Returns 1 if the device
+ * was rolled back, 0 if there was nothing to do (no or torn journal), -ENODEV
+ * if the journal belongs to another device or -errno.
+ */
+int label_journal_replay(const char* path, int devFd);
+
+/* remove the journal durably, the commit is final afterwards */
+int label_journal_discard(const char* path);
+
+/*
+ * label_edit_commit() protected by an undo journal at @path: either all
+ * changed sectors reach the device or, after label_journal_replay(), none.
+ * A failed in-place write is rolled back right away.
+ */
+int label_edit_commit_journaled(LabelEdit* le, const char* path);
+
+#endif //GRACEFUL_PARTITION_PARTITIONS_JOURNAL_H
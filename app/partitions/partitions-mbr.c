@@ -4,13 +4,15 @@
 
 #include "partitions-mbr.h"
 
+#include <stddef.h>
+
 static inline uint32_t __dos_assemble_4le(const unsigned char *p);
 static inline void __dos_store_4le(unsigned char *p, unsigned int val);
 
-struct dos_partition *mbr_get_partition(unsigned char *mbr, int i)
+DosPartition* mbr_get_partition(unsigned char *mbr, int i)
 {
-    return (struct dos_partition *)
-            (mbr + MBR_PT_OFFSET + (i * sizeof(struct dos_partition)));
+    return (DosPartition*)
+            (mbr + MBR_PT_OFFSET + (i * sizeof(DosPartition)));
 }
 
 /* assemble badly aligned little endian integer */
@@ -32,22 +34,22 @@ static inline void __dos_store_4le(unsigned char *p, unsigned int val)
 
 unsigned int dos_partition_get_start(DosPartition* p)
 {
-    return __dos_assemble_4le(&(p->start_sect[0]));
+    return __dos_assemble_4le(&(p->startSect[0]));
 }
 
 void dos_partition_set_start(DosPartition* p, unsigned int n)
 {
-    __dos_store_4le(p->start_sect, n);
+    __dos_store_4le(p->startSect, n);
 }
 
 unsigned int dos_partition_get_size(DosPartition* p)
 {
-    return __dos_assemble_4le(&(p->nr_sects[0]));
+    return __dos_assemble_4le(&(p->nrSects[0]));
 }
 
 void dos_partition_set_size(DosPartition* p, unsigned int n)
 {
-    __dos_store_4le(p->nr_sects, n);
+    __dos_store_4le(p->nrSects, n);
 }
 
 void dos_partition_sync_chs(DosPartition* p, unsigned long long int part_offset, unsigned int geom_sectors, unsigned int geom_heads)
@@ -0,0 +1,482 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "partitions-move.h"
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "../common/crc32.h"
+#include "../common/bitops.h"
+#include "../common/blkdev.h"
+#include "../common/all-io.h"
+#include "../common/bufpool.h"
+
+typedef struct _PartMoveJob         PartMoveJob;
+typedef struct _PartMoveSlot        PartMoveSlot;
+
+struct _PartMoveSlot
+{
+    unsigned char*                  buf;
+    uint64_t                        pos;                /* in copy direction, see PartMoveCheckpoint */
+    unsigned int                    len;
+    int                             rc;
+    int                             full;               /* read, waiting for the writer */
+};
+
+struct _PartMoveJob
+{
+    int                             fd;
+    uint64_t                        src;
+    uint64_t                        dst;
+    uint64_t                        length;
+    uint64_t                        shift;              /* distance between source and destination */
+    unsigned int                    chunk;
+    uint64_t                        start;              /* taken over from the checkpoint */
+
+    PartMoveSlot                    slots[PART_MOVE_MAX_BUFFERS];
+    unsigned int                    nslots;
+    pthread_mutex_t                 lock;
+    pthread_cond_t                  cond;
+    int                             stop;
+
+    int                             cpFd;               /* -1 without checkpoint */
+    uint64_t                        cpBytes;
+    uint64_t                        devSize;
+    uint64_t                        devId;
+    uint64_t                        seq;
+    uint64_t                        durable;            /* recorded and flushed */
+
+    PartMoveProgress                p;
+};
+
+static double part_move_now(void);
+static void part_move_deadline(struct timespec* ts, unsigned int ms);
+static int part_move_sync_dir(const char* path);
+static int part_move_load(int fd, PartMoveCheckpoint* cp);
+static int part_move_save(PartMoveJob* job, uint64_t done);
+static int part_move_checkpoint_open(PartMoveJob* job, const char* path);
+static uint64_t part_move_offset(const PartMoveJob* job, uint64_t pos, unsigned int len);
+static int part_move_pio(int fd, int write, unsigned char* buf, size_t len, uint64_t offset);
+static int part_move_write(PartMoveJob* job, const PartMoveSlot* slot);
+static void* part_move_reader(void* arg);
+static void part_move_progress(PartMoveJob* job, double start);
+
+int part_move_run(const char* path, const PartMove* opts, PartMoveProgress* result)
+{
+    unsigned int i, ms, align;
+    pthread_condattr_t attr;
+    struct timespec next;
+    BlkdevTopology tp;
+    pthread_t reader;
+    PartMoveJob job;
+    struct stat st;
+    uint64_t pos;
+    double start;
+    int rc, err;
+
+    memset(&job, 0, sizeof(job));
+    job.cpFd = -1;
+    job.src = opts->src;
+    job.dst = opts->dst;
+    job.length = opts->length;
+    job.p.total = opts->length;
+    job.p.backward = opts->dst > opts->src;
+    job.shift = job.p.backward ? opts->dst - opts->src : opts->src - opts->dst;
+    if (!job.length || !job.shift)
+        return 0;
+
+    job.fd = blkdev_open_direct(path, O_RDWR | O_CLOEXEC, &job.p.direct);
+    if (job.fd < 0)
+        return job.fd;
+
+    if (fstat(job.fd, &st) != 0) {
+        rc = -errno;
+        goto out;
+    }
+    rc = blkdev_get_topology(job.fd, &tp);
+    if (rc)
+        goto out;
+    job.devSize = tp.size;
+    job.devId = S_ISBLK(st.st_mode) ? (uint64_t) st.st_rdev : (uint64_t) st.st_ino;
+
+    align = tp.logicalSectorSize;
+    if (job.p.direct && tp.dioOffsetAlign > align)
+        align = tp.dioOffsetAlign;
+    if (job.src % align || job.dst % align || job.length % align
+        || job.src + job.length > tp.size || job.dst + job.length > tp.size
+        || job.src + job.length < job.src || job.dst + job.length < job.dst) {
+        rc = -EINVAL;
+        goto out;
+    }
+
+    /* a chunk never reaches into its own source, see part_move_write() */
+    job.chunk = opts->chunkSize ? opts->chunkSize : PART_MOVE_CHUNK_SIZE;
+    if (job.chunk > job.shift)
+        job.chunk = (unsigned int) job.shift;
+    job.chunk -= job.chunk % align;
+    if (!job.chunk)
+        job.chunk = align;
+    job.p.chunkSize = job.chunk;
+
+    if (opts->checkpoint) {
+        job.cpBytes = opts->checkpointBytes ? opts->checkpointBytes : PART_MOVE_CHECKPOINT_BYTES;
+        rc = part_move_checkpoint_open(&job, opts->checkpoint);
+        if (rc)
+            goto out;
+        job.p.resumed = job.p.done = job.start;
+    }
+
+    job.nslots = opts->nbuffers ? opts->nbuffers : PART_MOVE_BUFFERS;
+    if (job.nslots > PART_MOVE_MAX_BUFFERS)
+        job.nslots = PART_MOVE_MAX_BUFFERS;
+    for (i = 0; i < job.nslots; i++) {
+        job.slots[i].buf = bufpool_get(job.chunk);
+        if (!job.slots[i].buf) {
+            rc = -ENOMEM;
+            goto out;
+        }
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&job.cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    err = pthread_create(&reader, NULL, part_move_reader, &job);
+    if (err) {
+        rc = -err;
+        goto destroy;
+    }
+
+    start = part_move_now();
+    ms = opts->intervalMs ? opts->intervalMs : PART_MOVE_INTERVAL_MS;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    part_move_deadline(&next, ms);
+    for (pos = job.start, i = 0; pos < job.length && !rc; i = (i + 1) % job.nslots) {
+        PartMoveSlot* slot = &job.slots[i];
+
+        pthread_mutex_lock(&job.lock);
+        while (!slot->full) {
+            if (pthread_cond_timedwait(&job.cond, &job.lock, &next) == ETIMEDOUT) {
+                part_move_deadline(&next, ms);
+                if (opts->func) {
+                    pthread_mutex_unlock(&job.lock);
+                    part_move_progress(&job, start);
+                    opts->func(&job.p, opts->data);
+                    pthread_mutex_lock(&job.lock);
+                }
+            }
+        }
+        pthread_mutex_unlock(&job.lock);
+
+        rc = slot->rc ? slot->rc : part_move_write(&job, slot);
+        if (!rc)
+            job.p.done += slot->len;
+        pos += slot->len;
+
+        pthread_mutex_lock(&job.lock);
+        slot->full = 0;
+        pthread_cond_broadcast(&job.cond);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    pthread_mutex_lock(&job.lock);
+    job.stop = 1;
+    pthread_cond_broadcast(&job.cond);
+    pthread_mutex_unlock(&job.lock);
+    pthread_join(reader, NULL);
+
+    if (!rc && fdatasync(job.fd) != 0)
+        rc = -errno;
+    if (!rc && job.cpFd >= 0) {
+        close(job.cpFd);
+        job.cpFd = -1;
+        if (unlink(opts->checkpoint) != 0)
+            rc = -errno;
+        else
+            rc = part_move_sync_dir(opts->checkpoint);
+    }
+
+    part_move_progress(&job, start);
+    if (opts->func)
+        opts->func(&job.p, opts->data);
+    if (result)
+        *result = job.p;
+
+destroy:
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.lock);
+
+out:
+    for (i = 0; i < job.nslots; i++) {
+        if (job.slots[i].buf)
+            bufpool_put(job.slots[i].buf, job.chunk);
+    }
+    if (job.cpFd >= 0)
+        close(job.cpFd);
+    close(job.fd);
+
+    return rc;
+}
+
+int part_move_checkpoint_read(const char* path, PartMoveCheckpoint* cp)
+{
+    int fd, rc;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return errno == ENOENT ? 0 : -errno;
+    rc = part_move_load(fd, cp);
+    close(fd);
+
+    return rc;
+}
+
+static double part_move_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void part_move_deadline(struct timespec* ts, unsigned int ms)
+{
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long) (ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+/* a new or removed directory entry is only durable once the directory is synced */
+static int part_move_sync_dir(const char* path)
+{
+    const char* p = strrchr(path, '/');
+    char* dir;
+    int fd, rc = 0;
+
+    if (!p)
+        dir = strdup(".");
+    else if (p == path)
+        dir = strdup("/");
+    else
+        dir = strndup(path, p - path);
+    if (!dir)
+        return -ENOMEM;
+
+    fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free(dir);
+    if (fd < 0)
+        return -errno;
+    if (fsync(fd) != 0)
+        rc = -errno;
+    close(fd);
+
+    return rc;
+}
+
+/* the valid slot with the higher sequence number, in CPU byte order */
+static int part_move_load(int fd, PartMoveCheckpoint* cp)
+{
+    unsigned char buf[2 * PART_MOVE_SLOT_SIZE];
+    PartMoveCheckpoint r;
+    ssize_t ret;
+    uint32_t crc;
+    int i, found = 0;
+
+    ret = pread(fd, buf, sizeof(buf), 0);
+    if (ret < 0)
+        return -errno;
+
+    for (i = 0; i < 2; i++) {
+        if ((size_t) ret < i * PART_MOVE_SLOT_SIZE + sizeof(r))
+            break;
+        memcpy(&r, buf + i * PART_MOVE_SLOT_SIZE, sizeof(r));
+        crc = le32_to_cpu(r.crc32);
+        r.crc32 = 0;
+        if (memcmp(r.magic, PART_MOVE_MAGIC, sizeof(r.magic)) != 0
+            || le32_to_cpu(r.version) != PART_MOVE_VERSION
+            || crc32_checksum(&r, sizeof(r)) != crc)
+            continue;
+        if (found && le64_to_cpu(r.seq) <= cp->seq)
+            continue;
+
+        memcpy(cp->magic, r.magic, sizeof(cp->magic));
+        cp->version = PART_MOVE_VERSION;
+        cp->reserved = 0;
+        cp->devSize = le64_to_cpu(r.devSize);
+        cp->devId = le64_to_cpu(r.devId);
+        cp->src = le64_to_cpu(r.src);
+        cp->dst = le64_to_cpu(r.dst);
+        cp->length = le64_to_cpu(r.length);
+        cp->done = le64_to_cpu(r.done);
+        cp->seq = le64_to_cpu(r.seq);
+        cp->crc32 = crc;
+        found = 1;
+    }
+
+    return found;
+}
+
+/* one slot, flushed; the other still holds the previous record */
+static int part_move_save(PartMoveJob* job, uint64_t done)
+{
+    unsigned char buf[PART_MOVE_SLOT_SIZE];
+    PartMoveCheckpoint* r = (PartMoveCheckpoint*) buf;
+    ssize_t ret;
+
+    memset(buf, 0, sizeof(buf));
+    memcpy(r->magic, PART_MOVE_MAGIC, sizeof(r->magic));
+    r->version = cpu_to_le32(PART_MOVE_VERSION);
+    r->devSize = cpu_to_le64(job->devSize);
+    r->devId = cpu_to_le64(job->devId);
+    r->src = cpu_to_le64(job->src);
+    r->dst = cpu_to_le64(job->dst);
+    r->length = cpu_to_le64(job->length);
+    r->done = cpu_to_le64(done);
+    r->seq = cpu_to_le64(++job->seq);
+    r->crc32 = cpu_to_le32(crc32_checksum(r, sizeof(*r)));
+
+    ret = pwrite(job->cpFd, buf, sizeof(buf), (off_t) ((job->seq & 1) * PART_MOVE_SLOT_SIZE));
+    if (ret != (ssize_t) sizeof(buf))
+        return ret < 0 ? -errno : -EIO;
+    if (fdatasync(job->cpFd) != 0)
+        return -errno;
+
+    job->durable = done;
+    job->p.checkpoints++;
+
+    return 0;
+}
+
+static int part_move_checkpoint_open(PartMoveJob* job, const char* path)
+{
+    PartMoveCheckpoint cp;
+    int rc;
+
+    job->cpFd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (job->cpFd < 0)
+        return -errno;
+
+    rc = part_move_load(job->cpFd, &cp);
+    if (rc < 0)
+        return rc;
+    if (rc) {
+        if (cp.devSize != job->devSize || cp.devId != job->devId)
+            return -ENODEV;
+        if (cp.src != job->src || cp.dst != job->dst || cp.length != job->length)
+            return -ESTALE;
+        if (cp.done > job->length)
+            return -EBADMSG;
+        job->seq = cp.seq;
+        job->start = job->durable = cp.done;
+        return 0;
+    }
+
+    /* nothing valid in there, so nothing was written yet either */
+    rc = part_move_save(job, 0);
+    if (!rc && fsync(job->cpFd) != 0)
+        rc = -errno;
+    if (!rc)
+        rc = part_move_sync_dir(path);
+    job->p.checkpoints = 0;
+
+    return rc;
+}
+
+/* device offset relative to source and destination of the chunk at @pos */
+static uint64_t part_move_offset(const PartMoveJob* job, uint64_t pos, unsigned int len)
+{
+    return job->p.backward ? job->length - pos - len : pos;
+}
+
+/* whole request or -errno, a short transfer inside the device is an I/O error */
+static int part_move_pio(int fd, int write, unsigned char* buf, size_t len, uint64_t offset)
+{
+    ssize_t ret;
+
+    if (write)
+        return pwrite_all(fd, buf, len, (off_t) offset) ? -errno : 0;
+
+    ret = pread_all(fd, buf, len, (off_t) offset);
+    if (ret < 0)
+        return -errno;
+
+    return (size_t) ret < len ? -EIO : 0;
+}
+
+/*
+ * Writing [pos, pos + len) in copy direction destroys the source of
+ * [pos - shift, pos + len - shift). Since a chunk is no longer than the
+ * shift that is always behind @pos, i.e. already copied, but after a crash
+ * it would be copied again from the overwritten source unless it is on
+ * record first. So the device is flushed and @pos recorded whenever the
+ * write reaches past what is recorded, or every job->cpBytes.
+ */
+static int part_move_write(PartMoveJob* job, const PartMoveSlot* slot)
+{
+    uint64_t end = slot->pos + slot->len;
+    int rc;
+
+    if (job->cpFd >= 0 && slot->pos > job->durable
+        && (end > job->durable + job->shift || slot->pos - job->durable >= job->cpBytes)) {
+        if (fdatasync(job->fd) != 0)
+            return -errno;
+        rc = part_move_save(job, slot->pos);
+        if (rc)
+            return rc;
+    }
+
+    return part_move_pio(job->fd, 1, slot->buf, slot->len, job->dst + part_move_offset(job, slot->pos, slot->len));
+}
+
+static void* part_move_reader(void* arg)
+{
+    PartMoveJob* job = arg;
+    unsigned int i, len;
+    uint64_t pos;
+    int stop;
+
+    for (pos = job->start, i = 0; pos < job->length; pos += len, i = (i + 1) % job->nslots) {
+        PartMoveSlot* slot = &job->slots[i];
+
+        pthread_mutex_lock(&job->lock);
+        while (slot->full && !job->stop)
+            pthread_cond_wait(&job->cond, &job->lock);
+        stop = job->stop;
+        pthread_mutex_unlock(&job->lock);
+        if (stop)
+            break;
+
+        len = job->length - pos < job->chunk ? (unsigned int) (job->length - pos) : job->chunk;
+        slot->pos = pos;
+        slot->len = len;
+        slot->rc = part_move_pio(job->fd, 0, slot->buf, len, job->src + part_move_offset(job, pos, len));
+
+        pthread_mutex_lock(&job->lock);
+        slot->full = 1;
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+        if (slot->rc)
+            break;
+    }
+
+    return NULL;
+}
+
+static void part_move_progress(PartMoveJob* job, double start)
+{
+    job->p.seconds = part_move_now() - start;
+    job->p.bytesPerSec = job->p.seconds > 0 ? (job->p.done - job->p.resumed) / job->p.seconds : 0;
+}
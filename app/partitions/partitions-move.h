@@ -0,0 +1,106 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_PARTITIONS_MOVE_H
+#define GRACEFUL_PARTITION_PARTITIONS_MOVE_H
+
+#include <stdint.h>
+
+#define PART_MOVE_MAGIC             "GPMOVE01"
+#define PART_MOVE_VERSION           1
+
+/* two copies of the record alternate, a torn write leaves the other one */
+#define PART_MOVE_SLOT_SIZE         512
+
+/* defaults if the caller leaves them 0 */
+#define PART_MOVE_CHUNK_SIZE        (8 * 1024 * 1024)
+#define PART_MOVE_BUFFERS           2
+#define PART_MOVE_CHECKPOINT_BYTES  (1024ULL * 1024 * 1024)
+#define PART_MOVE_INTERVAL_MS       1000
+
+#define PART_MOVE_MAX_BUFFERS       16
+
+typedef struct _PartMove            PartMove;
+typedef struct _PartMoveProgress    PartMoveProgress;
+typedef struct _PartMoveCheckpoint  PartMoveCheckpoint;
+
+/*
+ * Checkpoint record, little endian. @done counts bytes in copy direction:
+ * from the start of the range when moving down, from its end when moving
+ * up. Everything before @done is on the device, everything after it still
+ * holds the original data at the source.
+ */
+struct _PartMoveCheckpoint
+{
+    char                            magic[8];
+    uint32_t                        version;
+    uint32_t                        reserved;
+    uint64_t                        devSize;            /* in bytes */
+    uint64_t                        devId;              /* st_rdev or st_ino */
+    uint64_t                        src;
+    uint64_t                        dst;
+    uint64_t                        length;
+    uint64_t                        done;
+    uint64_t                        seq;                /* the higher valid one wins */
+    uint32_t                        crc32;              /* of the record, this field zeroed */
+} __attribute__ ((packed));
+
+struct _PartMoveProgress
+{
+    uint64_t                        done;               /* bytes, including @resumed */
+    uint64_t                        total;
+    uint64_t                        resumed;            /* taken over from the checkpoint */
+    double                          seconds;
+    double                          bytesPerSec;        /* of this run */
+    unsigned int                    chunkSize;          /* after clamping to the shift */
+    uint64_t                        checkpoints;        /* records written */
+    int                             backward;           /* copied from the end down */
+    int                             direct;             /* O_DIRECT was used */
+};
+
+typedef void (*PartMoveProgressFunc) (const PartMoveProgress* p, void* data);
+
+struct _PartMove
+{
+    uint64_t                        src;                /* bytes, sector aligned */
+    uint64_t                        dst;
+    uint64_t                        length;
+
+    unsigned int                    chunkSize;          /* bytes per request */
+    unsigned int                    nbuffers;           /* chunks in flight between reader and writer */
+
+    const char*                     checkpoint;         /* file, NULL = not resumable */
+    uint64_t                        checkpointBytes;    /* at most this much is redone after a crash */
+
+    PartMoveProgressFunc            func;               /* may be NULL */
+    void*                           data;
+    unsigned int                    intervalMs;
+};
+
+/*
+ * Move @opts->length bytes inside @path (block device or image file) from
+ * @opts->src to @opts->dst. Overlapping ranges are copied front to back
+ * when moving down and back to front when moving up, so no byte is
+ * overwritten before it was read. A reader thread keeps @opts->nbuffers
+ * chunks ahead of the writing caller, with O_DIRECT if the device takes it.
+ *
+ * With @opts->checkpoint the progress is recorded there, and a later call
+ * with the same arguments continues where the record says. Before a write
+ * would overwrite source data of the range that was copied but is not yet
+ * recorded, the device is flushed and the record updated; a short shift
+ * therefore means small chunks (never more than the shift) and frequent
+ * flushes, a long one a record every @opts->checkpointBytes. The file is
+ * removed once the move is complete.
+ *
+ * @opts->func is called every @opts->intervalMs and once at the end, the
+ * final numbers are stored in @result (may be NULL). Returns 0 or -errno,
+ * -ENODEV if the checkpoint belongs to another device and -ESTALE if it
+ * records a different move.
+ */
+int part_move_run(const char* path, const PartMove* opts, PartMoveProgress* result);
+
+/* read the newer valid record of @path into @cp, 1 if there is one, 0 if not, -errno */
+int part_move_checkpoint_read(const char* path, PartMoveCheckpoint* cp);
+
+#endif //GRACEFUL_PARTITION_PARTITIONS_MOVE_H
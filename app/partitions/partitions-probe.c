@@ -0,0 +1,333 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "partitions-probe.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "partitions-mbr.h"
+#include "partitions-gpt.h"
+#include "../common/crc32.h"
+#include "../common/bitops.h"
+#include "../common/blkcache.h"
+#include "../common/bufpool.h"
+
+typedef struct _ProbeLabel          ProbeLabel;
+
+struct _ProbeLabel
+{
+    ProbeLabelType                  type;
+    const char*                     name;
+    int                           (*probe) (ProbeCxt* pr);
+};
+
+static int probe_mbr(ProbeCxt* pr);
+static int probe_pmbr(ProbeCxt* pr);
+static int probe_gpt(ProbeCxt* pr);
+static int probe_bsd(ProbeCxt* pr);
+static int probe_gpt_backup(ProbeCxt* pr);
+static int probe_mbr_is_fat_boot(const unsigned char* b);
+static int probe_bsd_label_at(ProbeCxt* pr, uint64_t off);
+
+static const ProbeLabel probeLabels[] = {
+    { PROBE_LABEL_GPT,  "gpt",  probe_gpt  },
+    { PROBE_LABEL_PMBR, "pmbr", probe_pmbr },
+    { PROBE_LABEL_BSD,  "bsd",  probe_bsd  },
+    { PROBE_LABEL_MBR,  "dos",  probe_mbr  },
+};
+
+#define PROBE_NLABELS               (sizeof(probeLabels) / sizeof(probeLabels[0]))
+
+int probe_init_layout(ProbeCxt* pr, int fd, uint64_t size, unsigned int sectorSize)
+{
+    size_t bufSize;
+
+    memset(pr, 0, sizeof(*pr));
+    if (!sectorSize)
+        return -EINVAL;
+
+    if (!size) {
+        off_t end = lseek(fd, 0, SEEK_END);
+        if (end < 0)
+            return -errno;
+        size = (uint64_t) end;
+    }
+
+    pr->fd = fd;
+    pr->size = size;
+    pr->sectorSize = sectorSize;
+
+    pr->headSize = size < PROBE_HEAD_SIZE ? (size_t) size : PROBE_HEAD_SIZE;
+    if (size > pr->headSize) {
+        pr->tailOffset = size > PROBE_TAIL_SIZE ? size - PROBE_TAIL_SIZE : 0;
+        pr->tailOffset -= pr->tailOffset % sectorSize;
+        if (pr->tailOffset < pr->headSize)
+            pr->tailOffset = pr->headSize;
+        pr->tailSize = (size_t) (size - pr->tailOffset);
+    }
+
+    bufSize = pr->headSize + pr->tailSize;
+    if (!bufSize)
+        return -EINVAL;
+    /* one per scanned image, the pool saves the 2M malloc and page faults each time */
+    pr->buf = bufpool_get(bufSize);
+    if (!pr->buf)
+        return -ENOMEM;
+
+    return 0;
+}
+
+int probe_init(ProbeCxt* pr, int fd, uint64_t size, unsigned int sectorSize)
+{
+    ssize_t ret;
+    int rc;
+
+    rc = probe_init_layout(pr, fd, size, sectorSize);
+    if (rc < 0)
+        return rc;
+
+    ret = blkcache_pread(fd, pr->buf, pr->headSize, 0);
+    if (ret < 0 || (size_t) ret != pr->headSize)
+        goto fail;
+
+    if (pr->tailSize) {
+        ret = blkcache_pread(fd, pr->buf + pr->headSize, pr->tailSize, pr->tailOffset);
+        if (ret < 0 || (size_t) ret != pr->tailSize)
+            goto fail;
+    }
+    return 0;
+
+fail:
+    ret = ret < 0 ? -errno : -EIO;
+    probe_deinit(pr);
+    return (int) ret;
+}
+
+void probe_deinit(ProbeCxt* pr)
+{
+    bufpool_put(pr->buf, pr->headSize + pr->tailSize);
+    pr->buf = NULL;
+    pr->headSize = pr->tailSize = 0;
+}
+
+const unsigned char* probe_get_buffer(ProbeCxt* pr, uint64_t off, size_t len)
+{
+    if (!pr->buf || off > UINT64_MAX - len)
+        return NULL;
+
+    if (off + len <= pr->headSize)
+        return pr->buf + off;
+
+    if (pr->tailSize && off >= pr->tailOffset && off + len <= pr->tailOffset + pr->tailSize)
+        return pr->buf + pr->headSize + (off - pr->tailOffset);
+
+    return NULL;
+}
+
+/* FAT and NTFS boot sectors carry the 0x55AA magic too */
+static int probe_mbr_is_fat_boot(const unsigned char* b)
+{
+    return memcmp(b + 3, "NTFS    ", 8) == 0
+           || memcmp(b + 3, "EXFAT   ", 8) == 0
+           || memcmp(b + 0x36, "FAT", 3) == 0
+           || memcmp(b + 0x52, "FAT32", 5) == 0;
+}
+
+static int probe_mbr(ProbeCxt* pr)
+{
+    unsigned char* mbr = (unsigned char*) probe_get_buffer(pr, 0, 512);
+    uint64_t nsectors = pr->size / pr->sectorSize;
+    int i, used = 0;
+
+    if (!mbr || !mbr_is_valid_magic(mbr))
+        return 0;
+
+    for (i = 0; i < 4; i++) {
+        DosPartition* p = mbr_get_partition(mbr, i);
+        uint64_t start = dos_partition_get_start(p);
+        uint64_t size = dos_partition_get_size(p);
+
+        if (p->bootInd != 0 && p->bootInd != 0x80)
+            return 0;
+        if (p->sysInd == MBR_EMPTY_PARTITION || !size)
+            continue;
+        if (p->sysInd == MBR_GPT_PARTITION)
+            return 0;
+        if (!start || start + size > nsectors)
+            return 10;
+        used++;
+    }
+
+    if (probe_mbr_is_fat_boot(mbr))
+        return used ? 20 : 0;
+
+    return used ? 70 : 30;
+}
+
+static int probe_pmbr(ProbeCxt* pr)
+{
+    unsigned char* mbr = (unsigned char*) probe_get_buffer(pr, 0, 512);
+    int i;
+
+    if (!mbr || !mbr_is_valid_magic(mbr))
+        return 0;
+
+    for (i = 0; i < 4; i++) {
+        DosPartition* p = mbr_get_partition(mbr, i);
+
+        if (p->sysInd == MBR_GPT_PARTITION && dos_partition_get_start(p) == GPT_PRIMARY_HEADER_LBA)
+            return 50;
+    }
+    return 0;
+}
+
+static int probe_gpt_backup(ProbeCxt* pr)
+{
+    unsigned int ss = pr->sectorSize;
+    uint64_t lastLba;
+    const GptHeader* h;
+    const unsigned char* ents;
+    size_t esz;
+
+    if (pr->size < (uint64_t) ss * 3)
+        return 0;
+
+    lastLba = pr->size / ss - 1;
+    h = (const GptHeader*) probe_get_buffer(pr, lastLba * ss, ss);
+    if (!h || gpt_header_check(h, ss, lastLba, lastLba) != 0)
+        return 0;
+
+    esz = gpt_header_get_entries_size(h);
+    ents = probe_get_buffer(pr, le64_to_cpu(h->partitionEntryLba) * ss, esz);
+    if (!ents || crc32_checksum(ents, esz) != le32_to_cpu(h->partitionEntryArrayCrc32))
+        return 0;
+
+    return 1;
+}
+
+static int probe_gpt(ProbeCxt* pr)
+{
+    uint64_t lastLba = pr->size / pr->sectorSize - 1;
+    int backup = probe_gpt_backup(pr);
+    GptTable t;
+    int rc;
+
+    rc = gpt_table_parse(&t, pr->buf, pr->headSize, pr->sectorSize, lastLba);
+    if (rc == 0)
+        return backup ? 100 : 90;
+
+    /* valid primary header, the entry array is beyond the probed head */
+    if (rc == -ERANGE && t.header)
+        return backup ? 90 : 80;
+
+    /* the primary table is damaged, but the backup is usable */
+    return backup ? 60 : 0;
+}
+
+static int probe_bsd_label_at(ProbeCxt* pr, uint64_t off)
+{
+    const unsigned char* l = probe_get_buffer(pr, off, 512);
+    const unsigned char* p;
+    uint16_t npart, sum = 0;
+    size_t i, len;
+
+    if (!l)
+        return 0;
+    if (le32_to_cpu(*(const uint32_t*) l) != BSD_DISKMAGIC
+        || le32_to_cpu(*(const uint32_t*) (l + 132)) != BSD_DISKMAGIC)
+        return 0;
+
+    npart = le16_to_cpu(*(const uint16_t*) (l + 138));
+    if (npart > BSD_LABEL_MAXPARTITIONS)
+        return 40;
+
+    /* d_checksum is the xor of the label including its partitions */
+    len = 148 + (size_t) npart * 16;
+    for (i = 0, p = l; i < len; i += 2, p += 2)
+        sum ^= le16_to_cpu(*(const uint16_t*) p);
+
+    return sum == 0 ? 85 : 60;
+}
+
+static int probe_bsd(ProbeCxt* pr)
+{
+    unsigned char* mbr = (unsigned char*) probe_get_buffer(pr, 0, 512);
+    int conf, i;
+
+    /* whole disk label: i386 puts it into sector 1, others at offset 64 */
+    conf = probe_bsd_label_at(pr, 512);
+    if (!conf)
+        conf = probe_bsd_label_at(pr, 64);
+    if (conf)
+        return conf;
+
+    /* label inside of a BSD slice of the MBR */
+    if (!mbr || !mbr_is_valid_magic(mbr))
+        return 0;
+
+    for (i = 0; i < 4; i++) {
+        DosPartition* p = mbr_get_partition(mbr, i);
+
+        if (p->sysInd != MBR_FREEBSD_PARTITION && p->sysInd != MBR_OPENBSD_PARTITION
+            && p->sysInd != MBR_NETBSD_PARTITION)
+            continue;
+
+        conf = probe_bsd_label_at(pr, (uint64_t) dos_partition_get_start(p) * pr->sectorSize + 512);
+        if (conf)
+            return conf;
+    }
+    return 0;
+}
+
+size_t probe_label_all(ProbeCxt* pr, ProbeResult* res, size_t max)
+{
+    size_t i, j, n = 0;
+
+    if (!pr->buf)
+        return 0;
+
+    for (i = 0; i < PROBE_NLABELS && n < max; i++) {
+        int conf = probeLabels[i].probe(pr);
+        if (conf <= 0)
+            continue;
+
+        /* insertion sort, highest confidence first */
+        for (j = n; j > 0 && res[j - 1].confidence < conf; j--)
+            res[j] = res[j - 1];
+        res[j].type = probeLabels[i].type;
+        res[j].name = probeLabels[i].name;
+        res[j].confidence = conf;
+        n++;
+    }
+    return n;
+}
+
+int probe_label(ProbeCxt* pr, ProbeResult* res)
+{
+    ProbeResult all[PROBE_NLABELS];
+
+    if (!probe_label_all(pr, all, PROBE_NLABELS)) {
+        res->type = PROBE_LABEL_NONE;
+        res->name = NULL;
+        res->confidence = 0;
+        return 0;
+    }
+    *res = all[0];
+    return 1;
+}
+
+const char* probe_label_type_to_name(ProbeLabelType type)
+{
+    size_t i;
+
+    for (i = 0; i < PROBE_NLABELS; i++) {
+        if (probeLabels[i].type == type)
+            return probeLabels[i].name;
+    }
+    return NULL;
+}
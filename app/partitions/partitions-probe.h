@@ -0,0 +1,81 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_PARTITIONS_PROBE_H
+#define GRACEFUL_PARTITION_PARTITIONS_PROBE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* areas of the device read by probe_init() */
+#define PROBE_HEAD_SIZE             (1024 * 1024)
+#define PROBE_TAIL_SIZE             (1024 * 1024)
+#define PROBE_BUFFER_ALIGN          4096
+
+#define BSD_DISKMAGIC               0x82564557U
+#define BSD_LABEL_MAXPARTITIONS     22
+
+typedef struct _ProbeCxt            ProbeCxt;
+typedef struct _ProbeResult         ProbeResult;
+
+typedef enum
+{
+    PROBE_LABEL_NONE = 0,
+    PROBE_LABEL_MBR,
+    PROBE_LABEL_PMBR,                                   /* protective MBR without a usable GPT */
+    PROBE_LABEL_GPT,
+    PROBE_LABEL_BSD,
+} ProbeLabelType;
+
+/*
+ * The first PROBE_HEAD_SIZE and the last PROBE_TAIL_SIZE bytes of a device,
+ * read once into one aligned buffer. All label probers work on this buffer.
+ */
+struct _ProbeCxt
+{
+    int                             fd;
+    uint64_t                        size;               /* device size in bytes */
+    unsigned int                    sectorSize;
+
+    unsigned char*                  buf;                /* head, then tail */
+    size_t                          headSize;
+    uint64_t                        tailOffset;         /* device offset of the tail */
+    size_t                          tailSize;
+};
+
+struct _ProbeResult
+{
+    ProbeLabelType                  type;
+    const char*                     name;
+    int                             confidence;         /* 0 - 100 */
+};
+
+/*
+ * Read the head and the tail of @fd. If @size is 0 the size is taken from
+ * lseek(SEEK_END). Returns 0 on success or -errno.
+ */
+int probe_init(ProbeCxt* pr, int fd, uint64_t size, unsigned int sectorSize);
+
+/*
+ * Like probe_init() but only allocates the buffer and computes the head and
+ * tail areas, for callers which fill them with their own reads.
+ */
+int probe_init_layout(ProbeCxt* pr, int fd, uint64_t size, unsigned int sectorSize);
+void probe_deinit(ProbeCxt* pr);
+
+/* pointer to @len bytes at device offset @off if they are in the buffer */
+const unsigned char* probe_get_buffer(ProbeCxt* pr, uint64_t off, size_t len);
+
+/*
+ * Run all label probers and store the best match into @res. Returns 1 if
+ * some label was recognized, 0 if not.
+ */
+int probe_label(ProbeCxt* pr, ProbeResult* res);
+
+/* run all label probers, fill up to @max results sorted by confidence, returns count */
+size_t probe_label_all(ProbeCxt* pr, ProbeResult* res, size_t max);
+
+const char* probe_label_type_to_name(ProbeLabelType type);
+
+#endif //GRACEFUL_PARTITION_PARTITIONS_PROBE_H
@@ -0,0 +1,679 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                 /* struct statx */
+#endif
+
+#include "partitions-scan.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "partitions-mbr.h"
+#include "partitions-gpt.h"
+#include "partitions-ebr.h"
+#include "../common/blkdev.h"
+#include "../common/blkcache.h"
+#include "../common/async-io.h"
+#include "../common/utils.h"
+
+typedef struct _ScanJob             ScanJob;
+typedef struct _ScanPool            ScanPool;
+typedef struct _ScanDeque           ScanDeque;
+typedef struct _ScanAsync           ScanAsync;
+typedef struct _ScanWorker          ScanWorker;
+
+/* steps of one path in scan_images_async() */
+typedef enum
+{
+    SCAN_JOB_STAT = 0,
+    SCAN_JOB_OPEN,
+    SCAN_JOB_FSTAT,
+    SCAN_JOB_READ,
+    SCAN_JOB_CLOSE,
+} ScanJobState;
+
+/* owner pops at the tail, thieves take from the head */
+struct _ScanDeque
+{
+    pthread_mutex_t                 lock;
+    size_t*                         items;
+    size_t                          head;
+    size_t                          tail;
+};
+
+struct _ScanPool
+{
+    const char* const*              paths;
+    ScanDeque*                      deques;
+    unsigned int                    nworkers;
+
+    pthread_mutex_t                 outLock;
+    ScanRecordFunc                  func;
+    void*                           data;
+};
+
+struct _ScanWorker
+{
+    ScanPool*                       pool;
+    unsigned int                    id;
+    pthread_t                       thread;
+};
+
+struct _ScanAsync
+{
+    AsyncIo                         aio;
+    const char* const*              paths;
+    size_t                          npaths;
+    size_t                          next;               /* first path no job has taken */
+
+    ScanRecordFunc                  func;
+    void*                           data;
+};
+
+struct _ScanJob
+{
+    ScanAsync*                      sa;
+    ScanJobState                    state;
+    ScanRecord                      rec;
+
+    int                             fd;
+    struct statx                    stx;                /* of the path, then of the fd */
+    uint64_t                        ino;
+    uint32_t                        devMajor;
+    uint32_t                        devMinor;
+    int                             cached;
+
+    ProbeCxt                        pr;
+    AsyncIoReq                      req;                /* stat, open and close */
+    AsyncIoReq                      head;
+    AsyncIoReq                      tail;
+    unsigned int                    reading;            /* reads in flight */
+};
+
+static int scan_deque_pop(ScanDeque* dq, size_t* item);
+static int scan_deque_steal(ScanDeque* dq, size_t* item);
+static void* scan_worker_run(void* arg);
+static void scan_count_gpt(ScanRecord* rec, ProbeCxt* pr);
+static void scan_count_mbr(ScanRecord* rec, ProbeCxt* pr);
+static void scan_record_reset(ScanRecord* rec);
+static void scan_probe_label(ScanRecord* rec, ProbeCxt* pr);
+static void scan_job_next(ScanJob* job);
+static void scan_job_close(ScanJob* job);
+static void scan_job_opened(ScanJob* job);
+static void scan_job_read(ScanJob* job, AsyncIoReq* req, uint64_t off, size_t len);
+static void scan_job_done(AsyncIoReq* req, void* data);
+static int scan_list_directory(const char* dir, char*** paths, size_t* n);
+
+static int scan_deque_pop(ScanDeque* dq, size_t* item)
+{
+    int ok = 0;
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->head < dq->tail) {
+        *item = dq->items[--dq->tail];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+
+    return ok;
+}
+
+static int scan_deque_steal(ScanDeque* dq, size_t* item)
+{
+    int ok = 0;
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->head < dq->tail) {
+        *item = dq->items[dq->head++];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+
+    return ok;
+}
+
+static void scan_count_gpt(ScanRecord* rec, ProbeCxt* pr)
+{
+    uint64_t lastLba = rec->size / rec->sectorSize - 1;
+    unsigned char* buf = NULL;
+    GptTable t;
+    int rc;
+
+    rc = gpt_table_parse(&t, pr->buf, pr->headSize, rec->sectorSize, lastLba);
+    if (rc == -ERANGE)
+        rc = gpt_table_read(&t, pr->fd, rec->sectorSize, lastLba, &buf);
+    if (rc)
+        return;
+
+    rec->nparts = gpt_table_count_used(&t);
+    gpt_guid_to_string(&t.header->diskGuid, rec->id);
+    free(buf);
+}
+
+static void scan_count_mbr(ScanRecord* rec, ProbeCxt* pr)
+{
+    unsigned char* mbr = (unsigned char*) probe_get_buffer(pr, 0, 512);
+    EbrLogical logical[EBR_MAX_DEPTH];
+    size_t nlogical = 0;
+    int i;
+
+    if (!mbr)
+        return;
+
+    for (i = 0; i < 4; i++) {
+        DosPartition* p = mbr_get_partition(mbr, i);
+
+        if (p->sysInd != MBR_EMPTY_PARTITION && dos_partition_get_size(p)
+            && !mbr_is_extended_type(p->sysInd))
+            rec->nparts++;
+    }
+
+    ebr_walk_mbr(pr->fd, rec->sectorSize, mbr, logical, EBR_MAX_DEPTH, &nlogical);
+    rec->nparts += nlogical;
+
+    snprintf(rec->id, sizeof(rec->id), "%08x", mbr_get_id(mbr));
+}
+
+static void scan_record_reset(ScanRecord* rec)
+{
+    rec->rc = 0;
+    rec->size = 0;
+    rec->sectorSize = DEFAULT_SECTOR_SIZE;
+    rec->label = PROBE_LABEL_NONE;
+    rec->confidence = 0;
+    rec->id[0] = '\0';
+    rec->nparts = 0;
+    memset(&rec->cache, 0, sizeof(rec->cache));
+}
+
+static void scan_probe_label(ScanRecord* rec, ProbeCxt* pr)
+{
+    ProbeResult res;
+
+    if (!probe_label(pr, &res))
+        return;
+
+    rec->label = res.type;
+    rec->confidence = res.confidence;
+
+    if (res.type == PROBE_LABEL_GPT)
+        scan_count_gpt(rec, pr);
+    else if (res.type == PROBE_LABEL_MBR)
+        scan_count_mbr(rec, pr);
+}
+
+void scan_image(ScanRecord* rec)
+{
+    unsigned long long bytes = 0;
+    struct stat st;
+    ProbeCxt pr;
+    int fd, ss, cached = 0;
+
+    scan_record_reset(rec);
+
+    if (stat(rec->path, &st) != 0) {
+        rec->rc = -errno;
+        return;
+    }
+
+    fd = open_blkdev_or_file(&st, rec->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        rec->rc = -errno;
+        return;
+    }
+
+    if (blkdev_get_size(fd, &bytes) != 0) {
+        rec->rc = -EIO;
+        goto done;
+    }
+    rec->size = bytes;
+    if (S_ISBLK(st.st_mode) && blkdev_get_sector_size(fd, &ss) == 0 && ss > 0)
+        rec->sectorSize = ss;
+
+    if (!rec->size)
+        goto done;
+
+    /* label, backup header and EBR chain are parsed from the same few blocks */
+    cached = blkcache_attach(fd, 0, 0) == 0;
+
+    rec->rc = probe_init(&pr, fd, rec->size, rec->sectorSize);
+    if (rec->rc)
+        goto done;
+
+    scan_probe_label(rec, &pr);
+    probe_deinit(&pr);
+
+done:
+    if (cached) {
+        blkcache_get_stats(fd, &rec->cache);
+        blkcache_detach(fd);
+    }
+    close(fd);
+}
+
+/* take the next path, or retire the job */
+static void scan_job_next(ScanJob* job)
+{
+    ScanAsync* sa = job->sa;
+
+    if (sa->next == sa->npaths)
+        return;
+
+    memset(&job->rec, 0, sizeof(job->rec));
+    scan_record_reset(&job->rec);
+    job->rec.path = sa->paths[sa->next++];
+    job->fd = -1;
+    job->cached = 0;
+    job->state = SCAN_JOB_STAT;
+
+    memset(&job->req, 0, sizeof(job->req));
+    job->req.op = ASYNC_IO_STATX;
+    job->req.fd = AT_FDCWD;
+    job->req.path = job->rec.path;
+    job->req.mode = STATX_TYPE | STATX_INO;
+    job->req.buf = &job->stx;
+    job->req.func = scan_job_done;
+    job->req.data = job;
+    async_io_submit(&sa->aio, &job->req);
+}
+
+static void scan_job_close(ScanJob* job)
+{
+    if (job->cached) {
+        blkcache_get_stats(job->fd, &job->rec.cache);
+        blkcache_detach(job->fd);
+    }
+    job->cached = 0;
+
+    job->state = SCAN_JOB_CLOSE;
+    memset(&job->req, 0, sizeof(job->req));
+    job->req.op = ASYNC_IO_CLOSE;
+    job->req.fd = job->fd;
+    job->req.func = scan_job_done;
+    job->req.data = job;
+    async_io_submit(&job->sa->aio, &job->req);
+}
+
+static void scan_job_read(ScanJob* job, AsyncIoReq* req, uint64_t off, size_t len)
+{
+    memset(req, 0, sizeof(*req));
+    req->op = ASYNC_IO_READ;
+    req->fd = job->fd;
+    req->buf = job->pr.buf + (req == &job->tail ? job->pr.headSize : 0);
+    req->len = len;
+    req->off = off;
+    req->func = scan_job_done;
+    req->data = job;
+    job->reading++;
+    async_io_submit(&job->sa->aio, req);
+}
+
+/* same checks as open_blkdev_or_file(), then size the device and read head and tail */
+static void scan_job_opened(ScanJob* job)
+{
+    ScanRecord* rec = &job->rec;
+    unsigned long long bytes = 0;
+    int ss;
+
+    if (job->stx.stx_ino != job->ino || job->stx.stx_dev_major != job->devMajor
+        || job->stx.stx_dev_minor != job->devMinor) {
+        rec->rc = -EBADFD;
+        goto close;
+    }
+
+    if (S_ISBLK(job->stx.stx_mode)) {
+        if (blkdev_get_size(job->fd, &bytes) != 0) {
+            rec->rc = -EIO;
+            goto close;
+        }
+        if (blkdev_get_sector_size(job->fd, &ss) == 0 && ss > 0)
+            rec->sectorSize = ss;
+    } else {
+        bytes = job->stx.stx_size;
+    }
+    rec->size = bytes;
+    if (!rec->size)
+        goto close;
+
+    rec->rc = probe_init_layout(&job->pr, job->fd, rec->size, rec->sectorSize);
+    if (rec->rc)
+        goto close;
+
+    job->state = SCAN_JOB_READ;
+    job->reading = 0;
+    scan_job_read(job, &job->head, 0, job->pr.headSize);
+    if (job->pr.tailSize)
+        scan_job_read(job, &job->tail, job->pr.tailOffset, job->pr.tailSize);
+    return;
+
+close:
+    scan_job_close(job);
+}
+
+static void scan_job_done(AsyncIoReq* req, void* data)
+{
+    ScanJob* job = (ScanJob*) data;
+    ScanRecord* rec = &job->rec;
+
+    switch (job->state) {
+        case SCAN_JOB_STAT:
+            if (req->res < 0) {
+                rec->rc = (int) req->res;
+                break;
+            }
+            job->ino = job->stx.stx_ino;
+            job->devMajor = job->stx.stx_dev_major;
+            job->devMinor = job->stx.stx_dev_minor;
+
+            job->state = SCAN_JOB_OPEN;
+            req->op = ASYNC_IO_OPENAT;
+            req->flags = O_RDONLY | O_CLOEXEC | (S_ISBLK(job->stx.stx_mode) ? O_EXCL : 0);
+            req->mode = 0;
+            req->buf = NULL;
+            async_io_submit(&job->sa->aio, req);
+            return;
+
+        case SCAN_JOB_OPEN:
+            if (req->res < 0) {
+                rec->rc = (int) req->res;
+                break;
+            }
+            job->fd = (int) req->res;
+
+            job->state = SCAN_JOB_FSTAT;
+            req->op = ASYNC_IO_STATX;
+            req->fd = job->fd;
+            req->path = "";
+            req->flags = AT_EMPTY_PATH;
+            req->mode = STATX_TYPE | STATX_INO | STATX_SIZE;
+            req->buf = &job->stx;
+            async_io_submit(&job->sa->aio, req);
+            return;
+
+        case SCAN_JOB_FSTAT:
+            if (req->res < 0) {
+                rec->rc = (int) req->res;
+                scan_job_close(job);
+            } else {
+                scan_job_opened(job);
+            }
+            return;
+
+        case SCAN_JOB_READ:
+            if (req->res < 0 && !rec->rc)
+                rec->rc = (int) req->res;
+            else if ((size_t) req->res != req->len && !rec->rc)
+                rec->rc = -EIO;
+            if (--job->reading)
+                return;
+
+            if (!rec->rc) {
+                /* the backup GPT and the EBR chain are still read synchronously */
+                job->cached = blkcache_attach(job->fd, 0, 0) == 0;
+                scan_probe_label(rec, &job->pr);
+            }
+            probe_deinit(&job->pr);
+            scan_job_close(job);
+            return;
+
+        case SCAN_JOB_CLOSE:
+            job->fd = -1;
+            break;
+    }
+
+    job->sa->func(rec, job->sa->data);
+    scan_job_next(job);
+}
+
+static void* scan_worker_run(void* arg)
+{
+    ScanWorker* w = (ScanWorker*) arg;
+    ScanPool* pool = w->pool;
+    unsigned int i;
+    size_t item;
+
+    while (1) {
+        ScanRecord rec;
+
+        if (!scan_deque_pop(&pool->deques[w->id], &item)) {
+            /* own work is done, help the others; nothing is ever queued again */
+            for (i = 1; i < pool->nworkers; i++) {
+                if (scan_deque_steal(&pool->deques[(w->id + i) % pool->nworkers], &item))
+                    break;
+            }
+            if (i == pool->nworkers)
+                break;
+        }
+
+        memset(&rec, 0, sizeof(rec));
+        rec.path = pool->paths[item];
+        scan_image(&rec);
+
+        pthread_mutex_lock(&pool->outLock);
+        pool->func(&rec, pool->data);
+        pthread_mutex_unlock(&pool->outLock);
+    }
+
+    return NULL;
+}
+
+int scan_images(const char* const* paths, size_t npaths, unsigned int nthreads, ScanRecordFunc func, void* data)
+{
+    ScanWorker* workers = NULL;
+    size_t* items = NULL;
+    ScanPool pool;
+    unsigned int i, started = 0;
+    size_t j, per;
+    int rc = 0;
+
+    if (!func)
+        return -EINVAL;
+    if (!npaths)
+        return 0;
+
+    if (!nthreads) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = n > 0 ? (unsigned int) n : 1;
+    }
+    if (nthreads > SCAN_MAX_THREADS)
+        nthreads = SCAN_MAX_THREADS;
+    if (nthreads > npaths)
+        nthreads = (unsigned int) npaths;
+
+    memset(&pool, 0, sizeof(pool));
+    pool.paths = paths;
+    pool.nworkers = nthreads;
+    pool.func = func;
+    pool.data = data;
+    pthread_mutex_init(&pool.outLock, NULL);
+
+    per = (npaths + nthreads - 1) / nthreads;
+    pool.deques = calloc(nthreads, sizeof(ScanDeque));
+    items = malloc(sizeof(size_t) * per * nthreads);
+    workers = calloc(nthreads, sizeof(ScanWorker));
+    if (!pool.deques || !items || !workers) {
+        rc = -ENOMEM;
+        goto done;
+    }
+
+    /* round robin, so neighbouring (often similar) images end up on different workers */
+    for (i = 0; i < nthreads; i++) {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+        pool.deques[i].items = items + (size_t) i * per;
+    }
+    for (j = 0; j < npaths; j++) {
+        ScanDeque* dq = &pool.deques[j % nthreads];
+        dq->items[dq->tail++] = j;
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        int err;
+
+        workers[i].pool = &pool;
+        workers[i].id = i;
+        err = pthread_create(&workers[i].thread, NULL, scan_worker_run, &workers[i]);
+        if (err) {
+            rc = -err;
+            break;
+        }
+        started++;
+    }
+
+    /* if not all workers came up, the started ones steal the orphaned work */
+    if (!started)
+        rc = rc ? rc : -EAGAIN;
+    else
+        rc = 0;
+
+    for (i = 0; i < started; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    for (i = 0; i < nthreads; i++)
+        pthread_mutex_destroy(&pool.deques[i].lock);
+
+done:
+    pthread_mutex_destroy(&pool.outLock);
+    free(workers);
+    free(items);
+    free(pool.deques);
+
+    return rc;
+}
+
+int scan_images_async(const char* const* paths, size_t npaths, unsigned int depth, ScanRecordFunc func, void* data)
+{
+    ScanJob* jobs;
+    ScanAsync sa;
+    size_t njobs, i;
+    int rc;
+
+    if (!func)
+        return -EINVAL;
+    if (!npaths)
+        return 0;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.paths = paths;
+    sa.npaths = npaths;
+    sa.func = func;
+    sa.data = data;
+
+    rc = async_io_init(&sa.aio, depth, 0);
+    if (rc)
+        return rc;
+
+    /* a job has at most two requests in flight, head and tail */
+    njobs = sa.aio.depth / 2 ? sa.aio.depth / 2 : 1;
+    if (njobs > npaths)
+        njobs = npaths;
+    jobs = calloc(njobs, sizeof(ScanJob));
+    if (!jobs) {
+        async_io_deinit(&sa.aio);
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < njobs; i++) {
+        jobs[i].sa = &sa;
+        jobs[i].fd = -1;
+        scan_job_next(&jobs[i]);
+    }
+
+    /* every job ends in SCAN_JOB_CLOSE, which frees its buffers and its fd */
+    async_io_run(&sa.aio);
+    async_io_deinit(&sa.aio);
+    free(jobs);
+
+    return 0;
+}
+
+static int scan_list_directory(const char* dir, char*** paths, size_t* n)
+{
+    size_t max = 0;
+    struct dirent* d;
+    DIR* dp;
+
+    *paths = NULL;
+    *n = 0;
+
+    dp = opendir(dir);
+    if (!dp)
+        return -errno;
+
+    while ((d = xreaddir(dp))) {
+        struct stat st;
+        char* p;
+
+        if (fstatat(dirfd(dp), d->d_name, &st, 0) != 0)
+            continue;
+        if (!S_ISREG(st.st_mode) && !S_ISBLK(st.st_mode))
+            continue;
+
+        if (*n == max) {
+            char** tmp = realloc(*paths, sizeof(char*) * (max ? max * 2 : 64));
+            if (!tmp)
+                break;
+            *paths = tmp;
+            max = max ? max * 2 : 64;
+        }
+        if (asprintf(&p, "%s/%s", dir, d->d_name) < 0)
+            break;
+        (*paths)[(*n)++] = p;
+    }
+    closedir(dp);
+
+    return d ? -ENOMEM : 0;
+}
+
+int scan_directory(const char* dir, unsigned int nthreads, ScanRecordFunc func, void* data)
+{
+    char** paths;
+    size_t n, i;
+    int rc;
+
+    rc = scan_list_directory(dir, &paths, &n);
+    if (!rc)
+        rc = scan_images((const char* const*) paths, n, nthreads, func, data);
+
+    for (i = 0; i < n; i++)
+        free(paths[i]);
+    free(paths);
+
+    return rc;
+}
+
+int scan_directory_async(const char* dir, unsigned int depth, ScanRecordFunc func, void* data)
+{
+    char** paths;
+    size_t n, i;
+    int rc;
+
+    rc = scan_list_directory(dir, &paths, &n);
+    if (!rc)
+        rc = scan_images_async((const char* const*) paths, n, depth, func, data);
+
+    for (i = 0; i < n; i++)
+        free(paths[i]);
+    free(paths);
+
+    return rc;
+}
+
+int scan_record_format(const ScanRecord* rec, char* buf, size_t bufSize)
+{
+    const char* label = probe_label_type_to_name(rec->label);
+
+    return snprintf(buf, bufSize, "%s\t%s\t%d\t%llu\t%u\t%u\t%s\t%d",
+                    rec->path, label ? label : "-", rec->confidence,
+                    (unsigned long long) rec->size, rec->sectorSize,
+                    rec->nparts, rec->id[0] ? rec->id : "-", rec->rc);
+}
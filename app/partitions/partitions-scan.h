@@ -0,0 +1,66 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_PARTITIONS_SCAN_H
+#define GRACEFUL_PARTITION_PARTITIONS_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "partitions-probe.h"
+#include "../common/blkcache.h"
+
+/* upper bound of worker threads */
+#define SCAN_MAX_THREADS            256
+
+typedef struct _ScanRecord          ScanRecord;
+
+typedef void (*ScanRecordFunc) (const ScanRecord* rec, void* data);
+
+/* one line of the inventory */
+struct _ScanRecord
+{
+    const char*                     path;
+    int                             rc;                 /* 0 or -errno */
+    uint64_t                        size;               /* in bytes */
+    unsigned int                    sectorSize;
+
+    ProbeLabelType                  label;
+    int                             confidence;
+    char                            id[37];             /* GPT disk GUID or MBR disk id */
+    uint32_t                        nparts;             /* used entries, logical ones included */
+
+    BlkCacheStats                   cache;              /* block cache counters of the label reads */
+};
+
+/*
+ * Probe @npaths images or devices with @nthreads workers (0 = number of
+ * online CPUs). Every worker owns a deque of paths and steals from the
+ * others when it runs dry, so a few slow images do not stall the batch.
+ *
+ * @func is called once per path, never concurrently. Returns 0 or -errno
+ * if the workers could not be started; per path errors are in ScanRecord.rc.
+ */
+int scan_images(const char* const* paths, size_t npaths, unsigned int nthreads, ScanRecordFunc func, void* data);
+
+/* scan all regular files and block devices in @dir (not recursive) */
+int scan_directory(const char* dir, unsigned int nthreads, ScanRecordFunc func, void* data);
+
+/*
+ * Same result as scan_images(), but from one thread which keeps up to @depth
+ * requests (0 = ASYNC_IO_DEPTH) in flight: stat, open, the head and tail
+ * reads and close go through io_uring, or its thread pool fallback. Only
+ * the size ioctls of block devices and the reads of labels extending past
+ * the probe areas stay synchronous. @func is called from the calling thread.
+ */
+int scan_images_async(const char* const* paths, size_t npaths, unsigned int depth, ScanRecordFunc func, void* data);
+int scan_directory_async(const char* dir, unsigned int depth, ScanRecordFunc func, void* data);
+
+/* probe one image, @rec->path must be set */
+void scan_image(ScanRecord* rec);
+
+/* "<path>\t<label>\t<confidence>\t<size>\t<sector size>\t<nparts>\t<id>\t<rc>" */
+int scan_record_format(const ScanRecord* rec, char* buf, size_t bufSize);
+
+#endif //GRACEFUL_PARTITION_PARTITIONS_SCAN_H
@@ -0,0 +1,605 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "partitions-superblock.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "../common/bitops.h"
+#include "../common/blkdev.h"
+#include "../common/blkcache.h"
+#include "../common/bufpool.h"
+
+#define SUPERBLOCK_MAX_MAGICS       6
+
+/* md 0.90 sits in the last 64 KiB aligned block but one, md 1.0 8 KiB before the end */
+#define MD_RESERVED_BYTES           (64 * 1024)
+
+typedef struct _SuperblockMagic     SuperblockMagic;
+typedef struct _SuperblockType      SuperblockType;
+typedef struct _SuperblockRegion    SuperblockRegion;
+
+typedef enum
+{
+    SUPERBLOCK_AT_START = 0,                            /* sbOffset from the start of the device */
+    SUPERBLOCK_AT_MD090,
+    SUPERBLOCK_AT_MD10,
+} SuperblockWhere;
+
+struct _SuperblockMagic
+{
+    const char*                     magic;              /* NULL ends the list */
+    unsigned int                    len;
+    SuperblockWhere                 where;
+    uint64_t                        sbOffset;
+    unsigned int                    magicOffset;        /* within the superblock */
+    unsigned int                    sbSize;             /* bytes the prober looks at */
+};
+
+struct _SuperblockType
+{
+    const char*                     name;
+    SuperblockUsage                 usage;
+    int                           (*probe) (const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res);
+    SuperblockMagic                 magics[SUPERBLOCK_MAX_MAGICS];
+};
+
+struct _SuperblockRegion
+{
+    uint64_t                        start;
+    uint64_t                        end;
+};
+
+static uint16_t sb_le16(const unsigned char* p);
+static uint32_t sb_le32(const unsigned char* p);
+static uint64_t sb_le64(const unsigned char* p);
+static int sb_is_power_of_2(uint64_t x);
+static void sb_set_label(char* dst, size_t size, const unsigned char* src, size_t len);
+static void sb_set_uuid(SuperblockResult* res, const unsigned char* uuid);
+static void sb_set_serial(SuperblockResult* res, uint32_t serial);
+static int sb_magic_offset(const SuperblockMagic* m, uint64_t size, uint64_t* off);
+static int sb_region_cmp(const void* a, const void* b);
+
+static int probe_md(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res);
+static int probe_lvm2(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res);
+static int probe_bcache(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res);
+static int probe_luks(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res);
+static int probe_btrfs(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res);
+static int probe_xfs(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res);
+static int probe_ext(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res);
+static int probe_exfat(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res);
+static int probe_ntfs(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res);
+static int probe_vfat(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res);
+static int probe_swap(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res);
+
+#define MD_MAGIC                    "\xfc\x4e\x2b\xa9"
+#define BCACHE_MAGIC                "\xc6\x85\x73\xf6\x4e\x1a\x45\xca\x82\x65\xf5\x7f\x48\xba\x6d\x81"
+
+/* containers first, they hold the filesystem and may carry a stale one at the start */
+static const SuperblockType superblockTypes[] = {
+    { "linux_raid_member", SUPERBLOCK_USAGE_RAID, probe_md, {
+        { MD_MAGIC, 4, SUPERBLOCK_AT_MD090, 0, 0, 256 },
+        { MD_MAGIC, 4, SUPERBLOCK_AT_MD10, 0, 0, 256 },
+        { MD_MAGIC, 4, SUPERBLOCK_AT_START, 0, 0, 256 },
+        { MD_MAGIC, 4, SUPERBLOCK_AT_START, 4096, 0, 256 },
+    } },
+    { "LVM2_member", SUPERBLOCK_USAGE_RAID, probe_lvm2, {
+        { "LABELONE", 8, SUPERBLOCK_AT_START, 0, 0, 512 },
+        { "LABELONE", 8, SUPERBLOCK_AT_START, 512, 0, 512 },
+        { "LABELONE", 8, SUPERBLOCK_AT_START, 1024, 0, 512 },
+        { "LABELONE", 8, SUPERBLOCK_AT_START, 1536, 0, 512 },
+    } },
+    { "bcache", SUPERBLOCK_USAGE_OTHER, probe_bcache, {
+        { BCACHE_MAGIC, 16, SUPERBLOCK_AT_START, 4096, 24, 512 },
+    } },
+    { "crypto_LUKS", SUPERBLOCK_USAGE_CRYPTO, probe_luks, {
+        { "LUKS\xba\xbe", 6, SUPERBLOCK_AT_START, 0, 0, 512 },
+    } },
+    { "btrfs", SUPERBLOCK_USAGE_FILESYSTEM, probe_btrfs, {
+        { "_BHRfS_M", 8, SUPERBLOCK_AT_START, 0x10000, 0x40, 0x400 },
+    } },
+    { "xfs", SUPERBLOCK_USAGE_FILESYSTEM, probe_xfs, {
+        { "XFSB", 4, SUPERBLOCK_AT_START, 0, 0, 512 },
+    } },
+    { "ext4", SUPERBLOCK_USAGE_FILESYSTEM, probe_ext, {
+        { "\x53\xef", 2, SUPERBLOCK_AT_START, 1024, 0x38, 1024 },
+    } },
+    { "exfat", SUPERBLOCK_USAGE_FILESYSTEM, probe_exfat, {
+        { "EXFAT   ", 8, SUPERBLOCK_AT_START, 0, 3, 512 },
+    } },
+    { "ntfs", SUPERBLOCK_USAGE_FILESYSTEM, probe_ntfs, {
+        { "NTFS    ", 8, SUPERBLOCK_AT_START, 0, 3, 512 },
+    } },
+    { "vfat", SUPERBLOCK_USAGE_FILESYSTEM, probe_vfat, {
+        { "FAT32   ", 8, SUPERBLOCK_AT_START, 0, 0x52, 512 },
+        { "FAT16   ", 8, SUPERBLOCK_AT_START, 0, 0x36, 512 },
+        { "FAT12   ", 8, SUPERBLOCK_AT_START, 0, 0x36, 512 },
+        { "FAT     ", 8, SUPERBLOCK_AT_START, 0, 0x36, 512 },
+    } },
+    /* the signature ends the first page, whatever the page size of the creator was */
+    { "swap", SUPERBLOCK_USAGE_OTHER, probe_swap, {
+        { "SWAPSPACE2", 10, SUPERBLOCK_AT_START, 0, 4096 - 10, 4096 },
+        { "SWAPSPACE2", 10, SUPERBLOCK_AT_START, 0, 8192 - 10, 8192 },
+        { "SWAPSPACE2", 10, SUPERBLOCK_AT_START, 0, 16384 - 10, 16384 },
+        { "SWAPSPACE2", 10, SUPERBLOCK_AT_START, 0, 65536 - 10, 65536 },
+        { "SWAP-SPACE", 10, SUPERBLOCK_AT_START, 0, 4096 - 10, 4096 },
+    } },
+};
+
+#define SUPERBLOCK_NTYPES           (sizeof(superblockTypes) / sizeof(superblockTypes[0]))
+
+static uint16_t sb_le16(const unsigned char* p)
+{
+    uint16_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return le16toh(v);
+}
+
+static uint32_t sb_le32(const unsigned char* p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return le32toh(v);
+}
+
+static uint64_t sb_le64(const unsigned char* p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return le64toh(v);
+}
+
+static int sb_is_power_of_2(uint64_t x)
+{
+    return x && !(x & (x - 1));
+}
+
+/* copy up to @len bytes or the first NUL, trailing blanks dropped */
+static void sb_set_label(char* dst, size_t size, const unsigned char* src, size_t len)
+{
+    size_t n = 0;
+
+    while (n < len && n + 1 < size && src[n])
+        n++;
+    while (n > 0 && (src[n - 1] == ' ' || src[n - 1] == '\t'))
+        n--;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+static void sb_set_uuid(SuperblockResult* res, const unsigned char* uuid)
+{
+    static const unsigned char zero[16];
+
+    if (!memcmp(uuid, zero, sizeof(zero)))
+        return;
+
+    snprintf(res->uuid, sizeof(res->uuid),
+             "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+             uuid[0], uuid[1], uuid[2], uuid[3], uuid[4], uuid[5], uuid[6], uuid[7],
+             uuid[8], uuid[9], uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]);
+}
+
+/* FAT and exFAT volume serial numbers */
+static void sb_set_serial(SuperblockResult* res, uint32_t serial)
+{
+    snprintf(res->uuid, sizeof(res->uuid), "%04X-%04X", serial >> 16, serial & 0xffff);
+}
+
+static int sb_magic_offset(const SuperblockMagic* m, uint64_t size, uint64_t* off)
+{
+    switch (m->where) {
+        case SUPERBLOCK_AT_START:
+            *off = m->sbOffset;
+            break;
+        case SUPERBLOCK_AT_MD090:
+            if (size < 2 * MD_RESERVED_BYTES)
+                return 0;
+            *off = (size & ~((uint64_t) MD_RESERVED_BYTES - 1)) - MD_RESERVED_BYTES;
+            break;
+        case SUPERBLOCK_AT_MD10:
+            if (size < 16 * 512)
+                return 0;
+            *off = ((size / 512 - 16) & ~(uint64_t) 7) * 512;
+            break;
+        default:
+            return 0;
+    }
+
+    return *off + m->sbSize <= size;
+}
+
+static int sb_region_cmp(const void* a, const void* b)
+{
+    const SuperblockRegion* x = (const SuperblockRegion*) a;
+    const SuperblockRegion* y = (const SuperblockRegion*) b;
+
+    return x->start < y->start ? -1 : x->start > y->start;
+}
+
+int superblock_init(SuperblockCxt* cxt, int fd, uint64_t size)
+{
+    SuperblockRegion* regions;
+    size_t i, j, n = 0, total = 0;
+    int rc = 0;
+
+    memset(cxt, 0, sizeof(*cxt));
+    if (!size) {
+        unsigned long long bytes;
+
+        errno = 0;
+        if (blkdev_get_size(fd, &bytes) != 0)
+            return errno ? -errno : -EINVAL;
+        size = bytes;
+    }
+    cxt->fd = fd;
+    cxt->size = size;
+
+    regions = malloc(sizeof(SuperblockRegion) * SUPERBLOCK_NTYPES * SUPERBLOCK_MAX_MAGICS);
+    if (!regions)
+        return -ENOMEM;
+
+    /* every place a signature may be, widened to whole aligned blocks */
+    for (i = 0; i < SUPERBLOCK_NTYPES; i++) {
+        for (j = 0; j < SUPERBLOCK_MAX_MAGICS && superblockTypes[i].magics[j].magic; j++) {
+            const SuperblockMagic* m = &superblockTypes[i].magics[j];
+            uint64_t off;
+
+            if (!sb_magic_offset(m, size, &off))
+                continue;
+            regions[n].start = off - off % SUPERBLOCK_READ_ALIGN;
+            regions[n].end = off + m->sbSize + SUPERBLOCK_READ_ALIGN - 1;
+            regions[n].end -= regions[n].end % SUPERBLOCK_READ_ALIGN;
+            if (regions[n].end > size)
+                regions[n].end = size;
+            n++;
+        }
+    }
+    if (!n)
+        goto done;
+
+    qsort(regions, n, sizeof(SuperblockRegion), sb_region_cmp);
+    cxt->reads[0].offset = regions[0].start;
+    cxt->reads[0].size = (size_t) (regions[0].end - regions[0].start);
+    cxt->nreads = 1;
+    for (i = 1; i < n; i++) {
+        SuperblockRead* r = &cxt->reads[cxt->nreads - 1];
+        uint64_t end = r->offset + r->size;
+
+        if (regions[i].start <= end + SUPERBLOCK_MERGE_GAP) {
+            if (regions[i].end > end)
+                r->size = (size_t) (regions[i].end - r->offset);
+        } else if (cxt->nreads < SUPERBLOCK_MAX_READS) {
+            r = &cxt->reads[cxt->nreads++];
+            r->offset = regions[i].start;
+            r->size = (size_t) (regions[i].end - regions[i].start);
+        } else {
+            r->size = (size_t) (regions[i].end - r->offset);
+        }
+    }
+
+    for (i = 0; i < cxt->nreads; i++) {
+        cxt->reads[i].bufOffset = total;
+        total += cxt->reads[i].size;
+    }
+    /* pool buffers are page aligned, which covers SUPERBLOCK_READ_ALIGN */
+    cxt->buf = bufpool_get(total);
+    if (!cxt->buf) {
+        rc = -ENOMEM;
+        goto done;
+    }
+    cxt->bufSize = total;
+
+    for (i = 0; i < cxt->nreads; i++) {
+        const SuperblockRead* r = &cxt->reads[i];
+        ssize_t ret = blkcache_pread(fd, cxt->buf + r->bufOffset, r->size, r->offset);
+
+        if (ret < 0 || (size_t) ret != r->size) {
+            rc = ret < 0 ? -errno : -EIO;
+            superblock_deinit(cxt);
+            break;
+        }
+    }
+
+done:
+    free(regions);
+    return rc;
+}
+
+void superblock_deinit(SuperblockCxt* cxt)
+{
+    bufpool_put(cxt->buf, cxt->bufSize);
+    cxt->buf = NULL;
+    cxt->bufSize = 0;
+    cxt->nreads = 0;
+}
+
+const unsigned char* superblock_get_buffer(SuperblockCxt* cxt, uint64_t off, size_t len)
+{
+    size_t i;
+
+    if (!cxt->buf || off > UINT64_MAX - len)
+        return NULL;
+
+    for (i = 0; i < cxt->nreads; i++) {
+        const SuperblockRead* r = &cxt->reads[i];
+
+        if (off >= r->offset && off + len <= r->offset + r->size)
+            return cxt->buf + r->bufOffset + (off - r->offset);
+    }
+
+    return NULL;
+}
+
+size_t superblock_probe_all(SuperblockCxt* cxt, SuperblockResult* res, size_t max)
+{
+    size_t i, j, n = 0;
+
+    for (i = 0; i < SUPERBLOCK_NTYPES && n < max; i++) {
+        const SuperblockType* t = &superblockTypes[i];
+
+        for (j = 0; j < SUPERBLOCK_MAX_MAGICS && t->magics[j].magic; j++) {
+            const SuperblockMagic* m = &t->magics[j];
+            const unsigned char* sb;
+            SuperblockResult r;
+            uint64_t off;
+
+            if (!sb_magic_offset(m, cxt->size, &off))
+                continue;
+            sb = superblock_get_buffer(cxt, off, m->sbSize);
+            if (!sb || memcmp(sb + m->magicOffset, m->magic, m->len) != 0)
+                continue;
+
+            memset(&r, 0, sizeof(r));
+            r.type = t->name;
+            r.usage = t->usage;
+            r.offset = off;
+            if (t->probe(m, sb, &r) <= 0)
+                continue;
+
+            res[n++] = r;
+            break;
+        }
+    }
+
+    return n;
+}
+
+int superblock_probe(int fd, SuperblockResult* res)
+{
+    SuperblockCxt cxt;
+    size_t n;
+    int rc;
+
+    rc = superblock_init(&cxt, fd, 0);
+    if (rc)
+        return rc;
+    n = superblock_probe_all(&cxt, res, 1);
+    superblock_deinit(&cxt);
+
+    return n ? 1 : 0;
+}
+
+const char* superblock_usage_to_name(SuperblockUsage usage)
+{
+    switch (usage) {
+        case SUPERBLOCK_USAGE_FILESYSTEM:
+            return "filesystem";
+        case SUPERBLOCK_USAGE_RAID:
+            return "raid";
+        case SUPERBLOCK_USAGE_CRYPTO:
+            return "crypto";
+        case SUPERBLOCK_USAGE_OTHER:
+            return "other";
+        default:
+            return "unknown";
+    }
+}
+
+static int probe_md(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res)
+{
+    static const unsigned int words[4] = { 5, 13, 14, 15 };
+    unsigned char uuid[16];
+    int i;
+
+    if (m->where == SUPERBLOCK_AT_MD090) {
+        if (sb_le32(sb + 4) != 0 || sb_le32(sb + 8) != 90)
+            return 0;
+        /* set_uuid0 is word 5, set_uuid1-3 are words 13-15, shown as numbers */
+        for (i = 0; i < 4; i++) {
+            uint32_t w = htobe32(sb_le32(sb + words[i] * 4));
+            memcpy(uuid + i * 4, &w, 4);
+        }
+        sb_set_uuid(res, uuid);
+        strcpy(res->version, "0.90.0");
+        return 1;
+    }
+
+    /* 1.x records where it lives, which tells 1.0, 1.1 and 1.2 apart from stale copies */
+    if (sb_le32(sb + 4) != 1 || sb_le64(sb + 144) != res->offset / 512)
+        return 0;
+    sb_set_uuid(res, sb + 16);
+    sb_set_label(res->label, sizeof(res->label), sb + 32, 32);
+    strcpy(res->version, m->where == SUPERBLOCK_AT_MD10 ? "1.0" : m->sbOffset ? "1.2" : "1.1");
+
+    return 1;
+}
+
+static int probe_lvm2(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res)
+{
+    const unsigned char* u;
+    uint32_t off = sb_le32(sb + 20);
+
+    if (memcmp(sb + 24, "LVM2 001", 8) != 0 || sb_le64(sb + 8) != m->sbOffset / 512)
+        return 0;
+    if (off < 32 || off + 32 > 512)
+        return 0;
+
+    /* the PV UUID is 32 characters, shown in groups of 6-4-4-4-4-4-6 */
+    u = sb + off;
+    snprintf(res->uuid, sizeof(res->uuid), "%.6s-%.4s-%.4s-%.4s-%.4s-%.4s-%.6s",
+             u, u + 6, u + 10, u + 14, u + 18, u + 22, u + 26);
+    strcpy(res->version, "LVM2 001");
+
+    return 1;
+}
+
+static int probe_bcache(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res)
+{
+    (void) m;
+
+    /* offset of the superblock itself, in sectors */
+    if (sb_le64(sb + 8) != res->offset / 512)
+        return 0;
+    sb_set_uuid(res, sb + 40);
+    sb_set_label(res->label, sizeof(res->label), sb + 72, 32);
+
+    return 1;
+}
+
+static int probe_luks(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res)
+{
+    unsigned int version = ((unsigned int) sb[6] << 8) | sb[7];
+
+    (void) m;
+
+    if (version != 1 && version != 2)
+        return 0;
+    sb_set_label(res->uuid, sizeof(res->uuid), sb + 168, 40);
+    if (version == 2)
+        sb_set_label(res->label, sizeof(res->label), sb + 24, 48);
+    snprintf(res->version, sizeof(res->version), "%u", version);
+
+    return 1;
+}
+
+static int probe_btrfs(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res)
+{
+    (void) m;
+
+    if (sb_le64(sb + 0x30) != res->offset)
+        return 0;
+    sb_set_uuid(res, sb + 0x20);
+    sb_set_label(res->label, sizeof(res->label), sb + 0x12b, 256);
+
+    return 1;
+}
+
+static int probe_xfs(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res)
+{
+    uint32_t blockSize = ((uint32_t) sb[4] << 24) | ((uint32_t) sb[5] << 16) | ((uint32_t) sb[6] << 8) | sb[7];
+
+    (void) m;
+
+    if (blockSize < 512 || blockSize > 65536 || !sb_is_power_of_2(blockSize))
+        return 0;
+    sb_set_uuid(res, sb + 32);
+    sb_set_label(res->label, sizeof(res->label), sb + 108, 12);
+
+    return 1;
+}
+
+#define EXT3_FEATURE_COMPAT_HAS_JOURNAL     0x0004
+#define EXT3_FEATURE_INCOMPAT_JOURNAL_DEV   0x0008
+#define EXT2_FEATURE_INCOMPAT_SUPP          (0x0002 | 0x0010)   /* filetype, meta_bg */
+#define EXT3_FEATURE_INCOMPAT_SUPP          (EXT2_FEATURE_INCOMPAT_SUPP | 0x0004)
+#define EXT2_FEATURE_RO_COMPAT_SUPP         (0x0001 | 0x0002 | 0x0004)
+
+static int probe_ext(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res)
+{
+    uint32_t compat = sb_le32(sb + 0x5c);
+    uint32_t incompat = sb_le32(sb + 0x60);
+    uint32_t roCompat = sb_le32(sb + 0x64);
+
+    (void) m;
+
+    /* an external journal is not a filesystem */
+    if (incompat & EXT3_FEATURE_INCOMPAT_JOURNAL_DEV) {
+        res->type = "jbd";
+        res->usage = SUPERBLOCK_USAGE_OTHER;
+    } else if ((incompat & ~EXT3_FEATURE_INCOMPAT_SUPP) || (roCompat & ~EXT2_FEATURE_RO_COMPAT_SUPP)) {
+        res->type = "ext4";
+    } else if (compat & EXT3_FEATURE_COMPAT_HAS_JOURNAL) {
+        res->type = "ext3";
+    } else {
+        res->type = "ext2";
+    }
+    sb_set_uuid(res, sb + 0x68);
+    sb_set_label(res->label, sizeof(res->label), sb + 0x78, 16);
+    snprintf(res->version, sizeof(res->version), "%u.%u", sb_le32(sb + 0x4c), sb_le16(sb + 0x3e));
+
+    return 1;
+}
+
+/* the exFAT and NTFS labels live in the root directory and $Volume, outside of the boot sector */
+static int probe_exfat(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res)
+{
+    (void) m;
+
+    if (sb[510] != 0x55 || sb[511] != 0xaa)
+        return 0;
+    sb_set_serial(res, sb_le32(sb + 0x64));
+    snprintf(res->version, sizeof(res->version), "%u.%u", sb[0x69], sb[0x68]);
+
+    return 1;
+}
+
+static int probe_ntfs(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res)
+{
+    uint16_t sectorSize = sb_le16(sb + 0x0b);
+
+    (void) m;
+
+    if (sectorSize < 256 || sectorSize > 4096 || !sb_is_power_of_2(sectorSize))
+        return 0;
+    snprintf(res->uuid, sizeof(res->uuid), "%016llX", (unsigned long long) sb_le64(sb + 0x48));
+
+    return 1;
+}
+
+static int probe_vfat(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res)
+{
+    uint16_t sectorSize = sb_le16(sb + 0x0b);
+    unsigned int at = m->magicOffset == 0x52 ? 0x43 : 0x27;
+
+    if (sb[510] != 0x55 || sb[511] != 0xaa)
+        return 0;
+    if (sectorSize < 512 || sectorSize > 4096 || !sb_is_power_of_2(sectorSize))
+        return 0;
+    if (!sb_is_power_of_2(sb[0x0d]) || !sb_le16(sb + 0x0e) || !sb[0x10])
+        return 0;
+
+    /* serial number, then the 11 character label */
+    sb_set_serial(res, sb_le32(sb + at));
+    sb_set_label(res->label, sizeof(res->label), sb + at + 4, 11);
+    if (!strcmp(res->label, "NO NAME"))
+        res->label[0] = '\0';
+    sb_set_label(res->version, sizeof(res->version), sb + m->magicOffset, 8);
+
+    return 1;
+}
+
+static int probe_swap(const SuperblockMagic* m, const unsigned char* sb, SuperblockResult* res)
+{
+    /* old style swap has no header */
+    if (m->magic[4] == '-') {
+        strcpy(res->version, "0");
+        return 1;
+    }
+    if (sb_le32(sb + 1024) != 1)
+        return 0;
+    sb_set_uuid(res, sb + 1024 + 12);
+    sb_set_label(res->label, sizeof(res->label), sb + 1024 + 28, 16);
+    strcpy(res->version, "1");
+
+    return 1;
+}
@@ -0,0 +1,90 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#ifndef GRACEFUL_PARTITION_PARTITIONS_SUPERBLOCK_H
+#define GRACEFUL_PARTITION_PARTITIONS_SUPERBLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* regions closer than this are read together, one more seek costs more than the gap */
+#define SUPERBLOCK_MERGE_GAP        (64 * 1024)
+#define SUPERBLOCK_READ_ALIGN       4096
+#define SUPERBLOCK_MAX_READS        32
+
+#define SUPERBLOCK_UUID_SIZE        64
+#define SUPERBLOCK_LABEL_SIZE       257
+
+typedef struct _SuperblockCxt       SuperblockCxt;
+typedef struct _SuperblockRead      SuperblockRead;
+typedef struct _SuperblockResult    SuperblockResult;
+
+typedef enum
+{
+    SUPERBLOCK_USAGE_FILESYSTEM = 0,
+    SUPERBLOCK_USAGE_RAID,                              /* md and LVM2 members */
+    SUPERBLOCK_USAGE_CRYPTO,
+    SUPERBLOCK_USAGE_OTHER,                             /* swap, bcache and external journals, as libblkid has it */
+} SuperblockUsage;
+
+/* one merged pread, the data lives in SuperblockCxt.buf at bufOffset */
+struct _SuperblockRead
+{
+    uint64_t                        offset;
+    size_t                          size;
+    size_t                          bufOffset;
+};
+
+/*
+ * The magic offsets of all known signatures are collected, sorted and
+ * merged into a few aligned reads before anything is matched, so probing
+ * a device costs two preads (head and tail) instead of one per candidate.
+ */
+struct _SuperblockCxt
+{
+    int                             fd;
+    uint64_t                        size;               /* device size in bytes */
+
+    unsigned char*                  buf;                /* from bufpool */
+    size_t                          bufSize;
+    SuperblockRead                  reads[SUPERBLOCK_MAX_READS];
+    size_t                          nreads;
+};
+
+struct _SuperblockResult
+{
+    const char*                     type;               /* "ext4", "crypto_LUKS", "linux_raid_member", ... */
+    SuperblockUsage                 usage;
+    char                            version[16];        /* empty if the format has none */
+    uint64_t                        offset;             /* of the superblock on the device */
+
+    char                            uuid[SUPERBLOCK_UUID_SIZE];
+    char                            label[SUPERBLOCK_LABEL_SIZE];
+};
+
+/*
+ * Plan and do the merged reads of @fd. If @size is 0 the size is taken from
+ * blkdev_get_size(), the file offset of @fd is left alone. Returns 0 on
+ * success or -errno.
+ */
+int superblock_init(SuperblockCxt* cxt, int fd, uint64_t size);
+void superblock_deinit(SuperblockCxt* cxt);
+
+/* pointer to @len bytes at device offset @off if one of the reads covers them */
+const unsigned char* superblock_get_buffer(SuperblockCxt* cxt, uint64_t off, size_t len);
+
+/*
+ * Match all signatures against the buffers. RAID, LVM2, bcache and LUKS
+ * come first as they contain the filesystem, not the other way round.
+ * Fills up to @max results in that order and returns how many were
+ * stored; the probing stops once @max signatures are found.
+ */
+size_t superblock_probe_all(SuperblockCxt* cxt, SuperblockResult* res, size_t max);
+
+/* best match only, 1 if something was found, 0 if not, -errno */
+int superblock_probe(int fd, SuperblockResult* res);
+
+const char* superblock_usage_to_name(SuperblockUsage usage);
+
+#endif //GRACEFUL_PARTITION_PARTITIONS_SUPERBLOCK_H
@@ -1,4 +1,14 @@
 FILE(GLOB GRACEFUL_PARTITION_PARTITIONS
         ${CMAKE_SOURCE_DIR}/app/partitions/partitions.h ${CMAKE_SOURCE_DIR}/app/partitions/partitions.c
         ${CMAKE_SOURCE_DIR}/app/partitions/partitions-mbr.h ${CMAKE_SOURCE_DIR}/app/partitions/partitions-mbr.c
+        ${CMAKE_SOURCE_DIR}/app/partitions/partitions-gpt.h ${CMAKE_SOURCE_DIR}/app/partitions/partitions-gpt.c
+        ${CMAKE_SOURCE_DIR}/app/partitions/partitions-ebr.h ${CMAKE_SOURCE_DIR}/app/partitions/partitions-ebr.c
+        ${CMAKE_SOURCE_DIR}/app/partitions/partitions-probe.h ${CMAKE_SOURCE_DIR}/app/partitions/partitions-probe.c
+        ${CMAKE_SOURCE_DIR}/app/partitions/partitions-alloc.h ${CMAKE_SOURCE_DIR}/app/partitions/partitions-alloc.c
+        ${CMAKE_SOURCE_DIR}/app/partitions/partitions-scan.h ${CMAKE_SOURCE_DIR}/app/partitions/partitions-scan.c
+        ${CMAKE_SOURCE_DIR}/app/partitions/partitions-edit.h ${CMAKE_SOURCE_DIR}/app/partitions/partitions-edit.c
+        ${CMAKE_SOURCE_DIR}/app/partitions/partitions-journal.h ${CMAKE_SOURCE_DIR}/app/partitions/partitions-journal.c
+        ${CMAKE_SOURCE_DIR}/app/partitions/partitions-blkpg.h ${CMAKE_SOURCE_DIR}/app/partitions/partitions-blkpg.c
+        ${CMAKE_SOURCE_DIR}/app/partitions/partitions-superblock.h ${CMAKE_SOURCE_DIR}/app/partitions/partitions-superblock.c
+        ${CMAKE_SOURCE_DIR}/app/partitions/partitions-move.h ${CMAKE_SOURCE_DIR}/app/partitions/partitions-move.c
         )
\ No newline at end of file
@@ -5,6 +5,14 @@
 #ifndef GRACEFUL_PARTITION_PARTITIONS_H
 #define GRACEFUL_PARTITION_PARTITIONS_H
 #include "partitions-mbr.h"
+#include "partitions-gpt.h"
+#include "partitions-ebr.h"
+#include "partitions-probe.h"
+#include "partitions-alloc.h"
+#include "partitions-edit.h"
+#include "partitions-journal.h"
+#include "partitions-blkpg.h"
+#include "partitions-superblock.h"
 
 #endif //GRACEFUL_PARTITION_PARTITIONS_H
 
@@ -0,0 +1,109 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/partitions/partitions-alloc.h"
+#include "../app/partitions/partitions-gpt.h"
+#include "../app/common/blkdev.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* protective MBR, GPT header and a 128 entry array at both ends */
+#define GPT_RESERVED_SECTORS        34
+
+/**
+ * @brief 按设备的对齐要求在空闲空间中一次放置多个分区, 已有的 GPT 分区保持不动:
+ *        demo-alloc <device|image> <MiB>...
+ *        大小为 0 的分区占用最后剩下的最大空闲区
+ */
+int main (int argc, char* argv[])
+{
+    PartAllocRequest* reqs;
+    PartAllocTopology topo;
+    unsigned char* buf = NULL;
+    uint64_t lastLba, start, size;
+    unsigned long long bytes = 0;
+    size_t i, n, failed;
+    GptTable table;
+    PartAlloc* pa;
+    uint32_t e;
+    int fd, rc;
+
+    if (argc < 3) {
+        printf ("usage: %s <device|image> <MiB>...\n", argv[0]);
+        return -1;
+    }
+
+    fd = open (argv[1], O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror (argv[1]);
+        return -1;
+    }
+
+    rc = palloc_topology_from_fd (&topo, fd);
+    if (rc || blkdev_get_size (fd, &bytes) != 0) {
+        printf ("%s: %s\n", argv[1], strerror (rc ? -rc : EIO));
+        close (fd);
+        return -1;
+    }
+    lastLba = bytes / topo.sectorSize - 1;
+    if (lastLba < 2 * GPT_RESERVED_SECTORS) {
+        printf ("%s: too small\n", argv[1]);
+        close (fd);
+        return -1;
+    }
+
+    pa = palloc_new (GPT_RESERVED_SECTORS, lastLba - GPT_RESERVED_SECTORS + 1, &topo);
+    if (!pa) {
+        close (fd);
+        return -1;
+    }
+    printf ("grain %llu sectors, free %llu-%llu\n", (unsigned long long) pa->grain,
+            (unsigned long long) pa->firstLba, (unsigned long long) pa->lastLba);
+
+    if (gpt_table_read (&table, fd, topo.sectorSize, lastLba, &buf) == 0) {
+        for (e = 0; e < gpt_table_get_nents (&table); e++) {
+            const GptEntry* ent = gpt_table_get_entry (&table, e);
+
+            if (!gpt_entry_is_used (ent))
+                continue;
+            printf ("  used %3u: %llu-%llu\n", e + 1, (unsigned long long) gpt_entry_get_start (ent),
+                    (unsigned long long) gpt_entry_get_end (ent));
+            palloc_add_used (pa, gpt_entry_get_start (ent), gpt_entry_get_size (ent));
+        }
+        free (buf);
+    }
+    close (fd);
+
+    if (palloc_largest_gap (pa, &start, &size) == 0)
+        printf ("largest gap %llu-%llu\n", (unsigned long long) start, (unsigned long long) (start + size - 1));
+
+    n = argc - 2;
+    reqs = calloc (n, sizeof (PartAllocRequest));
+    if (!reqs) {
+        palloc_free (pa);
+        return -1;
+    }
+    for (i = 0; i < n; i++)
+        reqs[i].size = strtoull (argv[i + 2], NULL, 0) * 1024 * 1024 / topo.sectorSize;
+
+    failed = palloc_alloc_batch (pa, reqs, n);
+    for (i = 0; i < n; i++) {
+        if (reqs[i].rc)
+            printf ("  %3zu: %s\n", i + 1, strerror (-reqs[i].rc));
+        else
+            printf ("  %3zu: %llu-%llu (%llu sectors)\n", i + 1, (unsigned long long) reqs[i].start,
+                    (unsigned long long) (reqs[i].start + reqs[i].size - 1), (unsigned long long) reqs[i].size);
+    }
+    printf ("%zu placed, %zu failed, %zu free regions left\n", n - failed, failed, pa->nregions);
+
+    free (reqs);
+    palloc_free (pa);
+
+    return failed ? -1 : 0;
+}
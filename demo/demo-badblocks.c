@@ -0,0 +1,81 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/common/badblocks.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+static void progress (const BadBlocksProgress* p, void* data)
+{
+    (void) data;
+
+    fprintf (stderr, "%llu/%llu MiB, %.1f MiB/s, %llu bad sectors%s\n",
+             (unsigned long long) (p->done >> 20), (unsigned long long) (p->total >> 20),
+             p->bytesPerSec / (1024 * 1024), (unsigned long long) p->nbad, p->direct ? "" : " (buffered)");
+}
+
+/**
+ * @brief 多线程扫描坏扇区, 输出 "起始扇区 扇区数" 列表, 可供分区分配器避开:
+ *        demo-badblocks [-w] [-j threads] [-c chunk] [-o list] <device|image>
+ *        -w 写入测试图案并读回校验 (会破坏数据)
+ */
+int main (int argc, char* argv[])
+{
+    BadBlocksScan opts;
+    const char* out = NULL;
+    BadBlocks bb;
+    FILE* f = stdout;
+    int c, rc;
+
+    memset (&opts, 0, sizeof (opts));
+    opts.func = progress;
+
+    while ((c = getopt (argc, argv, "wj:c:o:h")) != -1) {
+        switch (c) {
+            case 'w':
+                opts.mode = BADBLOCKS_WRITE;
+                break;
+            case 'j':
+                opts.nthreads = strtoul (optarg, NULL, 10);
+                break;
+            case 'c':
+                opts.chunkSize = strtoul (optarg, NULL, 0);
+                break;
+            case 'o':
+                out = optarg;
+                break;
+            default:
+                printf ("usage: %s [-w] [-j threads] [-c chunk] [-o list] <device|image>\n", argv[0]);
+                return -1;
+        }
+    }
+
+    if (optind + 1 != argc) {
+        printf ("usage: %s [-w] [-j threads] [-c chunk] [-o list] <device|image>\n", argv[0]);
+        return -1;
+    }
+
+    rc = badblocks_scan (argv[optind], &opts, &bb, NULL);
+    if (rc) {
+        printf ("%s: %s\n", argv[optind], strerror (-rc));
+        badblocks_deinit (&bb);
+        return -1;
+    }
+
+    if (out && !(f = fopen (out, "w"))) {
+        perror (out);
+        badblocks_deinit (&bb);
+        return -1;
+    }
+    fprintf (f, "# %s: %u byte sectors\n", argv[optind], bb.sectorSize);
+    rc = badblocks_write_list (&bb, f);
+    if (f != stdout)
+        fclose (f);
+    badblocks_deinit (&bb);
+
+    return rc ? -1 : 0;
+}
@@ -0,0 +1,105 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/common/blkbench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+static void print_point (const BlkBenchResult* r, void* data)
+{
+    (void) data;
+
+    fprintf (stderr, "%-9s bs %-8u qd %-3u %9.1f MiB/s %9.0f iops  avg %.1f p99 %.1f max %.1f us%s\n",
+             blkbench_pattern_to_name (r->pattern), r->blockSize, r->depth,
+             r->bytesPerSec / (1024 * 1024), r->iops, r->latAvg, r->lat[2], r->latMax,
+             r->rc ? " (error)" : "");
+}
+
+static void parse_list (const char* s, unsigned int* out)
+{
+    char* end;
+    int i;
+
+    for (i = 0; i < BLKBENCH_MAX_POINTS && *s; i++) {
+        unsigned long v = strtoul (s, &end, 0);
+
+        if (*end == 'k' || *end == 'K')
+            v <<= 10, end++;
+        else if (*end == 'm' || *end == 'M')
+            v <<= 20, end++;
+        out[i] = (unsigned int) v;
+        s = *end == ',' ? end + 1 : end;
+        if (end == s && *s)
+            break;
+    }
+}
+
+/**
+ * @brief 测试设备或镜像文件的顺序/随机读写吞吐量与延迟分布, 输出设备性能概要:
+ *        demo-bench [-w] [-B] [-t ms] [-b 4k,64k,1m] [-q 1,4,16] [-o profile] <device|image>
+ *        -w 同时测试写入 (会破坏数据), -B 不使用 O_DIRECT
+ */
+int main (int argc, char* argv[])
+{
+    BlkBenchResult res[BLKBENCH_NPATTERNS * BLKBENCH_MAX_POINTS * BLKBENCH_MAX_POINTS];
+    const char* out = NULL;
+    BlkBenchInfo info;
+    BlkBench opts;
+    FILE* f = stdout;
+    size_t n = 0;
+    int c, rc;
+
+    memset (&opts, 0, sizeof (opts));
+    opts.func = print_point;
+
+    while ((c = getopt (argc, argv, "wBt:b:q:o:h")) != -1) {
+        switch (c) {
+            case 'w':
+                opts.write = 1;
+                break;
+            case 'B':
+                opts.buffered = 1;
+                break;
+            case 't':
+                opts.runtimeMs = strtoul (optarg, NULL, 10);
+                break;
+            case 'b':
+                parse_list (optarg, opts.blockSizes);
+                break;
+            case 'q':
+                parse_list (optarg, opts.depths);
+                break;
+            case 'o':
+                out = optarg;
+                break;
+            default:
+                printf ("usage: %s [-w] [-B] [-t ms] [-b sizes] [-q depths] [-o profile] <device|image>\n", argv[0]);
+                return -1;
+        }
+    }
+
+    if (optind + 1 != argc) {
+        printf ("usage: %s [-w] [-B] [-t ms] [-b sizes] [-q depths] [-o profile] <device|image>\n", argv[0]);
+        return -1;
+    }
+
+    rc = blkbench_run (argv[optind], &opts, &info, res, sizeof (res) / sizeof (res[0]), &n);
+    if (rc) {
+        printf ("%s: %s\n", argv[optind], strerror (-rc));
+        return -1;
+    }
+
+    if (out && !(f = fopen (out, "w"))) {
+        perror (out);
+        return -1;
+    }
+    rc = blkbench_write_profile (f, argv[optind], &info, res, n);
+    if (f != stdout)
+        fclose (f);
+
+    return rc ? -1 : 0;
+}
@@ -0,0 +1,181 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/partitions/partitions-blkpg.h"
+#include "../app/partitions/partitions-mbr.h"
+#include "../app/common/blkdev.h"
+#include "../app/common/path.h"
+#include "../app/common/path-name.h"
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+static const char* delta_name (PartDeltaType type)
+{
+    switch (type) {
+        case PART_DELTA_DEL:
+            return "delete";
+        case PART_DELTA_RESIZE:
+            return "resize";
+        case PART_DELTA_ADD:
+            return "add";
+    }
+
+    return "unknown";
+}
+
+/* the partitions the kernel knows of, sysfs counts in 512 byte sectors */
+static int kernel_layout (dev_t disk, unsigned int sectorSize, PartLayout** parts)
+{
+    PartLayout* res = NULL;
+    struct dirent* d;
+    PathCxt* pc;
+    DIR* dir;
+    int n = 0;
+
+    pc = path_new_path (_PATH_SYS_DEVBLOCK "/%d:%d", major (disk), minor (disk));
+    if (!pc)
+        return -1;
+    dir = path_opendir (pc, NULL);
+    if (!dir) {
+        path_unref_path (pc);
+        return -1;
+    }
+
+    while ((d = readdir (dir))) {
+        int32_t partno;
+        uint64_t start, size;
+        PartLayout* tmp;
+
+        if (path_readf_s32 (pc, &partno, "%s/partition", d->d_name) != 0
+            || path_readf_u64 (pc, &start, "%s/start", d->d_name) != 0
+            || path_readf_u64 (pc, &size, "%s/size", d->d_name) != 0)
+            continue;
+
+        tmp = realloc (res, sizeof (PartLayout) * (n + 1));
+        if (!tmp)
+            break;
+        res = tmp;
+        res[n].partno = partno;
+        res[n].start = start * 512 / sectorSize;
+        res[n].size = size * 512 / sectorSize;
+        n++;
+    }
+    closedir (dir);
+    path_unref_path (pc);
+
+    *parts = res;
+
+    return n;
+}
+
+/**
+ * @brief 只用最少的 BLKPG 操作让内核中的分区与磁盘上的分区表 (GPT 或 MBR) 一致, 不影响其它正在使用的分区:
+ *        demo-blkpg [-n] <disk>
+ *        -n 只打印需要的操作, 不执行
+ */
+int main (int argc, char* argv[])
+{
+    PartLayout* disk = NULL, *kernel = NULL;
+    unsigned long long bytes = 0;
+    unsigned char* buf = NULL;
+    unsigned char mbr[512];
+    PartDelta* deltas = NULL;
+    int c, fd, ss = 0, dry = 0;
+    int ndisk, nkernel, n, rc;
+    struct stat st;
+    GptTable table;
+    size_t done, i;
+
+    while ((c = getopt (argc, argv, "nh")) != -1) {
+        switch (c) {
+            case 'n':
+                dry = 1;
+                break;
+            default:
+                printf ("usage: %s [-n] <disk>\n", argv[0]);
+                return -1;
+        }
+    }
+
+    if (optind + 1 != argc) {
+        printf ("usage: %s [-n] <disk>\n", argv[0]);
+        return -1;
+    }
+
+    fd = open (argv[optind], O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat (fd, &st) != 0) {
+        perror (argv[optind]);
+        return -1;
+    }
+    if (!S_ISBLK (st.st_mode)) {
+        printf ("%s: not a block device\n", argv[optind]);
+        close (fd);
+        return -1;
+    }
+    if (blkdev_get_sector_size (fd, &ss) != 0 || ss <= 0)
+        ss = 512;
+    blkdev_get_size (fd, &bytes);
+
+    if (gpt_table_read (&table, fd, ss, bytes / ss - 1, &buf) == 0) {
+        ndisk = blkpg_layout_from_gpt (&table, &disk);
+        printf ("gpt: %d partitions\n", ndisk);
+    } else if (pread (fd, mbr, sizeof (mbr), 0) == sizeof (mbr) && mbr_is_valid_magic (mbr)) {
+        ndisk = blkpg_layout_from_mbr (fd, ss, mbr, &disk);
+        printf ("dos: %d partitions\n", ndisk);
+    } else {
+        /* no label, the kernel should not have any partition either */
+        ndisk = 0;
+        printf ("no partition table\n");
+    }
+    if (ndisk < 0) {
+        printf ("%s: %s\n", argv[optind], strerror (-ndisk));
+        free (buf);
+        close (fd);
+        return -1;
+    }
+
+    nkernel = kernel_layout (st.st_rdev, ss, &kernel);
+    if (nkernel < 0) {
+        printf ("%s: cannot read the partitions from sysfs\n", argv[optind]);
+        free (disk);
+        free (buf);
+        close (fd);
+        return -1;
+    }
+    printf ("kernel: %d partitions\n", nkernel);
+
+    rc = 0;
+    n = blkpg_diff (kernel, nkernel, disk, ndisk, &deltas);
+    if (n < 0)
+        rc = n;
+    for (i = 0; n > 0 && i < (size_t) n; i++) {
+        printf ("  %-6s %3d: start=%-12llu size=%llu\n", delta_name (deltas[i].type), deltas[i].part.partno,
+                (unsigned long long) deltas[i].part.start, (unsigned long long) deltas[i].part.size);
+    }
+
+    if (n > 0 && !dry) {
+        rc = blkpg_apply (fd, ss, deltas, n, &done);
+        printf ("%zu of %d operations applied\n", done, n);
+    } else if (!n) {
+        printf ("nothing to do\n");
+    }
+    if (rc)
+        printf ("%s: %s\n", argv[optind], strerror (-rc));
+
+    free (deltas);
+    free (kernel);
+    free (disk);
+    free (buf);
+    close (fd);
+
+    return rc ? -1 : 0;
+}
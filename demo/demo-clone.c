@@ -0,0 +1,77 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/common/blkclone.h"
+#include "../app/common/buffer-zero.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+static void progress (const BlkCloneProgress* p, void* data)
+{
+    (void) data;
+
+    fprintf (stderr, "%llu/%llu MiB, %.1f MiB/s, %llu MiB data, %llu MiB zero (%s)%s\n",
+             (unsigned long long) (p->done >> 20), (unsigned long long) (p->total >> 20),
+             p->bytesPerSec / (1024 * 1024), (unsigned long long) (p->written >> 20),
+             (unsigned long long) (p->zeroed >> 20), blkclone_zero_to_name (p->method),
+             p->direct ? "" : " (buffered)");
+}
+
+/**
+ * @brief 克隆磁盘或镜像文件, 全零块不写入: 目标为文件时留空洞, 为块设备时用 BLKZEROOUT 或 discard:
+ *        demo-clone [-S] [-d] [-c chunk] [-b block] [-n buffers] <source> <target>
+ *        -S 全零块也照常写入, -d 目标设备上的全零区间用 discard (仅当设备读回 discard 区域为零时使用)
+ */
+int main (int argc, char* argv[])
+{
+    BlkCloneProgress p;
+    BlkClone opts;
+    int c, rc;
+
+    memset (&opts, 0, sizeof (opts));
+    opts.func = progress;
+
+    while ((c = getopt (argc, argv, "Sdc:b:n:h")) != -1) {
+        switch (c) {
+            case 'S':
+                opts.noSparse = 1;
+                break;
+            case 'd':
+                opts.discard = 1;
+                break;
+            case 'c':
+                opts.chunkSize = strtoul (optarg, NULL, 0);
+                break;
+            case 'b':
+                opts.blockSize = strtoul (optarg, NULL, 0);
+                break;
+            case 'n':
+                opts.nbuffers = strtoul (optarg, NULL, 10);
+                break;
+            default:
+                printf ("usage: %s [-S] [-d] [-c chunk] [-b block] [-n buffers] <source> <target>\n", argv[0]);
+                return -1;
+        }
+    }
+
+    if (optind + 2 != argc) {
+        printf ("usage: %s [-S] [-d] [-c chunk] [-b block] [-n buffers] <source> <target>\n", argv[0]);
+        return -1;
+    }
+
+    rc = blkclone_run (argv[optind], argv[optind + 1], &opts, &p);
+    if (rc) {
+        printf ("%s -> %s: %s\n", argv[optind], argv[optind + 1], strerror (-rc));
+        return -1;
+    }
+
+    printf ("%llu bytes, %llu written, %llu zero of which %llu never read (%s, %s zero check), %.2f s\n",
+            (unsigned long long) p.done, (unsigned long long) p.written, (unsigned long long) p.zeroed,
+            (unsigned long long) p.skipped, blkclone_zero_to_name (p.method), buffer_is_zero_impl (), p.seconds);
+
+    return 0;
+}
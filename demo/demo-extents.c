@@ -0,0 +1,55 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/common/extents.h"
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief 列出镜像文件中实际有数据的区间 (跳过空洞与未写入的预分配区间):
+ *        demo-extents [-f] <image>
+ *        -f 不使用 SEEK_DATA/SEEK_HOLE, 直接用 FIEMAP
+ */
+int main (int argc, char* argv[])
+{
+    uint64_t bytes = 0;
+    int fd, rc, flags = 0;
+    const char* path;
+    ExtentIter it;
+    Extent ext;
+
+    if (argc == 3 && !strcmp (argv[1], "-f")) {
+        flags = EXTENT_ITER_NO_SEEK;
+    } else if (argc != 2) {
+        printf ("usage: %s [-f] <image>\n", argv[0]);
+        return -1;
+    }
+    path = argv[argc - 1];
+
+    fd = open (path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror (path);
+        return -1;
+    }
+
+    rc = extent_iter_init (&it, fd, 0, 0, flags);
+    while (!rc && (rc = extent_iter_next (&it, &ext)) > 0) {
+        printf ("%20llu %20llu\n", (unsigned long long) ext.offset, (unsigned long long) ext.length);
+        bytes += ext.length;
+        rc = 0;
+    }
+    if (rc) {
+        printf ("%s: %s\n", path, strerror (-rc));
+    } else {
+        printf ("%s: %llu of %llu bytes hold data (%s)\n", path, (unsigned long long) bytes,
+                (unsigned long long) it.end, extent_iter_method_to_name (it.method));
+    }
+    extent_iter_deinit (&it);
+    close (fd);
+
+    return rc ? -1 : 0;
+}
@@ -4,8 +4,65 @@
 
 #include "../app/common/file-utils.h"
 
+#include <time.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+static double now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief 用 ul_copy_file () 复制文件, 普通文件之间只读写有数据的区间, 空洞保持为空洞:
+ *        demo-file-utils <from> <to>
+ *        输出两个文件的大小与实际占用的空间
+ */
 int main (int argc, char* argv[])
 {
+    struct stat in, out;
+    int from, to, rc;
+    double t;
+
+    if (argc != 3) {
+        printf ("usage: %s <from> <to>\n", argv[0]);
+        return -1;
+    }
+
+    from = open (argv[1], O_RDONLY | O_CLOEXEC);
+    if (from < 0) {
+        perror (argv[1]);
+        return -1;
+    }
+    to = open (argv[2], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (to < 0) {
+        perror (argv[2]);
+        close (from);
+        return -1;
+    }
+
+    t = now ();
+    rc = ul_copy_file (from, to);
+    t = now () - t;
+    if (rc == UL_COPY_READ_ERROR)
+        printf ("%s: read error: %s\n", argv[1], strerror (errno));
+    else if (rc == UL_COPY_WRITE_ERROR)
+        printf ("%s: write error: %s\n", argv[2], strerror (errno));
+
+    if (!rc && fstat (from, &in) == 0 && fstat (to, &out) == 0) {
+        printf ("%s: %lld bytes, %lld allocated\n", argv[1], (long long) in.st_size, (long long) in.st_blocks * 512);
+        printf ("%s: %lld bytes, %lld allocated\n", argv[2], (long long) out.st_size, (long long) out.st_blocks * 512);
+        printf ("copied in %.3f s\n", t);
+    }
+    close (to);
+    close (from);
 
-    return 0;
-}
\ No newline at end of file
+    return rc ? -1 : 0;
+}
@@ -0,0 +1,64 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/partitions/partitions-gpt.h"
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * @brief 打印设备或镜像中的 GPT 分区表: demo-gpt <device|image> [sector size]
+ */
+int main (int argc, char* argv[])
+{
+    int fd, rc;
+    off_t size;
+    GptTable table;
+    uint32_t i;
+    unsigned char* buf = NULL;
+    unsigned int sectorSize = 512;
+    char name[GPT_PART_NAME_LEN * 4 + 1], guid[37];
+
+    if (argc < 2) {
+        printf ("usage: %s <device|image> [sector size]\n", argv[0]);
+        return -1;
+    }
+    if (argc > 2)
+        sectorSize = atoi (argv[2]);
+
+    fd = open (argv[1], O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror ("open");
+        return -1;
+    }
+
+    size = lseek (fd, 0, SEEK_END);
+    rc = gpt_table_read (&table, fd, sectorSize, size > 0 ? size / sectorSize - 1 : 0, &buf);
+    close (fd);
+    if (rc) {
+        printf ("no valid GPT: %d\n", rc);
+        return -1;
+    }
+
+    printf ("disk guid: %s\n", gpt_guid_to_string (&table.header->diskGuid, guid));
+    printf ("entries: %u (%u used)\n", gpt_table_get_nents (&table), gpt_table_count_used (&table));
+
+    for (i = 0; i < gpt_table_get_nents (&table); i++) {
+        const GptEntry* e = gpt_table_get_entry (&table, i);
+        if (!gpt_entry_is_used (e))
+            continue;
+
+        gpt_entry_get_name (e, name, sizeof (name));
+        printf ("  %3u: start=%-12llu size=%-12llu type=%s name=\"%s\"\n", i + 1,
+                (unsigned long long) gpt_entry_get_start (e),
+                (unsigned long long) gpt_entry_get_size (e),
+                gpt_guid_to_string (&e->typeGuid, guid), name);
+    }
+
+    free (buf);
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/partitions/partitions-edit.h"
+#include "../app/partitions/partitions-journal.h"
+#include "../app/common/bitops.h"
+#include "../app/common/blkdev.h"
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+/**
+ * @brief 修改 GPT 分区的名字, 只写回内容真正改变的扇区; 指定 -j 时先写撤销日志, 中途失败可以回滚:
+ *        demo-label-edit [-j journal] <device|image> <partno> <name>
+ *        demo-label-edit -R <journal> <device|image>      崩溃后用日志恢复原来的扇区
+ */
+int main (int argc, char* argv[])
+{
+    const char* journal = NULL;
+    unsigned long long bytes = 0;
+    LabelWriteRun* runs = NULL;
+    int c, fd, ss = 0, replay = 0;
+    int partno, nruns, rc;
+    size_t i, dirty;
+    GptEntry* e;
+    GptEdit ge;
+
+    while ((c = getopt (argc, argv, "j:Rh")) != -1) {
+        switch (c) {
+            case 'j':
+                journal = optarg;
+                break;
+            case 'R':
+                replay = 1;
+                break;
+            default:
+                goto usage;
+        }
+    }
+
+    if (replay) {
+        if (optind + 2 != argc)
+            goto usage;
+        fd = open (argv[optind + 1], O_RDWR | O_CLOEXEC);
+        if (fd < 0) {
+            perror (argv[optind + 1]);
+            return -1;
+        }
+        rc = label_journal_replay (argv[optind], fd);
+        close (fd);
+        if (rc < 0)
+            printf ("%s: %s\n", argv[optind], strerror (-rc));
+        else
+            printf (rc ? "rolled back\n" : "nothing to do\n");
+        return rc < 0 ? -1 : 0;
+    }
+
+    if (optind + 3 != argc)
+        goto usage;
+
+    fd = open (argv[optind], O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        perror (argv[optind]);
+        return -1;
+    }
+    if (blkdev_get_sector_size (fd, &ss) != 0 || ss <= 0)
+        ss = 512;
+    blkdev_get_size (fd, &bytes);
+
+    rc = gpt_edit_init (&ge, fd, ss, bytes / ss - 1);
+    if (rc) {
+        printf ("%s: no valid GPT: %s\n", argv[optind], strerror (-rc));
+        close (fd);
+        return -1;
+    }
+
+    partno = atoi (argv[optind + 1]);
+    e = partno > 0 ? gpt_edit_get_entry (&ge, partno - 1) : NULL;
+    if (!e) {
+        printf ("%s: no partition %d\n", argv[optind], partno);
+        rc = -1;
+        goto done;
+    }
+
+    /* ASCII only, each character becomes one UTF-16LE code unit */
+    memset (e->name, 0, sizeof (e->name));
+    for (i = 0; argv[optind + 2][i] && i < GPT_PART_NAME_LEN; i++)
+        e->name[i] = cpu_to_le16 ((unsigned char) argv[optind + 2][i]);
+    gpt_edit_update (&ge);
+
+    dirty = label_edit_update_dirty (&ge.edit);
+    nruns = label_edit_get_runs (&ge.edit, &runs);
+    printf ("%zu dirty sectors in %d runs\n", dirty, nruns);
+    for (i = 0; nruns > 0 && i < (size_t) nruns; i++)
+        printf ("  %12llu +%zu\n", (unsigned long long) runs[i].offset, runs[i].size);
+    free (runs);
+
+    rc = journal ? label_edit_commit_journaled (&ge.edit, journal) : label_edit_commit (&ge.edit);
+    if (rc)
+        printf ("%s: %s\n", argv[optind], strerror (-rc));
+
+done:
+    gpt_edit_deinit (&ge);
+    close (fd);
+
+    return rc ? -1 : 0;
+
+usage:
+    printf ("usage: %s [-j journal] <device|image> <partno> <name>\n"
+            "       %s -R <journal> <device|image>\n", argv[0], argv[0]);
+    return -1;
+}
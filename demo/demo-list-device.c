@@ -5,10 +5,14 @@
 > Created Time: 2022年02月14日 星期一 11时55分11秒
  ************************************************************************/
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <stdlib.h>
 #include <parted/parted.h>
 #include <parted/filesys.h>
 
+#include "../app/partitions/partitions-superblock.h"
+
 /**
  * @brief 执行需要 root 权限，否则没有任何输出
  */
@@ -49,16 +53,25 @@ int main (int argc, char* argv[])
             cur1 = next1;
             next1 = NULL;
 
-            const PedFileSystemType* fsType = cur1->fs_type;
-            if (!fsType) continue;
+            if (cur1->num <= 0) continue;
+            // libparted 不识别 md/LUKS/LVM, 直接读超级块
+            char* path = ped_partition_get_path (cur1);
+            SuperblockResult sb;
+            int fd = path ? open (path, O_RDONLY | O_CLOEXEC) : -1;
+            int found = fd >= 0 && superblock_probe (fd, &sb) > 0;
+            if (fd >= 0) close (fd);
+            if (!found) { free (path); continue; }
             const char* name= ped_partition_type_get_name (cur1->type);
 
-            printf ("    %s:\n", ped_partition_get_path (cur1));
+            printf ("    %s:\n", path);
             printf ("      is busy: %s\n", ped_partition_is_busy (cur1) ? "yes" : "no");
             printf ("      is active: %s\n", ped_partition_is_active (cur1) ? "yes" : "no");
-            printf ("      filesystem type: %s\n", fsType->name);
+            printf ("      filesystem type: %s\n", sb.type);
+            printf ("      uuid: %s\n", sb.uuid);
+            printf ("      label: %s\n", sb.label);
             printf ("      partition type: \"%s\"\n", name? name : "<unknown>");
             printf ("\n");
+            free (path);
         }
 
         printf ("\n");
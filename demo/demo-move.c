@@ -0,0 +1,102 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/partitions/partitions-move.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+static unsigned long long parse_size (const char* s)
+{
+    char* end;
+    unsigned long long v = strtoull (s, &end, 0);
+
+    switch (*end) {
+        case 'g': case 'G':
+            v <<= 10;
+            /* fall through */
+        case 'm': case 'M':
+            v <<= 10;
+            /* fall through */
+        case 'k': case 'K':
+            v <<= 10;
+            break;
+        default:
+            break;
+    }
+
+    return v;
+}
+
+static void progress (const PartMoveProgress* p, void* data)
+{
+    (void) data;
+
+    fprintf (stderr, "%llu/%llu MiB, %.1f MiB/s, chunk %u, %llu checkpoints%s%s\n",
+             (unsigned long long) (p->done >> 20), (unsigned long long) (p->total >> 20),
+             p->bytesPerSec / (1024 * 1024), p->chunkSize, (unsigned long long) p->checkpoints,
+             p->backward ? ", backward" : "", p->direct ? "" : " (buffered)");
+}
+
+/**
+ * @brief 在设备或镜像内移动一段数据 (例如平移分区), 源与目标可重叠; 指定检查点文件后, 中断 (掉电) 再次运行会从断点继续:
+ *        demo-move [-c chunk] [-n buffers] [-k checkpoint] [-K bytes] <device|image> <src> <dst> <length>
+ *        偏移与长度单位为字节, 可带 k/m/g 后缀
+ */
+int main (int argc, char* argv[])
+{
+    PartMoveCheckpoint cp;
+    PartMoveProgress p;
+    PartMove opts;
+    int c, rc;
+
+    memset (&opts, 0, sizeof (opts));
+    opts.func = progress;
+
+    while ((c = getopt (argc, argv, "c:n:k:K:h")) != -1) {
+        switch (c) {
+            case 'c':
+                opts.chunkSize = (unsigned int) parse_size (optarg);
+                break;
+            case 'n':
+                opts.nbuffers = strtoul (optarg, NULL, 10);
+                break;
+            case 'k':
+                opts.checkpoint = optarg;
+                break;
+            case 'K':
+                opts.checkpointBytes = parse_size (optarg);
+                break;
+            default:
+                printf ("usage: %s [-c chunk] [-n buffers] [-k checkpoint] [-K bytes] <device|image> <src> <dst> <length>\n", argv[0]);
+                return -1;
+        }
+    }
+
+    if (optind + 4 != argc) {
+        printf ("usage: %s [-c chunk] [-n buffers] [-k checkpoint] [-K bytes] <device|image> <src> <dst> <length>\n", argv[0]);
+        return -1;
+    }
+    opts.src = parse_size (argv[optind + 1]);
+    opts.dst = parse_size (argv[optind + 2]);
+    opts.length = parse_size (argv[optind + 3]);
+
+    if (opts.checkpoint && part_move_checkpoint_read (opts.checkpoint, &cp) > 0) {
+        printf ("resuming %llu -> %llu at %llu of %llu bytes\n", (unsigned long long) cp.src,
+                (unsigned long long) cp.dst, (unsigned long long) cp.done, (unsigned long long) cp.length);
+    }
+
+    rc = part_move_run (argv[optind], &opts, &p);
+    if (rc) {
+        printf ("%s: %s\n", argv[optind], strerror (-rc));
+        return -1;
+    }
+
+    printf ("%llu bytes moved (%llu resumed), %.1f MiB/s, %llu checkpoints\n", (unsigned long long) p.done,
+            (unsigned long long) p.resumed, p.bytesPerSec / (1024 * 1024), (unsigned long long) p.checkpoints);
+
+    return 0;
+}
@@ -4,8 +4,45 @@
 
 #include "../app/partitions/partitions.h"
 
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief 探测设备或镜像上的分区表类型: demo-partition <device|image>...
+ */
 int main (int argc, char* argv[])
 {
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        ProbeCxt pr;
+        ProbeResult res[4];
+        size_t n, j;
+        int fd, rc;
+
+        fd = open (argv[i], O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            perror (argv[i]);
+            continue;
+        }
+
+        rc = probe_init (&pr, fd, 0, 512);
+        if (rc) {
+            printf ("%s: probe failed: %d\n", argv[i], rc);
+            close (fd);
+            continue;
+        }
+
+        n = probe_label_all (&pr, res, sizeof (res) / sizeof (res[0]));
+        printf ("%s:", argv[i]);
+        for (j = 0; j < n; j++)
+            printf (" %s(%d)", res[j].name, res[j].confidence);
+        printf ("%s\n", n ? "" : " <none>");
+
+        probe_deinit (&pr);
+        close (fd);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
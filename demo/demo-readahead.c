@@ -0,0 +1,96 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/common/blkra.h"
+
+#include <time.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#define BUF_SIZE        (1024 * 1024)
+
+static double now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief 在提高预读 (按 io_opt 计算) 的范围内顺序读取设备, 结束后恢复原值; -R 恢复异常退出的进程留下的预读设置:
+ *        demo-readahead [-R] [-l length] <device|image>
+ */
+int main (int argc, char* argv[])
+{
+    unsigned long long length = 0, done = 0;
+    static char buf[BUF_SIZE];
+    BlkReadahead ra;
+    double t;
+    ssize_t n;
+    int c, fd, rc;
+
+    while ((c = getopt (argc, argv, "Rl:h")) != -1) {
+        switch (c) {
+            case 'R':
+                rc = blkra_recover ();
+                if (rc < 0) {
+                    printf ("recover: %s\n", strerror (-rc));
+                    return -1;
+                }
+                printf ("%d disks restored\n", rc);
+                return 0;
+            case 'l':
+                length = strtoull (optarg, NULL, 0);
+                break;
+            default:
+                printf ("usage: %s [-R] [-l length] <device|image>\n", argv[0]);
+                return -1;
+        }
+    }
+
+    if (optind + 1 != argc) {
+        printf ("usage: %s [-R] [-l length] <device|image>\n", argv[0]);
+        return -1;
+    }
+
+    fd = open (argv[optind], O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror (argv[optind]);
+        return -1;
+    }
+
+    rc = blkra_begin (&ra, fd, 0, length);
+    if (rc)
+        printf ("readahead left at %lu KiB: %s\n", ra.orig / 2, strerror (-rc));
+    else if (!ra.disk)
+        printf ("not a block device, fadvise hints only\n");
+    else if (ra.raised)
+        printf ("readahead %lu KiB -> %lu KiB\n", ra.orig / 2, ra.raised / 2);
+    else
+        printf ("readahead %lu KiB, left alone\n", ra.orig / 2);
+
+    t = now ();
+    while (!length || done < length) {
+        n = read (fd, buf, length && length - done < BUF_SIZE ? length - done : BUF_SIZE);
+        if (n <= 0)
+            break;
+        blkra_drop (&ra, done, n);
+        done += n;
+    }
+    t = now () - t;
+    printf ("%llu MiB in %.2f s, %.1f MiB/s\n", done >> 20, t, t > 0 ? done / t / (1024 * 1024) : 0);
+
+    rc = blkra_end (&ra);
+    if (rc)
+        printf ("restore: %s\n", strerror (-rc));
+    close (fd);
+
+    return rc ? -1 : 0;
+}
@@ -0,0 +1,79 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/partitions/partitions-scan.h"
+
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+static void print_record (const ScanRecord* rec, void* data)
+{
+    char line[PATH_MAX + 128];
+    BlkCacheStats* total = data;
+
+    scan_record_format (rec, line, sizeof (line));
+    puts (line);
+
+    total->hits += rec->cache.hits;
+    total->misses += rec->cache.misses;
+    total->evictions += rec->cache.evictions;
+    total->reads += rec->cache.reads;
+    total->bytesRead += rec->cache.bytesRead;
+}
+
+/**
+ * @brief 并行扫描目录或文件列表中镜像的分区表: demo-scan [-j threads | -q depth] <dir|image>...
+ *        -q 使用 io_uring (或线程池) 在单线程中异步扫描
+ *        最后输出扇区缓存 (blkcache) 的命中统计
+ */
+int main (int argc, char* argv[])
+{
+    BlkCacheStats total = { 0 };
+    int c, rc;
+    struct stat st;
+    unsigned int nthreads = 0;
+    unsigned int depth = 0;
+    int async = 0;
+
+    while ((c = getopt (argc, argv, "j:q:h")) != -1) {
+        switch (c) {
+            case 'j':
+                nthreads = strtoul (optarg, NULL, 10);
+                break;
+            case 'q':
+                depth = strtoul (optarg, NULL, 10);
+                async = 1;
+                break;
+            default:
+                printf ("usage: %s [-j threads | -q depth] <dir|image>...\n", argv[0]);
+                return -1;
+        }
+    }
+
+    if (optind == argc) {
+        printf ("usage: %s [-j threads | -q depth] <dir|image>...\n", argv[0]);
+        return -1;
+    }
+
+    if (optind + 1 == argc && stat (argv[optind], &st) == 0 && S_ISDIR(st.st_mode))
+        rc = async ? scan_directory_async (argv[optind], depth, print_record, &total)
+                   : scan_directory (argv[optind], nthreads, print_record, &total);
+    else if (async)
+        rc = scan_images_async ((const char* const*) argv + optind, argc - optind, depth, print_record, &total);
+    else
+        rc = scan_images ((const char* const*) argv + optind, argc - optind, nthreads, print_record, &total);
+
+    if (rc)
+        printf ("scan failed: %d\n", rc);
+    else
+        printf ("block cache: %llu hits, %llu misses, %llu evictions, %llu reads, %llu KiB\n",
+                (unsigned long long) total.hits, (unsigned long long) total.misses,
+                (unsigned long long) total.evictions, (unsigned long long) total.reads,
+                (unsigned long long) total.bytesRead >> 10);
+
+    return rc ? -1 : 0;
+}
@@ -0,0 +1,59 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/common/blkwipe.h"
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void progress (const BlkWipeProgress* p, void* data)
+{
+    (void) data;
+
+    printf ("%llu/%llu MiB, %.1f MiB/s (%s)\n",
+            (unsigned long long) (p->done >> 20), (unsigned long long) (p->total >> 20),
+            p->bytesPerSec / (1024 * 1024), blkwipe_method_to_name (p->method));
+}
+
+/**
+ * @brief 并行 discard/zero-out 设备或镜像文件: demo-wipe <discard|zeroout|secdiscard> <device> [threads]
+ */
+int main (int argc, char* argv[])
+{
+    BlkWipe opts;
+    int fd, rc;
+
+    if (argc < 3) {
+        printf ("usage: %s <discard|zeroout|secdiscard> <device> [threads]\n", argv[0]);
+        return -1;
+    }
+
+    memset (&opts, 0, sizeof (opts));
+    if (!strcmp (argv[1], "zeroout"))
+        opts.op = BLKWIPE_ZEROOUT;
+    else if (!strcmp (argv[1], "secdiscard"))
+        opts.op = BLKWIPE_SECDISCARD;
+    else
+        opts.op = BLKWIPE_DISCARD;
+    opts.nthreads = argc > 3 ? (unsigned int) atoi (argv[3]) : 0;
+    opts.func = progress;
+
+    fd = open (argv[2], O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        perror (argv[2]);
+        return -1;
+    }
+
+    rc = blkwipe_run (fd, &opts, NULL);
+    close (fd);
+    if (rc) {
+        printf ("%s: %s\n", argv[2], strerror (-rc));
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include "../app/common/blkzone.h"
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief 统计 zoned 设备(SMR/ZNS)的 zone 状态: demo-zones <device>
+ */
+int main (int argc, char* argv[])
+{
+    int i, fd, rc;
+    BlkZoneStats st;
+
+    if (argc != 2) {
+        printf ("usage: %s <device>\n", argv[0]);
+        return -1;
+    }
+
+    fd = open (argv[1], O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror (argv[1]);
+        return -1;
+    }
+
+    rc = blkzone_get_stats (fd, &st);
+    close (fd);
+    if (rc) {
+        printf ("%s: %s\n", argv[1], strerror (-rc));
+        return -1;
+    }
+
+    printf ("zones: %llu (conventional %llu, seq-required %llu, seq-preferred %llu)\n",
+            (unsigned long long) st.nzones, (unsigned long long) st.nconventional,
+            (unsigned long long) st.nseqRequired, (unsigned long long) st.nseqPreferred);
+    printf ("zone size: %llu sectors\n", (unsigned long long) st.zoneSectors);
+    printf ("empty %llu, implicit-open %llu, explicit-open %llu, closed %llu, full %llu, read-only %llu, offline %llu\n",
+            (unsigned long long) st.nempty, (unsigned long long) st.nimpOpen, (unsigned long long) st.nexpOpen,
+            (unsigned long long) st.nclosed, (unsigned long long) st.nfull, (unsigned long long) st.nreadOnly,
+            (unsigned long long) st.noffline);
+    printf ("written: %llu of %llu sectors\n",
+            (unsigned long long) st.writtenSectors, (unsigned long long) st.capacitySectors);
+
+    printf ("write pointers:");
+    for (i = 0; i < BLKZONE_WP_BUCKETS; i++)
+        printf (" %d%%:%llu", i * 100 / BLKZONE_WP_BUCKETS, (unsigned long long) st.wpHistogram[i]);
+    printf ("\n");
+
+    return 0;
+}
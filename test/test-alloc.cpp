@@ -0,0 +1,168 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include "../app/partitions/partitions-alloc.h"
+}
+
+/* 512 byte sectors and a 1 MiB grain: 2048 sectors */
+#define GRAIN       2048
+
+static PartAlloc* new_alloc(void)
+{
+    PartAllocTopology topo = { 512, 512, 0, 0, 0 };
+
+    /* like a 1 GiB GPT disk, the label at both ends is never free */
+    return palloc_new(34, 2097151 - 33, &topo);
+}
+
+TEST(TestAlloc, FirstFitIsAligned) {
+    PartAlloc* pa = new_alloc();
+    uint64_t start;
+
+    ASSERT_NE(pa, nullptr);
+    EXPECT_EQ(pa->grain, (uint64_t) GRAIN);
+    EXPECT_EQ(palloc_align_up(pa, 34), (uint64_t) GRAIN);
+    ASSERT_EQ(palloc_first_fit(pa, 1000, &start), 0);
+    EXPECT_EQ(start, (uint64_t) GRAIN);
+    palloc_free(pa);
+}
+
+TEST(TestAlloc, AllocSplitsAndFrees) {
+    PartAlloc* pa = new_alloc();
+    uint64_t a, b, c;
+
+    ASSERT_EQ(palloc_alloc(pa, GRAIN, &a), 0);
+    ASSERT_EQ(palloc_alloc(pa, GRAIN, &b), 0);
+    ASSERT_EQ(palloc_alloc(pa, GRAIN, &c), 0);
+    EXPECT_EQ(a, (uint64_t) GRAIN);
+    EXPECT_EQ(b, (uint64_t) 2 * GRAIN);
+    EXPECT_EQ(c, (uint64_t) 3 * GRAIN);
+
+    /* the hole left by b is found again before the tail */
+    ASSERT_EQ(palloc_add_free(pa, b, GRAIN), 0);
+    ASSERT_EQ(palloc_first_fit(pa, GRAIN, &c), 0);
+    EXPECT_EQ(c, b);
+
+    /* but not for anything larger */
+    ASSERT_EQ(palloc_first_fit(pa, GRAIN + 1, &c), 0);
+    EXPECT_EQ(c, (uint64_t) 4 * GRAIN);
+    palloc_free(pa);
+}
+
+TEST(TestAlloc, UsedSpaceIsSkipped) {
+    PartAlloc* pa = new_alloc();
+    uint64_t start, size;
+
+    ASSERT_EQ(palloc_add_used(pa, GRAIN, 10 * GRAIN), 0);
+    ASSERT_EQ(palloc_first_fit(pa, 1, &start), 0);
+    EXPECT_EQ(start, (uint64_t) 11 * GRAIN);
+
+    ASSERT_EQ(palloc_largest_gap(pa, &start, &size), 0);
+    EXPECT_EQ(start, (uint64_t) 11 * GRAIN);
+    EXPECT_EQ(start + size - 1, pa->lastLba);
+    palloc_free(pa);
+}
+
+TEST(TestAlloc, NoSpace) {
+    PartAlloc* pa = new_alloc();
+    uint64_t start;
+
+    EXPECT_EQ(palloc_alloc(pa, 2097152, &start), -ENOSPC);
+    ASSERT_EQ(palloc_add_used(pa, 34, pa->lastLba - 33), 0);
+    EXPECT_EQ(palloc_first_fit(pa, 1, &start), -ENOSPC);
+    palloc_free(pa);
+}
+
+/* compare the treap against a linear scan over a bitmap of the same space */
+TEST(TestAlloc, MatchesBruteForce) {
+    const uint64_t last = 255 * GRAIN - 1;
+    PartAllocTopology topo = { 512, 512, 0, 0, 0 };
+    unsigned char* used;
+    PartAlloc* pa;
+    uint64_t i, s, size, start, want;
+    int round, rc;
+
+    pa = palloc_new(34, last, &topo);
+    used = (unsigned char*) calloc(last + 1, 1);
+    ASSERT_NE(pa, nullptr);
+    ASSERT_NE(used, nullptr);
+    memset(used, 1, 34);
+
+    srand(1);
+    for (round = 0; round < 2000; round++) {
+        size = (rand() % 8 + 1) * GRAIN / (rand() % 2 ? 1 : 4);
+
+        if (rand() % 3 == 0) {
+            /* give back something taken earlier */
+            s = (rand() % 255) * GRAIN;
+            for (i = s; i < s + size && i <= last; i++)
+                if (!used[i] || i < 34)
+                    break;
+            if (i == s + size && s >= 34) {
+                ASSERT_EQ(palloc_add_free(pa, s, size), 0);
+                memset(used + s, 0, size);
+            }
+            continue;
+        }
+
+        want = 0;
+        for (s = palloc_align_up(pa, 34); s + size - 1 <= last; s += GRAIN) {
+            for (i = s; i < s + size && !used[i]; i++)
+                ;
+            if (i == s + size) {
+                want = s;
+                break;
+            }
+        }
+
+        rc = palloc_alloc(pa, size, &start);
+        if (!want) {
+            EXPECT_EQ(rc, -ENOSPC);
+            continue;
+        }
+        ASSERT_EQ(rc, 0);
+        ASSERT_EQ(start, want);
+        memset(used + start, 1, size);
+    }
+
+    free(used);
+    palloc_free(pa);
+}
+
+TEST(TestAlloc, Batch) {
+    PartAlloc* pa = new_alloc();
+    PartAllocRequest reqs[3] = { { GRAIN, 0, 0 }, { 100 * GRAIN, 0, 0 }, { 0, 0, 0 } };
+
+    ASSERT_EQ(palloc_alloc_batch(pa, reqs, 3), 0u);
+    /* largest first */
+    EXPECT_EQ(reqs[1].start, (uint64_t) GRAIN);
+    EXPECT_EQ(reqs[0].start, (uint64_t) 101 * GRAIN);
+    /* the rest of the disk */
+    EXPECT_EQ(reqs[2].start, (uint64_t) 102 * GRAIN);
+    EXPECT_GT(reqs[2].size, 0u);
+    EXPECT_LE(reqs[2].start + reqs[2].size - 1, pa->lastLba);
+    palloc_free(pa);
+}
+
+TEST(TestAlloc, DosPartitionRange) {
+    DosPartition p;
+
+    EXPECT_EQ(palloc_fill_dos_partition(&p, 0x83, 2048, 2048, 0, 0), 0);
+    EXPECT_EQ(palloc_fill_dos_partition(&p, 0x83, 1ULL << 32, 2048, 0, 0), -ERANGE);
+    EXPECT_EQ(palloc_fill_dos_partition(&p, 0x83, 2048, 1ULL << 32, 0, 0), -ERANGE);
+}
+
+int main (int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
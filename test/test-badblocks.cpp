@@ -0,0 +1,232 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <set>
+
+extern "C" {
+#include "../app/common/badblocks.h"
+}
+
+#define SECTOR          512
+#define IMAGE_SIZE      (16 * 1024 * 1024)
+
+/*
+ * pread() of the scanner ends up here: reads of the test image touching a
+ * sector in badSectors fail with badErrno, everything else goes to the
+ * kernel.
+ */
+static std::set<uint64_t> badSectors;
+static ino_t badIno;
+static int badErrno = EIO;
+static int nreads;
+
+extern "C" ssize_t pread(int fd, void* buf, size_t count, off_t offset)
+{
+    struct stat st;
+
+    if (badIno && fstat(fd, &st) == 0 && st.st_ino == badIno) {
+        std::set<uint64_t>::iterator it = badSectors.lower_bound((uint64_t) offset / SECTOR);
+
+        __atomic_add_fetch(&nreads, 1, __ATOMIC_RELAXED);
+        if (it != badSectors.end() && *it < ((uint64_t) offset + count + SECTOR - 1) / SECTOR) {
+            errno = badErrno;
+            return -1;
+        }
+    }
+
+    return syscall(SYS_pread64, fd, buf, count, offset);
+}
+
+TEST(TestBadBlocks, Map) {
+    BadBlocks bb;
+    uint64_t start, count;
+
+    ASSERT_EQ(badblocks_init(&bb, 3 * BADBLOCKS_LEAF_SECTORS + 10, SECTOR), 0);
+    EXPECT_EQ(badblocks_next_range(&bb, 0, &start, &count), 0);
+
+    ASSERT_EQ(badblocks_mark(&bb, 7, 1), 0);
+    /* a run across a leaf boundary */
+    ASSERT_EQ(badblocks_mark(&bb, BADBLOCKS_LEAF_SECTORS - 3, 6), 0);
+    ASSERT_EQ(badblocks_mark(&bb, 3 * BADBLOCKS_LEAF_SECTORS + 9, 1), 0);
+    /* marking twice does not count twice */
+    ASSERT_EQ(badblocks_mark(&bb, 7, 1), 0);
+    EXPECT_EQ(bb.nbad, 8u);
+
+    EXPECT_EQ(badblocks_mark(&bb, 3 * BADBLOCKS_LEAF_SECTORS + 9, 2), -ERANGE);
+    EXPECT_EQ(badblocks_mark(&bb, 3 * BADBLOCKS_LEAF_SECTORS + 10, 1), -ERANGE);
+
+    EXPECT_TRUE(badblocks_is_bad(&bb, 7));
+    EXPECT_FALSE(badblocks_is_bad(&bb, 8));
+    EXPECT_TRUE(badblocks_is_bad(&bb, BADBLOCKS_LEAF_SECTORS));
+    EXPECT_FALSE(badblocks_is_bad(&bb, 2 * BADBLOCKS_LEAF_SECTORS));
+    EXPECT_FALSE(badblocks_is_bad(&bb, 4 * BADBLOCKS_LEAF_SECTORS));
+
+    ASSERT_EQ(badblocks_next_range(&bb, 0, &start, &count), 1);
+    EXPECT_EQ(start, 7u);
+    EXPECT_EQ(count, 1u);
+    ASSERT_EQ(badblocks_next_range(&bb, 8, &start, &count), 1);
+    EXPECT_EQ(start, BADBLOCKS_LEAF_SECTORS - 3);
+    EXPECT_EQ(count, 6u);
+    /* from the middle of a run */
+    ASSERT_EQ(badblocks_next_range(&bb, BADBLOCKS_LEAF_SECTORS + 1, &start, &count), 1);
+    EXPECT_EQ(start, BADBLOCKS_LEAF_SECTORS + 1);
+    EXPECT_EQ(count, 2u);
+    ASSERT_EQ(badblocks_next_range(&bb, BADBLOCKS_LEAF_SECTORS + 3, &start, &count), 1);
+    EXPECT_EQ(start, 3 * BADBLOCKS_LEAF_SECTORS + 9);
+    EXPECT_EQ(count, 1u);
+    EXPECT_EQ(badblocks_next_range(&bb, start + 1, &start, &count), 0);
+
+    /* no leaf for the clean third of the map */
+    EXPECT_EQ(bb.leaves[2], nullptr);
+    badblocks_deinit(&bb);
+}
+
+TEST(TestBadBlocks, List) {
+    BadBlocks bb, rb;
+    char* buf = NULL;
+    size_t len = 0;
+    FILE* f;
+
+    ASSERT_EQ(badblocks_init(&bb, 100000, SECTOR), 0);
+    ASSERT_EQ(badblocks_mark(&bb, 10, 3), 0);
+    ASSERT_EQ(badblocks_mark(&bb, 99999, 1), 0);
+
+    f = open_memstream(&buf, &len);
+    ASSERT_NE(f, nullptr);
+    ASSERT_EQ(badblocks_write_list(&bb, f), 0);
+    fclose(f);
+    EXPECT_STREQ(buf, "10 3\n99999 1\n");
+    free(buf);
+
+    const char text[] = "# from the last scan\n10 3\n\n99999 1\n";
+    ASSERT_EQ(badblocks_init(&rb, 100000, SECTOR), 0);
+    f = fmemopen((void*) text, sizeof(text) - 1, "r");
+    ASSERT_NE(f, nullptr);
+    ASSERT_EQ(badblocks_read_list(&rb, f), 0);
+    fclose(f);
+    EXPECT_EQ(rb.nbad, bb.nbad);
+    EXPECT_TRUE(badblocks_is_bad(&rb, 12));
+    EXPECT_FALSE(badblocks_is_bad(&rb, 13));
+
+    const char bad[] = "10 3\n100000 1\n";
+    f = fmemopen((void*) bad, sizeof(bad) - 1, "r");
+    EXPECT_EQ(badblocks_read_list(&rb, f), -ERANGE);
+    fclose(f);
+
+    badblocks_deinit(&rb);
+    badblocks_deinit(&bb);
+}
+
+class TestBadBlocksScan : public ::testing::Test
+{
+protected:
+    char image[64];
+
+    void SetUp() override
+    {
+        struct stat st;
+        int fd;
+
+        snprintf(image, sizeof(image), "/tmp/test-badblocks-%d.img", (int) getpid());
+        fd = open(image, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(ftruncate(fd, IMAGE_SIZE), 0);
+        ASSERT_EQ(fstat(fd, &st), 0);
+        close(fd);
+
+        badSectors.clear();
+        badErrno = EIO;
+        nreads = 0;
+        badIno = st.st_ino;
+    }
+
+    void TearDown() override
+    {
+        badIno = 0;
+        unlink(image);
+    }
+
+    int scan(BadBlocks* bb, unsigned int nthreads)
+    {
+        BadBlocksScan opts;
+
+        memset(&opts, 0, sizeof(opts));
+        opts.mode = BADBLOCKS_READ;
+        opts.nthreads = nthreads;
+        opts.chunkSize = 1024 * 1024;
+
+        return badblocks_scan(image, &opts, bb, NULL);
+    }
+};
+
+TEST_F(TestBadBlocksScan, Clean) {
+    BadBlocks bb;
+    uint64_t start, count;
+
+    ASSERT_EQ(scan(&bb, 4), 0);
+    EXPECT_EQ(bb.nsectors, (uint64_t) IMAGE_SIZE / SECTOR);
+    EXPECT_EQ(bb.nbad, 0u);
+    EXPECT_EQ(badblocks_next_range(&bb, 0, &start, &count), 0);
+    EXPECT_EQ(nreads, IMAGE_SIZE / (1024 * 1024));
+    badblocks_deinit(&bb);
+}
+
+/* only the failing sectors are marked, and finding them costs a few reads per bad sector */
+TEST_F(TestBadBlocksScan, Bisect) {
+    uint64_t start, count;
+    BadBlocks bb;
+
+    badSectors.insert(0);
+    badSectors.insert(1000);
+    badSectors.insert(1001);
+    badSectors.insert(20000);
+    badSectors.insert(IMAGE_SIZE / SECTOR - 1);
+
+    ASSERT_EQ(scan(&bb, 4), 0);
+    EXPECT_EQ(bb.nbad, 5u);
+    ASSERT_EQ(badblocks_next_range(&bb, 0, &start, &count), 1);
+    EXPECT_EQ(start, 0u);
+    EXPECT_EQ(count, 1u);
+    ASSERT_EQ(badblocks_next_range(&bb, 1, &start, &count), 1);
+    EXPECT_EQ(start, 1000u);
+    EXPECT_EQ(count, 2u);
+    ASSERT_EQ(badblocks_next_range(&bb, 1002, &start, &count), 1);
+    EXPECT_EQ(start, 20000u);
+    ASSERT_EQ(badblocks_next_range(&bb, 20001, &start, &count), 1);
+    EXPECT_EQ(start, (uint64_t) IMAGE_SIZE / SECTOR - 1);
+    EXPECT_EQ(badblocks_next_range(&bb, start + 1, &start, &count), 0);
+
+    /* 2048 sectors per chunk: 11 halvings, two reads each, per bad sector at most */
+    EXPECT_LE(nreads, IMAGE_SIZE / (1024 * 1024) + 5 * 2 * 11);
+    badblocks_deinit(&bb);
+}
+
+/* anything but a media error is not a bad sector, it ends the scan */
+TEST_F(TestBadBlocksScan, OtherError) {
+    BadBlocks bb;
+
+    badSectors.insert(3000);
+    badErrno = EPERM;
+    EXPECT_EQ(scan(&bb, 2), -EPERM);
+    EXPECT_EQ(bb.nbad, 0u);
+    badblocks_deinit(&bb);
+}
+
+int main (int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
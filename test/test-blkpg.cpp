@@ -0,0 +1,98 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <stdlib.h>
+
+extern "C" {
+#include "../app/partitions/partitions-blkpg.h"
+}
+
+TEST(TestBlkpg, Unchanged) {
+    PartLayout parts[] = { { 1, 2048, 2048 }, { 2, 4096, 8192 } };
+    PartDelta* deltas = NULL;
+
+    EXPECT_EQ(blkpg_diff(parts, 2, parts, 2, &deltas), 0);
+    free(deltas);
+}
+
+TEST(TestBlkpg, AddAndDelete) {
+    PartLayout old[] = { { 1, 2048, 2048 }, { 3, 16384, 2048 } };
+    PartLayout nw[] = { { 1, 2048, 2048 }, { 2, 4096, 8192 } };
+    PartDelta* deltas = NULL;
+
+    ASSERT_EQ(blkpg_diff(old, 2, nw, 2, &deltas), 2);
+    EXPECT_EQ(deltas[0].type, PART_DELTA_DEL);
+    EXPECT_EQ(deltas[0].part.partno, 3);
+    EXPECT_EQ(deltas[1].type, PART_DELTA_ADD);
+    EXPECT_EQ(deltas[1].part.partno, 2);
+    EXPECT_EQ(deltas[1].part.start, 4096u);
+    EXPECT_EQ(deltas[1].part.size, 8192u);
+    free(deltas);
+}
+
+TEST(TestBlkpg, MovedStartIsDeleteAndAdd) {
+    PartLayout old[] = { { 1, 2048, 2048 } };
+    PartLayout nw[] = { { 1, 4096, 2048 } };
+    PartDelta* deltas = NULL;
+
+    ASSERT_EQ(blkpg_diff(old, 1, nw, 1, &deltas), 2);
+    EXPECT_EQ(deltas[0].type, PART_DELTA_DEL);
+    EXPECT_EQ(deltas[0].part.start, 2048u);
+    EXPECT_EQ(deltas[1].type, PART_DELTA_ADD);
+    EXPECT_EQ(deltas[1].part.start, 4096u);
+    free(deltas);
+}
+
+/* the kernel must never see an overlap: shrink before grow, add last */
+TEST(TestBlkpg, OrderAvoidsOverlap) {
+    PartLayout old[] = { { 1, 2048, 2048 }, { 2, 4096, 8192 }, { 4, 32768, 2048 } };
+    PartLayout nw[] = { { 1, 2048, 4096 }, { 2, 6144, 6144 }, { 3, 12288, 2048 } };
+    PartDelta* deltas = NULL;
+    int n, i;
+
+    /* 2 moved: delete and re-add, 1 grows into the freed space, 4 goes away, 3 is new */
+    n = blkpg_diff(old, 3, nw, 3, &deltas);
+    ASSERT_EQ(n, 5);
+    for (i = 1; i < n; i++)
+        EXPECT_LE(deltas[i - 1].type, deltas[i].type);
+    EXPECT_EQ(deltas[0].type, PART_DELTA_DEL);
+    EXPECT_EQ(deltas[1].type, PART_DELTA_DEL);
+    EXPECT_EQ(deltas[2].type, PART_DELTA_RESIZE);
+    EXPECT_EQ(deltas[2].part.partno, 1);
+    EXPECT_EQ(deltas[2].part.size, 4096u);
+    EXPECT_EQ(deltas[3].part.partno, 2);
+    EXPECT_EQ(deltas[4].part.partno, 3);
+    free(deltas);
+}
+
+TEST(TestBlkpg, DuplicatePartno) {
+    PartLayout old[] = { { 1, 2048, 2048 }, { 1, 4096, 2048 } };
+    PartDelta* deltas = NULL;
+
+    EXPECT_EQ(blkpg_diff(old, 2, NULL, 0, &deltas), -EINVAL);
+    EXPECT_EQ(deltas, nullptr);
+}
+
+TEST(TestBlkpg, ShrinkBeforeGrow) {
+    PartLayout old[] = { { 1, 2048, 2048 }, { 2, 4096, 8192 } };
+    PartLayout nw[] = { { 1, 2048, 4096 }, { 2, 4096, 4096 } };
+    PartDelta* deltas = NULL;
+
+    ASSERT_EQ(blkpg_diff(old, 2, nw, 2, &deltas), 2);
+    EXPECT_EQ(deltas[0].type, PART_DELTA_RESIZE);
+    EXPECT_EQ(deltas[0].part.partno, 2);
+    EXPECT_EQ(deltas[1].type, PART_DELTA_RESIZE);
+    EXPECT_EQ(deltas[1].part.partno, 1);
+    free(deltas);
+}
+
+int main (int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,86 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <vector>
+
+extern "C" {
+#include "../app/common/buffer-zero.h"
+}
+
+/* both sides of the scalar cut-off and of every vector loop stride */
+static const size_t testLengths[] = {
+    0, 1, 7, 8, 9, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65, 95, 96, 127, 128, 129,
+    159, 160, 191, 192, 255, 256, 257, 383, 384, 385,
+};
+
+#define MAX_MISALIGN        64
+
+TEST(TestBufferZero, ImplsAgree) {
+    static const char* impls[] = { "scalar", "sse2", "avx2" };
+    std::string orig = buffer_is_zero_impl();
+    size_t k, l, off, pos, len;
+    int tested = 0;
+
+    for (k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        if (buffer_is_zero_set_impl(impls[k]) != 0)
+            continue;
+        tested++;
+        ASSERT_STREQ(buffer_is_zero_impl(), impls[k]);
+
+        for (l = 0; l < sizeof(testLengths) / sizeof(testLengths[0]); l++) {
+            len = testLengths[l];
+            /* non-zero guards around the window, nothing outside of it may be looked at */
+            std::vector<unsigned char> buf(len + 2 * MAX_MISALIGN, 0xff);
+
+            for (off = 1; off <= MAX_MISALIGN; off++) {
+                unsigned char* p = buf.data() + off;
+
+                memset(p, 0, len);
+                ASSERT_EQ(buffer_is_zero(p, len), 1) << impls[k] << " len " << len << " off " << off;
+                for (pos = 0; pos < len; pos++) {
+                    p[pos] = 1;
+                    ASSERT_EQ(buffer_is_zero(p, len), 0) << impls[k] << " len " << len << " off " << off
+                                                         << " pos " << pos;
+                    p[pos] = 0x80;
+                    ASSERT_EQ(buffer_is_zero(p, len), 0) << impls[k] << " len " << len << " off " << off
+                                                         << " pos " << pos;
+                    p[pos] = 0;
+                }
+                memset(p, 0xff, len);
+            }
+        }
+    }
+    EXPECT_GE(tested, 1);
+
+    EXPECT_EQ(buffer_is_zero_set_impl("neon"), -ENOTSUP);
+    ASSERT_EQ(buffer_is_zero_set_impl(orig.c_str()), 0);
+}
+
+/* clone buffers are page sized and aligned, the vector loops run to the end */
+TEST(TestBufferZero, LargeBuffers) {
+    std::vector<unsigned char> buf(1024 * 1024 + 64, 0);
+    size_t pos;
+
+    EXPECT_EQ(buffer_is_zero(buf.data(), buf.size()), 1);
+    for (pos = 0; pos < buf.size(); pos += 4093) {
+        buf[pos] = 1;
+        EXPECT_EQ(buffer_is_zero(buf.data(), buf.size()), 0) << "pos " << pos;
+        buf[pos] = 0;
+    }
+    buf.back() = 1;
+    EXPECT_EQ(buffer_is_zero(buf.data(), buf.size()), 0);
+    EXPECT_EQ(buffer_is_zero(buf.data(), buf.size() - 1), 1);
+}
+
+int main (int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,196 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <vector>
+
+extern "C" {
+#include "../app/partitions/partitions-ebr.h"
+}
+
+#define SECTOR          512
+#define EXT_START       2048
+#define EXT_SIZE        200000
+
+/* reads of the walker are counted, the point of the read window is to keep this low */
+static int nreads;
+
+extern "C" ssize_t pread(int fd, void* buf, size_t count, off_t offset)
+{
+    __atomic_add_fetch(&nreads, 1, __ATOMIC_RELAXED);
+
+    return syscall(SYS_pread64, fd, buf, count, offset);
+}
+
+class TestEbr : public ::testing::Test
+{
+protected:
+    char image[64];
+    unsigned char mbr[SECTOR];
+    int fd;
+
+    void SetUp() override
+    {
+        DosPartition* p;
+
+        snprintf(image, sizeof(image), "/tmp/test-ebr-%d.img", (int) getpid());
+        fd = open(image, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(ftruncate(fd, (off_t) (EXT_START + EXT_SIZE) * SECTOR), 0);
+
+        memset(mbr, 0, sizeof(mbr));
+        mbr_set_magic(mbr);
+        p = mbr_get_partition(mbr, 1);
+        p->sysInd = MBR_DOS_EXTENDED_PARTITION;
+        dos_partition_set_start(p, EXT_START);
+        dos_partition_set_size(p, EXT_SIZE);
+        nreads = 0;
+    }
+
+    void TearDown() override
+    {
+        close(fd);
+        unlink(image);
+    }
+
+    /* an EBR at @lba with a logical partition @start sectors behind it and a link to @next (0 = last) */
+    void put_ebr(uint64_t lba, uint32_t start, uint32_t size, uint64_t next)
+    {
+        unsigned char ebr[SECTOR];
+        DosPartition* p;
+
+        memset(ebr, 0, sizeof(ebr));
+        mbr_set_magic(ebr);
+        p = mbr_get_partition(ebr, 0);
+        p->sysInd = 0x83;
+        dos_partition_set_start(p, start);
+        dos_partition_set_size(p, size);
+        if (next) {
+            p = mbr_get_partition(ebr, 1);
+            p->sysInd = MBR_DOS_EXTENDED_PARTITION;
+            dos_partition_set_start(p, (uint32_t) (next - EXT_START));
+            dos_partition_set_size(p, 1);
+        }
+        ASSERT_EQ(pwrite(fd, ebr, sizeof(ebr), (off_t) lba * SECTOR), SECTOR);
+    }
+
+    /* @n EBRs @stride sectors apart, the partitions fill the space between */
+    void put_chain(int n, uint64_t stride)
+    {
+        int i;
+
+        for (i = 0; i < n; i++)
+            put_ebr(EXT_START + i * stride, 1, (uint32_t) stride - 1,
+                    i + 1 < n ? EXT_START + (i + 1) * stride : 0);
+        nreads = 0;
+    }
+};
+
+TEST_F(TestEbr, Chain) {
+    std::vector<EbrLogical> parts(100);
+    size_t n, i;
+
+    put_chain(60, 2000);
+    ASSERT_EQ(ebr_walk_mbr(fd, SECTOR, mbr, parts.data(), parts.size(), &n), 0);
+    ASSERT_EQ(n, 60u);
+    for (i = 0; i < n; i++) {
+        EXPECT_EQ(parts[i].ebrLba, EXT_START + i * 2000);
+        EXPECT_EQ(parts[i].start, EXT_START + i * 2000 + 1);
+        EXPECT_EQ(parts[i].size, 1999u);
+        EXPECT_EQ(parts[i].sysInd, 0x83);
+    }
+}
+
+/* closely packed EBRs come in with one read per window, not one per link */
+TEST_F(TestEbr, PackedChainFewReads) {
+    std::vector<EbrLogical> parts(100);
+    size_t n;
+
+    put_chain(60, 2);
+    ASSERT_EQ(ebr_walk_chain(fd, SECTOR, EXT_START, EXT_SIZE, parts.data(), parts.size(), &n), 0);
+    EXPECT_EQ(n, 60u);
+    EXPECT_LE(nreads, 120 * SECTOR / EBR_READ_WINDOW + 2);
+}
+
+TEST_F(TestEbr, Loop) {
+    std::vector<EbrLogical> parts(100);
+    size_t n;
+
+    put_chain(5, 100);
+    put_ebr(EXT_START + 400, 1, 99, EXT_START + 200);
+    EXPECT_EQ(ebr_walk_chain(fd, SECTOR, EXT_START, EXT_SIZE, parts.data(), parts.size(), &n), -ELOOP);
+    /* valid up to the failing link */
+    EXPECT_EQ(n, 5u);
+}
+
+TEST_F(TestEbr, LinkOutside) {
+    std::vector<EbrLogical> parts(100);
+    size_t n;
+
+    put_chain(3, 100);
+    put_ebr(EXT_START + 200, 1, 99, EXT_START + EXT_SIZE);
+    EXPECT_EQ(ebr_walk_chain(fd, SECTOR, EXT_START, EXT_SIZE, parts.data(), parts.size(), &n), -EINVAL);
+    EXPECT_EQ(n, 3u);
+}
+
+/* a logical partition has to stay inside the extended one just like the links */
+TEST_F(TestEbr, PartitionOutside) {
+    std::vector<EbrLogical> parts(100);
+    size_t n;
+
+    put_chain(3, 100);
+    put_ebr(EXT_START + 200, 1, EXT_SIZE - 201, 0);
+    ASSERT_EQ(ebr_walk_chain(fd, SECTOR, EXT_START, EXT_SIZE, parts.data(), parts.size(), &n), 0);
+    EXPECT_EQ(n, 3u);
+    EXPECT_EQ(parts[2].start + parts[2].size, (uint64_t) EXT_START + EXT_SIZE);
+
+    put_ebr(EXT_START + 200, 1, EXT_SIZE - 200, 0);
+    EXPECT_EQ(ebr_walk_chain(fd, SECTOR, EXT_START, EXT_SIZE, parts.data(), parts.size(), &n), -EINVAL);
+    EXPECT_EQ(n, 2u);
+
+    /* start alone already past the end, start + size wrapping in 32 bits */
+    put_ebr(EXT_START + 200, EXT_SIZE, 1, 0);
+    EXPECT_EQ(ebr_walk_chain(fd, SECTOR, EXT_START, EXT_SIZE, parts.data(), parts.size(), &n), -EINVAL);
+    put_ebr(EXT_START + 200, 0xfffffff0, 0x20, 0);
+    EXPECT_EQ(ebr_walk_chain(fd, SECTOR, EXT_START, EXT_SIZE, parts.data(), parts.size(), &n), -EINVAL);
+    EXPECT_EQ(n, 2u);
+}
+
+TEST_F(TestEbr, TooDeep) {
+    std::vector<EbrLogical> parts(EBR_MAX_DEPTH + 10);
+    size_t n;
+
+    put_chain(10, 100);
+    EXPECT_EQ(ebr_walk_chain(fd, SECTOR, EXT_START, EXT_SIZE, parts.data(), 4, &n), -E2BIG);
+    EXPECT_EQ(n, 4u);
+
+    put_chain(EBR_MAX_DEPTH + 1, 100);
+    EXPECT_EQ(ebr_walk_chain(fd, SECTOR, EXT_START, EXT_SIZE, parts.data(), parts.size(), &n), -E2BIG);
+    EXPECT_EQ(n, (size_t) EBR_MAX_DEPTH);
+}
+
+TEST_F(TestEbr, NoExtended) {
+    EbrLogical parts[4];
+    size_t n = 1;
+
+    mbr_get_partition(mbr, 1)->sysInd = 0x83;
+    EXPECT_EQ(ebr_walk_mbr(fd, SECTOR, mbr, parts, 4, &n), 0);
+    EXPECT_EQ(n, 0u);
+    EXPECT_EQ(nreads, 0);
+}
+
+int main (int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,205 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include <vector>
+
+extern "C" {
+#include "../app/partitions/partitions-gpt.h"
+#include "../app/common/crc32.h"
+#include "../app/common/bitops.h"
+}
+
+#define SECTOR      512
+#define NSECTORS    2048
+
+/* one bit at a time, slow but obviously right */
+static uint32_t crc32_reference(const unsigned char* p, size_t len)
+{
+    uint32_t crc = ~0U;
+    int k;
+
+    while (len--) {
+        crc ^= *p++;
+        for (k = 0; k < 8; k++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320U : crc >> 1;
+    }
+
+    return ~crc;
+}
+
+TEST(TestCrc32, KnownValue) {
+    EXPECT_EQ(crc32_checksum("123456789", 9), 0xCBF43926U);
+    EXPECT_EQ(crc32_checksum("", 0), 0U);
+}
+
+/* the table and the carry-less multiply path must agree at every length and alignment */
+TEST(TestCrc32, MatchesReference) {
+    std::vector<unsigned char> buf(64 * 1024 + 64);
+    size_t len, off, i;
+
+    srand(1);
+    for (i = 0; i < buf.size(); i++)
+        buf[i] = (unsigned char) rand();
+
+    for (off = 0; off < 16; off++)
+        for (len = 0; len < 600; len++)
+            ASSERT_EQ(crc32_checksum(buf.data() + off, len), crc32_reference(buf.data() + off, len))
+                << "off " << off << " len " << len;
+    for (len = 1024; len <= 64 * 1024; len = len * 2 + 3)
+        ASSERT_EQ(crc32_checksum(buf.data() + 1, len), crc32_reference(buf.data() + 1, len)) << "len " << len;
+}
+
+TEST(TestCrc32, Incremental) {
+    std::vector<unsigned char> buf(5000, 0x5a);
+    uint32_t crc;
+
+    crc = crc32_update(~0U, buf.data(), 1234);
+    crc = crc32_update(crc, buf.data() + 1234, buf.size() - 1234);
+    EXPECT_EQ(~crc, crc32_checksum(buf.data(), buf.size()));
+}
+
+TEST(TestCrc32, ExcludeOffset) {
+    std::vector<unsigned char> buf(300), zeroed;
+    size_t off;
+
+    for (off = 0; off < buf.size(); off++)
+        buf[off] = (unsigned char) (off * 7 + 1);
+
+    for (off = 0; off + 4 <= buf.size(); off += 37) {
+        zeroed = buf;
+        memset(zeroed.data() + off, 0, 4);
+        ASSERT_EQ(crc32_exclude_offset(buf.data(), buf.size(), off, 4), crc32_reference(zeroed.data(), zeroed.size()))
+            << "off " << off;
+    }
+}
+
+class TestGpt : public ::testing::Test
+{
+protected:
+    std::vector<unsigned char> disk;
+
+    GptHeader* header()
+    {
+        return (GptHeader*) (disk.data() + SECTOR);
+    }
+
+    GptEntry* entry(int i)
+    {
+        return (GptEntry*) (disk.data() + 2 * SECTOR) + i;
+    }
+
+    void seal()
+    {
+        GptHeader* h = header();
+
+        h->partitionEntryArrayCrc32 = cpu_to_le32(crc32_reference(disk.data() + 2 * SECTOR,
+                                                                  GPT_NPARTITIONS_DEFAULT * sizeof(GptEntry)));
+        h->crc32 = 0;
+        h->crc32 = cpu_to_le32(crc32_reference((unsigned char*) h, GPT_HEADER_MIN_SIZE));
+    }
+
+    void SetUp() override
+    {
+        GptHeader* h;
+
+        disk.assign(34 * SECTOR, 0);
+        h = header();
+        h->signature = cpu_to_le64(GPT_HEADER_SIGNATURE);
+        h->revision = cpu_to_le32(GPT_HEADER_REVISION_V1_00);
+        h->size = cpu_to_le32(GPT_HEADER_MIN_SIZE);
+        h->myLba = cpu_to_le64(1);
+        h->alternativeLba = cpu_to_le64(NSECTORS - 1);
+        h->firstUsableLba = cpu_to_le64(34);
+        h->lastUsableLba = cpu_to_le64(NSECTORS - 34);
+        h->partitionEntryLba = cpu_to_le64(2);
+        h->npartitionEntries = cpu_to_le32(GPT_NPARTITIONS_DEFAULT);
+        h->sizeofPartitionEntry = cpu_to_le32(sizeof(GptEntry));
+
+        entry(0)->typeGuid.timeLow = cpu_to_le32(0x0FC63DAF);
+        entry(0)->lbaStart = cpu_to_le64(34);
+        entry(0)->lbaEnd = cpu_to_le64(1023);
+        entry(5)->typeGuid.timeLow = cpu_to_le32(0x0FC63DAF);
+        entry(5)->lbaStart = cpu_to_le64(1024);
+        entry(5)->lbaEnd = cpu_to_le64(NSECTORS - 34);
+        seal();
+    }
+};
+
+TEST_F(TestGpt, Parse) {
+    GptTable t;
+
+    ASSERT_EQ(gpt_table_parse(&t, disk.data(), disk.size(), SECTOR, NSECTORS - 1), 0);
+    EXPECT_EQ(gpt_table_get_nents(&t), (uint32_t) GPT_NPARTITIONS_DEFAULT);
+    EXPECT_EQ(gpt_table_count_used(&t), 2u);
+    /* views into the buffer, not copies */
+    EXPECT_EQ((const void*) gpt_table_get_entry(&t, 5), (void*) entry(5));
+    EXPECT_EQ(gpt_entry_get_start(gpt_table_get_entry(&t, 5)), 1024u);
+    EXPECT_EQ(gpt_entry_get_size(gpt_table_get_entry(&t, 0)), 990u);
+}
+
+TEST_F(TestGpt, HeaderCrc) {
+    GptTable t;
+
+    header()->lastUsableLba = cpu_to_le64(NSECTORS - 35);
+    EXPECT_EQ(gpt_table_parse(&t, disk.data(), disk.size(), SECTOR, NSECTORS - 1), -EBADMSG);
+    seal();
+    EXPECT_EQ(gpt_table_parse(&t, disk.data(), disk.size(), SECTOR, NSECTORS - 1), 0);
+
+    /* bytes behind the header size are not covered */
+    disk[SECTOR + GPT_HEADER_MIN_SIZE] = 1;
+    EXPECT_EQ(gpt_table_parse(&t, disk.data(), disk.size(), SECTOR, NSECTORS - 1), 0);
+}
+
+TEST_F(TestGpt, EntriesCrc) {
+    GptTable t;
+
+    /* even an unused entry is covered */
+    disk[2 * SECTOR + 100 * sizeof(GptEntry) + 3] ^= 1;
+    EXPECT_EQ(gpt_table_parse(&t, disk.data(), disk.size(), SECTOR, NSECTORS - 1), -EBADMSG);
+}
+
+TEST_F(TestGpt, ShortBuffer) {
+    GptTable t;
+
+    EXPECT_EQ(gpt_table_parse(&t, disk.data(), SECTOR, SECTOR, NSECTORS - 1), -ERANGE);
+    EXPECT_EQ(gpt_table_parse(&t, disk.data(), 10 * SECTOR, SECTOR, NSECTORS - 1), -ERANGE);
+    EXPECT_EQ(gpt_table_get_read_size(t.header, SECTOR), (size_t) 34 * SECTOR);
+}
+
+TEST_F(TestGpt, BadSignature) {
+    GptTable t;
+
+    header()->signature = 0;
+    seal();
+    EXPECT_EQ(gpt_table_parse(&t, disk.data(), disk.size(), SECTOR, NSECTORS - 1), -EINVAL);
+}
+
+/* the disk is smaller than the header claims */
+TEST_F(TestGpt, BeyondDisk) {
+    GptTable t;
+
+    EXPECT_EQ(gpt_table_parse(&t, disk.data(), disk.size(), SECTOR, NSECTORS / 2), -EINVAL);
+}
+
+TEST_F(TestGpt, BadEntrySize) {
+    GptTable t;
+
+    header()->sizeofPartitionEntry = cpu_to_le32(100);
+    seal();
+    EXPECT_EQ(gpt_table_parse(&t, disk.data(), disk.size(), SECTOR, NSECTORS - 1), -EINVAL);
+}
+
+int main (int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,201 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+extern "C" {
+#include "../app/partitions/partitions-journal.h"
+#include "../app/common/bitops.h"
+}
+
+#define SECTOR      512
+#define NSECTORS    64
+
+class TestJournal : public ::testing::Test
+{
+protected:
+    char image[64];
+    char journal[64];
+    int fd;
+
+    void SetUp() override
+    {
+        unsigned char buf[SECTOR];
+        int i;
+
+        snprintf(image, sizeof(image), "/tmp/test-journal-%d.img", (int) getpid());
+        snprintf(journal, sizeof(journal), "/tmp/test-journal-%d.undo", (int) getpid());
+        fd = open(image, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ASSERT_GE(fd, 0);
+        for (i = 0; i < NSECTORS; i++) {
+            memset(buf, i, sizeof(buf));
+            ASSERT_EQ(pwrite(fd, buf, sizeof(buf), (off_t) i * SECTOR), SECTOR);
+        }
+    }
+
+    void TearDown() override
+    {
+        close(fd);
+        unlink(image);
+        unlink(journal);
+    }
+
+    /* sectors 1, 2 and 40 changed: two runs */
+    void edit(LabelEdit* le)
+    {
+        unsigned char* p;
+
+        ASSERT_EQ(label_edit_init(le, fd, SECTOR), 0);
+        p = label_edit_add_region(le, 0, 4 * SECTOR);
+        ASSERT_NE(p, nullptr);
+        memset(p + SECTOR, 0xaa, 2 * SECTOR);
+        p = label_edit_add_region(le, 40 * SECTOR, SECTOR);
+        ASSERT_NE(p, nullptr);
+        memset(p, 0xbb, SECTOR);
+    }
+
+    int sector_is(int i, int c)
+    {
+        unsigned char buf[SECTOR];
+        int k;
+
+        if (pread(fd, buf, sizeof(buf), (off_t) i * SECTOR) != SECTOR)
+            return 0;
+        for (k = 0; k < SECTOR; k++)
+            if (buf[k] != (unsigned char) c)
+                return 0;
+        return 1;
+    }
+
+    off_t journal_size()
+    {
+        struct stat st;
+
+        return stat(journal, &st) == 0 ? st.st_size : -1;
+    }
+};
+
+TEST_F(TestJournal, Encoding) {
+    LabelJournalHeader hdr;
+    LabelJournalRecord rec;
+    LabelWriteRun* runs;
+    LabelEdit le;
+    int jfd, n;
+
+    edit(&le);
+    n = label_edit_get_runs(&le, &runs);
+    ASSERT_EQ(n, 2);
+    ASSERT_EQ(label_journal_write(journal, fd, SECTOR, runs, n), 0);
+    free(runs);
+
+    /* header, two records with their pre-images, trailer */
+    EXPECT_EQ(journal_size(), (off_t) (sizeof(hdr) + 2 * sizeof(rec) + 3 * SECTOR + sizeof(LabelJournalTrailer)));
+
+    jfd = open(journal, O_RDONLY | O_CLOEXEC);
+    ASSERT_GE(jfd, 0);
+    ASSERT_EQ(pread(jfd, &hdr, sizeof(hdr), 0), (ssize_t) sizeof(hdr));
+    EXPECT_EQ(memcmp(hdr.magic, LABEL_JOURNAL_MAGIC, sizeof(hdr.magic)), 0);
+    EXPECT_EQ(le32_to_cpu(hdr.version), (uint32_t) LABEL_JOURNAL_VERSION);
+    EXPECT_EQ(le32_to_cpu(hdr.sectorSize), (uint32_t) SECTOR);
+    EXPECT_EQ(le64_to_cpu(hdr.devSize), (uint64_t) NSECTORS * SECTOR);
+    EXPECT_EQ(le32_to_cpu(hdr.nrecords), 2u);
+    ASSERT_EQ(pread(jfd, &rec, sizeof(rec), sizeof(hdr)), (ssize_t) sizeof(rec));
+    EXPECT_EQ(le64_to_cpu(rec.offset), (uint64_t) SECTOR);
+    EXPECT_EQ(le32_to_cpu(rec.size), (uint32_t) 2 * SECTOR);
+    close(jfd);
+
+    label_edit_deinit(&le);
+}
+
+TEST_F(TestJournal, Commit) {
+    LabelWriteRun* runs;
+    LabelEdit le;
+
+    edit(&le);
+    /* the commit itself must not leave a journal behind */
+    ASSERT_EQ(label_edit_commit_journaled(&le, journal), 0);
+    EXPECT_EQ(journal_size(), -1);
+    EXPECT_TRUE(sector_is(1, 0xaa));
+    EXPECT_TRUE(sector_is(40, 0xbb));
+    label_edit_deinit(&le);
+    EXPECT_EQ(label_journal_replay(journal, fd), 0);
+
+    /* the same edit again changes nothing, so nothing is written */
+    edit(&le);
+    ASSERT_EQ(label_edit_get_runs(&le, &runs), 0);
+    free(runs);
+    label_edit_deinit(&le);
+}
+
+TEST_F(TestJournal, CrashAfterWrite) {
+    LabelWriteRun* runs;
+    LabelEdit le;
+    int n;
+
+    edit(&le);
+    n = label_edit_get_runs(&le, &runs);
+    ASSERT_EQ(label_journal_write(journal, fd, SECTOR, runs, n), 0);
+    free(runs);
+    ASSERT_EQ(label_edit_commit(&le), 0);
+    label_edit_deinit(&le);
+    EXPECT_TRUE(sector_is(2, 0xaa));
+
+    EXPECT_EQ(label_journal_replay(journal, fd), 1);
+    EXPECT_EQ(journal_size(), -1);
+    EXPECT_TRUE(sector_is(0, 0));
+    EXPECT_TRUE(sector_is(1, 1));
+    EXPECT_TRUE(sector_is(2, 2));
+    EXPECT_TRUE(sector_is(3, 3));
+    EXPECT_TRUE(sector_is(40, 40));
+}
+
+TEST_F(TestJournal, TornJournalIsDropped) {
+    LabelWriteRun* runs;
+    LabelEdit le;
+    int n;
+
+    edit(&le);
+    n = label_edit_get_runs(&le, &runs);
+    ASSERT_EQ(label_journal_write(journal, fd, SECTOR, runs, n), 0);
+    free(runs);
+    label_edit_deinit(&le);
+
+    /* the trailer never made it */
+    ASSERT_EQ(truncate(journal, journal_size() - 1), 0);
+    EXPECT_EQ(label_journal_replay(journal, fd), 0);
+    EXPECT_EQ(journal_size(), -1);
+    EXPECT_TRUE(sector_is(1, 1));
+}
+
+TEST_F(TestJournal, OtherDevice) {
+    LabelWriteRun* runs;
+    LabelEdit le;
+    int n;
+
+    edit(&le);
+    n = label_edit_get_runs(&le, &runs);
+    ASSERT_EQ(label_journal_write(journal, fd, SECTOR, runs, n), 0);
+    free(runs);
+    label_edit_deinit(&le);
+
+    /* same file, other size: not the device the journal was written for */
+    ASSERT_EQ(ftruncate(fd, (NSECTORS + 1) * SECTOR), 0);
+    EXPECT_EQ(label_journal_replay(journal, fd), -ENODEV);
+    EXPECT_GT(journal_size(), 0);
+}
+
+int main (int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
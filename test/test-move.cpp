@@ -0,0 +1,271 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <vector>
+
+extern "C" {
+#include "../app/partitions/partitions-move.h"
+#include "../app/common/crc32.h"
+#include "../app/common/bitops.h"
+}
+
+#define KiB             1024
+#define IMAGE_SIZE      (1024 * KiB)
+#define CHUNK           (4 * KiB)
+
+class TestMove : public ::testing::Test
+{
+protected:
+    char image[64];
+    char checkpoint[64];
+    std::vector<unsigned char> orig;
+
+    /* every 32 bit word holds its own offset, a misplaced sector shows up */
+    void SetUp() override
+    {
+        uint32_t i;
+        int fd;
+
+        snprintf(image, sizeof(image), "/tmp/test-move-%d.img", (int) getpid());
+        snprintf(checkpoint, sizeof(checkpoint), "/tmp/test-move-%d.cp", (int) getpid());
+        orig.resize(IMAGE_SIZE);
+        for (i = 0; i < IMAGE_SIZE; i += 4) {
+            uint32_t v = i | 0x80000000;
+            memcpy(&orig[i], &v, sizeof(v));
+        }
+
+        fd = open(image, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(pwrite(fd, orig.data(), orig.size(), 0), IMAGE_SIZE);
+        close(fd);
+    }
+
+    void TearDown() override
+    {
+        unlink(image);
+        unlink(checkpoint);
+    }
+
+    /* the image once the first @done bytes in copy direction are moved */
+    std::vector<unsigned char> moved(uint64_t src, uint64_t dst, uint64_t length, uint64_t done)
+    {
+        std::vector<unsigned char> res = orig;
+        uint64_t from = dst > src ? length - done : 0;
+
+        memcpy(&res[dst + from], &orig[src + from], done);
+
+        return res;
+    }
+
+    std::vector<unsigned char> contents()
+    {
+        std::vector<unsigned char> buf(IMAGE_SIZE);
+        int fd = open(image, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0 || pread(fd, buf.data(), buf.size(), 0) != IMAGE_SIZE)
+            buf.clear();
+        if (fd >= 0)
+            close(fd);
+
+        return buf;
+    }
+
+    void write_image(const std::vector<unsigned char>& buf)
+    {
+        int fd = open(image, O_WRONLY | O_CLOEXEC);
+
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(pwrite(fd, buf.data(), buf.size(), 0), IMAGE_SIZE);
+        close(fd);
+    }
+
+    /* a record as part_move_save() writes it, @torn spoils its checksum */
+    void write_record(uint64_t src, uint64_t dst, uint64_t length, uint64_t done, uint64_t seq,
+                      uint64_t devSize, int torn = 0)
+    {
+        unsigned char buf[PART_MOVE_SLOT_SIZE];
+        PartMoveCheckpoint* r = (PartMoveCheckpoint*) buf;
+        struct stat st;
+        int fd;
+
+        ASSERT_EQ(stat(image, &st), 0);
+        memset(buf, 0, sizeof(buf));
+        memcpy(r->magic, PART_MOVE_MAGIC, sizeof(r->magic));
+        r->version = cpu_to_le32(PART_MOVE_VERSION);
+        r->devSize = cpu_to_le64(devSize);
+        r->devId = cpu_to_le64((uint64_t) st.st_ino);
+        r->src = cpu_to_le64(src);
+        r->dst = cpu_to_le64(dst);
+        r->length = cpu_to_le64(length);
+        r->done = cpu_to_le64(done);
+        r->seq = cpu_to_le64(seq);
+        r->crc32 = cpu_to_le32(crc32_checksum(r, sizeof(*r)));
+        if (torn)
+            r->done ^= cpu_to_le64(CHUNK);
+
+        fd = open(checkpoint, O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(pwrite(fd, buf, sizeof(buf), (off_t) ((seq & 1) * PART_MOVE_SLOT_SIZE)), PART_MOVE_SLOT_SIZE);
+        close(fd);
+    }
+
+    /*
+     * A run that died after recording @done: the chunks after it may or may
+     * not have landed, but never further than the shift.
+     */
+    void crash(uint64_t src, uint64_t dst, uint64_t length, uint64_t done, uint64_t landed)
+    {
+        write_image(moved(src, dst, length, done + landed));
+        write_record(src, dst, length, done, 4, IMAGE_SIZE);
+    }
+
+    int run(uint64_t src, uint64_t dst, uint64_t length, const char* cp, PartMoveProgress* p)
+    {
+        PartMove opts;
+
+        memset(&opts, 0, sizeof(opts));
+        opts.src = src;
+        opts.dst = dst;
+        opts.length = length;
+        opts.chunkSize = CHUNK;
+        opts.checkpoint = cp;
+        opts.checkpointBytes = 64 * KiB;
+
+        return part_move_run(image, &opts, p);
+    }
+};
+
+TEST_F(TestMove, OverlapDown)
+{
+    PartMoveProgress p;
+
+    ASSERT_EQ(run(128 * KiB, 116 * KiB, 512 * KiB, NULL, &p), 0);
+    EXPECT_FALSE(p.backward);
+    EXPECT_EQ(p.chunkSize, (unsigned int) CHUNK);
+    EXPECT_EQ(p.done, 512u * KiB);
+    EXPECT_TRUE(contents() == moved(128 * KiB, 116 * KiB, 512 * KiB, 512 * KiB));
+}
+
+TEST_F(TestMove, OverlapUp)
+{
+    PartMoveProgress p;
+
+    ASSERT_EQ(run(116 * KiB, 128 * KiB, 512 * KiB, NULL, &p), 0);
+    EXPECT_TRUE(p.backward);
+    EXPECT_EQ(p.done, 512u * KiB);
+    EXPECT_TRUE(contents() == moved(116 * KiB, 128 * KiB, 512 * KiB, 512 * KiB));
+}
+
+/* the chunk is clamped to the shift, else it would overwrite its own source */
+TEST_F(TestMove, ChunkClampedToShift)
+{
+    PartMoveProgress p;
+    PartMove opts;
+
+    memset(&opts, 0, sizeof(opts));
+    opts.src = 64 * KiB;
+    opts.dst = 66 * KiB;
+    opts.length = 256 * KiB;
+    opts.chunkSize = 64 * KiB;
+    ASSERT_EQ(part_move_run(image, &opts, &p), 0);
+    EXPECT_EQ(p.chunkSize, 2u * KiB);
+    EXPECT_TRUE(contents() == moved(64 * KiB, 66 * KiB, 256 * KiB, 256 * KiB));
+}
+
+TEST_F(TestMove, CheckpointRemovedWhenDone)
+{
+    PartMoveProgress p;
+
+    ASSERT_EQ(run(128 * KiB, 116 * KiB, 512 * KiB, checkpoint, &p), 0);
+    EXPECT_GT(p.checkpoints, 0u);
+    EXPECT_NE(access(checkpoint, F_OK), 0);
+    EXPECT_TRUE(contents() == moved(128 * KiB, 116 * KiB, 512 * KiB, 512 * KiB));
+}
+
+TEST_F(TestMove, ResumeDown)
+{
+    PartMoveProgress p;
+
+    crash(128 * KiB, 116 * KiB, 512 * KiB, 200 * KiB, 12 * KiB);
+    ASSERT_EQ(run(128 * KiB, 116 * KiB, 512 * KiB, checkpoint, &p), 0);
+    EXPECT_EQ(p.resumed, 200u * KiB);
+    EXPECT_EQ(p.done, 512u * KiB);
+    EXPECT_NE(access(checkpoint, F_OK), 0);
+    EXPECT_TRUE(contents() == moved(128 * KiB, 116 * KiB, 512 * KiB, 512 * KiB));
+}
+
+TEST_F(TestMove, ResumeUp)
+{
+    PartMoveProgress p;
+
+    crash(116 * KiB, 128 * KiB, 512 * KiB, 300 * KiB, 8 * KiB);
+    ASSERT_EQ(run(116 * KiB, 128 * KiB, 512 * KiB, checkpoint, &p), 0);
+    EXPECT_EQ(p.resumed, 300u * KiB);
+    EXPECT_TRUE(contents() == moved(116 * KiB, 128 * KiB, 512 * KiB, 512 * KiB));
+}
+
+/* the newer slot was torn while being written, the older one is used */
+TEST_F(TestMove, TornSlot)
+{
+    PartMoveCheckpoint cp;
+    PartMoveProgress p;
+
+    crash(128 * KiB, 116 * KiB, 512 * KiB, 200 * KiB, 12 * KiB);
+    write_record(128 * KiB, 116 * KiB, 512 * KiB, 212 * KiB, 5, IMAGE_SIZE, 1);
+    ASSERT_EQ(part_move_checkpoint_read(checkpoint, &cp), 1);
+    EXPECT_EQ(cp.seq, 4u);
+    EXPECT_EQ(cp.done, 200u * KiB);
+
+    /* and the intact newer one wins over the older one */
+    write_record(128 * KiB, 116 * KiB, 512 * KiB, 204 * KiB, 5, IMAGE_SIZE);
+    ASSERT_EQ(part_move_checkpoint_read(checkpoint, &cp), 1);
+    EXPECT_EQ(cp.seq, 5u);
+    EXPECT_EQ(cp.done, 204u * KiB);
+
+    write_record(128 * KiB, 116 * KiB, 512 * KiB, 212 * KiB, 5, IMAGE_SIZE, 1);
+    ASSERT_EQ(run(128 * KiB, 116 * KiB, 512 * KiB, checkpoint, &p), 0);
+    EXPECT_EQ(p.resumed, 200u * KiB);
+    EXPECT_TRUE(contents() == moved(128 * KiB, 116 * KiB, 512 * KiB, 512 * KiB));
+}
+
+TEST_F(TestMove, RefuseOtherMove)
+{
+    PartMoveProgress p;
+    std::vector<unsigned char> before;
+
+    crash(128 * KiB, 116 * KiB, 512 * KiB, 200 * KiB, 0);
+    before = contents();
+    EXPECT_EQ(run(128 * KiB, 112 * KiB, 512 * KiB, checkpoint, &p), -ESTALE);
+    EXPECT_EQ(run(128 * KiB, 116 * KiB, 256 * KiB, checkpoint, &p), -ESTALE);
+    EXPECT_EQ(access(checkpoint, F_OK), 0);
+    EXPECT_TRUE(contents() == before);
+}
+
+TEST_F(TestMove, RefuseOtherDevice)
+{
+    PartMoveProgress p;
+    std::vector<unsigned char> before;
+
+    write_record(128 * KiB, 116 * KiB, 512 * KiB, 200 * KiB, 4, 2 * IMAGE_SIZE);
+    before = contents();
+    EXPECT_EQ(run(128 * KiB, 116 * KiB, 512 * KiB, checkpoint, &p), -ENODEV);
+    EXPECT_EQ(access(checkpoint, F_OK), 0);
+    EXPECT_TRUE(contents() == before);
+}
+
+int main (int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
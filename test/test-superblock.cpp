@@ -0,0 +1,387 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+extern "C" {
+#include "../app/partitions/partitions-superblock.h"
+#include "../app/common/bitops.h"
+}
+
+#define IMAGE_SIZE      (1024 * 1024)
+
+/* where md 0.90 and 1.0 sit on a device of IMAGE_SIZE bytes */
+#define MD090_OFFSET    (IMAGE_SIZE - 64 * 1024)
+#define MD10_OFFSET     ((IMAGE_SIZE / 512 - 16) * 512)
+
+static const unsigned char testUuid[16] = {
+    0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x01,
+};
+#define TEST_UUID       "11223344-5566-7788-99aa-bbccddeeff01"
+
+static void put_le16(unsigned char* p, uint16_t v)
+{
+    v = cpu_to_le16(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static void put_le32(unsigned char* p, uint32_t v)
+{
+    v = cpu_to_le32(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static void put_le64(unsigned char* p, uint64_t v)
+{
+    v = cpu_to_le64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static void put_be32(unsigned char* p, uint32_t v)
+{
+    v = cpu_to_be32(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+static void put_str(unsigned char* p, const char* s)
+{
+    memcpy(p, s, strlen(s));
+}
+
+static void build_md(unsigned char* sb, uint64_t off, const char* label)
+{
+    memcpy(sb, "\xfc\x4e\x2b\xa9", 4);
+    put_le32(sb + 4, 1);
+    memcpy(sb + 16, testUuid, 16);
+    put_str(sb + 32, label);
+    put_le64(sb + 144, off / 512);
+}
+
+static void build_md090(unsigned char* img)
+{
+    unsigned char* sb = img + MD090_OFFSET;
+
+    /* set_uuid0 is word 5, the rest words 13 to 15 */
+    memcpy(sb, "\xfc\x4e\x2b\xa9", 4);
+    put_le32(sb + 8, 90);
+    put_le32(sb + 5 * 4, 0x11223344);
+    put_le32(sb + 13 * 4, 0x55667788);
+    put_le32(sb + 14 * 4, 0x99aabbcc);
+    put_le32(sb + 15 * 4, 0xddeeff01);
+}
+
+static void build_md10(unsigned char* img)
+{
+    build_md(img + MD10_OFFSET, MD10_OFFSET, "host:md10");
+}
+
+static void build_md11(unsigned char* img)
+{
+    build_md(img, 0, "host:md11");
+}
+
+static void build_md12(unsigned char* img)
+{
+    build_md(img + 4096, 4096, "host:md12");
+}
+
+static void build_lvm2(unsigned char* img)
+{
+    unsigned char* sb = img + 512;
+
+    put_str(sb, "LABELONE");
+    put_le64(sb + 8, 1);
+    put_le32(sb + 20, 32);
+    put_str(sb + 24, "LVM2 001");
+    put_str(sb + 32, "abcdefGHIJklmnOPQRstuvWXYZ012345");
+}
+
+static void build_bcache(unsigned char* img)
+{
+    unsigned char* sb = img + 4096;
+
+    put_le64(sb + 8, 4096 / 512);
+    memcpy(sb + 24, "\xc6\x85\x73\xf6\x4e\x1a\x45\xca\x82\x65\xf5\x7f\x48\xba\x6d\x81", 16);
+    memcpy(sb + 40, testUuid, 16);
+    put_str(sb + 72, "cache0");
+}
+
+static void build_luks1(unsigned char* img)
+{
+    put_str(img, "LUKS\xba\xbe");
+    img[7] = 1;
+    put_str(img + 168, TEST_UUID);
+}
+
+static void build_luks2(unsigned char* img)
+{
+    build_luks1(img);
+    img[7] = 2;
+    put_str(img + 24, "secret");
+}
+
+static void build_btrfs(unsigned char* img)
+{
+    unsigned char* sb = img + 0x10000;
+
+    memcpy(sb + 0x20, testUuid, 16);
+    put_le64(sb + 0x30, 0x10000);
+    put_str(sb + 0x40, "_BHRfS_M");
+    put_str(sb + 0x12b, "pool");
+}
+
+static void build_xfs(unsigned char* img)
+{
+    put_str(img, "XFSB");
+    put_be32(img + 4, 4096);
+    memcpy(img + 32, testUuid, 16);
+    put_str(img + 108, "data");
+}
+
+static void build_ext(unsigned char* img, uint32_t compat, uint32_t incompat, const char* label)
+{
+    unsigned char* sb = img + 1024;
+
+    memcpy(sb + 0x38, "\x53\xef", 2);
+    put_le16(sb + 0x3e, 0);
+    put_le32(sb + 0x4c, 1);
+    put_le32(sb + 0x5c, compat);
+    put_le32(sb + 0x60, incompat);
+    memcpy(sb + 0x68, testUuid, 16);
+    put_str(sb + 0x78, label);
+}
+
+static void build_ext2(unsigned char* img)
+{
+    build_ext(img, 0, 0x0002, "boot");
+}
+
+static void build_ext3(unsigned char* img)
+{
+    build_ext(img, 0x0004, 0x0002, "home");
+}
+
+static void build_ext4(unsigned char* img)
+{
+    build_ext(img, 0x0004, 0x0002 | 0x0040, "root");
+}
+
+static void build_jbd(unsigned char* img)
+{
+    build_ext(img, 0, 0x0008, "journal");
+}
+
+static void build_exfat(unsigned char* img)
+{
+    put_str(img + 3, "EXFAT   ");
+    put_le32(img + 0x64, 0x1234abcd);
+    img[0x68] = 0;
+    img[0x69] = 1;
+    img[510] = 0x55;
+    img[511] = 0xaa;
+}
+
+static void build_ntfs(unsigned char* img)
+{
+    put_str(img + 3, "NTFS    ");
+    put_le16(img + 0x0b, 512);
+    put_le64(img + 0x48, 0x0123456789abcdefULL);
+}
+
+static void build_fat_bpb(unsigned char* img)
+{
+    put_le16(img + 0x0b, 512);
+    img[0x0d] = 8;
+    put_le16(img + 0x0e, 32);
+    img[0x10] = 2;
+    img[510] = 0x55;
+    img[511] = 0xaa;
+}
+
+static void build_fat32(unsigned char* img)
+{
+    build_fat_bpb(img);
+    put_le32(img + 0x43, 0xdeadbeef);
+    put_str(img + 0x47, "EFI        ");
+    put_str(img + 0x52, "FAT32   ");
+}
+
+static void build_fat16(unsigned char* img)
+{
+    build_fat_bpb(img);
+    put_le32(img + 0x27, 0x0badcafe);
+    put_str(img + 0x2b, "NO NAME    ");
+    put_str(img + 0x36, "FAT16   ");
+}
+
+static void build_swap(unsigned char* img)
+{
+    put_le32(img + 1024, 1);
+    memcpy(img + 1024 + 12, testUuid, 16);
+    put_str(img + 1024 + 28, "swap0");
+    put_str(img + 4096 - 10, "SWAPSPACE2");
+}
+
+static void build_swap_old(unsigned char* img)
+{
+    put_str(img + 4096 - 10, "SWAP-SPACE");
+}
+
+struct SuperblockCase
+{
+    const char*                     name;
+    void                          (*build) (unsigned char* img);
+    const char*                     type;
+    SuperblockUsage                 usage;
+    const char*                     uuid;
+    const char*                     label;
+    const char*                     version;
+    uint64_t                        offset;
+};
+
+static const SuperblockCase superblockCases[] = {
+    { "md090", build_md090, "linux_raid_member", SUPERBLOCK_USAGE_RAID, TEST_UUID, "", "0.90.0", MD090_OFFSET },
+    { "md10", build_md10, "linux_raid_member", SUPERBLOCK_USAGE_RAID, TEST_UUID, "host:md10", "1.0", MD10_OFFSET },
+    { "md11", build_md11, "linux_raid_member", SUPERBLOCK_USAGE_RAID, TEST_UUID, "host:md11", "1.1", 0 },
+    { "md12", build_md12, "linux_raid_member", SUPERBLOCK_USAGE_RAID, TEST_UUID, "host:md12", "1.2", 4096 },
+    { "lvm2", build_lvm2, "LVM2_member", SUPERBLOCK_USAGE_RAID, "abcdef-GHIJ-klmn-OPQR-stuv-WXYZ-012345", "",
+      "LVM2 001", 512 },
+    { "bcache", build_bcache, "bcache", SUPERBLOCK_USAGE_OTHER, TEST_UUID, "cache0", "", 4096 },
+    { "luks1", build_luks1, "crypto_LUKS", SUPERBLOCK_USAGE_CRYPTO, TEST_UUID, "", "1", 0 },
+    { "luks2", build_luks2, "crypto_LUKS", SUPERBLOCK_USAGE_CRYPTO, TEST_UUID, "secret", "2", 0 },
+    { "btrfs", build_btrfs, "btrfs", SUPERBLOCK_USAGE_FILESYSTEM, TEST_UUID, "pool", "", 0x10000 },
+    { "xfs", build_xfs, "xfs", SUPERBLOCK_USAGE_FILESYSTEM, TEST_UUID, "data", "", 0 },
+    { "ext2", build_ext2, "ext2", SUPERBLOCK_USAGE_FILESYSTEM, TEST_UUID, "boot", "1.0", 1024 },
+    { "ext3", build_ext3, "ext3", SUPERBLOCK_USAGE_FILESYSTEM, TEST_UUID, "home", "1.0", 1024 },
+    { "ext4", build_ext4, "ext4", SUPERBLOCK_USAGE_FILESYSTEM, TEST_UUID, "root", "1.0", 1024 },
+    { "jbd", build_jbd, "jbd", SUPERBLOCK_USAGE_OTHER, TEST_UUID, "journal", "1.0", 1024 },
+    { "exfat", build_exfat, "exfat", SUPERBLOCK_USAGE_FILESYSTEM, "1234-ABCD", "", "1.0", 0 },
+    { "ntfs", build_ntfs, "ntfs", SUPERBLOCK_USAGE_FILESYSTEM, "0123456789ABCDEF", "", "", 0 },
+    { "fat32", build_fat32, "vfat", SUPERBLOCK_USAGE_FILESYSTEM, "DEAD-BEEF", "EFI", "FAT32", 0 },
+    { "fat16", build_fat16, "vfat", SUPERBLOCK_USAGE_FILESYSTEM, "0BAD-CAFE", "", "FAT16", 0 },
+    { "swap", build_swap, "swap", SUPERBLOCK_USAGE_OTHER, TEST_UUID, "swap0", "1", 0 },
+    { "swap0", build_swap_old, "swap", SUPERBLOCK_USAGE_OTHER, "", "", "0", 0 },
+};
+
+class TestSuperblockProbe : public ::testing::Test
+{
+protected:
+    std::vector<unsigned char> img;
+    SuperblockCxt cxt;
+
+    void SetUp() override
+    {
+        img.assign(IMAGE_SIZE, 0);
+    }
+
+    /* the whole image as one read, the prober only ever looks at the buffers */
+    size_t probe(SuperblockResult* res, size_t max)
+    {
+        memset(&cxt, 0, sizeof(cxt));
+        cxt.fd = -1;
+        cxt.size = img.size();
+        cxt.buf = img.data();
+        cxt.bufSize = img.size();
+        cxt.reads[0].size = img.size();
+        cxt.nreads = 1;
+
+        return superblock_probe_all(&cxt, res, max);
+    }
+};
+
+class TestSuperblock : public TestSuperblockProbe, public ::testing::WithParamInterface<SuperblockCase>
+{
+};
+
+TEST_P(TestSuperblock, Probe)
+{
+    const SuperblockCase& c = GetParam();
+    SuperblockResult res[4];
+
+    c.build(img.data());
+    ASSERT_EQ(probe(res, 4), 1u);
+    EXPECT_STREQ(res[0].type, c.type);
+    EXPECT_EQ(res[0].usage, c.usage);
+    EXPECT_STREQ(res[0].uuid, c.uuid);
+    EXPECT_STREQ(res[0].label, c.label);
+    EXPECT_STREQ(res[0].version, c.version);
+    EXPECT_EQ(res[0].offset, c.offset);
+}
+
+INSTANTIATE_TEST_SUITE_P(Types, TestSuperblock, ::testing::ValuesIn(superblockCases),
+                         [](const ::testing::TestParamInfo<SuperblockCase>& info) {
+                             return std::string(info.param.name);
+                         });
+
+/* the container comes first, the filesystem found inside it second */
+TEST_F(TestSuperblockProbe, ContainerFirst)
+{
+    SuperblockResult res[4];
+
+    build_ext4(img.data());
+    build_md12(img.data());
+    ASSERT_EQ(probe(res, 4), 2u);
+    EXPECT_STREQ(res[0].type, "linux_raid_member");
+    EXPECT_STREQ(res[1].type, "ext4");
+
+    ASSERT_EQ(probe(res, 1), 1u);
+    EXPECT_STREQ(res[0].type, "linux_raid_member");
+    EXPECT_EQ(probe(res, 0), 0u);
+}
+
+/* a magic alone is not enough, the fields checked by the probers have to agree */
+TEST_F(TestSuperblockProbe, StaleCopies)
+{
+    SuperblockResult res[4];
+
+    build_md12(img.data());
+    put_le64(img.data() + 4096 + 144, 0);
+    build_btrfs(img.data());
+    put_le64(img.data() + 0x10000 + 0x30, 0x20000);
+    build_xfs(img.data());
+    put_be32(img.data() + 4, 3000);
+    EXPECT_EQ(probe(res, 4), 0u);
+}
+
+/* the size comes from the fd without moving its offset */
+TEST_F(TestSuperblockProbe, FromFile)
+{
+    char path[64];
+    SuperblockResult res;
+    int fd;
+
+    snprintf(path, sizeof(path), "/tmp/test-superblock-%d.img", (int) getpid());
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ASSERT_GE(fd, 0);
+    unlink(path);
+
+    build_ext4(img.data());
+    ASSERT_EQ(pwrite(fd, img.data(), img.size(), 0), IMAGE_SIZE);
+    ASSERT_EQ(lseek(fd, 100, SEEK_SET), 100);
+
+    ASSERT_EQ(superblock_init(&cxt, fd, 0), 0);
+    EXPECT_EQ(cxt.size, (uint64_t) IMAGE_SIZE);
+    EXPECT_EQ(lseek(fd, 0, SEEK_CUR), 100);
+    superblock_deinit(&cxt);
+
+    ASSERT_EQ(superblock_probe(fd, &res), 1);
+    EXPECT_STREQ(res.type, "ext4");
+    EXPECT_STREQ(res.label, "root");
+    EXPECT_EQ(lseek(fd, 0, SEEK_CUR), 100);
+    close(fd);
+}
+
+int main (int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,269 @@
+//
+// Created by dingjing on 10/17/26.
+//
+
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "../app/common/hash64.h"
+#include "../app/common/blkverify.h"
+}
+
+#define CHUNK       4096
+#define NCHUNKS     37
+
+static std::vector<unsigned char> random_bytes(size_t len, unsigned int seed)
+{
+    std::vector<unsigned char> buf(len);
+    size_t i;
+
+    srand(seed);
+    for (i = 0; i < len; i++)
+        buf[i] = (unsigned char) rand();
+
+    return buf;
+}
+
+/* every implementation must give the value of the scalar one */
+TEST(TestHash64, ImplsAgree) {
+    static const char* impls[] = { "sse2", "avx2" };
+    std::vector<unsigned char> buf = random_bytes(3 * 1024 * 1024 + 77, 1);
+    std::vector<uint64_t> want;
+    const char* orig = hash64_impl();
+    size_t len, i, k;
+
+    ASSERT_EQ(hash64_set_impl("scalar"), 0);
+    /* short inputs, both sides of a stripe, a scramble block and big ones */
+    for (len = 0; len < 2200; len++)
+        want.push_back(hash64(buf.data() + 1, len, len));
+    for (len = 4096; len <= buf.size() - 1; len = len * 3 + 5)
+        want.push_back(hash64(buf.data() + 1, len, 7));
+
+    for (k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        if (hash64_set_impl(impls[k]) != 0)
+            continue;
+        i = 0;
+        for (len = 0; len < 2200; len++)
+            ASSERT_EQ(hash64(buf.data() + 1, len, len), want[i++]) << impls[k] << " len " << len;
+        for (len = 4096; len <= buf.size() - 1; len = len * 3 + 5)
+            ASSERT_EQ(hash64(buf.data() + 1, len, 7), want[i++]) << impls[k] << " len " << len;
+    }
+
+    EXPECT_EQ(hash64_set_impl("neon"), -ENOTSUP);
+    ASSERT_EQ(hash64_set_impl(orig), 0);
+}
+
+TEST(TestHash64, SeedAndContent) {
+    std::vector<unsigned char> buf = random_bytes(8192, 2);
+    uint64_t h = hash64(buf.data(), buf.size(), 0);
+
+    EXPECT_EQ(hash64(buf.data(), buf.size(), 0), h);
+    EXPECT_NE(hash64(buf.data(), buf.size(), 1), h);
+    buf[4000] ^= 1;
+    EXPECT_NE(hash64(buf.data(), buf.size(), 0), h);
+}
+
+class TestVerify : public ::testing::Test
+{
+protected:
+    char a[64];
+    char b[64];
+
+    void SetUp() override
+    {
+        snprintf(a, sizeof(a), "/tmp/test-verify-%d.a", (int) getpid());
+        snprintf(b, sizeof(b), "/tmp/test-verify-%d.b", (int) getpid());
+    }
+
+    void TearDown() override
+    {
+        unlink(a);
+        unlink(b);
+    }
+
+    static void write_file(const char* path, const std::vector<unsigned char>& data)
+    {
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(write(fd, data.data(), data.size()), (ssize_t) data.size());
+        close(fd);
+    }
+
+    static int run(const char* path, BlkVerifyManifest* m)
+    {
+        BlkVerify opts;
+
+        memset(&opts, 0, sizeof(opts));
+        opts.chunkSize = CHUNK;
+        opts.nthreads = 4;
+
+        return blkverify_run(path, &opts, m, NULL);
+    }
+};
+
+static void collect(uint64_t offset, uint64_t length, void* data)
+{
+    ((std::vector<std::pair<uint64_t, uint64_t>>*) data)->push_back(std::make_pair(offset, length));
+}
+
+TEST_F(TestVerify, Compare) {
+    std::vector<unsigned char> data = random_bytes(NCHUNKS * CHUNK - 100, 3);
+    std::vector<std::pair<uint64_t, uint64_t>> runs;
+    BlkVerifyManifest ma, mb;
+
+    write_file(a, data);
+    data[3 * CHUNK] ^= 1;
+    data[5 * CHUNK - 1] ^= 1;
+    data[20 * CHUNK + 10] ^= 1;
+    data[data.size() - 1] ^= 1;
+    write_file(b, data);
+
+    ASSERT_EQ(run(a, &ma), 0);
+    ASSERT_EQ(run(b, &mb), 0);
+    EXPECT_EQ(ma.nchunks, (uint64_t) NCHUNKS);
+    EXPECT_EQ(blkverify_compare(&ma, &ma, NULL, NULL), 0);
+
+    EXPECT_EQ(blkverify_compare(&ma, &mb, collect, &runs), 4);
+    ASSERT_EQ(runs.size(), 3u);
+    EXPECT_EQ(runs[0], std::make_pair((uint64_t) 3 * CHUNK, (uint64_t) 2 * CHUNK));
+    EXPECT_EQ(runs[1], std::make_pair((uint64_t) 20 * CHUNK, (uint64_t) CHUNK));
+    /* the last chunk is short */
+    EXPECT_EQ(runs[2], std::make_pair((uint64_t) (NCHUNKS - 1) * CHUNK, (uint64_t) CHUNK - 100));
+
+    blkverify_manifest_deinit(&ma);
+    blkverify_manifest_deinit(&mb);
+}
+
+TEST_F(TestVerify, CompareSizeMismatch) {
+    BlkVerifyManifest ma, mb;
+
+    write_file(a, random_bytes(4 * CHUNK, 4));
+    write_file(b, random_bytes(5 * CHUNK, 4));
+    ASSERT_EQ(run(a, &ma), 0);
+    ASSERT_EQ(run(b, &mb), 0);
+    EXPECT_EQ(blkverify_compare(&ma, &mb, NULL, NULL), -EINVAL);
+    blkverify_manifest_deinit(&ma);
+    blkverify_manifest_deinit(&mb);
+}
+
+/* a hole is hashed without reading, it must look like written zeroes */
+TEST_F(TestVerify, HolesHashAsZeroes) {
+    std::vector<unsigned char> zero(NCHUNKS * CHUNK, 0);
+    BlkVerifyManifest ma, mb;
+    int fd;
+
+    write_file(a, zero);
+    fd = open(b, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(ftruncate(fd, zero.size()), 0);
+    close(fd);
+
+    ASSERT_EQ(run(a, &ma), 0);
+    ASSERT_EQ(run(b, &mb), 0);
+    EXPECT_EQ(blkverify_manifest_root(&ma), blkverify_manifest_root(&mb));
+    EXPECT_EQ(blkverify_compare(&ma, &mb, NULL, NULL), 0);
+    blkverify_manifest_deinit(&ma);
+    blkverify_manifest_deinit(&mb);
+}
+
+TEST_F(TestVerify, ManifestRoundTrip) {
+    BlkVerifyManifest m, r;
+    FILE* f;
+
+    write_file(a, random_bytes(NCHUNKS * CHUNK - 1, 5));
+    ASSERT_EQ(run(a, &m), 0);
+
+    f = tmpfile();
+    ASSERT_NE(f, nullptr);
+    ASSERT_EQ(blkverify_write_manifest(&m, f), 0);
+    rewind(f);
+    ASSERT_EQ(blkverify_read_manifest(&r, f), 0);
+    fclose(f);
+
+    EXPECT_EQ(r.offset, m.offset);
+    EXPECT_EQ(r.size, m.size);
+    EXPECT_EQ(r.chunkSize, m.chunkSize);
+    EXPECT_EQ(r.nchunks, m.nchunks);
+    EXPECT_EQ(blkverify_manifest_root(&r), blkverify_manifest_root(&m));
+    EXPECT_EQ(blkverify_compare(&m, &r, NULL, NULL), 0);
+
+    blkverify_manifest_deinit(&r);
+    blkverify_manifest_deinit(&m);
+}
+
+static int read_text(const std::string& text, BlkVerifyManifest* m)
+{
+    FILE* f = fmemopen((void*) text.data(), text.size(), "r");
+    int rc;
+
+    if (!f)
+        return -errno;
+    rc = blkverify_read_manifest(m, f);
+    fclose(f);
+
+    return rc;
+}
+
+TEST_F(TestVerify, ManifestBadRoot) {
+    BlkVerifyManifest m, r;
+    std::string text, bad;
+    char* buf = NULL;
+    size_t len = 0, pos;
+    FILE* f;
+
+    write_file(a, random_bytes(NCHUNKS * CHUNK, 6));
+    ASSERT_EQ(run(a, &m), 0);
+    f = open_memstream(&buf, &len);
+    ASSERT_NE(f, nullptr);
+    ASSERT_EQ(blkverify_write_manifest(&m, f), 0);
+    fclose(f);
+    text = std::string(buf, len);
+    free(buf);
+
+    ASSERT_EQ(read_text(text, &r), 0);
+    blkverify_manifest_deinit(&r);
+
+    /* another root */
+    pos = text.find("root=");
+    ASSERT_NE(pos, std::string::npos);
+    bad = text;
+    bad[pos + 5] = bad[pos + 5] == '0' ? '1' : '0';
+    EXPECT_EQ(read_text(bad, &r), -EBADMSG);
+    blkverify_manifest_deinit(&r);
+
+    /* a changed chunk hash no longer adds up to the root */
+    pos = text.find('\n') + 1;
+    pos = text.find(' ', pos) + 1;
+    bad = text;
+    bad[pos] = bad[pos] == '0' ? '1' : '0';
+    EXPECT_EQ(read_text(bad, &r), -EBADMSG);
+    blkverify_manifest_deinit(&r);
+
+    /* a missing chunk */
+    bad = text.substr(0, text.rfind('\n', text.size() - 2) + 1);
+    EXPECT_EQ(read_text(bad, &r), -EBADMSG);
+    blkverify_manifest_deinit(&r);
+
+    EXPECT_EQ(read_text("manifest version=2", &r), -EBADMSG);
+    blkverify_manifest_deinit(&r);
+
+    blkverify_manifest_deinit(&m);
+}
+
+int main (int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    return RUN_ALL_TESTS();
+}